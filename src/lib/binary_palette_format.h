@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+namespace palette {
+
+// On-disk layout of a binary palette file, designed to be memory-mapped and
+// used in place. All integers are stored in host byte order, which readers
+// verify through byte_order_. Every section begins on an 8-byte boundary.
+//
+//   header        BinaryPaletteHeader
+//   colors        uint32_t[num_colors_], each packed as 0x00RRGGBB
+//   columns       for each present string column, uint32_t[num_colors_ + 1]
+//                 offsets into the string table; string i spans
+//                 [offset[i], offset[i + 1] - 1) and is NUL-terminated
+//   strings       string table beginning with a single NUL byte
+struct BinaryPaletteHeader final {
+    enum Column : uint32_t {
+        name_column,
+        keyword_column,
+        comment_column,
+        num_columns
+    };
+
+    static constexpr char magic_string[8] = {
+        'P', 'A', 'L', 'P', 'I', 'C', 'K', '\0' };
+    static constexpr uint32_t byte_order_mark = 0x01020304;
+    static constexpr uint32_t current_version = 1;
+
+    char magic_[8];
+    uint32_t byte_order_;
+    uint32_t version_;
+    uint64_t num_colors_;
+    uint64_t colors_offset_;
+    // Zero if the column is absent.
+    uint64_t column_offsets_[num_columns];
+    uint64_t strings_offset_;
+    uint64_t strings_size_;
+    // String table offsets of the palette's own name and comment.
+    uint32_t palette_name_offset_;
+    uint32_t palette_comment_offset_;
+};
+
+static_assert(sizeof(BinaryPaletteHeader) == 80,
+              "Binary palette header layout changed");
+}  // namespace palette
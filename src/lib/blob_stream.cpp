@@ -0,0 +1,42 @@
+#include "lib/blob_stream.h"
+
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#include <Magick++.h>
+
+namespace palette {
+
+bool BlobStream::read(std::istream &in, Magick::Blob &blob,
+                      std::stringstream &error_stream) {
+    std::vector<char> bytes{std::istreambuf_iterator<char>(in),
+                            std::istreambuf_iterator<char>()};
+    if (in.bad()) {
+        error_stream << "Failed to read image from standard input"
+            << std::endl;
+        return false;
+    }
+    if (bytes.empty()) {
+        error_stream << "No image data on standard input" << std::endl;
+        return false;
+    }
+    // The blob keeps its own copy of the bytes.
+    blob = Magick::Blob(bytes.data(), bytes.size());
+    return true;
+}
+
+bool BlobStream::write(const Magick::Blob &blob, std::ostream &out,
+                       std::stringstream &error_stream) {
+    out.write(static_cast<const char *>(blob.data()),
+              static_cast<std::streamsize>(blob.length()));
+    out.flush();
+    if (!out) {
+        error_stream << "Failed to write image to standard output"
+            << std::endl;
+        return false;
+    }
+    return true;
+}
+}  // namespace palette
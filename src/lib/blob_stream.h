@@ -0,0 +1,24 @@
+#pragma once
+
+#include <iostream>
+#include <sstream>
+
+#include <Magick++.h>
+
+namespace palette {
+
+// Moves encoded images between standard streams and blobs, so that tools can
+// read an image from stdin or write one to stdout with "-" as the file name.
+class BlobStream {
+ public:
+    // Read everything left in in into blob. Return whether or not the
+    // stream held any bytes and was read without error.
+    static bool read(std::istream &in, Magick::Blob &blob,
+                     std::stringstream &error_stream);
+
+    // Write every byte of blob to out and flush it. Return whether or not
+    // the write succeeded.
+    static bool write(const Magick::Blob &blob, std::ostream &out,
+                      std::stringstream &error_stream);
+};
+}  // namespace palette
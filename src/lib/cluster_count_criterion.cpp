@@ -0,0 +1,47 @@
+#include "lib/cluster_count_criterion.h"
+
+#include <string>
+
+namespace palette {
+
+ClusterCountCriterion::ClusterCountCriterion(Value value) : value_(value) { }
+
+ClusterCountCriterion::ClusterCountCriterion(const std::string &value_str) :
+    value_(value_from_string(value_str)) { }
+
+ClusterCountCriterion::ClusterCountCriterion(
+    const ClusterCountCriterion &other) :
+    value_(other.value_) { }
+
+ClusterCountCriterion::Value ClusterCountCriterion::get() const {
+    return value_;
+}
+
+bool ClusterCountCriterion::valid() const {
+    return value_ != Value::unknown;
+}
+
+std::string ClusterCountCriterion::to_string() const {
+    return value_to_string(value_);
+}
+
+ClusterCountCriterion::Value ClusterCountCriterion::value_from_string(
+    const std::string &value_str) {
+    if (value_str.compare(value_to_string(Value::elbow)) == 0) {
+        return Value::elbow;
+    }
+    if (value_str.compare(value_to_string(Value::silhouette)) == 0) {
+        return Value::silhouette;
+    }
+    return Value::unknown;
+}
+
+std::string ClusterCountCriterion::value_to_string(const Value value) {
+    switch (value) {
+        case ClusterCountCriterion::Value::elbow: return "elbow";
+        case ClusterCountCriterion::Value::silhouette: return "silhouette";
+        default: break;
+    }
+    return "unknown";
+}
+}  // namespace palette
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+namespace palette {
+
+class ClusterCountCriterion {
+ public:
+    enum class Value { elbow, silhouette, unknown };
+
+    explicit ClusterCountCriterion(Value value);
+    explicit ClusterCountCriterion(const std::string &value_str);
+    ClusterCountCriterion(const ClusterCountCriterion &other);
+
+    Value get() const;
+    bool valid() const;
+    std::string to_string() const;
+
+    static Value value_from_string(const std::string &value_str);
+    static std::string value_to_string(const Value value);
+
+ private:
+    Value value_;
+};
+}  // namespace palette
@@ -0,0 +1,291 @@
+#include "lib/cluster_count_search.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "lib/cluster_count_criterion.h"
+#include "lib/color.h"
+#include "lib/color_histogram.h"
+#include "lib/color_k_means.h"
+#include "lib/packed_color.h"
+#include "lib/parallel.h"
+
+namespace palette {
+namespace {
+
+using Point = std::array<float, 3>;
+
+// Colors drawn from a histogram with the distances between every pair.
+struct SilhouetteSample final {
+    explicit SilhouetteSample(const ColorHistogram &histogram);
+
+    // Return the mean silhouette of the sample colors when each belongs to
+    // its nearest centroid.
+    double get_silhouette(const std::vector<Color> &centroids) const;
+
+    std::vector<Point> points_;
+    std::vector<float> distances_;
+};
+
+Point to_point(uint32_t rgb);
+
+float distance(const Point &a, const Point &b);
+
+// Return the number of clusters at the elbow of the inertia curve: the
+// point farthest below the line between its ends once both axes are
+// scaled to [0, 1].
+size_t get_elbow(const std::vector<ClusterCountSearch::Score> &scores);
+}  // namespace
+
+ClusterCountSearch::ClusterCountSearch(size_t min_clusters,
+                                       size_t max_clusters,
+                                       ClusterCountCriterion criterion) :
+    min_clusters_(min_clusters),
+    max_clusters_(max_clusters),
+    criterion_(criterion.get()),
+    scores_(),
+    best_num_clusters_(0) { }
+
+ClusterCountSearch::ClusterCountSearch(const ClusterCountSearch &other) :
+    min_clusters_(other.min_clusters_),
+    max_clusters_(other.max_clusters_),
+    criterion_(other.criterion_),
+    scores_(other.scores_),
+    best_num_clusters_(other.best_num_clusters_) { }
+
+ClusterCountSearch &ClusterCountSearch::operator=(
+    const ClusterCountSearch &other) {
+    min_clusters_ = other.min_clusters_;
+    max_clusters_ = other.max_clusters_;
+    criterion_ = other.criterion_;
+    scores_ = other.scores_;
+    best_num_clusters_ = other.best_num_clusters_;
+    return *this;
+}
+
+bool ClusterCountSearch::run(const ColorHistogram &histogram,
+                             const ColorKMeans::Settings &settings,
+                             std::stringstream &error_stream) {
+    scores_.clear();
+    best_num_clusters_ = 0;
+    if (criterion_ == ClusterCountCriterion::Value::unknown) {
+        error_stream << "Unknown cluster count criterion" << std::endl;
+        return false;
+    }
+    if ((min_clusters_ == 0) || (min_clusters_ > max_clusters_)) {
+        error_stream << "Invalid range of numbers of clusters "
+            << min_clusters_ << "-" << max_clusters_ << std::endl;
+        return false;
+    }
+    if (histogram.empty()) {
+        error_stream << "No colors to cluster" << std::endl;
+        return false;
+    }
+    const size_t max_clusters = std::min(max_clusters_, histogram.size());
+    const size_t min_clusters = std::min(min_clusters_, max_clusters);
+    const size_t num_counts = max_clusters - min_clusters + 1;
+    const SilhouetteSample sample(histogram);
+
+    scores_.resize(num_counts);
+    const size_t num_parts =
+        std::min(num_counts, Parallel::default_num_threads());
+    Parallel::run(num_parts, [&](size_t part) {
+        const size_t begin = (part * num_counts) / num_parts;
+        const size_t end = ((part + 1) * num_counts) / num_parts;
+        std::vector<Color> centroids;
+        for (size_t i = begin; i < end; ++i) {
+            const size_t num_clusters = min_clusters + i;
+            ColorKMeans::find_weighted_clusters(
+                num_clusters,
+                (i == begin) ? ColorKMeans::SeedMode::static_spread
+                    : ColorKMeans::SeedMode::keep_existing,
+                histogram, settings, centroids);
+            scores_[i].num_clusters_ = num_clusters;
+            scores_[i].inertia_ =
+                ColorKMeans::get_inertia(histogram, centroids);
+            scores_[i].silhouette_ = sample.get_silhouette(centroids);
+        }
+    });
+
+    if (criterion_ == ClusterCountCriterion::Value::elbow) {
+        best_num_clusters_ = get_elbow(scores_);
+    } else {
+        best_num_clusters_ = std::max_element(
+            scores_.begin(), scores_.end(),
+            [](const Score &a, const Score &b) {
+                return a.silhouette_ < b.silhouette_;
+            })->num_clusters_;
+    }
+    return true;
+}
+
+const std::vector<ClusterCountSearch::Score> &
+ClusterCountSearch::get_scores() const {
+    return scores_;
+}
+
+size_t ClusterCountSearch::get_best_num_clusters() const {
+    return best_num_clusters_;
+}
+
+std::string ClusterCountSearch::to_string() const {
+    std::stringstream string_stream;
+    string_stream << "clusters inertia silhouette" << std::endl;
+    for (const Score &score : scores_) {
+        string_stream << score.num_clusters_ << " "
+            << std::setprecision(6) << score.inertia_ << " "
+            << std::fixed << std::setprecision(4) << score.silhouette_
+            << std::defaultfloat
+            << ((score.num_clusters_ == best_num_clusters_) ? " *" : "")
+            << std::endl;
+    }
+    return string_stream.str();
+}
+
+namespace {
+
+SilhouetteSample::SilhouetteSample(const ColorHistogram &histogram) :
+    points_(),
+    distances_() {
+    if (histogram.size() <= ClusterCountSearch::silhouette_sample_size) {
+        // Small histograms are used whole; repeat heavy colors roughly in
+        // proportion to their weights so they count as much.
+        const double total = histogram.total_weight();
+        for (size_t i = 0; i < histogram.size(); ++i) {
+            const size_t copies = std::max<size_t>(1, static_cast<size_t>(
+                (histogram.weight(i) / total)
+                * ClusterCountSearch::silhouette_sample_size));
+            points_.insert(points_.end(), copies,
+                           to_point(histogram.rgb24(i)));
+        }
+    } else {
+        // A fixed seed keeps the choice of k reproducible.
+        std::vector<double> cumulative(histogram.size());
+        double total = 0.0;
+        for (size_t i = 0; i < histogram.size(); ++i) {
+            total += histogram.weight(i);
+            cumulative[i] = total;
+        }
+        std::mt19937_64 generator(0);
+        for (size_t s = 0; s < ClusterCountSearch::silhouette_sample_size;
+             ++s) {
+            const double target = static_cast<double>(generator() >> 11)
+                * (1.0 / 9007199254740992.0) * total;
+            const size_t i = std::min<size_t>(
+                std::upper_bound(cumulative.begin(), cumulative.end(), target)
+                - cumulative.begin(), histogram.size() - 1);
+            points_.push_back(to_point(histogram.rgb24(i)));
+        }
+    }
+    const size_t n = points_.size();
+    distances_.resize(n * n);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i; j < n; ++j) {
+            distances_[(i * n) + j] = distances_[(j * n) + i] =
+                distance(points_[i], points_[j]);
+        }
+    }
+}
+
+double SilhouetteSample::get_silhouette(
+    const std::vector<Color> &centroids) const {
+    const size_t num_clusters = centroids.size();
+    const size_t n = points_.size();
+    if ((num_clusters < 2) || (n == 0)) {
+        return 0.0;
+    }
+    std::vector<Point> means;
+    for (const Color &centroid : centroids) {
+        means.push_back(to_point(centroid.to_rgb24()));
+    }
+    std::vector<size_t> labels(n);
+    std::vector<size_t> sizes(num_clusters, 0);
+    for (size_t i = 0; i < n; ++i) {
+        float nearest_distance = std::numeric_limits<float>::max();
+        for (size_t c = 0; c < num_clusters; ++c) {
+            const float d = distance(points_[i], means[c]);
+            if (d < nearest_distance) {
+                labels[i] = c;
+                nearest_distance = d;
+            }
+        }
+        ++sizes[labels[i]];
+    }
+
+    double silhouette_sum = 0.0;
+    std::vector<double> cluster_distances(num_clusters);
+    for (size_t i = 0; i < n; ++i) {
+        const size_t own = labels[i];
+        if (sizes[own] < 2) {
+            continue;
+        }
+        std::fill(cluster_distances.begin(), cluster_distances.end(), 0.0);
+        const float *row = &distances_[i * n];
+        for (size_t j = 0; j < n; ++j) {
+            cluster_distances[labels[j]] += row[j];
+        }
+        const double a = cluster_distances[own] / (sizes[own] - 1);
+        double b = std::numeric_limits<double>::max();
+        for (size_t c = 0; c < num_clusters; ++c) {
+            if ((c != own) && (sizes[c] > 0)) {
+                b = std::min(b, cluster_distances[c] / sizes[c]);
+            }
+        }
+        if (b == std::numeric_limits<double>::max()) {
+            continue;
+        }
+        const double scale = std::max(a, b);
+        if (scale > 0.0) {
+            silhouette_sum += (b - a) / scale;
+        }
+    }
+    return silhouette_sum / n;
+}
+
+Point to_point(uint32_t rgb) {
+    const PackedColor8 color = PackedColor8::from_rgb24(rgb);
+    return Point{static_cast<float>(color.red_),
+                 static_cast<float>(color.green_),
+                 static_cast<float>(color.blue_)};
+}
+
+float distance(const Point &a, const Point &b) {
+    const float d0 = a[0] - b[0];
+    const float d1 = a[1] - b[1];
+    const float d2 = a[2] - b[2];
+    return std::sqrt((d0 * d0) + (d1 * d1) + (d2 * d2));
+}
+
+size_t get_elbow(const std::vector<ClusterCountSearch::Score> &scores) {
+    const ClusterCountSearch::Score &first = scores.front();
+    const ClusterCountSearch::Score &last = scores.back();
+    const double inertia_range = first.inertia_ - last.inertia_;
+    if ((scores.size() < 3) || (inertia_range <= 0.0)) {
+        return first.num_clusters_;
+    }
+    const double count_range = static_cast<double>(
+        last.num_clusters_ - first.num_clusters_);
+    size_t elbow = first.num_clusters_;
+    double elbow_gap = 0.0;
+    for (const auto &score : scores) {
+        const double x = (score.num_clusters_ - first.num_clusters_)
+            / count_range;
+        const double y = (first.inertia_ - score.inertia_) / inertia_range;
+        if ((y - x) > elbow_gap) {
+            elbow = score.num_clusters_;
+            elbow_gap = y - x;
+        }
+    }
+    return elbow;
+}
+}  // namespace
+}  // namespace palette
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "lib/cluster_count_criterion.h"
+#include "lib/color_k_means.h"
+
+namespace palette {
+
+class ColorHistogram;
+
+// Clusters a histogram with every number of clusters in a range and picks
+// the number that best fits the colors by a criterion: the elbow of the
+// inertia curve, or the highest mean silhouette over a sample of colors.
+class ClusterCountSearch {
+ public:
+    static const size_t default_min_clusters = 2;
+    static const size_t default_max_clusters = 16;
+    // Silhouettes are measured on at most this many histogram colors,
+    // drawn in proportion to their weights.
+    static const size_t silhouette_sample_size = 1000;
+
+    struct Score final {
+        size_t num_clusters_;
+        double inertia_;
+        double silhouette_;
+    };
+
+    ClusterCountSearch(size_t min_clusters, size_t max_clusters,
+                       ClusterCountCriterion criterion);
+    ClusterCountSearch(const ClusterCountSearch &other);
+
+    ClusterCountSearch &operator=(const ClusterCountSearch &other);
+
+    // Score every number of clusters in the range. Contiguous parts of the
+    // range are scored in parallel, each number warm-starting from the
+    // clusters of the number before it. Return whether or not the range is
+    // valid for the histogram.
+    bool run(const ColorHistogram &histogram,
+             const ColorKMeans::Settings &settings,
+             std::stringstream &error_stream);
+
+    const std::vector<Score> &get_scores() const;
+    size_t get_best_num_clusters() const;
+
+    // Return one line per number of clusters with its inertia and
+    // silhouette, marking the chosen number.
+    std::string to_string() const;
+
+ private:
+    size_t min_clusters_;
+    size_t max_clusters_;
+    ClusterCountCriterion::Value criterion_;
+    std::vector<Score> scores_;
+    size_t best_num_clusters_;
+};
+}  // namespace palette
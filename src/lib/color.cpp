@@ -1,5 +1,6 @@
 #include "lib/color.h"
 
+#include <cstdint>
 #include <iomanip>
 #include <sstream>
 #include <string>
@@ -7,6 +8,9 @@
 
 #include <Magick++.h>
 
+#include "lib/fixed_hsl.h"
+#include "lib/packed_color.h"
+
 namespace palette {
 
 Color::Color() : color_() { }
@@ -49,15 +53,16 @@ bool Color::lessThanRgb(const Color &left, const Color &right) {
 }
 
 bool Color::lessThanHsl(const Color &left, const Color &right) {
-    Magick::ColorHSL left_hsl(left.color_);
-    Magick::ColorHSL right_hsl(right.color_);
-    if (left_hsl.hue() == right_hsl.hue()) {
-        if (left_hsl.saturation() == right_hsl.saturation()) {
-            return (left_hsl.lightness() < right_hsl.lightness());
-        }
-        return (left_hsl.saturation() < right_hsl.saturation());
-    }
-    return (left_hsl.hue() < right_hsl.hue());
+    return FixedHsl::from_magick(left.color_)
+        < FixedHsl::from_magick(right.color_);
+}
+
+Color Color::from_rgb24(uint32_t rgb) {
+    return Color(PackedColor8::from_rgb24(rgb).to_magick());
+}
+
+uint32_t Color::to_rgb24() const {
+    return PackedColor8::from_magick(color_).to_rgb24();
 }
 
 Magick::Color &Color::get() { return color_; }
@@ -67,10 +72,7 @@ const Magick::Color &Color::get() const { return color_; }
 std::string Color::to_string() const {
     std::ostringstream hex_stringstream;
     hex_stringstream << std::setfill('0') << std::hex << std::uppercase;
-    hex_stringstream << "#"
-        << std::setw(2) << (static_cast<int>(color_.quantumRed()) >> 8)
-        << std::setw(2) << (static_cast<int>(color_.quantumGreen()) >> 8)
-        << std::setw(2) << (static_cast<int>(color_.quantumBlue()) >> 8);
+    hex_stringstream << "#" << std::setw(6) << to_rgb24();
     return hex_stringstream.str();
 }
 }  // namespace palette
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 #include <Magick++.h>
@@ -23,6 +24,10 @@ class Color {
     static bool lessThanRgb(const Color &left, const Color &right);
     static bool lessThanHsl(const Color &left, const Color &right);
 
+    // Convert to and from 8 bits per channel packed as 0xRRGGBB.
+    static Color from_rgb24(uint32_t rgb);
+    uint32_t to_rgb24() const;
+
     Magick::Color &get();
     const Magick::Color &get() const;
 
@@ -0,0 +1,261 @@
+#include "lib/color_counter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <Magick++.h>
+
+#include "lib/color_histogram.h"
+#include "lib/image_rows.h"
+#include "lib/kernels.h"
+#include "lib/parallel.h"
+#include "lib/pixel_view.h"
+#include "lib/sample_weights.h"
+
+namespace palette {
+namespace {
+
+const uint32_t empty_key = 0xFFFFFFFF;
+const size_t num_dense_colors = 1 << 24;
+const size_t num_estimate_rows = 64;
+
+// Open-addressing hash table from 0xRRGGBB to a total weight, probed
+// linearly and grown to keep at most half of its slots full.
+class ColorTable final {
+ public:
+    ColorTable();
+
+    void add(uint32_t rgb, double weight);
+    size_t size() const;
+
+    // Append every entry as (color, weight) in no particular order.
+    void append_entries(std::vector<std::pair<uint32_t, double>> &entries)
+        const;
+
+ private:
+    size_t get_slot(uint32_t rgb) const;
+    void grow();
+
+    std::vector<uint32_t> keys_;
+    std::vector<double> weights_;
+    size_t size_;
+    int bits_;
+};
+
+// Count the colors of a width by height image whose rows are read by
+// readers that make_rows() returns, one for each band of rows.
+template <typename MakeRows>
+bool count_colors(size_t width, size_t height, const MakeRows &make_rows,
+                  const SampleWeights &weights, ColorHistogram &histogram);
+
+// Estimate the number of distinct colors in the image from evenly spaced
+// rows, assuming new colors keep appearing at the rate they do there.
+template <typename Rows>
+size_t estimate_num_colors(Rows &rows, size_t width, size_t height);
+
+// Call add(rgb, weight) for each run of equal colors in a row span, with
+// the total weight of the run, skipping runs of zero weight.
+template <typename Add>
+void add_runs(const uint32_t *row, const float *weights, size_t width,
+              const Add &add);
+}  // namespace
+
+bool ColorCounter::count(const Magick::Image &image,
+                         const SampleWeights &weights,
+                         ColorHistogram &histogram) {
+    return count_colors(
+        image.columns(), image.rows(),
+        [&image]() { return ImageRows(image); }, weights, histogram);
+}
+
+bool ColorCounter::count(const PixelView &pixels,
+                         const SampleWeights &weights,
+                         ColorHistogram &histogram) {
+    if (!pixels.valid()) {
+        histogram = ColorHistogram();
+        return false;
+    }
+    return count_colors(
+        pixels.width(), pixels.height(),
+        [&pixels]() { return pixels; }, weights, histogram);
+}
+
+namespace {
+
+ColorTable::ColorTable() :
+    keys_(size_t(1) << 12, empty_key),
+    weights_(size_t(1) << 12, 0.0),
+    size_(0),
+    bits_(12) { }
+
+void ColorTable::add(uint32_t rgb, double weight) {
+    size_t slot = get_slot(rgb);
+    if (keys_[slot] == empty_key) {
+        if (((size_ + 1) * 2) > keys_.size()) {
+            grow();
+            slot = get_slot(rgb);
+        }
+        keys_[slot] = rgb;
+        ++size_;
+    }
+    weights_[slot] += weight;
+}
+
+size_t ColorTable::size() const { return size_; }
+
+void ColorTable::append_entries(
+    std::vector<std::pair<uint32_t, double>> &entries) const {
+    for (size_t slot = 0; slot < keys_.size(); ++slot) {
+        if (keys_[slot] != empty_key) {
+            entries.emplace_back(keys_[slot], weights_[slot]);
+        }
+    }
+}
+
+size_t ColorTable::get_slot(uint32_t rgb) const {
+    const size_t mask = keys_.size() - 1;
+    size_t slot = static_cast<uint32_t>(rgb * 0x9E3779B1u) >> (32 - bits_);
+    while ((keys_[slot] != empty_key) && (keys_[slot] != rgb)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void ColorTable::grow() {
+    std::vector<uint32_t> old_keys(std::move(keys_));
+    std::vector<double> old_weights(std::move(weights_));
+    ++bits_;
+    keys_.assign(size_t(1) << bits_, empty_key);
+    weights_.assign(size_t(1) << bits_, 0.0);
+    for (size_t slot = 0; slot < old_keys.size(); ++slot) {
+        if (old_keys[slot] != empty_key) {
+            const size_t new_slot = get_slot(old_keys[slot]);
+            keys_[new_slot] = old_keys[slot];
+            weights_[new_slot] = old_weights[slot];
+        }
+    }
+}
+
+template <typename MakeRows>
+bool count_colors(size_t width, size_t height, const MakeRows &make_rows,
+                  const SampleWeights &weights, ColorHistogram &histogram) {
+    histogram = ColorHistogram();
+    if ((width == 0) || (height == 0)) {
+        return true;
+    }
+    const size_t num_bands =
+        std::min(height, Parallel::default_num_threads());
+    std::vector<char> band_success(num_bands, false);
+
+    // Each band reads its rows through its own reader.
+    auto for_each_band_span = [&](size_t band, const auto &add) {
+        auto band_rows = make_rows();
+        std::vector<uint32_t> row(width);
+        band_success[band] = weights.for_each_span(
+            width, height, (band * height) / num_bands,
+            ((band + 1) * height) / num_bands,
+            [&](size_t y, size_t x_begin, size_t x_end, const float *span) {
+                const size_t span_width = x_end - x_begin;
+                if (!band_rows.read_rgb24(x_begin, y, span_width,
+                                          row.data())) {
+                    return false;
+                }
+                add_runs(row.data(), span, span_width, add);
+                return true;
+            });
+    };
+
+    auto rows = make_rows();
+    if (weights.unit_weights()
+        && (estimate_num_colors(rows, width, height)
+            >= ColorCounter::dense_table_min_colors)) {
+        std::vector<std::atomic<uint32_t>> counts(num_dense_colors);
+        Parallel::run(num_bands, [&](size_t band) {
+            for_each_band_span(band, [&counts](uint32_t rgb, double weight) {
+                counts[rgb].fetch_add(static_cast<uint32_t>(weight),
+                                      std::memory_order_relaxed);
+            });
+        });
+        for (uint32_t rgb = 0; rgb < num_dense_colors; ++rgb) {
+            const uint32_t count = counts[rgb].load(std::memory_order_relaxed);
+            if (count > 0) {
+                histogram.add(rgb, count);
+            }
+        }
+    } else {
+        std::vector<ColorTable> tables(num_bands);
+        Parallel::run(num_bands, [&](size_t band) {
+            ColorTable &table = tables[band];
+            for_each_band_span(band, [&table](uint32_t rgb, double weight) {
+                table.add(rgb, weight);
+            });
+        });
+        std::vector<std::pair<uint32_t, double>> entries;
+        size_t num_entries = 0;
+        for (const auto &table : tables) {
+            num_entries += table.size();
+        }
+        entries.reserve(num_entries);
+        for (const auto &table : tables) {
+            table.append_entries(entries);
+        }
+        std::sort(entries.begin(), entries.end());
+        histogram.reserve(entries.size());
+        for (size_t i = 0; i < entries.size();) {
+            const uint32_t rgb = entries[i].first;
+            double weight = 0.0;
+            for (; (i < entries.size()) && (entries[i].first == rgb); ++i) {
+                weight += entries[i].second;
+            }
+            histogram.add(rgb, weight);
+        }
+    }
+    return std::all_of(band_success.begin(), band_success.end(),
+                       [](char success) { return success; });
+}
+
+template <typename Rows>
+size_t estimate_num_colors(Rows &rows, size_t width, size_t height) {
+    const size_t num_rows = std::min(height, num_estimate_rows);
+    ColorTable table;
+    std::vector<uint32_t> row(width);
+    for (size_t r = 0; r < num_rows; ++r) {
+        const size_t y = ((r * height) + (height / 2)) / num_rows;
+        if (!rows.read_rgb24(0, y, width, row.data())) {
+            return 0;
+        }
+        add_runs(row.data(), nullptr, width,
+                 [&table](uint32_t rgb, double weight) {
+                     table.add(rgb, weight);
+                 });
+    }
+    return (table.size() * height) / num_rows;
+}
+
+template <typename Add>
+void add_runs(const uint32_t *row, const float *weights, size_t width,
+              const Add &add) {
+    const Kernels &kernels = Kernels::get();
+    size_t i = 0;
+    while (i < width) {
+        const uint32_t rgb = row[i];
+        const size_t length = kernels.run_length(row + i, width - i);
+        double weight = static_cast<double>(length);
+        if (weights != nullptr) {
+            weight = 0.0;
+            for (size_t k = i; k < i + length; ++k) {
+                weight += weights[k];
+            }
+        }
+        if (weight > 0.0) {
+            add(rgb, weight);
+        }
+        i += length;
+    }
+}
+}  // namespace
+}  // namespace palette
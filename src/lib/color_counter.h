@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+#include <Magick++.h>
+
+namespace palette {
+
+class ColorHistogram;
+class PixelView;
+class SampleWeights;
+
+// Counts the weighted colors of an image in one pass over its pixel cache,
+// or over pixels held in memory.
+// Bands of rows are read by separate threads. Each thread accumulates into
+// its own open-addressing hash table, and the tables are merged at the
+// end; when a sample of rows shows that the image has too many distinct
+// colors for that to pay off and weights are whole pixel counts, all
+// threads instead add to one shared table with a counter for every
+// possible 0xRRGGBB color.
+class ColorCounter {
+ public:
+    // Estimated distinct colors above which the shared table is used.
+    static const size_t dense_table_min_colors = 1 << 20;
+
+    // Replace the contents of the histogram with the colors of the image
+    // ordered by color. Return whether or not every pixel could be read.
+    static bool count(const Magick::Image &image,
+                      const SampleWeights &weights,
+                      ColorHistogram &histogram);
+
+    // Like count, but read the pixels of the view in place. Return whether
+    // or not the view is valid.
+    static bool count(const PixelView &pixels,
+                      const SampleWeights &weights,
+                      ColorHistogram &histogram);
+};
+}  // namespace palette
@@ -0,0 +1,250 @@
+#include "lib/color_histogram.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "lib/color.h"
+
+namespace palette {
+
+ColorHistogram::const_iterator::const_iterator(
+    const ColorHistogram *histogram, size_t index) :
+    histogram_(histogram),
+    index_(index) { }
+
+ColorHistogram::const_iterator::const_iterator(const const_iterator &other) :
+    histogram_(other.histogram_),
+    index_(other.index_) { }
+
+ColorHistogram::const_iterator &ColorHistogram::const_iterator::operator=(
+    const const_iterator &other) {
+    histogram_ = other.histogram_;
+    index_ = other.index_;
+    return *this;
+}
+
+ColorHistogram::Entry ColorHistogram::const_iterator::operator*() const {
+    return Entry{histogram_->colors_[index_], histogram_->weights_[index_]};
+}
+
+ColorHistogram::const_iterator &ColorHistogram::const_iterator::operator++() {
+    ++index_;
+    return *this;
+}
+
+ColorHistogram::const_iterator ColorHistogram::const_iterator::operator++(
+    int) {
+    const_iterator previous(*this);
+    ++index_;
+    return previous;
+}
+
+bool ColorHistogram::const_iterator::operator==(
+    const const_iterator &other) const {
+    return (histogram_ == other.histogram_) && (index_ == other.index_);
+}
+
+bool ColorHistogram::const_iterator::operator!=(
+    const const_iterator &other) const {
+    return !(*this == other);
+}
+
+ColorHistogram::ColorHistogram() : colors_(), weights_() { }
+
+ColorHistogram::ColorHistogram(const ColorHistogram &other) :
+    colors_(other.colors_),
+    weights_(other.weights_) { }
+
+ColorHistogram::ColorHistogram(ColorHistogram &&other) :
+    colors_(std::move(other.colors_)),
+    weights_(std::move(other.weights_)) { }
+
+ColorHistogram &ColorHistogram::operator=(const ColorHistogram &other) {
+    colors_ = other.colors_;
+    weights_ = other.weights_;
+    return *this;
+}
+
+ColorHistogram &ColorHistogram::operator=(ColorHistogram &&other) {
+    colors_ = std::move(other.colors_);
+    weights_ = std::move(other.weights_);
+    return *this;
+}
+
+void ColorHistogram::add(uint32_t rgb, double weight) {
+    colors_.push_back(rgb);
+    weights_.push_back(weight);
+}
+
+void ColorHistogram::reserve(size_t num_colors) {
+    colors_.reserve(num_colors);
+    weights_.reserve(num_colors);
+}
+
+size_t ColorHistogram::size() const { return colors_.size(); }
+
+bool ColorHistogram::empty() const { return colors_.empty(); }
+
+uint32_t ColorHistogram::rgb24(size_t index) const { return colors_[index]; }
+
+double ColorHistogram::weight(size_t index) const { return weights_[index]; }
+
+double ColorHistogram::total_weight() const {
+    return std::accumulate(weights_.begin(), weights_.end(), 0.0);
+}
+
+ColorHistogram::const_iterator ColorHistogram::begin() const {
+    return const_iterator(this, 0);
+}
+
+ColorHistogram::const_iterator ColorHistogram::end() const {
+    return const_iterator(this, colors_.size());
+}
+
+std::vector<Color> ColorHistogram::to_colors() const {
+    std::vector<Color> colors;
+    to_colors(colors);
+    return colors;
+}
+
+void ColorHistogram::to_colors(std::vector<Color> &colors) const {
+    colors.clear();
+    colors.reserve(colors_.size());
+    for (uint32_t rgb : colors_) {
+        colors.push_back(Color::from_rgb24(rgb));
+    }
+}
+
+void ColorHistogram::merge(const ColorHistogram &other) {
+    std::vector<uint32_t> merged_colors;
+    std::vector<double> merged_weights;
+    merged_colors.reserve(colors_.size() + other.colors_.size());
+    merged_weights.reserve(colors_.size() + other.colors_.size());
+    size_t i = 0;
+    size_t j = 0;
+    while ((i < colors_.size()) || (j < other.colors_.size())) {
+        if ((j == other.colors_.size())
+            || ((i < colors_.size()) && (colors_[i] < other.colors_[j]))) {
+            merged_colors.push_back(colors_[i]);
+            merged_weights.push_back(weights_[i++]);
+        } else if ((i == colors_.size())
+                   || (other.colors_[j] < colors_[i])) {
+            merged_colors.push_back(other.colors_[j]);
+            merged_weights.push_back(other.weights_[j++]);
+        } else {
+            merged_colors.push_back(colors_[i]);
+            merged_weights.push_back(weights_[i++] + other.weights_[j++]);
+        }
+    }
+    colors_ = std::move(merged_colors);
+    weights_ = std::move(merged_weights);
+}
+
+ColorHistogram ColorHistogram::filtered(
+    const std::function<bool(const Color &)> &predicate) const {
+    ColorHistogram result;
+    for (size_t i = 0; i < colors_.size(); ++i) {
+        if (predicate(Color::from_rgb24(colors_[i]))) {
+            result.add(colors_[i], weights_[i]);
+        }
+    }
+    return result;
+}
+
+void ColorHistogram::filtered(
+    const std::function<bool(const Entry &)> &predicate,
+    ColorHistogram &result) const {
+    result.colors_.clear();
+    result.weights_.clear();
+    for (const Entry entry : *this) {
+        if (predicate(entry)) {
+            result.add(entry.rgb24_, entry.weight_);
+        }
+    }
+}
+
+void ColorHistogram::scale(double factor) {
+    for (double &weight : weights_) {
+        weight *= factor;
+    }
+}
+
+void ColorHistogram::coarsen(uint32_t bits) {
+    if ((bits == 0) || colors_.empty()) {
+        return;
+    }
+    const uint32_t channel_mask = (bits >= 8) ? 0 : ((0xFF << bits) & 0xFF);
+    const uint32_t mask =
+        (channel_mask << 16) | (channel_mask << 8) | channel_mask;
+    std::vector<size_t> order(colors_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this, mask](size_t a, size_t b) {
+        return ((colors_[a] & mask) < (colors_[b] & mask))
+            || (((colors_[a] & mask) == (colors_[b] & mask)) && (a < b));
+    });
+
+    ColorHistogram coarse;
+    for (size_t begin = 0; begin < order.size();) {
+        const uint32_t group = colors_[order[begin]] & mask;
+        double weight = 0.0;
+        double sums[3] = { 0.0, 0.0, 0.0 };
+        size_t end = begin;
+        for (; (end < order.size()) && ((colors_[order[end]] & mask) == group);
+             ++end) {
+            const uint32_t rgb = colors_[order[end]];
+            const double color_weight = weights_[order[end]];
+            weight += color_weight;
+            sums[0] += color_weight * ((rgb >> 16) & 0xFF);
+            sums[1] += color_weight * ((rgb >> 8) & 0xFF);
+            sums[2] += color_weight * (rgb & 0xFF);
+        }
+        uint32_t mean = colors_[order[begin]];
+        if (weight > 0.0) {
+            mean = 0;
+            for (size_t c = 0; c < 3; ++c) {
+                mean = (mean << 8)
+                    | static_cast<uint32_t>((sums[c] / weight) + 0.5);
+            }
+        }
+        coarse.add(mean, weight);
+        begin = end;
+    }
+
+    // Means stay within their groups, so they are distinct, but they are
+    // not necessarily ordered like their groups.
+    std::vector<size_t> coarse_order(coarse.size());
+    std::iota(coarse_order.begin(), coarse_order.end(), 0);
+    std::sort(coarse_order.begin(), coarse_order.end(),
+              [&coarse](size_t a, size_t b) {
+                  return coarse.colors_[a] < coarse.colors_[b];
+              });
+    colors_.resize(coarse.size());
+    weights_.resize(coarse.size());
+    for (size_t i = 0; i < coarse_order.size(); ++i) {
+        colors_[i] = coarse.colors_[coarse_order[i]];
+        weights_[i] = coarse.weights_[coarse_order[i]];
+    }
+}
+
+void ColorHistogram::sort_by_weight() {
+    std::vector<size_t> order(colors_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return (weights_[a] > weights_[b])
+            || ((weights_[a] == weights_[b]) && (colors_[a] < colors_[b]));
+    });
+    std::vector<uint32_t> sorted_colors(colors_.size());
+    std::vector<double> sorted_weights(weights_.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        sorted_colors[i] = colors_[order[i]];
+        sorted_weights[i] = weights_[order[i]];
+    }
+    colors_ = std::move(sorted_colors);
+    weights_ = std::move(sorted_weights);
+}
+}  // namespace palette
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+namespace palette {
+
+class Color;
+
+// Distinct colors packed as 0xRRGGBB, each with the total weight of the
+// pixels that have it.
+class ColorHistogram {
+ public:
+    // A color and the total weight of the pixels that have it.
+    struct Entry {
+        uint32_t rgb24_;
+        double weight_;
+    };
+
+    // Iterates over the entries in order, reading each in place as it is
+    // dereferenced.
+    class const_iterator {
+     public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Entry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Entry *;
+        using reference = Entry;
+
+        const_iterator(const ColorHistogram *histogram, size_t index);
+        const_iterator(const const_iterator &other);
+
+        const_iterator &operator=(const const_iterator &other);
+
+        Entry operator*() const;
+        const_iterator &operator++();
+        const_iterator operator++(int);
+        bool operator==(const const_iterator &other) const;
+        bool operator!=(const const_iterator &other) const;
+
+     private:
+        const ColorHistogram *histogram_;
+        size_t index_;
+    };
+
+    ColorHistogram();
+    ColorHistogram(const ColorHistogram &other);
+    ColorHistogram(ColorHistogram &&other);
+
+    ColorHistogram &operator=(const ColorHistogram &other);
+    ColorHistogram &operator=(ColorHistogram &&other);
+
+    // Append a color without checking whether it is already present.
+    void add(uint32_t rgb, double weight);
+    void reserve(size_t num_colors);
+
+    size_t size() const;
+    bool empty() const;
+    uint32_t rgb24(size_t index) const;
+    double weight(size_t index) const;
+    double total_weight() const;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    std::vector<Color> to_colors() const;
+
+    // Like to_colors, but replace the contents of colors, reusing its
+    // storage.
+    void to_colors(std::vector<Color> &colors) const;
+
+    // Add the weights of another histogram to this one. Both must be
+    // ordered by color, as Image::get_histogram orders them.
+    void merge(const ColorHistogram &other);
+
+    // Return the entries whose color satisfies the predicate.
+    ColorHistogram filtered(
+        const std::function<bool(const Color &)> &predicate) const;
+
+    // Replace the contents of result, reusing its storage, with the entries
+    // that satisfy the predicate, which reads them in packed form. The
+    // result must be another histogram.
+    void filtered(const std::function<bool(const Entry &)> &predicate,
+                  ColorHistogram &result) const;
+
+    // Multiply every weight by factor.
+    void scale(double factor);
+
+    // Merge the colors that agree in all but the lowest bits of each
+    // channel into their weighted mean, which lies within the same span of
+    // values, and order the result by color. Coarsening by more bits later
+    // merges whole groups of an earlier coarsening.
+    void coarsen(uint32_t bits);
+
+    // Order entries from heaviest to lightest, breaking ties by color.
+    void sort_by_weight();
+
+ private:
+    std::vector<uint32_t> colors_;
+    std::vector<double> weights_;
+};
+}  // namespace palette
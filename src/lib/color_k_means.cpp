@@ -1,5 +1,12 @@
 #include "lib/color_k_means.h"
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <random>
 #include <vector>
 
 #include <armadillo>
@@ -7,8 +14,51 @@
 #include <Magick++.h>
 
 #include "lib/color.h"
+#include "lib/color_histogram.h"
+#include "lib/kernels.h"
+#include "lib/packed_color.h"
+#include "lib/parallel.h"
 
 namespace palette {
+namespace {
+
+using Point = std::array<double, 3>;
+
+Point to_point(uint32_t rgb) {
+    const PackedColor8 color = PackedColor8::from_rgb24(rgb);
+    return Point{static_cast<double>(color.red_),
+                 static_cast<double>(color.green_),
+                 static_cast<double>(color.blue_)};
+}
+
+double distance_squared(const Point &a, const Point &b) {
+    const double d0 = a[0] - b[0];
+    const double d1 = a[1] - b[1];
+    const double d2 = a[2] - b[2];
+    return (d0 * d0) + (d1 * d1) + (d2 * d2);
+}
+
+// Add seeds until there are num_clusters, each time taking the histogram
+// color farthest from every seed so far. With no seeds yet, start from the
+// given first color.
+void add_farthest_seeds(size_t num_clusters, size_t first,
+                        const std::vector<Point> &points,
+                        std::vector<Point> &means);
+
+// Add seeds until there are num_clusters, each time picking a histogram
+// color at random with probability proportional to its weight times its
+// squared distance from the nearest seed so far (k-means++).
+void add_random_seeds(size_t num_clusters, const std::vector<Point> &points,
+                      const std::vector<double> &weights,
+                      std::mt19937_64 &generator, std::vector<Point> &means);
+
+// Run weighted Lloyd iterations from the given means. Return the weighted
+// sum of squared distances from each color to its nearest final mean.
+double run_lloyd(const std::vector<Point> &points,
+                 const std::vector<double> &weights,
+                 const ColorKMeans::Settings &settings,
+                 std::vector<Point> &means);
+}  // namespace
 
 bool ColorKMeans::find_clusters(size_t num_clusters,
                                 SeedMode seed_mode,
@@ -74,4 +124,286 @@ bool ColorKMeans::find_clusters(size_t num_clusters,
     }
     return k_means_success;
 }
+
+ColorKMeans::Settings::Settings() :
+    max_iterations_(10),
+    tolerance_(0.0),
+    num_restarts_(1),
+    seed_(std::nullopt) { }
+
+ColorKMeans::Settings::Settings(size_t max_iterations, double tolerance) :
+    max_iterations_(max_iterations),
+    tolerance_(tolerance),
+    num_restarts_(1),
+    seed_(std::nullopt) { }
+
+bool ColorKMeans::find_weighted_clusters(size_t num_clusters,
+                                         SeedMode seed_mode,
+                                         const ColorHistogram &histogram,
+                                         std::vector<Color> &color_centroids) {
+    return find_weighted_clusters(num_clusters, seed_mode, histogram,
+                                  Settings(), color_centroids);
+}
+
+bool ColorKMeans::find_weighted_clusters(size_t num_clusters,
+                                         SeedMode seed_mode,
+                                         const ColorHistogram &histogram,
+                                         const Settings &settings,
+                                         std::vector<Color> &color_centroids) {
+    if (num_clusters >= histogram.size()) {
+        color_centroids = histogram.to_colors();
+        return true;
+    }
+    if (num_clusters == 0) {
+        color_centroids.clear();
+        return true;
+    }
+
+    std::vector<Point> points;
+    std::vector<double> weights;
+    points.reserve(histogram.size());
+    weights.reserve(histogram.size());
+    size_t heaviest = 0;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        points.push_back(to_point(histogram.rgb24(i)));
+        weights.push_back(histogram.weight(i));
+        if (weights[i] > weights[heaviest]) {
+            heaviest = i;
+        }
+    }
+
+    std::vector<Point> means;
+    means.reserve(num_clusters);
+    switch (seed_mode) {
+        case SeedMode::keep_existing:
+            for (const Color &color : color_centroids) {
+                if (means.size() == num_clusters) {
+                    break;
+                }
+                means.push_back(to_point(color.to_rgb24()));
+            }
+            add_farthest_seeds(num_clusters, heaviest, points, means);
+            run_lloyd(points, weights, settings, means);
+            break;
+        case SeedMode::random_spread: {
+            // Every restart draws from its own generator, derived from the
+            // seed and the restart index, so that results do not depend on
+            // how restarts are scheduled.
+            uint64_t seed = 0;
+            if (settings.seed_.has_value()) {
+                seed = settings.seed_.value();
+            } else {
+                std::random_device device;
+                seed = (static_cast<uint64_t>(device()) << 32) | device();
+            }
+            const size_t num_restarts =
+                std::max<size_t>(settings.num_restarts_, 1);
+            std::vector<std::vector<Point>> restart_means(num_restarts);
+            std::vector<double> inertias(num_restarts);
+            Parallel::run(num_restarts, [&](size_t restart) {
+                std::seed_seq seed_sequence{
+                    static_cast<uint32_t>(seed),
+                    static_cast<uint32_t>(seed >> 32),
+                    static_cast<uint32_t>(restart)};
+                std::mt19937_64 generator(seed_sequence);
+                add_random_seeds(num_clusters, points, weights, generator,
+                                 restart_means[restart]);
+                inertias[restart] = run_lloyd(points, weights, settings,
+                                              restart_means[restart]);
+            });
+            const size_t best = static_cast<size_t>(
+                std::min_element(inertias.begin(), inertias.end())
+                - inertias.begin());
+            means = std::move(restart_means[best]);
+            break;
+        }
+        case SeedMode::static_spread:
+            add_farthest_seeds(num_clusters, heaviest, points, means);
+            run_lloyd(points, weights, settings, means);
+            break;
+        default: return false;
+    }
+
+    color_centroids.clear();
+    color_centroids.reserve(num_clusters);
+    for (const Point &mean : means) {
+        uint32_t rgb = 0;
+        for (size_t channel = 0; channel < 3; ++channel) {
+            rgb = (rgb << 8) | static_cast<uint32_t>(mean[channel] + 0.5);
+        }
+        color_centroids.push_back(Color::from_rgb24(rgb));
+    }
+    return true;
+}
+
+double ColorKMeans::get_inertia(const ColorHistogram &histogram,
+                                const std::vector<Color> &color_centroids) {
+    std::vector<Point> means;
+    means.reserve(color_centroids.size());
+    for (const Color &color : color_centroids) {
+        means.push_back(to_point(color.to_rgb24()));
+    }
+    double inertia = 0.0;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        const Point point = to_point(histogram.rgb24(i));
+        double nearest_distance = std::numeric_limits<double>::max();
+        for (const Point &mean : means) {
+            nearest_distance =
+                std::min(nearest_distance, distance_squared(point, mean));
+        }
+        inertia += histogram.weight(i) * nearest_distance;
+    }
+    return inertia;
+}
+
+namespace {
+
+void add_farthest_seeds(size_t num_clusters, size_t first,
+                        const std::vector<Point> &points,
+                        std::vector<Point> &means) {
+    if (means.empty()) {
+        means.push_back(points[first]);
+    }
+    std::vector<double> distances(points.size(),
+                                  std::numeric_limits<double>::max());
+    size_t measured = 0;
+    while (means.size() < num_clusters) {
+        for (; measured < means.size(); ++measured) {
+            for (size_t i = 0; i < points.size(); ++i) {
+                distances[i] = std::min(
+                    distances[i], distance_squared(points[i], means[measured]));
+            }
+        }
+        size_t farthest = 0;
+        for (size_t i = 1; i < points.size(); ++i) {
+            if (distances[i] > distances[farthest]) {
+                farthest = i;
+            }
+        }
+        means.push_back(points[farthest]);
+    }
+}
+
+void add_random_seeds(size_t num_clusters, const std::vector<Point> &points,
+                      const std::vector<double> &weights,
+                      std::mt19937_64 &generator, std::vector<Point> &means) {
+    // Draw from the generator's raw output rather than a standard
+    // distribution, whose results differ between library implementations.
+    auto pick = [&generator](const std::vector<double> &masses) {
+        double total = 0.0;
+        for (double mass : masses) {
+            total += mass;
+        }
+        double target = static_cast<double>(generator() >> 11)
+            * (1.0 / 9007199254740992.0) * total;
+        size_t last_positive = 0;
+        for (size_t i = 0; i < masses.size(); ++i) {
+            if (masses[i] > 0.0) {
+                last_positive = i;
+                if (target < masses[i]) {
+                    return i;
+                }
+                target -= masses[i];
+            }
+        }
+        return last_positive;
+    };
+    std::vector<double> masses(weights);
+    std::vector<double> distances(points.size(),
+                                  std::numeric_limits<double>::max());
+    while (means.size() < num_clusters) {
+        means.push_back(points[pick(masses)]);
+        for (size_t i = 0; i < points.size(); ++i) {
+            distances[i] = std::min(distances[i],
+                                    distance_squared(points[i], means.back()));
+            masses[i] = weights[i] * distances[i];
+        }
+    }
+}
+
+double run_lloyd(const std::vector<Point> &points,
+                 const std::vector<double> &weights,
+                 const ColorKMeans::Settings &settings,
+                 std::vector<Point> &means) {
+    // A cluster that loses all of its colors keeps its previous centroid.
+    // Colors are assigned to their nearest means by Kernels::nearest_colors
+    // in single precision, which holds 8-bit channels exactly; sums and
+    // the inertia stay in double precision.
+    const size_t num_points = points.size();
+    const size_t num_clusters = means.size();
+    std::array<std::vector<float>, 3> channels;
+    for (size_t channel = 0; channel < 3; ++channel) {
+        channels[channel].resize(num_points);
+        for (size_t i = 0; i < num_points; ++i) {
+            channels[channel][i] = static_cast<float>(points[i][channel]);
+        }
+    }
+    std::array<std::vector<float>, 3> mean_channels;
+    for (auto &mean_channel : mean_channels) {
+        mean_channel.resize(num_clusters);
+    }
+    std::vector<float> distances(num_points);
+    std::vector<uint32_t> nearest(num_points);
+    const Kernels &kernels = Kernels::get();
+    auto assign_nearest = [&]() {
+        for (size_t c = 0; c < num_clusters; ++c) {
+            for (size_t channel = 0; channel < 3; ++channel) {
+                mean_channels[channel][c] =
+                    static_cast<float>(means[c][channel]);
+            }
+        }
+        kernels.nearest_colors(
+            channels[0].data(), channels[1].data(), channels[2].data(),
+            num_points, mean_channels[0].data(), mean_channels[1].data(),
+            mean_channels[2].data(), num_clusters, distances.data(),
+            nearest.data());
+    };
+    std::vector<uint32_t> assignments(num_points,
+                                      static_cast<uint32_t>(num_clusters));
+    std::vector<Point> sums(num_clusters);
+    std::vector<double> totals(num_clusters);
+    const double tolerance_squared = settings.tolerance_ * settings.tolerance_;
+    for (size_t iteration = 0; iteration < settings.max_iterations_;
+         ++iteration) {
+        assign_nearest();
+        bool changed = false;
+        sums.assign(num_clusters, Point{0.0, 0.0, 0.0});
+        totals.assign(num_clusters, 0.0);
+        for (size_t i = 0; i < num_points; ++i) {
+            const uint32_t c = nearest[i];
+            changed |= (assignments[i] != c);
+            assignments[i] = c;
+            for (size_t channel = 0; channel < 3; ++channel) {
+                sums[c][channel] += weights[i] * points[i][channel];
+            }
+            totals[c] += weights[i];
+        }
+        if (!changed) {
+            break;
+        }
+        double max_movement = 0.0;
+        for (size_t c = 0; c < num_clusters; ++c) {
+            if (totals[c] > 0.0) {
+                Point mean;
+                for (size_t channel = 0; channel < 3; ++channel) {
+                    mean[channel] = sums[c][channel] / totals[c];
+                }
+                max_movement = std::max(max_movement,
+                                        distance_squared(mean, means[c]));
+                means[c] = mean;
+            }
+        }
+        if (max_movement <= tolerance_squared) {
+            break;
+        }
+    }
+
+    assign_nearest();
+    double inertia = 0.0;
+    for (size_t i = 0; i < num_points; ++i) {
+        inertia += weights[i] * distance_squared(points[i], means[nearest[i]]);
+    }
+    return inertia;
+}
+}  // namespace
 }  // namespace palette
@@ -1,18 +1,56 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <optional>
 #include <vector>
 
 namespace palette {
 
 class Color;
+class ColorHistogram;
 
 class ColorKMeans {
  public:
     enum class SeedMode { keep_existing, random_spread, static_spread };
 
+    // Limits on the iterations of find_weighted_clusters.
+    struct Settings final {
+        Settings();
+        Settings(size_t max_iterations, double tolerance);
+
+        size_t max_iterations_;
+        // Stop once no centroid moves farther than this, in 8-bit channel
+        // units, within an iteration.
+        double tolerance_;
+        // Independent runs of random_spread, run in parallel, of which the
+        // one with the lowest inertia is kept.
+        size_t num_restarts_;
+        // Seed for random_spread, or none to seed from the system.
+        std::optional<uint64_t> seed_;
+    };
+
     static bool find_clusters(size_t num_clusters,
                               SeedMode seed_mode,
                               const std::vector<Color> &colors,
                               std::vector<Color> &color_centroids);
+
+    // Find clusters of histogram colors where each color pulls its centroid
+    // in proportion to its weight. Existing centroids beyond num_clusters
+    // are ignored, and missing ones are seeded as for static_spread.
+    static bool find_weighted_clusters(size_t num_clusters,
+                                       SeedMode seed_mode,
+                                       const ColorHistogram &histogram,
+                                       std::vector<Color> &color_centroids);
+    static bool find_weighted_clusters(size_t num_clusters,
+                                       SeedMode seed_mode,
+                                       const ColorHistogram &histogram,
+                                       const Settings &settings,
+                                       std::vector<Color> &color_centroids);
+
+    // Return the weighted sum of squared distances, in 8-bit channel units,
+    // from each histogram color to its nearest centroid.
+    static double get_inertia(const ColorHistogram &histogram,
+                              const std::vector<Color> &color_centroids);
 };
 }  // namespace palette
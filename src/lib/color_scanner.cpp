@@ -0,0 +1,245 @@
+#include "lib/color_scanner.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "lib/color.h"
+#include "lib/kernels.h"
+#include "lib/mapped_file.h"
+
+namespace palette {
+namespace {
+
+const uint64_t ones = 0x0101010101010101ULL;
+const uint64_t highs = 0x8080808080808080ULL;
+
+// Longest rgb() or rgba() expression considered, from the opening
+// parenthesis to the closing one.
+const size_t max_function_length = 64;
+
+bool is_word_char(unsigned char c) {
+    return ((c >= '0') && (c <= '9')) || (((c | 0x20) >= 'a')
+                                          && ((c | 0x20) <= 'z'))
+        || (c == '_') || (c == '-');
+}
+
+// Set the high bit of each byte of x that lies in [low, high], where every
+// byte of x is below 0x80.
+uint64_t bytes_in_range(uint64_t x, uint8_t low, uint8_t high) {
+    return (x + (ones * (0x80 - low))) & ~(x + (ones * (0x7F - high)))
+        & highs;
+}
+
+// Set the high bit of each byte of x that is an ASCII hex digit.
+uint64_t hex_byte_mask(uint64_t x) {
+    const uint64_t low7 = x & ~highs;
+    const uint64_t digits = bytes_in_range(low7, '0', '9');
+    const uint64_t letters = bytes_in_range(low7 | (ones * 0x20), 'a', 'f');
+    return (digits | letters) & ~x & highs;
+}
+
+// Nibble value of each byte of x, valid wherever hex_byte_mask is set.
+uint64_t hex_nibbles(uint64_t x) {
+    return (x & (ones * 0x0F)) + (((x >> 6) & ones) * 9);
+}
+
+uint32_t nibble(uint64_t nibbles, int index) {
+    return static_cast<uint32_t>((nibbles >> (8 * index)) & 0x0F);
+}
+
+// Try to match a hex color at the '#' at position. Return the length of the
+// match including the '#', or 0 if there is none.
+size_t match_hex(const unsigned char *data, size_t size, size_t position,
+                 ScannedColor &match) {
+    if ((position > 0) && (is_word_char(data[position - 1])
+                           || (data[position - 1] == '&'))) {
+        return 0;
+    }
+    uint64_t word = 0;
+    const size_t available = std::min<size_t>(8, size - position - 1);
+    std::memcpy(&word, data + position + 1, available);
+    const uint64_t not_hex = ~hex_byte_mask(word) & highs;
+    const int num_digits = (not_hex == 0)
+        ? 8 : (__builtin_ctzll(not_hex) / 8);
+    const size_t end = position + 1 + num_digits;
+    if ((num_digits != 3) && (num_digits != 4) && (num_digits != 6)
+        && (num_digits != 8)) {
+        return 0;
+    }
+    if ((end < size) && is_word_char(data[end])) {
+        return 0;
+    }
+
+    const uint64_t nibbles = hex_nibbles(word);
+    if (num_digits <= 4) {
+        match.rgb_ = (nibble(nibbles, 0) * 0x110000)
+            | (nibble(nibbles, 1) * 0x1100) | (nibble(nibbles, 2) * 0x11);
+        match.alpha_ = (num_digits == 4)
+            ? static_cast<uint8_t>(nibble(nibbles, 3) * 0x11) : 0xFF;
+    } else {
+        match.rgb_ = (nibble(nibbles, 0) << 20) | (nibble(nibbles, 1) << 16)
+            | (nibble(nibbles, 2) << 12) | (nibble(nibbles, 3) << 8)
+            | (nibble(nibbles, 4) << 4) | nibble(nibbles, 5);
+        match.alpha_ = (num_digits == 8)
+            ? static_cast<uint8_t>((nibble(nibbles, 6) << 4)
+                                   | nibble(nibbles, 7))
+            : 0xFF;
+    }
+    match.offset_ = position;
+    match.length_ = end - position;
+    return match.length_;
+}
+
+// Parse a non-negative decimal number with an optional fraction and an
+// optional percent sign. Return whether or not a number was found.
+bool parse_component(const unsigned char *data, size_t end, size_t &cursor,
+                     double &value, bool &percent) {
+    value = 0.0;
+    bool any_digits = false;
+    while ((cursor < end) && (data[cursor] >= '0') && (data[cursor] <= '9')) {
+        value = (value * 10.0) + (data[cursor] - '0');
+        any_digits = true;
+        ++cursor;
+    }
+    if ((cursor < end) && (data[cursor] == '.')) {
+        ++cursor;
+        double scale = 0.1;
+        while ((cursor < end) && (data[cursor] >= '0')
+               && (data[cursor] <= '9')) {
+            value += (data[cursor] - '0') * scale;
+            scale *= 0.1;
+            any_digits = true;
+            ++cursor;
+        }
+    }
+    percent = (cursor < end) && (data[cursor] == '%');
+    cursor += (percent ? 1 : 0);
+    return any_digits;
+}
+
+uint8_t to_channel8(double value) {
+    return static_cast<uint8_t>(std::min(255.0, std::max(0.0, value)) + 0.5);
+}
+
+// Try to match an rgb() or rgba() expression whose '(' is at position.
+// Components may be separated by commas or spaces, and the alpha component
+// may follow a '/'. Return the length of the match, or 0 if there is none.
+size_t match_function(const unsigned char *data, size_t size,
+                      size_t position, ScannedColor &match) {
+    auto name_matches = [data, position](const char *name, size_t length) {
+        if (position < length) {
+            return false;
+        }
+        for (size_t i = 0; i < length; ++i) {
+            if ((data[position - length + i] | 0x20) != name[i]) {
+                return false;
+            }
+        }
+        return true;
+    };
+    size_t begin;
+    if (name_matches("rgba", 4)) {
+        begin = position - 4;
+    } else if (name_matches("rgb", 3)) {
+        begin = position - 3;
+    } else {
+        return 0;
+    }
+    if ((begin > 0) && is_word_char(data[begin - 1])) {
+        return 0;
+    }
+
+    const size_t end = std::min(size, position + max_function_length);
+    size_t cursor = position + 1;
+    double components[4] = { 0.0, 0.0, 0.0, 1.0 };
+    int num_components = 0;
+    while (num_components < 4) {
+        while ((cursor < end) && ((data[cursor] == ' ')
+                                  || (data[cursor] == '\t')
+                                  || (data[cursor] == ',')
+                                  || (data[cursor] == '/'))) {
+            ++cursor;
+        }
+        if ((cursor < end) && (data[cursor] == ')')) {
+            break;
+        }
+        double value;
+        bool percent;
+        if (!parse_component(data, end, cursor, value, percent)) {
+            return 0;
+        }
+        if (num_components < 3) {
+            components[num_components] = percent ? (value * 2.55) : value;
+        } else {
+            components[num_components] = percent ? (value / 100.0) : value;
+        }
+        ++num_components;
+    }
+    while ((cursor < end) && ((data[cursor] == ' ')
+                              || (data[cursor] == '\t'))) {
+        ++cursor;
+    }
+    if ((num_components < 3) || (cursor >= end) || (data[cursor] != ')')) {
+        return 0;
+    }
+
+    match.rgb_ = (static_cast<uint32_t>(to_channel8(components[0])) << 16)
+        | (static_cast<uint32_t>(to_channel8(components[1])) << 8)
+        | to_channel8(components[2]);
+    match.alpha_ = to_channel8(components[3] * 255.0);
+    match.offset_ = begin;
+    match.length_ = cursor + 1 - begin;
+    return match.length_;
+}
+
+void match_site(const unsigned char *data, size_t size, size_t position,
+                const ColorScanner::MatchSink &sink) {
+    ScannedColor match = { 0, 0, 0, 0 };
+    const size_t length = (data[position] == '#')
+        ? match_hex(data, size, position, match)
+        : match_function(data, size, position, match);
+    if (length > 0) {
+        sink(match);
+    }
+}
+}  // namespace
+
+// Report every color found in the text, in order of offset.
+void ColorScanner::scan(const unsigned char *data, size_t size,
+                        const MatchSink &sink) {
+    const Kernels &kernels = Kernels::get();
+    size_t position = kernels.find_site(data, size);
+    while (position < size) {
+        match_site(data, size, position, sink);
+        ++position;
+        position += kernels.find_site(data + position, size - position);
+    }
+}
+
+// Memory-map a file and scan it. Return whether or not the file could be
+// read.
+bool ColorScanner::scan_file(const std::string &file_name,
+                             const MatchSink &sink,
+                             std::stringstream &error_stream) {
+    MappedFile file;
+    if (!file.open(file_name, error_stream)) {
+        return false;
+    }
+    file.advise_sequential();
+    scan(file.data(), file.size(), sink);
+    return true;
+}
+
+bool ColorScanner::scan_file(const std::string &file_name,
+                             std::vector<Color> &colors,
+                             std::stringstream &error_stream) {
+    auto append_color = [&colors](const ScannedColor &match) {
+        colors.push_back(Color::from_rgb24(match.rgb_));
+    };
+    return scan_file(file_name, append_color, error_stream);
+}
+}  // namespace palette
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace palette {
+
+class Color;
+
+// Color found in text by ColorScanner.
+struct ScannedColor final {
+    size_t offset_;
+    size_t length_;
+    uint32_t rgb_;
+    uint8_t alpha_;
+};
+
+// Finds colors written in text, such as theme files and CSS, in the forms
+// #RGB, #RGBA, #RRGGBB, #RRGGBBAA, rgb(r, g, b), and rgba(r, g, b, a).
+//
+// Candidate sites ('#' and '(' bytes) are located a block at a time by
+// Kernels::find_site, built for the processor's instruction set, and hex
+// digits following a '#' are validated and decoded eight at a time within
+// a 64-bit register.
+class ColorScanner {
+ public:
+    using MatchSink = std::function<void(const ScannedColor &match)>;
+
+    static void scan(const unsigned char *data, size_t size,
+                     const MatchSink &sink);
+    static bool scan_file(const std::string &file_name,
+                          const MatchSink &sink,
+                          std::stringstream &error_stream);
+    static bool scan_file(const std::string &file_name,
+                          std::vector<Color> &colors,
+                          std::stringstream &error_stream);
+};
+}  // namespace palette
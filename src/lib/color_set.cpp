@@ -1,49 +1,193 @@
 #include "lib/color_set.h"
 
-#include <iomanip>
-#include <set>
-#include <sstream>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "lib/color.h"
+#include "lib/color_vector.h"
 
 namespace palette {
+namespace {
 
-ColorSet::ColorSet() : colors_() { }
+// 0xFFFFFFFF is no 0xRRGGBB value, so it marks a slot as empty.
+const uint32_t empty_key = 0xFFFFFFFF;
+const int min_bits = 4;
+}  // namespace
 
-ColorSet::ColorSet(const std::set<Color> &colors) :
-    colors_(colors.begin(), colors.end()) { }
+ColorSet::ColorSet() :
+    keys_(size_t(1) << min_bits, empty_key),
+    size_(0),
+    bits_(min_bits) { }
 
-ColorSet::ColorSet(std::set<Color> &&colors) :
-    colors_(std::move(colors)) { }
+ColorSet::ColorSet(const std::vector<Color> &colors) : ColorSet() {
+    reserve(colors.size());
+    for (const Color &color : colors) {
+        insert(color);
+    }
+}
 
 ColorSet::ColorSet(const ColorSet &other) :
-    colors_(other.colors_.begin(), other.colors_.end()) { }
+    keys_(other.keys_),
+    size_(other.size_),
+    bits_(other.bits_) { }
 
 ColorSet::ColorSet(ColorSet &&other) :
-    colors_(std::move(other.colors_)) { }
+    keys_(std::move(other.keys_)),
+    size_(other.size_),
+    bits_(other.bits_) {
+    other.keys_.assign(size_t(1) << min_bits, empty_key);
+    other.size_ = 0;
+    other.bits_ = min_bits;
+}
 
 ColorSet &ColorSet::operator=(const ColorSet &other) {
-    colors_ = other.colors_;
+    keys_ = other.keys_;
+    size_ = other.size_;
+    bits_ = other.bits_;
     return *this;
 }
 
-std::set<Color> &ColorSet::get() { return colors_; }
+bool ColorSet::insert(const Color &color) {
+    return insert(color.to_rgb24());
+}
+
+bool ColorSet::insert(uint32_t rgb) {
+    rgb &= 0xFFFFFF;
+    size_t slot = get_slot(rgb);
+    if (keys_[slot] == rgb) {
+        return false;
+    }
+    if (((size_ + 1) * 2) > keys_.size()) {
+        rehash(bits_ + 1);
+        slot = get_slot(rgb);
+    }
+    keys_[slot] = rgb;
+    ++size_;
+    return true;
+}
 
-const std::set<Color> &ColorSet::get() const {
-    return colors_;
+bool ColorSet::contains(const Color &color) const {
+    return contains(color.to_rgb24());
+}
+
+bool ColorSet::contains(uint32_t rgb) const {
+    rgb &= 0xFFFFFF;
+    return keys_[get_slot(rgb)] == rgb;
+}
+
+size_t ColorSet::size() const { return size_; }
+
+bool ColorSet::empty() const { return size_ == 0; }
+
+void ColorSet::clear() {
+    keys_.assign(size_t(1) << min_bits, empty_key);
+    size_ = 0;
+    bits_ = min_bits;
+}
+
+void ColorSet::reserve(size_t num_colors) {
+    int bits = bits_;
+    while (((size_t(1) << bits) / 2) < num_colors) {
+        ++bits;
+    }
+    if (bits > bits_) {
+        rehash(bits);
+    }
+}
+
+std::vector<uint32_t> ColorSet::to_rgb24() const {
+    std::vector<uint32_t> colors;
+    colors.reserve(size_);
+    for (const uint32_t key : keys_) {
+        if (key != empty_key) {
+            colors.push_back(key);
+        }
+    }
+    std::sort(colors.begin(), colors.end());
+    return colors;
+}
+
+std::vector<Color> ColorSet::to_colors() const {
+    std::vector<Color> colors;
+    colors.reserve(size_);
+    for (const uint32_t rgb : to_rgb24()) {
+        colors.push_back(Color::from_rgb24(rgb));
+    }
+    return colors;
 }
 
 std::string ColorSet::to_string(const std::string &delimiter) const {
-    std::stringstream hex_stringstream;
-    hex_stringstream << std::setfill('0') << std::hex << std::uppercase;
-    bool first_elem = true;
-    for (const auto &color : colors_) {
-        hex_stringstream << (first_elem ? "" : delimiter) << color.to_string();
-        first_elem = false;
-    }
-    std::string hex(hex_stringstream.str());
-    return hex;
+    return ColorVector(to_colors()).to_string(delimiter);
+}
+
+size_t ColorSet::get_slot(uint32_t rgb) const {
+    const size_t mask = keys_.size() - 1;
+    size_t slot = static_cast<uint32_t>(rgb * 0x9E3779B1u) >> (32 - bits_);
+    while ((keys_[slot] != empty_key) && (keys_[slot] != rgb)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void ColorSet::rehash(int bits) {
+    std::vector<uint32_t> old_keys(std::move(keys_));
+    bits_ = bits;
+    keys_.assign(size_t(1) << bits_, empty_key);
+    for (const uint32_t key : old_keys) {
+        if (key != empty_key) {
+            keys_[get_slot(key)] = key;
+        }
+    }
+}
+
+OrderedColorSet::OrderedColorSet() : set_(), colors_() { }
+
+OrderedColorSet::OrderedColorSet(const std::vector<Color> &colors) :
+    set_(),
+    colors_() {
+    set_.reserve(colors.size());
+    for (const Color &color : colors) {
+        insert(color);
+    }
+}
+
+OrderedColorSet::OrderedColorSet(const OrderedColorSet &other) :
+    set_(other.set_),
+    colors_(other.colors_) { }
+
+OrderedColorSet::OrderedColorSet(OrderedColorSet &&other) :
+    set_(std::move(other.set_)),
+    colors_(std::move(other.colors_)) { }
+
+OrderedColorSet &OrderedColorSet::operator=(const OrderedColorSet &other) {
+    set_ = other.set_;
+    colors_ = other.colors_;
+    return *this;
+}
+
+bool OrderedColorSet::insert(const Color &color) {
+    if (!set_.insert(color)) {
+        return false;
+    }
+    colors_.push_back(color);
+    return true;
+}
+
+bool OrderedColorSet::contains(const Color &color) const {
+    return set_.contains(color);
+}
+
+size_t OrderedColorSet::size() const { return colors_.size(); }
+
+bool OrderedColorSet::empty() const { return colors_.empty(); }
+
+const std::vector<Color> &OrderedColorSet::get() const { return colors_; }
+
+std::string OrderedColorSet::to_string(const std::string &delimiter) const {
+    return ColorVector(colors_).to_string(delimiter);
 }
 }  // namespace palette
@@ -1,28 +1,83 @@
 #pragma once
 
-#include <set>
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace palette {
 
 class Color;
 
+// Set of colors keyed by their 0xRRGGBB value, so colors that differ only
+// below 8 bits per channel, and print the same, are one color to the set.
+// Keys live in an open-addressing hash table probed linearly and grown to
+// keep at most half of its slots full, so inserting and finding a color
+// hashes one integer and usually reads one cache line.
 class ColorSet {
  public:
     ColorSet();
-    explicit ColorSet(const std::set<Color> &colors);
-    explicit ColorSet(std::set<Color> &&colors);
+    explicit ColorSet(const std::vector<Color> &colors);
     ColorSet(const ColorSet &other);
     ColorSet(ColorSet &&other);
 
     ColorSet &operator=(const ColorSet &other);
 
-    std::set<Color> &get();
-    const std::set<Color> &get() const;
+    // Add a color. Return whether or not it was not in the set yet.
+    bool insert(const Color &color);
+    bool insert(uint32_t rgb);
+
+    bool contains(const Color &color) const;
+    bool contains(uint32_t rgb) const;
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+
+    // Make room for num_colors colors without growing the table.
+    void reserve(size_t num_colors);
+
+    // Return the colors ordered by 0xRRGGBB value.
+    std::vector<uint32_t> to_rgb24() const;
+    std::vector<Color> to_colors() const;
+
+    std::string to_string(const std::string &delimiter) const;
+
+ private:
+    size_t get_slot(uint32_t rgb) const;
+    void rehash(int bits);
+
+    std::vector<uint32_t> keys_;
+    size_t size_;
+    int bits_;
+};
+
+// ColorSet that also keeps the colors in the order they were first
+// inserted, such as the order they were given on the command line.
+class OrderedColorSet {
+ public:
+    OrderedColorSet();
+    explicit OrderedColorSet(const std::vector<Color> &colors);
+    OrderedColorSet(const OrderedColorSet &other);
+    OrderedColorSet(OrderedColorSet &&other);
+
+    OrderedColorSet &operator=(const OrderedColorSet &other);
+
+    // Add a color unless an equal one was added before. Return whether or
+    // not it was added.
+    bool insert(const Color &color);
+
+    bool contains(const Color &color) const;
+    size_t size() const;
+    bool empty() const;
+
+    // Return the first inserted color of each key, in insertion order.
+    const std::vector<Color> &get() const;
 
     std::string to_string(const std::string &delimiter) const;
 
  private:
-    std::set<Color> colors_;
+    ColorSet set_;
+    std::vector<Color> colors_;
 };
 }  // namespace palette
@@ -0,0 +1,312 @@
+#include "lib/color_space.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace palette {
+namespace {
+
+float srgb_to_linear(float c) {
+    return (c <= 0.04045f) ? (c / 12.92f)
+        : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+float linear_to_srgb(float c) {
+    return (c <= 0.0031308f) ? (c * 12.92f)
+        : ((1.055f * std::pow(c, 1.0f / 2.4f)) - 0.055f);
+}
+
+float clamp_unit(float c) { return std::min(1.0f, std::max(0.0f, c)); }
+
+float wrap_unit(float c) { return c - std::floor(c); }
+
+// Hue in [0, 1) of an sRGB color given its largest and smallest channels.
+float rgb_hue(float r, float g, float b, float max_c, float min_c) {
+    const float delta = max_c - min_c;
+    if (delta <= 0.0f) {
+        return 0.0f;
+    }
+    float hue;
+    if (max_c == r) {
+        hue = (g - b) / delta;
+    } else if (max_c == g) {
+        hue = ((b - r) / delta) + 2.0f;
+    } else {
+        hue = ((r - g) / delta) + 4.0f;
+    }
+    return wrap_unit(hue / 6.0f);
+}
+
+// CIELAB companding of a tristimulus value relative to the white point, and
+// its inverse.
+float lab_f(float t) {
+    const float delta = 6.0f / 29.0f;
+    return (t > (delta * delta * delta)) ? std::cbrt(t)
+        : ((t / (3.0f * delta * delta)) + (4.0f / 29.0f));
+}
+
+float lab_f_inverse(float f) {
+    const float delta = 6.0f / 29.0f;
+    return (f > delta) ? (f * f * f)
+        : (3.0f * delta * delta * (f - (4.0f / 29.0f)));
+}
+
+// Branch-free HSL to RGB for one channel, where n is 0, 8, or 4 for red,
+// green, or blue.
+float hsl_channel(float n, float h, float s, float l) {
+    const float k = std::fmod(n + (h * 12.0f), 12.0f);
+    const float a = s * std::min(l, 1.0f - l);
+    return l - (a * std::max(-1.0f, std::min({k - 3.0f, 9.0f - k, 1.0f})));
+}
+
+// Branch-free HSV to RGB for one channel, where n is 5, 3, or 1 for red,
+// green, or blue.
+float hsv_channel(float n, float h, float s, float v) {
+    const float k = std::fmod(n + (h * 6.0f), 6.0f);
+    return v - (v * s * std::max(0.0f, std::min({k, 4.0f - k, 1.0f})));
+}
+}  // namespace
+
+ColorSpace::ColorSpace(Value value) : value_(value) { }
+
+ColorSpace::ColorSpace(const std::string &value_str) :
+    value_(value_from_string(value_str)) { }
+
+ColorSpace::ColorSpace(const ColorSpace &other) : value_(other.value_) { }
+
+ColorSpace::Value ColorSpace::get() const { return value_; }
+
+bool ColorSpace::valid() const { return value_ != Value::unknown; }
+
+std::string ColorSpace::to_string() const { return value_to_string(value_); }
+
+int ColorSpace::hue_channel() const {
+    return ((value_ == Value::hsl) || (value_ == Value::hsv)) ? 0 : -1;
+}
+
+void ColorSpace::from_rgb(size_t num_colors,
+                          const float *red, const float *green,
+                          const float *blue,
+                          float *channel0, float *channel1,
+                          float *channel2) const {
+    switch (value_) {
+        case Value::rgb:
+            for (size_t i = 0; i < num_colors; ++i) {
+                const float r = red[i];
+                const float g = green[i];
+                const float b = blue[i];
+                channel0[i] = r;
+                channel1[i] = g;
+                channel2[i] = b;
+            }
+            break;
+        case Value::linear_rgb:
+            for (size_t i = 0; i < num_colors; ++i) {
+                const float r = srgb_to_linear(red[i]);
+                const float g = srgb_to_linear(green[i]);
+                const float b = srgb_to_linear(blue[i]);
+                channel0[i] = r;
+                channel1[i] = g;
+                channel2[i] = b;
+            }
+            break;
+        case Value::hsl:
+            for (size_t i = 0; i < num_colors; ++i) {
+                const float r = red[i];
+                const float g = green[i];
+                const float b = blue[i];
+                const float max_c = std::max({r, g, b});
+                const float min_c = std::min({r, g, b});
+                const float l = (max_c + min_c) * 0.5f;
+                const float denom = 1.0f - std::fabs((2.0f * l) - 1.0f);
+                channel0[i] = rgb_hue(r, g, b, max_c, min_c);
+                channel1[i] = (denom > 0.0f) ? ((max_c - min_c) / denom)
+                    : 0.0f;
+                channel2[i] = l;
+            }
+            break;
+        case Value::hsv:
+            for (size_t i = 0; i < num_colors; ++i) {
+                const float r = red[i];
+                const float g = green[i];
+                const float b = blue[i];
+                const float max_c = std::max({r, g, b});
+                const float min_c = std::min({r, g, b});
+                channel0[i] = rgb_hue(r, g, b, max_c, min_c);
+                channel1[i] = (max_c > 0.0f) ? ((max_c - min_c) / max_c)
+                    : 0.0f;
+                channel2[i] = max_c;
+            }
+            break;
+        case Value::oklab:
+            for (size_t i = 0; i < num_colors; ++i) {
+                const float r = srgb_to_linear(red[i]);
+                const float g = srgb_to_linear(green[i]);
+                const float b = srgb_to_linear(blue[i]);
+                const float l = std::cbrt((0.4122214708f * r)
+                                          + (0.5363325363f * g)
+                                          + (0.0514459929f * b));
+                const float m = std::cbrt((0.2119034982f * r)
+                                          + (0.6806995451f * g)
+                                          + (0.1073969566f * b));
+                const float s = std::cbrt((0.0883024619f * r)
+                                          + (0.2817188376f * g)
+                                          + (0.6299787005f * b));
+                channel0[i] = (0.2104542553f * l) + (0.7936177850f * m)
+                    - (0.0040720468f * s);
+                channel1[i] = (1.9779984951f * l) - (2.4285922050f * m)
+                    + (0.4505937099f * s);
+                channel2[i] = (0.0259040371f * l) + (0.7827717662f * m)
+                    - (0.8086757660f * s);
+            }
+            break;
+        case Value::lab:
+            for (size_t i = 0; i < num_colors; ++i) {
+                const float r = srgb_to_linear(red[i]);
+                const float g = srgb_to_linear(green[i]);
+                const float b = srgb_to_linear(blue[i]);
+                const float fx = lab_f(((0.4124564f * r) + (0.3575761f * g)
+                                        + (0.1804375f * b)) / 0.95047f);
+                const float fy = lab_f((0.2126729f * r) + (0.7151522f * g)
+                                       + (0.0721750f * b));
+                const float fz = lab_f(((0.0193339f * r) + (0.1191920f * g)
+                                        + (0.9503041f * b)) / 1.08883f);
+                channel0[i] = (116.0f * fy) - 16.0f;
+                channel1[i] = 500.0f * (fx - fy);
+                channel2[i] = 200.0f * (fy - fz);
+            }
+            break;
+        default: break;
+    }
+}
+
+void ColorSpace::to_rgb(size_t num_colors,
+                        const float *channel0, const float *channel1,
+                        const float *channel2,
+                        float *red, float *green, float *blue) const {
+    switch (value_) {
+        case Value::rgb:
+            for (size_t i = 0; i < num_colors; ++i) {
+                const float r = channel0[i];
+                const float g = channel1[i];
+                const float b = channel2[i];
+                red[i] = clamp_unit(r);
+                green[i] = clamp_unit(g);
+                blue[i] = clamp_unit(b);
+            }
+            break;
+        case Value::linear_rgb:
+            for (size_t i = 0; i < num_colors; ++i) {
+                const float r = channel0[i];
+                const float g = channel1[i];
+                const float b = channel2[i];
+                red[i] = clamp_unit(linear_to_srgb(clamp_unit(r)));
+                green[i] = clamp_unit(linear_to_srgb(clamp_unit(g)));
+                blue[i] = clamp_unit(linear_to_srgb(clamp_unit(b)));
+            }
+            break;
+        case Value::hsl:
+            for (size_t i = 0; i < num_colors; ++i) {
+                const float h = wrap_unit(channel0[i]);
+                const float s = clamp_unit(channel1[i]);
+                const float l = clamp_unit(channel2[i]);
+                red[i] = clamp_unit(hsl_channel(0.0f, h, s, l));
+                green[i] = clamp_unit(hsl_channel(8.0f, h, s, l));
+                blue[i] = clamp_unit(hsl_channel(4.0f, h, s, l));
+            }
+            break;
+        case Value::hsv:
+            for (size_t i = 0; i < num_colors; ++i) {
+                const float h = wrap_unit(channel0[i]);
+                const float s = clamp_unit(channel1[i]);
+                const float v = clamp_unit(channel2[i]);
+                red[i] = clamp_unit(hsv_channel(5.0f, h, s, v));
+                green[i] = clamp_unit(hsv_channel(3.0f, h, s, v));
+                blue[i] = clamp_unit(hsv_channel(1.0f, h, s, v));
+            }
+            break;
+        case Value::oklab:
+            for (size_t i = 0; i < num_colors; ++i) {
+                const float lab_l = channel0[i];
+                const float lab_a = channel1[i];
+                const float lab_b = channel2[i];
+                const float l_root = lab_l + (0.3963377774f * lab_a)
+                    + (0.2158037573f * lab_b);
+                const float m_root = lab_l - (0.1055613458f * lab_a)
+                    - (0.0638541728f * lab_b);
+                const float s_root = lab_l - (0.0894841775f * lab_a)
+                    - (1.2914855480f * lab_b);
+                const float l = l_root * l_root * l_root;
+                const float m = m_root * m_root * m_root;
+                const float s = s_root * s_root * s_root;
+                const float r = (4.0767416621f * l) - (3.3077115913f * m)
+                    + (0.2309699292f * s);
+                const float g = (-1.2684380046f * l) + (2.6097574011f * m)
+                    - (0.3413193965f * s);
+                const float b = (-0.0041960863f * l) - (0.7034186147f * m)
+                    + (1.7076147010f * s);
+                red[i] = clamp_unit(linear_to_srgb(clamp_unit(r)));
+                green[i] = clamp_unit(linear_to_srgb(clamp_unit(g)));
+                blue[i] = clamp_unit(linear_to_srgb(clamp_unit(b)));
+            }
+            break;
+        case Value::lab:
+            for (size_t i = 0; i < num_colors; ++i) {
+                const float fy = (channel0[i] + 16.0f) / 116.0f;
+                const float x = 0.95047f * lab_f_inverse(
+                    fy + (channel1[i] / 500.0f));
+                const float y = lab_f_inverse(fy);
+                const float z = 1.08883f * lab_f_inverse(
+                    fy - (channel2[i] / 200.0f));
+                const float r = (3.2404542f * x) - (1.5371385f * y)
+                    - (0.4985314f * z);
+                const float g = (-0.9692660f * x) + (1.8760108f * y)
+                    + (0.0415560f * z);
+                const float b = (0.0556434f * x) - (0.2040259f * y)
+                    + (1.0572252f * z);
+                red[i] = clamp_unit(linear_to_srgb(clamp_unit(r)));
+                green[i] = clamp_unit(linear_to_srgb(clamp_unit(g)));
+                blue[i] = clamp_unit(linear_to_srgb(clamp_unit(b)));
+            }
+            break;
+        default: break;
+    }
+}
+
+ColorSpace::Value ColorSpace::value_from_string(
+    const std::string &value_str) {
+    if (value_str.compare(value_to_string(Value::rgb)) == 0) {
+        return Value::rgb;
+    }
+    if (value_str.compare(value_to_string(Value::linear_rgb)) == 0) {
+        return Value::linear_rgb;
+    }
+    if (value_str.compare(value_to_string(Value::hsl)) == 0) {
+        return Value::hsl;
+    }
+    if (value_str.compare(value_to_string(Value::hsv)) == 0) {
+        return Value::hsv;
+    }
+    if (value_str.compare(value_to_string(Value::oklab)) == 0) {
+        return Value::oklab;
+    }
+    if (value_str.compare(value_to_string(Value::lab)) == 0) {
+        return Value::lab;
+    }
+    return Value::unknown;
+}
+
+std::string ColorSpace::value_to_string(const Value value) {
+    switch (value) {
+        case ColorSpace::Value::rgb: return "rgb";
+        case ColorSpace::Value::linear_rgb: return "linear-rgb";
+        case ColorSpace::Value::hsl: return "hsl";
+        case ColorSpace::Value::hsv: return "hsv";
+        case ColorSpace::Value::oklab: return "oklab";
+        case ColorSpace::Value::lab: return "lab";
+        default: break;
+    }
+    return "unknown";
+}
+}  // namespace palette
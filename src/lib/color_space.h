@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace palette {
+
+// Color spaces in which colors can be interpolated or laid out. Conversion
+// functions operate on blocks of channel arrays (structure of arrays) so the
+// compiler can vectorize them. Channel values are in [0, 1] for every space
+// except OKLab, whose a and b channels are signed, and CIELAB (D65), whose
+// channels keep their usual scale of [0, 100] for L so that distances in it
+// are Delta E (1976) values.
+class ColorSpace {
+ public:
+    enum class Value { rgb, linear_rgb, hsl, hsv, oklab, lab, unknown };
+
+    explicit ColorSpace(Value value);
+    explicit ColorSpace(const std::string &value_str);
+    ColorSpace(const ColorSpace &other);
+
+    Value get() const;
+    bool valid() const;
+    std::string to_string() const;
+
+    // Return the index of the channel holding a hue, which wraps around at
+    // 1, or -1 if the space has no hue channel.
+    int hue_channel() const;
+
+    // Convert num_colors sRGB colors to this space. The output arrays may
+    // alias the input arrays.
+    void from_rgb(size_t num_colors,
+                  const float *red, const float *green, const float *blue,
+                  float *channel0, float *channel1, float *channel2) const;
+
+    // Convert num_colors colors in this space to sRGB, clamped to [0, 1].
+    // The output arrays may alias the input arrays.
+    void to_rgb(size_t num_colors,
+                const float *channel0, const float *channel1,
+                const float *channel2,
+                float *red, float *green, float *blue) const;
+
+    static Value value_from_string(const std::string &value_str);
+    static std::string value_to_string(const Value value);
+
+ private:
+    Value value_;
+};
+}  // namespace palette
@@ -29,6 +29,11 @@ ColorVector &ColorVector::operator=(const ColorVector &other) {
     return *this;
 }
 
+ColorVector &ColorVector::operator=(ColorVector &&other) {
+    colors_ = std::move(other.colors_);
+    return *this;
+}
+
 std::vector<Color> &ColorVector::get() { return colors_; }
 
 const std::vector<Color> &ColorVector::get() const {
@@ -16,6 +16,7 @@ class ColorVector {
     ColorVector(ColorVector &&other);
 
     ColorVector &operator=(const ColorVector &other);
+    ColorVector &operator=(ColorVector &&other);
 
     std::vector<Color> &get();
     const std::vector<Color> &get() const;
@@ -0,0 +1,308 @@
+#include "lib/corpus_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Magick++.h>
+
+#include "lib/color_histogram.h"
+#include "lib/corpus_histogram_format.h"
+#include "lib/image.h"
+#include "lib/mapped_file.h"
+#include "lib/parallel.h"
+#include "lib/sample_weights.h"
+
+namespace palette {
+namespace {
+
+// Coarsening by all 8 bits of each channel leaves a single color.
+const uint32_t max_coarsened_bits = 8;
+
+// A histogram with the bits it was coarsened by.
+struct Partial final {
+    ColorHistogram histogram_;
+    uint32_t coarsened_bits_;
+};
+
+void cap_colors(size_t max_colors, Partial &partial);
+void merge_partials(size_t max_colors, Partial &into, Partial &&from);
+bool section_fits(uint64_t offset, uint64_t num_bytes, size_t file_size);
+}  // namespace
+
+CorpusHistogram::Settings::Settings() :
+    max_colors_(default_max_colors),
+    max_pixels_(0),
+    weigh_by_pixels_(false),
+    max_threads_(0) { }
+
+CorpusHistogram::CorpusHistogram() : CorpusHistogram(Settings()) { }
+
+CorpusHistogram::CorpusHistogram(const Settings &settings) :
+    settings_(settings),
+    histogram_(),
+    num_images_(0),
+    coarsened_bits_(0) { }
+
+CorpusHistogram::CorpusHistogram(const CorpusHistogram &other) :
+    settings_(other.settings_),
+    histogram_(other.histogram_),
+    num_images_(other.num_images_),
+    coarsened_bits_(other.coarsened_bits_) { }
+
+CorpusHistogram &CorpusHistogram::operator=(const CorpusHistogram &other) {
+    settings_ = other.settings_;
+    histogram_ = other.histogram_;
+    num_images_ = other.num_images_;
+    coarsened_bits_ = other.coarsened_bits_;
+    return *this;
+}
+
+bool CorpusHistogram::add_images(const std::vector<std::string> &files,
+                                 std::stringstream &error_stream) {
+    const size_t batch_size = (settings_.max_threads_ > 0)
+        ? settings_.max_threads_ : Parallel::default_num_threads();
+    Partial total{ColorHistogram(), 0};
+    for (size_t first = 0; first < files.size(); first += batch_size) {
+        const size_t num_files = std::min(batch_size, files.size() - first);
+        std::vector<Partial> batch(num_files, Partial{ColorHistogram(), 0});
+        std::vector<std::string> errors(num_files);
+        Parallel::run(num_files, [&](size_t f) {
+            const std::string &file = files[first + f];
+            std::stringstream file_error_stream;
+            Image image;
+            bool success = true;
+            if (settings_.max_pixels_ > 0) {
+                Magick::Geometry original_size;
+                success = image.read(file, settings_.max_pixels_,
+                                     original_size, file_error_stream);
+            } else {
+                try {
+                    image.get().read(file);
+                } catch (Magick::Exception &error) {
+                    file_error_stream << "ImageMagick exception: "
+                        << error.what() << std::endl;
+                    success = false;
+                }
+            }
+            if (success) {
+                batch[f].histogram_ =
+                    image.get_histogram(SampleWeights(), success);
+                if (!success) {
+                    file_error_stream << "Failed to count the colors of "
+                        << file << std::endl;
+                }
+            }
+            if (!success) {
+                errors[f] = file_error_stream.str();
+                return;
+            }
+            const double total_weight = batch[f].histogram_.total_weight();
+            if (!settings_.weigh_by_pixels_ && (total_weight > 0.0)) {
+                batch[f].histogram_.scale(1.0 / total_weight);
+            }
+            cap_colors(settings_.max_colors_, batch[f]);
+        }, batch_size);
+        for (const std::string &error : errors) {
+            if (!error.empty()) {
+                error_stream << error;
+                return false;
+            }
+        }
+
+        // Merge pairs of histograms, then pairs of pairs, and so on.
+        for (size_t stride = 1; stride < num_files; stride *= 2) {
+            const size_t num_merges =
+                (num_files + (2 * stride) - 1) / (2 * stride);
+            Parallel::run(num_merges, [&](size_t m) {
+                const size_t into = m * 2 * stride;
+                if ((into + stride) < num_files) {
+                    merge_partials(settings_.max_colors_, batch[into],
+                                   std::move(batch[into + stride]));
+                }
+            }, batch_size);
+        }
+        merge_partials(settings_.max_colors_, total, std::move(batch[0]));
+    }
+    add(std::move(total.histogram_), total.coarsened_bits_, files.size());
+    return true;
+}
+
+void CorpusHistogram::add(const CorpusHistogram &other) {
+    add(ColorHistogram(other.histogram_), other.coarsened_bits_,
+        other.num_images_);
+}
+
+// Map a partial histogram file, validate it, and copy its colors. Return
+// whether or not the file is a usable partial histogram.
+bool CorpusHistogram::read(const std::string &file_name,
+                           std::stringstream &error_stream) {
+    MappedFile file;
+    if (!file.open(file_name, error_stream)) {
+        return false;
+    }
+    if (!has_magic(file.data(), file.size())
+        || (file.size() < sizeof(CorpusHistogramHeader))) {
+        error_stream << file_name << " is not a corpus histogram file"
+            << std::endl;
+        return false;
+    }
+
+    const auto *header =
+        reinterpret_cast<const CorpusHistogramHeader *>(file.data());
+    if (header->byte_order_ != CorpusHistogramHeader::byte_order_mark) {
+        error_stream << file_name << " was written on a machine with "
+            << "a different byte order" << std::endl;
+        return false;
+    }
+    if (header->version_ != CorpusHistogramHeader::current_version) {
+        error_stream << file_name << " has corpus histogram format version "
+            << header->version_ << "; only version "
+            << CorpusHistogramHeader::current_version << " is supported"
+            << std::endl;
+        return false;
+    }
+
+    const uint64_t num_colors = header->num_colors_;
+    bool valid = (num_colors <= (uint64_t(1) << 24))
+        && (header->coarsened_bits_ <= max_coarsened_bits)
+        && section_fits(header->colors_offset_,
+                        num_colors * sizeof(uint32_t), file.size())
+        && section_fits(header->weights_offset_,
+                        num_colors * sizeof(double), file.size());
+    ColorHistogram histogram;
+    if (valid) {
+        const auto *colors = reinterpret_cast<const uint32_t *>(
+            file.data() + header->colors_offset_);
+        const auto *weights = reinterpret_cast<const double *>(
+            file.data() + header->weights_offset_);
+        histogram.reserve(num_colors);
+        for (uint64_t i = 0; valid && (i < num_colors); ++i) {
+            // Merging relies on colors in strictly ascending order.
+            valid = (colors[i] <= 0xFFFFFF)
+                && ((i == 0) || (colors[i - 1] < colors[i]))
+                && std::isfinite(weights[i]) && (weights[i] >= 0.0);
+            histogram.add(colors[i], weights[i]);
+        }
+    }
+    if (!valid) {
+        error_stream << file_name << " is a truncated or corrupt "
+            << "corpus histogram file" << std::endl;
+        return false;
+    }
+
+    histogram_ = std::move(histogram);
+    num_images_ = header->num_images_;
+    coarsened_bits_ = header->coarsened_bits_;
+    return true;
+}
+
+bool CorpusHistogram::write(const std::string &file_name,
+                            std::stringstream &error_stream) const {
+    const size_t num_colors = histogram_.size();
+    CorpusHistogramHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic_, CorpusHistogramHeader::magic_string,
+                sizeof(header.magic_));
+    header.byte_order_ = CorpusHistogramHeader::byte_order_mark;
+    header.version_ = CorpusHistogramHeader::current_version;
+    header.num_colors_ = num_colors;
+    header.num_images_ = num_images_;
+    header.coarsened_bits_ = coarsened_bits_;
+    // The header size is a multiple of 8, and so is the size of the
+    // colors when padded.
+    header.colors_offset_ = sizeof(CorpusHistogramHeader);
+    header.weights_offset_ = header.colors_offset_
+        + (((num_colors * sizeof(uint32_t)) + 7) & ~uint64_t(7));
+
+    std::vector<uint32_t> colors(num_colors + (num_colors % 2), 0);
+    std::vector<double> weights(num_colors);
+    for (size_t i = 0; i < num_colors; ++i) {
+        colors[i] = histogram_.rgb24(i);
+        weights[i] = histogram_.weight(i);
+    }
+
+    std::ofstream out(file_name, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(colors.data()),
+              static_cast<std::streamsize>(colors.size() * sizeof(uint32_t)));
+    out.write(reinterpret_cast<const char *>(weights.data()),
+              static_cast<std::streamsize>(num_colors * sizeof(double)));
+    out.close();
+    if (!out) {
+        error_stream << "Failed to write corpus histogram to " << file_name
+            << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool CorpusHistogram::has_magic(const unsigned char *data, size_t size) {
+    return (data != nullptr)
+        && (size >= sizeof(CorpusHistogramHeader::magic_string))
+        && (std::memcmp(data, CorpusHistogramHeader::magic_string,
+                        sizeof(CorpusHistogramHeader::magic_string)) == 0);
+}
+
+const ColorHistogram &CorpusHistogram::get() const { return histogram_; }
+
+size_t CorpusHistogram::num_images() const { return num_images_; }
+
+uint32_t CorpusHistogram::coarsened_bits() const { return coarsened_bits_; }
+
+void CorpusHistogram::add(ColorHistogram &&histogram,
+                          uint32_t coarsened_bits, size_t num_images) {
+    Partial total{std::move(histogram_), coarsened_bits_};
+    merge_partials(settings_.max_colors_, total,
+                   Partial{std::move(histogram), coarsened_bits});
+    histogram_ = std::move(total.histogram_);
+    coarsened_bits_ = total.coarsened_bits_;
+    num_images_ += num_images;
+}
+
+namespace {
+
+// Coarsen the histogram one more bit at a time until it has at most
+// max_colors colors.
+void cap_colors(size_t max_colors, Partial &partial) {
+    while ((partial.histogram_.size() > max_colors)
+           && (partial.coarsened_bits_ < max_coarsened_bits)) {
+        partial.histogram_.coarsen(++partial.coarsened_bits_);
+    }
+}
+
+// Merge a histogram into another after coarsening the finer of them to
+// match the other, and then cap the colors of the result.
+void merge_partials(size_t max_colors, Partial &into, Partial &&from) {
+    const uint32_t bits = std::max(into.coarsened_bits_,
+                                   from.coarsened_bits_);
+    if (into.coarsened_bits_ < bits) {
+        into.histogram_.coarsen(bits);
+    }
+    if (from.coarsened_bits_ < bits) {
+        from.histogram_.coarsen(bits);
+    }
+    if (into.histogram_.empty()) {
+        into.histogram_ = std::move(from.histogram_);
+    } else {
+        into.histogram_.merge(from.histogram_);
+        // Groups present in both hold two means until coarsened again.
+        into.histogram_.coarsen(bits);
+    }
+    into.coarsened_bits_ = bits;
+    cap_colors(max_colors, into);
+}
+
+bool section_fits(uint64_t offset, uint64_t num_bytes, size_t file_size) {
+    return ((offset % 8) == 0) && (offset <= file_size)
+        && (num_bytes <= (file_size - offset));
+}
+}  // namespace
+}  // namespace palette
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "lib/color_histogram.h"
+
+namespace palette {
+
+// Histogram of the colors of a whole corpus of images, to cluster once into
+// a shared palette.
+//
+// Images are read and counted in parallel, a batch of as many images as
+// there are threads at a time, and the histograms of a batch are merged
+// pairwise in a tree whose levels also run in parallel before the result
+// is merged into the corpus. Whenever a merged histogram holds more
+// distinct colors than the cap, it is coarsened one more bit per channel,
+// and every histogram merged later is coarsened as much first, so memory
+// stays bounded by the cap times the number of histograms in flight.
+//
+// Corpora can be split among processes that each write their histogram to
+// a partial file, which a coordinating process reads and adds.
+class CorpusHistogram {
+ public:
+    // 2^20 colors take 12 MiB per histogram.
+    static constexpr size_t default_max_colors = size_t(1) << 20;
+
+    struct Settings final {
+        Settings();
+
+        // Cap on the distinct colors of any merged histogram.
+        size_t max_colors_;
+        // Scale each image down while reading it to at most this many
+        // pixels, or 0 to read it at full size.
+        size_t max_pixels_;
+        // Weigh images by their number of pixels instead of equally.
+        bool weigh_by_pixels_;
+        // Threads, or 0 for Parallel::default_num_threads().
+        size_t max_threads_;
+    };
+
+    CorpusHistogram();
+    explicit CorpusHistogram(const Settings &settings);
+    CorpusHistogram(const CorpusHistogram &other);
+
+    CorpusHistogram &operator=(const CorpusHistogram &other);
+
+    // Count the colors of the image files and add them. Return whether or
+    // not every file could be read; nothing is added otherwise.
+    bool add_images(const std::vector<std::string> &files,
+                    std::stringstream &error_stream);
+
+    // Add the colors of another corpus, coarsening whichever of the two
+    // is finer to match the other.
+    void add(const CorpusHistogram &other);
+
+    // Replace this corpus with a partial file written by write(), keeping
+    // the settings.
+    bool read(const std::string &file_name, std::stringstream &error_stream);
+    bool write(const std::string &file_name,
+               std::stringstream &error_stream) const;
+
+    static bool has_magic(const unsigned char *data, size_t size);
+
+    // Return the merged histogram, ordered by color.
+    const ColorHistogram &get() const;
+    size_t num_images() const;
+    uint32_t coarsened_bits() const;
+
+ private:
+    // Merge a histogram of num_images images into this corpus.
+    void add(ColorHistogram &&histogram, uint32_t coarsened_bits,
+             size_t num_images);
+
+    Settings settings_;
+    ColorHistogram histogram_;
+    size_t num_images_;
+    uint32_t coarsened_bits_;
+};
+}  // namespace palette
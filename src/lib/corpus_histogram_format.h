@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+namespace palette {
+
+// On-disk layout of a partial corpus histogram, written by one process of a
+// sharded run for another to merge. All integers are stored in host byte
+// order, which readers verify through byte_order_. Every section begins on
+// an 8-byte boundary.
+//
+//   header        CorpusHistogramHeader
+//   colors        uint32_t[num_colors_], each packed as 0x00RRGGBB, in
+//                 ascending order
+//   weights       double[num_colors_]
+struct CorpusHistogramHeader final {
+    static constexpr char magic_string[8] = {
+        'P', 'A', 'L', 'H', 'I', 'S', 'T', '\0' };
+    static constexpr uint32_t byte_order_mark = 0x01020304;
+    static constexpr uint32_t current_version = 1;
+
+    char magic_[8];
+    uint32_t byte_order_;
+    uint32_t version_;
+    uint64_t num_colors_;
+    uint64_t num_images_;
+    // Low bits of each channel merged away to keep within the color cap.
+    uint32_t coarsened_bits_;
+    uint32_t reserved_;
+    uint64_t colors_offset_;
+    uint64_t weights_offset_;
+};
+
+static_assert(sizeof(CorpusHistogramHeader) == 56,
+              "Corpus histogram header layout changed");
+}  // namespace palette
@@ -0,0 +1,149 @@
+#include "lib/cpu_features.h"
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <utility>
+
+namespace palette {
+namespace {
+
+// Levels and the notes on the override, settled on first use.
+struct Selection final {
+    CpuFeatures::Level detected_;
+    CpuFeatures::Level active_;
+    std::string note_;
+};
+
+const Selection &get_selection();
+Selection select_level();
+CpuFeatures::Level detect_level();
+
+// Return the names of the detected extensions the kernels care about.
+std::string list_extensions();
+}  // namespace
+
+CpuFeatures::Level CpuFeatures::detected() {
+    return get_selection().detected_;
+}
+
+CpuFeatures::Level CpuFeatures::active() { return get_selection().active_; }
+
+std::string CpuFeatures::level_to_string(Level level) {
+    switch (level) {
+        case Level::baseline: return "baseline";
+        case Level::sse4_2: return "sse4.2";
+        case Level::avx2: return "avx2";
+        case Level::avx512: return "avx512";
+        default: return "unknown";
+    }
+}
+
+bool CpuFeatures::string_to_level(const std::string &name, Level &level) {
+    for (const Level candidate : {Level::baseline, Level::sse4_2,
+                                  Level::avx2, Level::avx512}) {
+        if (name == level_to_string(candidate)) {
+            level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string CpuFeatures::report() {
+    const Selection &selection = get_selection();
+    std::stringstream report_stream;
+    report_stream << "Detected extensions: " << list_extensions()
+        << std::endl;
+    report_stream << "Detected level: "
+        << level_to_string(selection.detected_) << std::endl;
+    if (!selection.note_.empty()) {
+        report_stream << selection.note_ << std::endl;
+    }
+    report_stream << "Kernels in use: "
+        << level_to_string(selection.active_) << std::endl;
+    return report_stream.str();
+}
+
+namespace {
+
+const Selection &get_selection() {
+    static const Selection selection = select_level();
+    return selection;
+}
+
+Selection select_level() {
+    Selection selection{detect_level(), CpuFeatures::Level::baseline,
+                        std::string()};
+    selection.active_ = selection.detected_;
+    const char *value = std::getenv(CpuFeatures::override_variable);
+    if ((value == nullptr) || (*value == '\0')) {
+        return selection;
+    }
+
+    std::stringstream note_stream;
+    note_stream << CpuFeatures::override_variable << "=" << value;
+    CpuFeatures::Level level = CpuFeatures::Level::baseline;
+    if (!CpuFeatures::string_to_level(value, level)) {
+        note_stream << " is not one of baseline, sse4.2, avx2 or avx512; "
+            << "ignoring it";
+    } else if (level > selection.detected_) {
+        note_stream << " is not supported here; ignoring it";
+    } else {
+        note_stream << " overrides the detected level";
+        selection.active_ = level;
+    }
+    selection.note_ = note_stream.str();
+    return selection;
+}
+
+CpuFeatures::Level detect_level() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    // These also check that the operating system saves the wider
+    // registers.
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+        && __builtin_cpu_supports("avx512vl")
+        && __builtin_cpu_supports("avx512dq")
+        && __builtin_cpu_supports("fma")) {
+        return CpuFeatures::Level::avx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return CpuFeatures::Level::avx2;
+    }
+    if (__builtin_cpu_supports("sse4.2")
+        && __builtin_cpu_supports("popcnt")) {
+        return CpuFeatures::Level::sse4_2;
+    }
+#endif
+    return CpuFeatures::Level::baseline;
+}
+
+std::string list_extensions() {
+    std::stringstream extensions_stream;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    // __builtin_cpu_supports takes only string literals.
+    const std::pair<const char *, bool> extensions[] = {
+        {"sse4.2", __builtin_cpu_supports("sse4.2")},
+        {"popcnt", __builtin_cpu_supports("popcnt")},
+        {"avx", __builtin_cpu_supports("avx")},
+        {"avx2", __builtin_cpu_supports("avx2")},
+        {"fma", __builtin_cpu_supports("fma")},
+        {"avx512f", __builtin_cpu_supports("avx512f")},
+        {"avx512bw", __builtin_cpu_supports("avx512bw")},
+        {"avx512vl", __builtin_cpu_supports("avx512vl")},
+        {"avx512dq", __builtin_cpu_supports("avx512dq")}};
+    for (const auto &extension : extensions) {
+        if (extension.second) {
+            extensions_stream << extension.first << " ";
+        }
+    }
+#endif
+    const std::string extensions_string = extensions_stream.str();
+    return extensions_string.empty()
+        ? std::string("none")
+        : extensions_string.substr(0, extensions_string.size() - 1);
+}
+}  // namespace
+}  // namespace palette
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+
+namespace palette {
+
+// Instruction set extensions of the processor, read once through CPUID,
+// which choose the variant of the library's kernels that runs.
+class CpuFeatures {
+ public:
+    // Levels of kernels, each of which requires the ones before it.
+    enum class Level { baseline, sse4_2, avx2, avx512 };
+
+    // Environment variable that lowers the level, such as to benchmark a
+    // slower variant, to one of the names level_to_string returns.
+    static constexpr const char *override_variable = "PALETTE_CPU_FEATURES";
+
+    // Return the highest level the processor and operating system support.
+    static Level detected();
+
+    // Return the level the kernels use: the detected level, or the level
+    // override_variable names if that is lower.
+    static Level active();
+
+    static std::string level_to_string(Level level);
+
+    // Set level to the level of the given name. Return whether or not the
+    // name is known.
+    static bool string_to_level(const std::string &name, Level &level);
+
+    // Return a description of the detected features, any override, and
+    // the level in use, a line each.
+    static std::string report();
+};
+}  // namespace palette
@@ -0,0 +1,40 @@
+#include "lib/fixed_hsl.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <Magick++.h>
+
+#include "lib/kernels.h"
+#include "lib/packed_color.h"
+
+namespace palette {
+
+// The kernel stores each color as three consecutive integers.
+static_assert((sizeof(FixedHsl) == (3 * sizeof(uint32_t)))
+              && std::is_standard_layout<FixedHsl>::value,
+              "FixedHsl must hold exactly its three integers");
+static_assert(FixedHsl::one == Kernels::hsl_one,
+              "Kernels must use the fixed-point scale of FixedHsl");
+
+void FixedHsl::from_rgb24(const uint32_t *rgb, size_t num_colors,
+                          FixedHsl *hsl) {
+    Kernels::get().hsl_from_rgb24(rgb, num_colors,
+                                  reinterpret_cast<uint32_t *>(hsl));
+}
+
+FixedHsl FixedHsl::from_magick(const Magick::Color &color) {
+    return from_rgb(PackedColor16::from_magick(color));
+}
+
+double FixedHsl::hue() const { return hue_ / static_cast<double>(one); }
+
+double FixedHsl::saturation() const {
+    return saturation_ / static_cast<double>(one);
+}
+
+double FixedHsl::lightness() const {
+    return lightness_ / static_cast<double>(one);
+}
+}  // namespace palette
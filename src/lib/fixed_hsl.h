@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <Magick++.h>
+
+#include "lib/packed_color.h"
+
+namespace palette {
+
+// Hue, saturation and lightness of a color in fixed point: each is an
+// integer in [0, one] standing for a value in [0, 1], as Magick::ColorHSL
+// gives them. Conversions to and from integer channels follow ImageMagick's
+// ConvertRGBToHSL and ConvertHSLToRGB in integer arithmetic alone and
+// round to the nearest value, so they agree with ImageMagick within one
+// quantum without constructing a Magick::ColorHSL.
+//
+// One unit is finer than the smallest difference between the hues,
+// saturations or lightnesses of two 8-bit colors, so ordering 8-bit colors
+// by their FixedHsl orders them as ordering by their values in double.
+struct FixedHsl {
+    static constexpr uint32_t one = uint32_t(1) << 24;
+
+    // Convert from integer channels.
+    template <typename Channel>
+    static constexpr FixedHsl from_rgb(const PackedColor<Channel> &color);
+
+    // Convert from 8 bits per channel packed as 0xRRGGBB.
+    static constexpr FixedHsl from_rgb24(uint32_t rgb) {
+        return from_rgb(PackedColor8::from_rgb24(rgb));
+    }
+
+    // Convert num_colors colors packed as 0xRRGGBB into hsl. The results
+    // equal those of from_rgb24, but the hsl_from_rgb24 kernel of the
+    // processor has no branches and divides in double, which is exact
+    // here, so that the compiler vectorizes it.
+    static void from_rgb24(const uint32_t *rgb, size_t num_colors,
+                           FixedHsl *hsl);
+
+    // Convert from the quanta of an ImageMagick color at 16 bits, which
+    // holds 8-bit and 16-bit quanta without loss.
+    static FixedHsl from_magick(const Magick::Color &color);
+
+    // Convert from values in [0, 1], clamping out of range values.
+    static constexpr FixedHsl from_unit(double hue, double saturation,
+                                        double lightness) {
+        return FixedHsl{unit_to_fixed(hue), unit_to_fixed(saturation),
+                        unit_to_fixed(lightness)};
+    }
+
+    // Convert to channels of the given depth.
+    template <typename Channel>
+    constexpr PackedColor<Channel> to_rgb() const;
+
+    double hue() const;
+    double saturation() const;
+    double lightness() const;
+
+    constexpr bool operator==(const FixedHsl &other) const {
+        return (hue_ == other.hue_) && (saturation_ == other.saturation_)
+            && (lightness_ == other.lightness_);
+    }
+
+    constexpr bool operator!=(const FixedHsl &other) const {
+        return !(*this == other);
+    }
+
+    // Order by hue, then saturation, then lightness.
+    constexpr bool operator<(const FixedHsl &other) const {
+        return (hue_ != other.hue_) ? (hue_ < other.hue_)
+            : ((saturation_ != other.saturation_)
+               ? (saturation_ < other.saturation_)
+               : (lightness_ < other.lightness_));
+    }
+
+    uint32_t hue_;
+    uint32_t saturation_;
+    uint32_t lightness_;
+
+ private:
+    static constexpr uint32_t unit_to_fixed(double value) {
+        return static_cast<uint32_t>(
+            (((value < 0.0) ? 0.0 : ((value > 1.0) ? 1.0 : value)) * one)
+            + 0.5);
+    }
+
+    // Return numerator / denominator rounded to the nearest integer.
+    static constexpr uint64_t divide_rounded(uint64_t numerator,
+                                             uint64_t denominator) {
+        return (numerator + (denominator / 2)) / denominator;
+    }
+};
+
+static_assert(std::is_trivially_copyable<FixedHsl>::value,
+              "FixedHsl must be trivially copyable");
+
+template <typename Channel>
+constexpr FixedHsl FixedHsl::from_rgb(const PackedColor<Channel> &color) {
+    static_assert(!std::is_floating_point<Channel>::value,
+                  "FixedHsl converts from integer channels only");
+    const uint64_t channel_max =
+        static_cast<uint64_t>(PackedColor<Channel>::channel_max);
+    const uint64_t red = color.red_;
+    const uint64_t green = color.green_;
+    const uint64_t blue = color.blue_;
+    const uint64_t max = std::max(red, std::max(green, blue));
+    const uint64_t min = std::min(red, std::min(green, blue));
+    const uint64_t chroma = max - min;
+    const uint64_t sum = max + min;
+    const auto lightness =
+        static_cast<uint32_t>(divide_rounded(sum * one, 2 * channel_max));
+    if (chroma == 0) {
+        return FixedHsl{0, 0, lightness};
+    }
+
+    // Six times the hue times the chroma, in [0, 6 * chroma).
+    uint64_t hue_sixths = 0;
+    if (max == red) {
+        hue_sixths = (green >= blue)
+            ? (green - blue) : ((6 * chroma) + green - blue);
+    } else if (max == green) {
+        hue_sixths = ((2 * chroma) + blue) - red;
+    } else {
+        hue_sixths = ((4 * chroma) + red) - green;
+    }
+    // The lightness is at most one half when sum is at most channel_max.
+    const uint64_t saturation_denominator =
+        (sum <= channel_max) ? sum : ((2 * channel_max) - sum);
+    return FixedHsl{
+        static_cast<uint32_t>(divide_rounded(hue_sixths * one, 6 * chroma)),
+        static_cast<uint32_t>(divide_rounded(chroma * one,
+                                             saturation_denominator)),
+        lightness};
+}
+
+template <typename Channel>
+constexpr PackedColor<Channel> FixedHsl::to_rgb() const {
+    const uint64_t lightness = lightness_;
+    const uint64_t chroma = divide_rounded(
+        ((lightness <= (one / 2)) ? (2 * lightness) : (2 * (one - lightness)))
+        * saturation_, one);
+    // A hue of one is a hue of zero.
+    const uint64_t hue_sixths = (uint64_t(hue_) * 6) % (uint64_t(6) * one);
+    const uint64_t sector = hue_sixths / one;
+    const uint64_t fraction = hue_sixths % one;
+    const uint64_t x = divide_rounded(
+        chroma * (((sector % 2) == 0) ? fraction : (one - fraction)), one);
+
+    // Channels in units of one half, so that the least channel, which is
+    // the lightness less half the chroma, needs no rounding.
+    const uint64_t least = (2 * lightness) - std::min(2 * lightness, chroma);
+    const uint64_t greatest = least + (2 * chroma);
+    const uint64_t middle = least + (2 * x);
+    uint64_t halves[3] = {least, least, least};
+    switch (sector) {
+        case 0: halves[0] = greatest; halves[1] = middle; break;
+        case 1: halves[0] = middle; halves[1] = greatest; break;
+        case 2: halves[1] = greatest; halves[2] = middle; break;
+        case 3: halves[1] = middle; halves[2] = greatest; break;
+        case 4: halves[0] = middle; halves[2] = greatest; break;
+        default: halves[0] = greatest; halves[2] = middle; break;
+    }
+
+    Channel channels[3] = {0, 0, 0};
+    for (size_t c = 0; c < 3; ++c) {
+        const uint64_t half = std::min(halves[c], uint64_t(2) * one);
+        if constexpr (std::is_floating_point<Channel>::value) {
+            channels[c] = static_cast<Channel>(
+                static_cast<double>(half) / (2.0 * one));
+        } else {
+            channels[c] = static_cast<Channel>(divide_rounded(
+                half * static_cast<uint64_t>(
+                    PackedColor<Channel>::channel_max),
+                uint64_t(2) * one));
+        }
+    }
+    return PackedColor<Channel>{channels[0], channels[1], channels[2]};
+}
+
+static_assert(FixedHsl::from_rgb24(0xFF0000)
+              == FixedHsl{0, FixedHsl::one, FixedHsl::one / 2},
+              "Red must have hue 0, full saturation and half lightness");
+static_assert(FixedHsl::from_rgb24(0x00FFFF).hue_ == FixedHsl::one / 2,
+              "Cyan must have hue one half");
+static_assert(FixedHsl::from_rgb24(0x12ABEF).to_rgb<uint8_t>().to_rgb24()
+              == 0x12ABEF,
+              "8-bit round trip must be exact");
+}  // namespace palette
@@ -0,0 +1,205 @@
+#include "lib/gradient.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <sstream>
+#include <vector>
+
+#include "lib/color.h"
+#include "lib/color_space.h"
+#include "lib/hex_color_writer.h"
+
+namespace palette {
+namespace {
+
+const size_t block_size = 1024;
+
+// Stops whose saturation is below this have no meaningful hue.
+const float achromatic_saturation = 1.0e-4f;
+
+uint8_t to_channel8(float c) {
+    return static_cast<uint8_t>((c * 255.0f) + 0.5f);
+}
+}  // namespace
+
+Gradient::Gradient(const ColorSpace &color_space) :
+    color_space_(color_space),
+    stop_colors_(),
+    stop_positions_() { }
+
+void Gradient::add_stop(const Color &color) {
+    stop_colors_.push_back(color.to_rgb24());
+    stop_positions_.push_back(std::nullopt);
+}
+
+void Gradient::add_stop(const Color &color, double position) {
+    stop_colors_.push_back(color.to_rgb24());
+    stop_positions_.push_back(position);
+}
+
+bool Gradient::get_colors(size_t num_colors, std::vector<Color> &colors,
+                          std::stringstream &error_stream) const {
+    colors.clear();
+    colors.reserve(num_colors);
+    auto append_block = [&colors](const uint8_t *red, const uint8_t *green,
+                                  const uint8_t *blue, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            colors.push_back(Color::from_rgb24(
+                (static_cast<uint32_t>(red[i]) << 16)
+                | (static_cast<uint32_t>(green[i]) << 8) | blue[i]));
+        }
+    };
+    return generate(num_colors, append_block, error_stream);
+}
+
+bool Gradient::write_colors(size_t num_colors, HexColorWriter &writer,
+                            std::stringstream &error_stream) const {
+    auto write_block = [&writer](const uint8_t *red, const uint8_t *green,
+                                 const uint8_t *blue, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            writer.write(red[i], green[i], blue[i]);
+        }
+    };
+    if (!generate(num_colors, write_block, error_stream)) {
+        return false;
+    }
+    if (!writer.flush()) {
+        error_stream << "Failed to write gradient colors" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Generate num_colors colors evenly spaced from position 0 to position 1,
+// handing them to the sink one block at a time. Return whether or not the
+// stops describe a valid gradient.
+bool Gradient::generate(size_t num_colors, const BlockSink &sink,
+                        std::stringstream &error_stream) const {
+    const size_t num_stops = stop_colors_.size();
+    if (num_stops == 0) {
+        error_stream << "Gradient has no color stops" << std::endl;
+        return false;
+    }
+    if (!color_space_.valid()) {
+        error_stream << "Unknown gradient color space" << std::endl;
+        return false;
+    }
+
+    // Resolve stop positions and convert stops to the interpolation space.
+    std::vector<float> positions(num_stops);
+    for (size_t s = 0; s < num_stops; ++s) {
+        const double even_position = (num_stops == 1)
+            ? 0.0 : (static_cast<double>(s) / (num_stops - 1));
+        const double position = stop_positions_[s].value_or(even_position);
+        if ((position < 0.0) || (position > 1.0)
+            || ((s > 0) && (position < positions[s - 1]))) {
+            error_stream << "Gradient stop positions must be in [0, 1] "
+                << "and non-decreasing" << std::endl;
+            return false;
+        }
+        positions[s] = static_cast<float>(position);
+    }
+    std::array<std::vector<float>, 3> stops;
+    for (auto &channel : stops) {
+        channel.resize(num_stops);
+    }
+    for (size_t s = 0; s < num_stops; ++s) {
+        stops[0][s] = ((stop_colors_[s] >> 16) & 0xFF) / 255.0f;
+        stops[1][s] = ((stop_colors_[s] >> 8) & 0xFF) / 255.0f;
+        stops[2][s] = (stop_colors_[s] & 0xFF) / 255.0f;
+    }
+    color_space_.from_rgb(num_stops, stops[0].data(), stops[1].data(),
+                          stops[2].data(), stops[0].data(), stops[1].data(),
+                          stops[2].data());
+
+    // Express each segment as a start value and a delta per channel so that
+    // the inner loop is a single multiply-add. Hues travel the short way
+    // around the circle, and an achromatic stop borrows its neighbor's hue.
+    const size_t num_segments = std::max<size_t>(num_stops - 1, 1);
+    std::array<std::vector<float>, 3> starts;
+    std::array<std::vector<float>, 3> deltas;
+    const int hue_channel = color_space_.hue_channel();
+    for (size_t c = 0; c < 3; ++c) {
+        starts[c].resize(num_segments);
+        deltas[c].resize(num_segments);
+        for (size_t s = 0; s < num_segments; ++s) {
+            const size_t next = std::min(s + 1, num_stops - 1);
+            float start = stops[c][s];
+            float end = stops[c][next];
+            if (static_cast<int>(c) == hue_channel) {
+                if (stops[1][s] < achromatic_saturation) {
+                    start = end;
+                } else if (stops[1][next] < achromatic_saturation) {
+                    end = start;
+                }
+                end = start + ((end - start) - std::round(end - start));
+            }
+            starts[c][s] = start;
+            deltas[c][s] = end - start;
+        }
+    }
+
+    std::array<uint32_t, block_size> segment;
+    std::array<float, block_size> fraction;
+    std::array<std::array<float, block_size>, 3> channels;
+    std::array<std::array<uint8_t, block_size>, 3> channels8;
+    size_t current_segment = 0;
+    const double step = (num_colors > 1) ? (1.0 / (num_colors - 1)) : 0.0;
+    for (size_t first = 0; first < num_colors; first += block_size) {
+        const size_t count = std::min(block_size, num_colors - first);
+
+        // Positions increase monotonically, so segments are found by
+        // walking forward from the previous block's segment.
+        for (size_t i = 0; i < count; ++i) {
+            const float t = static_cast<float>((first + i) * step);
+            while (((current_segment + 1) < num_segments)
+                   && (t > positions[current_segment + 1])) {
+                ++current_segment;
+            }
+            const float begin = positions[current_segment];
+            const float end = positions[std::min(current_segment + 1,
+                                                 num_stops - 1)];
+            const float u = (end > begin) ? ((t - begin) / (end - begin))
+                : ((t < begin) ? 0.0f : 1.0f);
+            segment[i] = static_cast<uint32_t>(current_segment);
+            fraction[i] = std::min(1.0f, std::max(0.0f, u));
+        }
+        for (size_t c = 0; c < 3; ++c) {
+            const float *start = starts[c].data();
+            const float *delta = deltas[c].data();
+            float *out = channels[c].data();
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = start[segment[i]] + (delta[segment[i]] * fraction[i]);
+            }
+        }
+        color_space_.to_rgb(count, channels[0].data(), channels[1].data(),
+                            channels[2].data(), channels[0].data(),
+                            channels[1].data(), channels[2].data());
+        for (size_t c = 0; c < 3; ++c) {
+            for (size_t i = 0; i < count; ++i) {
+                channels8[c][i] = to_channel8(channels[c][i]);
+            }
+        }
+
+        // Emit stops at the ends exactly rather than after a round trip
+        // through the interpolation space.
+        if ((first == 0) && (positions.front() == 0.0f)) {
+            channels8[0][0] = (stop_colors_.front() >> 16) & 0xFF;
+            channels8[1][0] = (stop_colors_.front() >> 8) & 0xFF;
+            channels8[2][0] = stop_colors_.front() & 0xFF;
+        }
+        if (((first + count) == num_colors) && (num_colors > 1)
+            && (positions.back() == 1.0f)) {
+            channels8[0][count - 1] = (stop_colors_.back() >> 16) & 0xFF;
+            channels8[1][count - 1] = (stop_colors_.back() >> 8) & 0xFF;
+            channels8[2][count - 1] = stop_colors_.back() & 0xFF;
+        }
+        sink(channels8[0].data(), channels8[1].data(), channels8[2].data(),
+             count);
+    }
+    return true;
+}
+}  // namespace palette
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <sstream>
+#include <vector>
+
+#include "lib/color_space.h"
+
+namespace palette {
+
+class Color;
+class HexColorWriter;
+
+// Discrete gradient through one or more color stops, interpolated in a
+// chosen color space. Colors are generated in fixed-size blocks, so a
+// gradient of any length can be streamed with memory proportional to the
+// number of stops.
+class Gradient {
+ public:
+    explicit Gradient(const ColorSpace &color_space);
+
+    // Add a stop at a position in [0, 1]. Stops added without a position
+    // are spaced evenly by their index among all stops.
+    void add_stop(const Color &color);
+    void add_stop(const Color &color, double position);
+
+    bool get_colors(size_t num_colors, std::vector<Color> &colors,
+                    std::stringstream &error_stream) const;
+    bool write_colors(size_t num_colors, HexColorWriter &writer,
+                      std::stringstream &error_stream) const;
+
+    // Called with the red, green, and blue channels of consecutive colors.
+    using BlockSink = std::function<void(const uint8_t *red,
+                                         const uint8_t *green,
+                                         const uint8_t *blue,
+                                         size_t num_colors)>;
+
+    bool generate(size_t num_colors, const BlockSink &sink,
+                  std::stringstream &error_stream) const;
+
+ private:
+    ColorSpace color_space_;
+    std::vector<uint32_t> stop_colors_;
+    std::vector<std::optional<double>> stop_positions_;
+};
+}  // namespace palette
@@ -0,0 +1,213 @@
+#include "lib/grid_image.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Magick++.h>
+
+#include "lib/color.h"
+#include "lib/color_space.h"
+
+namespace palette {
+namespace {
+
+// Fraction of the way along an axis of num_cells cells.
+float axis_fraction(int cell, int num_cells) {
+    return (num_cells > 1)
+        ? (static_cast<float>(cell) / static_cast<float>(num_cells - 1))
+        : 0.0f;
+}
+}  // namespace
+
+GridImage::GridImage(int num_columns, int num_rows, int cell_size,
+                     const ColorSpace &color_space) :
+    num_columns_(num_columns),
+    num_rows_(num_rows),
+    cell_size_(cell_size),
+    color_space_(color_space),
+    first_color_(),
+    last_color_(),
+    horizontal_channel_(0),
+    vertical_channel_(1) { }
+
+void GridImage::set_colors(const Color &first_color,
+                           const Color &last_color) {
+    first_color_ = first_color;
+    last_color_ = last_color;
+}
+
+// Select which channels of the color space vary across columns and down
+// rows, as indices from 0 to 2.
+void GridImage::set_channels(int horizontal_channel, int vertical_channel) {
+    horizontal_channel_ = horizontal_channel;
+    vertical_channel_ = vertical_channel;
+}
+
+// Compute only the color of each cell, packed as 0xRRGGBB in row-major
+// order. Return whether or not the grid is configured validly.
+bool GridImage::get_cell_colors(std::vector<uint32_t> &cell_colors,
+                                std::stringstream &error_stream) const {
+    if ((num_columns_ <= 0) || (num_rows_ <= 0)) {
+        error_stream << "Grid was configured with " << num_columns_
+            << " columns and " << num_rows_ << " rows; both must be "
+            << "positive integers" << std::endl;
+        return false;
+    }
+    if (!color_space_.valid()) {
+        error_stream << "Unknown grid color space" << std::endl;
+        return false;
+    }
+    if ((horizontal_channel_ < 0) || (horizontal_channel_ > 2)
+        || (vertical_channel_ < 0) || (vertical_channel_ > 2)
+        || (horizontal_channel_ == vertical_channel_)) {
+        error_stream << "Grid channels must be two different channels "
+            << "of the color space" << std::endl;
+        return false;
+    }
+    const int diagonal_channel = 3 - horizontal_channel_ - vertical_channel_;
+
+    // Convert both corner colors to the grid's color space.
+    std::array<float, 3> first;
+    std::array<float, 3> last;
+    const uint32_t first_rgb = first_color_.to_rgb24();
+    const uint32_t last_rgb = last_color_.to_rgb24();
+    for (int c = 0; c < 3; ++c) {
+        first[c] = ((first_rgb >> (16 - (8 * c))) & 0xFF) / 255.0f;
+        last[c] = ((last_rgb >> (16 - (8 * c))) & 0xFF) / 255.0f;
+    }
+    color_space_.from_rgb(1, &first[0], &first[1], &first[2],
+                          &first[0], &first[1], &first[2]);
+    color_space_.from_rgb(1, &last[0], &last[1], &last[2],
+                          &last[0], &last[1], &last[2]);
+
+    const size_t num_cells = static_cast<size_t>(num_columns_) * num_rows_;
+    std::array<std::vector<float>, 3> channels;
+    for (auto &channel : channels) {
+        channel.resize(num_cells);
+    }
+    size_t cell = 0;
+    for (int row = 0; row < num_rows_; ++row) {
+        const float v = axis_fraction(row, num_rows_);
+        for (int column = 0; column < num_columns_; ++column, ++cell) {
+            const float u = axis_fraction(column, num_columns_);
+            const float d = (num_columns_ > 1) && (num_rows_ > 1)
+                ? ((u + v) * 0.5f) : std::max(u, v);
+            const float fractions[3] = { u, v, d };
+            const int channel_indices[3] = {
+                horizontal_channel_, vertical_channel_, diagonal_channel };
+            for (int a = 0; a < 3; ++a) {
+                const int c = channel_indices[a];
+                channels[c][cell] =
+                    first[c] + ((last[c] - first[c]) * fractions[a]);
+            }
+        }
+    }
+    color_space_.to_rgb(num_cells, channels[0].data(), channels[1].data(),
+                        channels[2].data(), channels[0].data(),
+                        channels[1].data(), channels[2].data());
+
+    cell_colors.resize(num_cells);
+    for (size_t i = 0; i < num_cells; ++i) {
+        cell_colors[i] =
+            (static_cast<uint32_t>((channels[0][i] * 255.0f) + 0.5f) << 16)
+            | (static_cast<uint32_t>((channels[1][i] * 255.0f) + 0.5f) << 8)
+            | static_cast<uint32_t>((channels[2][i] * 255.0f) + 0.5f);
+    }
+    cell_colors.front() = first_rgb;
+    cell_colors.back() = last_rgb;
+    return true;
+}
+
+// Return whether or not export was successful.
+//
+// Each cell is rasterized as a solid block directly into the pixel cache of
+// the output image: one pixel row is built per row of cells and copied into
+// every pixel row of those cells, and the image is encoded once.
+bool GridImage::export_image(const std::string file_name,
+                             std::stringstream &export_stream,
+                             std::stringstream &error_stream) {
+    if (cell_size_ <= 0) {
+        error_stream << "Image was configured with cell size "
+            << cell_size_ << " which is not a positive integer; "
+            << "it must be a positive integer" << std::endl;
+        return false;
+    }
+    std::vector<uint32_t> cell_colors;
+    if (!get_cell_colors(cell_colors, error_stream)) {
+        return false;
+    }
+
+    const size_t image_width = static_cast<size_t>(num_columns_) * cell_size_;
+    const size_t image_height = static_cast<size_t>(num_rows_) * cell_size_;
+    try {
+        Magick::Image grid(Magick::Geometry(image_width, image_height),
+                           first_color_.get());
+        grid.modifyImage();
+        const MagickCore::Image *grid_image = grid.constImage();
+        const size_t num_channels = grid.channels();
+        const size_t row_length = image_width * num_channels;
+        std::vector<Magick::Quantum> pixel_row(row_length);
+        Magick::Pixels view(grid);
+        for (int row = 0; row < num_rows_; ++row) {
+            const ssize_t first_y = static_cast<ssize_t>(row) * cell_size_;
+            Magick::Quantum *pixels = view.get(0, first_y, image_width, 1);
+            if (pixels == nullptr) {
+                error_stream << "Failed to get pixel row " << first_y
+                    << " of the grid image" << std::endl;
+                return false;
+            }
+            // Start from the canvas row so that channels other than red,
+            // green, and blue keep their values.
+            std::memcpy(pixel_row.data(), pixels,
+                        row_length * sizeof(Magick::Quantum));
+            for (int column = 0; column < num_columns_; ++column) {
+                const uint32_t rgb =
+                    cell_colors[(static_cast<size_t>(row) * num_columns_)
+                                + column];
+                const Magick::Quantum red =
+                    MagickCore::ScaleCharToQuantum((rgb >> 16) & 0xFF);
+                const Magick::Quantum green =
+                    MagickCore::ScaleCharToQuantum((rgb >> 8) & 0xFF);
+                const Magick::Quantum blue =
+                    MagickCore::ScaleCharToQuantum(rgb & 0xFF);
+                Magick::Quantum *cell_pixel = pixel_row.data()
+                    + (static_cast<size_t>(column) * cell_size_
+                       * num_channels);
+                for (int x = 0; x < cell_size_; ++x) {
+                    MagickCore::SetPixelRed(grid_image, red, cell_pixel);
+                    MagickCore::SetPixelGreen(grid_image, green, cell_pixel);
+                    MagickCore::SetPixelBlue(grid_image, blue, cell_pixel);
+                    cell_pixel += num_channels;
+                }
+            }
+            for (int y = 0; y < cell_size_; ++y) {
+                pixels = (y == 0) ? pixels
+                    : view.get(0, first_y + y, image_width, 1);
+                if (pixels == nullptr) {
+                    error_stream << "Failed to get pixel row "
+                        << (first_y + y) << " of the grid image"
+                        << std::endl;
+                    return false;
+                }
+                std::memcpy(pixels, pixel_row.data(),
+                            row_length * sizeof(Magick::Quantum));
+                view.sync();
+            }
+        }
+        grid.write(file_name);
+    } catch (Magick::Exception &error) {
+        error_stream << "ImageMagick exception: " << error.what() << std::endl;
+        return false;
+    }
+    export_stream << "Wrote " << std::dec << image_width << "x"
+        << image_height << " image to " << file_name << " with "
+        << num_columns_ << "x" << num_rows_ << " cells in "
+        << color_space_.to_string() << std::endl;
+    return true;
+}
+}  // namespace palette
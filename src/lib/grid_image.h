@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "lib/color.h"
+#include "lib/color_space.h"
+
+namespace palette {
+
+// Image of square cells laid out in a grid that spans a subset of a color
+// space. The top left cell has the first color and the bottom right cell
+// has the last color. One channel of the color space varies across columns,
+// another varies down rows, and the remaining channel varies along the
+// diagonal between the two colors.
+class GridImage {
+ public:
+    GridImage(int num_columns, int num_rows, int cell_size,
+              const ColorSpace &color_space);
+
+    void set_colors(const Color &first_color, const Color &last_color);
+    void set_channels(int horizontal_channel, int vertical_channel);
+
+    bool get_cell_colors(std::vector<uint32_t> &cell_colors,
+                         std::stringstream &error_stream) const;
+
+    bool export_image(const std::string file_name,
+                      std::stringstream &export_stream,
+                      std::stringstream &error_stream);
+
+ private:
+    int num_columns_;
+    int num_rows_;
+    int cell_size_;
+    ColorSpace color_space_;
+    Color first_color_;
+    Color last_color_;
+    int horizontal_channel_;
+    int vertical_channel_;
+};
+}  // namespace palette
@@ -0,0 +1,63 @@
+#include "lib/hex_color_writer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+namespace palette {
+namespace {
+
+const char hex_digits[] = "0123456789ABCDEF";
+}  // namespace
+
+HexColorWriter::HexColorWriter(std::ostream &out, char delimiter) :
+    out_(out), delimiter_(delimiter), used_(0), buffer_() { }
+
+HexColorWriter::~HexColorWriter() { flush(); }
+
+void HexColorWriter::write(uint8_t red, uint8_t green, uint8_t blue) {
+    if ((buffer_size - used_) < color_length) {
+        flush();
+    }
+    char *cursor = buffer_.data() + used_;
+    cursor[0] = '#';
+    cursor[1] = hex_digits[red >> 4];
+    cursor[2] = hex_digits[red & 0xF];
+    cursor[3] = hex_digits[green >> 4];
+    cursor[4] = hex_digits[green & 0xF];
+    cursor[5] = hex_digits[blue >> 4];
+    cursor[6] = hex_digits[blue & 0xF];
+    cursor[7] = delimiter_;
+    used_ += color_length;
+}
+
+void HexColorWriter::write_rgb24(uint32_t rgb) {
+    write(static_cast<uint8_t>(rgb >> 16), static_cast<uint8_t>(rgb >> 8),
+          static_cast<uint8_t>(rgb));
+}
+
+// Write arbitrary text, such as a label, between colors.
+void HexColorWriter::write_text(const char *text, size_t length) {
+    while (length > 0) {
+        if (used_ == buffer_size) {
+            flush();
+        }
+        const size_t chunk = std::min(length, buffer_size - used_);
+        std::memcpy(buffer_.data() + used_, text, chunk);
+        used_ += chunk;
+        text += chunk;
+        length -= chunk;
+    }
+}
+
+// Hand buffered output to the stream. Return whether or not the stream is
+// still in a good state.
+bool HexColorWriter::flush() {
+    if (used_ > 0) {
+        out_.write(buffer_.data(), static_cast<std::streamsize>(used_));
+        used_ = 0;
+    }
+    return static_cast<bool>(out_);
+}
+}  // namespace palette
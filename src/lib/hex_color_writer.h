@@ -0,0 +1,36 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace palette {
+
+// Buffered writer of "#RRGGBB" color strings, each followed by a delimiter.
+// Formatting uses a lookup table and a fixed buffer, so writing any number
+// of colors performs no allocations. Remaining output is flushed when the
+// writer is destroyed.
+class HexColorWriter {
+ public:
+    explicit HexColorWriter(std::ostream &out, char delimiter = '\n');
+    HexColorWriter(const HexColorWriter &other) = delete;
+    ~HexColorWriter();
+
+    HexColorWriter &operator=(const HexColorWriter &other) = delete;
+
+    void write(uint8_t red, uint8_t green, uint8_t blue);
+    void write_rgb24(uint32_t rgb);
+    void write_text(const char *text, size_t length);
+    bool flush();
+
+ private:
+    static const size_t buffer_size = 1 << 16;
+    static const size_t color_length = 8;
+
+    std::ostream &out_;
+    char delimiter_;
+    size_t used_;
+    std::array<char, buffer_size> buffer_;
+};
+}  // namespace palette
@@ -1,14 +1,29 @@
 #include "lib/image.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include <Magick++.h>
 
 #include "lib/color.h"
+#include "lib/color_counter.h"
+#include "lib/color_histogram.h"
 #include "lib/color_k_means.h"
+#include "lib/fixed_hsl.h"
 #include "lib/image_get_sample_colors_mode.h"
+#include "lib/memory_budget.h"
+#include "lib/pixel_view.h"
+#include "lib/sample_weights.h"
+#include "lib/superpixels.h"
 
 namespace palette {
 namespace {
@@ -17,7 +32,10 @@ struct HslRangeProperties final {
  public:
     HslRangeProperties(double min_saturation, double max_saturation,
                        double min_lightness, double max_lightness);
-    explicit HslRangeProperties(const std::vector<Color> &colors);
+    explicit HslRangeProperties(const ColorHistogram &histogram);
+
+    // Return whether or not the color lies inside this range.
+    bool contains(const FixedHsl &hsl) const;
 
     double min_saturation_;
     double max_saturation_;
@@ -25,60 +43,251 @@ struct HslRangeProperties final {
     double max_lightness_;
 };
 
-std::vector<Color> get_filtered_colors(const std::vector<Color> &colors,
-                                       const HslRangeProperties &properties);
-
-std::vector<Color> get_bright_colors(const std::vector<Color> &colors);
+HslRangeProperties get_bright_range(const HslRangeProperties &total_range);
 
-std::vector<Color> get_saturated_colors(const std::vector<Color> &colors);
+HslRangeProperties get_saturated_range(
+    const HslRangeProperties &total_range);
 
 std::vector<Color> get_hue_spread_colors(int num_colors);
+
+// Return the part of the histogram that a mode clusters: the histogram
+// itself, or the entries of it copied into filtered.
+const ColorHistogram &get_mode_histogram(const ColorHistogram &histogram,
+                                         ImageGetSampleColorsMode mode,
+                                         ColorHistogram &filtered);
+
+// Read only the size of the image through ping_function. Return whether
+// or not it could be read.
+bool ping_size(const std::function<void(Magick::Image &)> &ping_function,
+               const std::string &name, Magick::Geometry &size,
+               std::stringstream &error_stream);
+
+// Cluster unique colors, each counting once, seeded the way the mode seeds
+// them. Return whether or not clustering succeeded; modes other than the
+// k-means ones cannot cluster colors alone.
+bool cluster_unique_colors(size_t num_colors, ImageGetSampleColorsMode mode,
+                           const std::vector<Color> &colors,
+                           std::vector<Color> &centroids);
+
+// Return whether or not get_sample_colors clusters the histogram by weight
+// rather than clustering the unique colors.
+bool clusters_by_weight(const SampleWeights &weights,
+                        ImageGetSampleColorsMode mode,
+                        const ColorKMeans::Settings &settings);
+
+// Return the colors of a histogram, each with a weight of one, so that
+// clustering them by weight clusters the unique colors.
+ColorHistogram with_unit_weights(const ColorHistogram &histogram);
+
+// Return a copy of the image scaled down, keeping its aspect ratio, to at
+// most max_pixels pixels. Scaling reads the image in place, so only the
+// small copy is allocated.
+Magick::Image scaled_to_at_most(const Magick::Image &image,
+                                uint64_t max_pixels);
+
+// Cluster the mean colors of superpixels, weighted by their weighted areas.
+bool cluster_superpixels(size_t num_colors, const Superpixels &superpixels,
+                         const ColorKMeans::Settings &settings,
+                         std::vector<Color> &centroids);
+
+// Name of an image read from a blob in error messages.
+const char *const blob_name = "<memory>";
+// Most bits per channel that get_sample_colors coarsens a histogram by to
+// fit its colors within a memory budget.
+const uint32_t max_binned_bits = 7;
 }  // namespace
 
-Image::Image() : image_() { }
+struct Image::Cache final {
+    Cache();
+
+    std::once_flag histogram_once_;
+    bool histogram_success_;
+    ColorHistogram histogram_;
 
-Image::Image(const Magick::Image &image) : image_(image) { }
+    // HSL of each histogram color, and the range of their saturation and
+    // lightness.
+    std::once_flag hsl_once_;
+    std::vector<FixedHsl> hsls_;
+    HslRangeProperties hsl_range_;
+};
+
+Image::Cache::Cache() :
+    histogram_once_(),
+    histogram_success_(false),
+    histogram_(),
+    hsl_once_(),
+    hsls_(),
+    hsl_range_(0.0, 0.0, 0.0, 0.0) { }
+
+Image::Image() : image_(), cache_(std::make_shared<Cache>()) { }
 
-Image::Image(Magick::Image &&image) : image_(std::move(image)) { }
+Image::Image(const Magick::Image &image) :
+    image_(image),
+    cache_(std::make_shared<Cache>()) { }
 
-Image::Image(const Image &other) : image_(other.image_) { }
+Image::Image(Magick::Image &&image) :
+    image_(std::move(image)),
+    cache_(std::make_shared<Cache>()) { }
 
-Image::Image(Image &&other) : image_(std::move(other.image_)) { }
+Image::Image(const Image &other) :
+    image_(other.image_),
+    cache_(other.cache_) { }
+
+Image::Image(Image &&other) :
+    image_(std::move(other.image_)),
+    cache_(std::move(other.cache_)) {
+    other.cache_ = std::make_shared<Cache>();
+}
 
 Image &Image::operator=(const Image &other) {
     image_ = other.image_;
+    cache_ = other.cache_;
     return *this;
 }
 
-Magick::Image &Image::get() { return image_; }
+Magick::Image &Image::get() {
+    cache_ = std::make_shared<Cache>();
+    return image_;
+}
 
 const Magick::Image &Image::get() const { return image_; }
 
-std::vector<Color> Image::get_colors() const {
-    const Magick::Geometry image_size = image_.size();
-    std::vector<Color> colors;
-    colors.reserve(image_size.width() * image_size.height());
-    std::vector<std::pair<Magick::Color, size_t>> color_histogram;
-    color_histogram.reserve(image_.totalColors());
-    Magick::colorHistogram(&color_histogram, image_);
-    for (const auto &histogram_elem : color_histogram) {
-        for (size_t c = 0; c < histogram_elem.second; ++c) {
-            colors.emplace_back(histogram_elem.first);
-        }
+bool Image::read(const std::string &file, const Magick::Geometry &decode_size,
+                 Magick::Geometry &original_size,
+                 std::stringstream &error_stream) {
+    return read_within(
+        [&file](Magick::Image &image) { image.ping(file); },
+        [&file](Magick::Image &image) { image.read(file); },
+        file, decode_size, original_size, error_stream);
+}
+
+bool Image::read(const std::string &file, size_t max_pixels,
+                 Magick::Geometry &original_size,
+                 std::stringstream &error_stream) {
+    return read_at_most(
+        [&file](Magick::Image &image) { image.ping(file); },
+        [&file](Magick::Image &image) { image.read(file); },
+        file, max_pixels, original_size, error_stream);
+}
+
+bool Image::read(const Magick::Blob &blob, std::stringstream &error_stream) {
+    Magick::Image &image = get();
+    try {
+        image.read(blob);
+    } catch (Magick::Exception &error) {
+        error_stream << "ImageMagick exception: " << error.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Image::read(const Magick::Blob &blob,
+                 const Magick::Geometry &decode_size,
+                 Magick::Geometry &original_size,
+                 std::stringstream &error_stream) {
+    return read_within(
+        [&blob](Magick::Image &image) { image.ping(blob); },
+        [&blob](Magick::Image &image) { image.read(blob); },
+        blob_name, decode_size, original_size, error_stream);
+}
+
+bool Image::read(const Magick::Blob &blob, size_t max_pixels,
+                 Magick::Geometry &original_size,
+                 std::stringstream &error_stream) {
+    return read_at_most(
+        [&blob](Magick::Image &image) { image.ping(blob); },
+        [&blob](Magick::Image &image) { image.read(blob); },
+        blob_name, max_pixels, original_size, error_stream);
+}
+
+bool Image::read(const std::string &file, MemoryBudget &budget,
+                 Magick::Geometry &original_size,
+                 std::stringstream &error_stream) {
+    return read_within_budget(
+        [&file](Magick::Image &image) { image.ping(file); },
+        [&file](Magick::Image &image) { image.read(file); },
+        file, budget, original_size, error_stream);
+}
+
+bool Image::read(const Magick::Blob &blob, MemoryBudget &budget,
+                 Magick::Geometry &original_size,
+                 std::stringstream &error_stream) {
+    return read_within_budget(
+        [&blob](Magick::Image &image) { image.ping(blob); },
+        [&blob](Magick::Image &image) { image.read(blob); },
+        blob_name, budget, original_size, error_stream);
+}
+
+bool Image::write(Magick::Blob &blob, const std::string &format,
+                  std::stringstream &error_stream) const {
+    // Copies of a Magick::Image share their pixels until either changes.
+    Magick::Image image(image_);
+    try {
+        image.write(&blob, format);
+    } catch (Magick::Exception &error) {
+        error_stream << "ImageMagick exception: " << error.what() << std::endl;
+        return false;
     }
+    return true;
+}
+
+std::vector<Color> Image::get_colors(bool &success) const {
+    std::vector<Color> colors;
+    success = get_colors(colors);
     return colors;
 }
 
 std::vector<Color> Image::get_unique_colors() const {
-    std::vector<Color> unique_colors;
-    unique_colors.reserve(image_.totalColors());
-    std::vector<std::pair<Magick::Color, size_t>> color_histogram;
-    color_histogram.reserve(image_.totalColors());
-    Magick::colorHistogram(&color_histogram, image_);
-    for (const auto &histogram_elem : color_histogram) {
-        unique_colors.emplace_back(histogram_elem.first);
+    std::vector<Color> colors;
+    get_unique_colors(colors);
+    return colors;
+}
+
+bool Image::get_colors(std::vector<Color> &colors) const {
+    bool success = false;
+    const ColorHistogram &histogram = get_cached_histogram(success);
+    colors.clear();
+    if (!success) {
+        return false;
+    }
+    colors.reserve(static_cast<size_t>(histogram.total_weight()));
+    for (const ColorHistogram::Entry entry : histogram) {
+        colors.insert(colors.end(), static_cast<size_t>(entry.weight_),
+                      Color::from_rgb24(entry.rgb24_));
+    }
+    return true;
+}
+
+bool Image::get_colors(MemoryBudget &budget,
+                       std::vector<Color> &colors) const {
+    const std::string stage = "colors";
+    const uint64_t num_pixels =
+        static_cast<uint64_t>(image_.columns()) * image_.rows();
+    const uint64_t held_bytes = num_pixels * MemoryBudget::pixel_cache_bytes;
+    const uint64_t full_bytes =
+        held_bytes + MemoryBudget::colors_bytes(num_pixels);
+    if (budget.fits(full_bytes)) {
+        budget.record(stage, MemoryBudget::Path::full, full_bytes,
+                      full_bytes);
+        return get_colors(colors);
     }
-    return unique_colors;
+    Magick::Image sampled = scaled_to_at_most(
+        image_, budget.max_sampled_pixels(
+            held_bytes, 0,
+            MemoryBudget::pixel_cache_bytes + MemoryBudget::color_bytes,
+            pyramid_base_size * pyramid_base_size));
+    const uint64_t sampled_pixels =
+        static_cast<uint64_t>(sampled.columns()) * sampled.rows();
+    budget.record(stage, MemoryBudget::Path::sampled, full_bytes,
+                  held_bytes
+                  + (sampled_pixels * MemoryBudget::pixel_cache_bytes)
+                  + MemoryBudget::colors_bytes(sampled_pixels));
+    return Image(std::move(sampled)).get_colors(colors);
+}
+
+void Image::get_unique_colors(std::vector<Color> &colors) const {
+    bool success = false;
+    get_cached_histogram(success).to_colors(colors);
 }
 
 std::vector<Color> Image::get_sample_colors(
@@ -95,38 +304,24 @@ std::vector<Color> Image::get_sample_colors(
             break;
         }
         case ImageGetSampleColorsMode::Value::kmeans_random_spread:
-            success = ColorKMeans::find_clusters(
-                num_colors, ColorKMeans::SeedMode::random_spread,
-                get_unique_colors(), sample_colors);
-            break;
         case ImageGetSampleColorsMode::Value::kmeans_static_spread:
-            success = ColorKMeans::find_clusters(
-                num_colors, ColorKMeans::SeedMode::static_spread,
-                get_unique_colors(), sample_colors);
-            break;
         case ImageGetSampleColorsMode::Value::kmeans_hue_spread:
-            sample_colors = get_hue_spread_colors(num_colors);
-            success = ColorKMeans::find_clusters(
-                num_colors, ColorKMeans::SeedMode::keep_existing,
-                get_unique_colors(), sample_colors);
+            success = cluster_unique_colors(num_colors, mode,
+                                            get_unique_colors(),
+                                            sample_colors);
             break;
-        case ImageGetSampleColorsMode::Value::kmeans_bright_hue_spread: {
-            const std::vector<Color> unique_colors = get_unique_colors();
-            std::vector<Color> data_colors = get_bright_colors(unique_colors);
-            sample_colors = get_hue_spread_colors(num_colors);
-            success = ColorKMeans::find_clusters(
-                num_colors, ColorKMeans::SeedMode::keep_existing,
-                data_colors, sample_colors);
+        case ImageGetSampleColorsMode::Value::kmeans_bright_hue_spread:
+        case ImageGetSampleColorsMode::Value::kmeans_saturated_hue_spread:
+            success = cluster_unique_colors(num_colors, mode,
+                                            get_unique_colors_for_mode(mode),
+                                            sample_colors);
             break;
-        }
-        case ImageGetSampleColorsMode::Value::kmeans_saturated_hue_spread: {
-            const std::vector<Color> unique_colors = get_unique_colors();
-            std::vector<Color> data_colors =
-                get_saturated_colors(unique_colors);
-            sample_colors = get_hue_spread_colors(num_colors);
-            success = ColorKMeans::find_clusters(
-                num_colors, ColorKMeans::SeedMode::keep_existing,
-                data_colors, sample_colors);
+        case ImageGetSampleColorsMode::Value::superpixels: {
+            MemoryBudget budget;
+            Superpixels superpixels;
+            success = get_superpixel_colors(
+                num_colors, SampleWeights(), ColorKMeans::Settings(), budget,
+                superpixels, sample_colors);
             break;
         }
         default: break;
@@ -134,6 +329,516 @@ std::vector<Color> Image::get_sample_colors(
     return sample_colors;
 }
 
+ColorHistogram Image::get_histogram(const SampleWeights &weights,
+                                    bool &success) const {
+    if (weights.uniform()) {
+        return get_cached_histogram(success);
+    }
+    ColorHistogram histogram;
+    success = ColorCounter::count(image_, weights, histogram);
+    return histogram;
+}
+
+std::vector<Color> Image::get_sample_colors(
+    size_t num_colors, ImageGetSampleColorsMode mode,
+    const SampleWeights &weights, const ColorKMeans::Settings &settings,
+    bool &success) const {
+    std::vector<Color> sample_colors;
+    success = get_sample_colors(num_colors, mode, weights, settings,
+                                sample_colors);
+    return sample_colors;
+}
+
+bool Image::get_sample_colors(size_t num_colors,
+                              ImageGetSampleColorsMode mode,
+                              const SampleWeights &weights,
+                              const ColorKMeans::Settings &settings,
+                              std::vector<Color> &sample_colors) const {
+    bool success = false;
+    if (mode.get_value() == ImageGetSampleColorsMode::Value::superpixels) {
+        MemoryBudget budget;
+        Superpixels superpixels;
+        return get_superpixel_colors(num_colors, weights, settings, budget,
+                                     superpixels, sample_colors);
+    }
+    if (!clusters_by_weight(weights, mode, settings)) {
+        sample_colors = get_sample_colors(num_colors, mode, success);
+        return success;
+    }
+    sample_colors.clear();
+    if (mode.get_value() == ImageGetSampleColorsMode::Value::quantize) {
+        // Quantization itself is unweighted; keep the quantized colors that
+        // the weighted pixels use, heaviest first.
+        Image quantized_image(image_);
+        quantized_image.get().quantizeColors(num_colors);
+        quantized_image.get().quantize();
+        ColorHistogram histogram =
+            quantized_image.get_histogram(weights, success);
+        histogram.sort_by_weight();
+        histogram.to_colors(sample_colors);
+        return success;
+    }
+
+    ColorHistogram storage;
+    const ColorHistogram &histogram =
+        get_histogram(weights, storage, success);
+    return success
+        && find_mode_clusters(num_colors, mode, histogram,
+                              /* keep centroids */ false, settings,
+                              sample_colors);
+}
+
+bool Image::get_sample_colors(size_t num_colors,
+                              ImageGetSampleColorsMode mode,
+                              const SampleWeights &weights,
+                              const ColorKMeans::Settings &settings,
+                              MemoryBudget &budget,
+                              std::vector<Color> &sample_colors) const {
+    if (!budget.limited()) {
+        return get_sample_colors(num_colors, mode, weights, settings,
+                                 sample_colors);
+    }
+    if (mode.get_value() == ImageGetSampleColorsMode::Value::superpixels) {
+        Superpixels superpixels;
+        return get_superpixel_colors(num_colors, weights, settings, budget,
+                                     superpixels, sample_colors);
+    }
+    const uint64_t num_pixels =
+        static_cast<uint64_t>(image_.columns()) * image_.rows();
+    const uint64_t held_bytes = num_pixels * MemoryBudget::pixel_cache_bytes;
+    if (mode.get_value() == ImageGetSampleColorsMode::Value::quantize) {
+        const uint64_t full_bytes =
+            held_bytes + MemoryBudget::quantize_bytes(num_pixels);
+        if (budget.fits(full_bytes)) {
+            budget.record(mode.to_string(), MemoryBudget::Path::full,
+                          full_bytes, full_bytes);
+            return get_sample_colors(num_colors, mode, weights, settings,
+                                     sample_colors);
+        }
+        Magick::Image sampled = scaled_to_at_most(
+            image_, budget.max_sampled_pixels(
+                held_bytes, MemoryBudget::max_quantize_tree_bytes,
+                MemoryBudget::pixel_cache_bytes,
+                pyramid_base_size * pyramid_base_size));
+        budget.record(mode.to_string(), MemoryBudget::Path::sampled,
+                      full_bytes,
+                      held_bytes + MemoryBudget::quantize_bytes(
+                          static_cast<uint64_t>(sampled.columns())
+                          * sampled.rows()));
+        const SampleWeights sampled_weights = weights.scaled(
+            static_cast<double>(sampled.columns()) / image_.columns(),
+            static_cast<double>(sampled.rows()) / image_.rows());
+        return Image(std::move(sampled)).get_sample_colors(
+            num_colors, mode, sampled_weights, settings, sample_colors);
+    }
+
+    bool success = false;
+    ColorHistogram storage;
+    const ColorHistogram &histogram =
+        get_histogram(weights, storage, success);
+    if (!success) {
+        return false;
+    }
+    const bool by_weight = clusters_by_weight(weights, mode, settings);
+    const uint64_t full_bytes = held_bytes
+        + MemoryBudget::cluster_bytes(histogram.size(), by_weight);
+    if (budget.fits(full_bytes)) {
+        budget.record(mode.to_string(), MemoryBudget::Path::full, full_bytes,
+                      full_bytes);
+        if (!by_weight) {
+            sample_colors = get_sample_colors(num_colors, mode, success);
+            return success;
+        }
+        return find_mode_clusters(num_colors, mode, histogram,
+                                  /* keep centroids */ false, settings,
+                                  sample_colors);
+    }
+    // Coarsen a copy of the histogram a bit per channel at a time; the copy
+    // takes a fraction of what clustering its colors would. A mode that
+    // clusters unique colors counts each once, so that each bin weighs as
+    // many colors as it merges rather than as many pixels.
+    ColorHistogram binned(by_weight ? histogram
+                          : with_unit_weights(histogram));
+    uint32_t bits = 0;
+    uint64_t bytes = full_bytes;
+    while (!budget.fits(bytes) && (bits < max_binned_bits)) {
+        binned.coarsen(++bits);
+        bytes = held_bytes
+            + MemoryBudget::cluster_bytes(binned.size(), /* weighted */ true);
+    }
+    budget.record(mode.to_string(), MemoryBudget::Path::binned, full_bytes,
+                  bytes);
+    return find_mode_clusters(num_colors, mode, binned,
+                              /* keep centroids */ false, settings,
+                              sample_colors);
+}
+
+bool Image::get_superpixel_colors(size_t num_colors,
+                                  const SampleWeights &weights,
+                                  const ColorKMeans::Settings &settings,
+                                  MemoryBudget &budget,
+                                  Superpixels &superpixels,
+                                  std::vector<Color> &sample_colors) const {
+    const std::string stage = ImageGetSampleColorsMode(
+        ImageGetSampleColorsMode::Value::superpixels).to_string();
+    const uint64_t num_pixels =
+        static_cast<uint64_t>(image_.columns()) * image_.rows();
+    const uint64_t held_bytes = num_pixels * MemoryBudget::pixel_cache_bytes;
+    const uint64_t full_bytes =
+        held_bytes + MemoryBudget::superpixel_bytes(num_pixels);
+    if (budget.fits(full_bytes)) {
+        budget.record(stage, MemoryBudget::Path::full, full_bytes,
+                      full_bytes);
+        return superpixels.segment(image_, weights)
+            && cluster_superpixels(num_colors, superpixels, settings,
+                                   sample_colors);
+    }
+    Magick::Image sampled = scaled_to_at_most(
+        image_, budget.max_sampled_pixels(
+            held_bytes, 0,
+            MemoryBudget::pixel_cache_bytes
+            + MemoryBudget::superpixel_bytes_per_pixel,
+            pyramid_base_size * pyramid_base_size));
+    const uint64_t sampled_pixels =
+        static_cast<uint64_t>(sampled.columns()) * sampled.rows();
+    budget.record(stage, MemoryBudget::Path::sampled, full_bytes,
+                  held_bytes
+                  + (sampled_pixels * MemoryBudget::pixel_cache_bytes)
+                  + MemoryBudget::superpixel_bytes(sampled_pixels));
+    const SampleWeights sampled_weights = weights.scaled(
+        static_cast<double>(sampled.columns()) / image_.columns(),
+        static_cast<double>(sampled.rows()) / image_.rows());
+    MemoryBudget unlimited;
+    return Image(std::move(sampled)).get_superpixel_colors(
+        num_colors, sampled_weights, settings, unlimited, superpixels,
+        sample_colors);
+}
+
+ColorHistogram Image::get_histogram(const PixelView &pixels,
+                                    const SampleWeights &weights,
+                                    bool &success) {
+    ColorHistogram histogram;
+    success = ColorCounter::count(pixels, weights, histogram);
+    return histogram;
+}
+
+std::vector<Color> Image::get_sample_colors(
+    const PixelView &pixels, size_t num_colors,
+    ImageGetSampleColorsMode mode, const SampleWeights &weights,
+    const ColorKMeans::Settings &settings, bool &success) {
+    success = false;
+    std::vector<Color> sample_colors;
+    if (mode.get_value() == ImageGetSampleColorsMode::Value::superpixels) {
+        Superpixels superpixels;
+        success = superpixels.segment(pixels, weights)
+            && cluster_superpixels(num_colors, superpixels, settings,
+                                   sample_colors);
+        return sample_colors;
+    }
+    if (mode.get_value() == ImageGetSampleColorsMode::Value::quantize) {
+        if (!pixels.valid()) {
+            return sample_colors;
+        }
+        return Image(pixels.to_magick_image()).get_sample_colors(
+            num_colors, mode, weights, settings, success);
+    }
+
+    // Cluster as the image overload does, so that the same pixels give
+    // the same colors either way.
+    const ColorHistogram histogram = get_histogram(pixels, weights, success);
+    if (success) {
+        success = find_sample_colors(num_colors, mode, histogram, weights,
+                                     settings, sample_colors);
+    }
+    return sample_colors;
+}
+
+std::vector<Color> Image::get_pyramid_sample_colors(
+    size_t num_colors, ImageGetSampleColorsMode mode,
+    const SampleWeights &weights, const ColorKMeans::Settings &settings,
+    bool &success) const {
+    success = false;
+    std::vector<Magick::Image> levels(1, image_);
+    while (std::max(levels.back().columns(), levels.back().rows())
+           > pyramid_base_size) {
+        Magick::Image level(levels.back());
+        level.scale(Magick::Geometry(
+            std::max<size_t>(levels.back().columns() / 2, 1),
+            std::max<size_t>(levels.back().rows() / 2, 1)));
+        levels.push_back(std::move(level));
+    }
+    auto level_weights = [this, &weights](const Magick::Image &level) {
+        return weights.scaled(
+            static_cast<double>(level.columns()) / image_.columns(),
+            static_cast<double>(level.rows()) / image_.rows());
+    };
+
+    // Let the mode do its full work on the smallest level, then only move
+    // the centroids a little at each finer level.
+    const Magick::Image &base = levels.back();
+    std::vector<Color> sample_colors = Image(base).get_sample_colors(
+        num_colors, mode, level_weights(base), settings, success);
+    const ColorKMeans::Settings refine_settings(
+        pyramid_refine_iterations, pyramid_refine_tolerance);
+    for (size_t i = levels.size() - 1; success && (i > 0); --i) {
+        const Magick::Image &level = levels[i - 1];
+        sample_colors = Image(level).refine_sample_colors(
+            sample_colors, mode, level_weights(level), refine_settings,
+            success);
+    }
+    return sample_colors;
+}
+
+std::vector<Color> Image::refine_sample_colors(
+    const std::vector<Color> &colors, ImageGetSampleColorsMode mode,
+    const SampleWeights &weights, const ColorKMeans::Settings &settings,
+    bool &success) const {
+    std::vector<Color> sample_colors(colors);
+    ColorHistogram storage;
+    const ColorHistogram &histogram = get_mode_weighted_histogram(
+        mode, weights, settings, storage, success);
+    if (success) {
+        success = find_mode_clusters(
+            sample_colors.size(), mode, histogram,
+            /* keep centroids */ true, settings, sample_colors);
+    }
+    return sample_colors;
+}
+
+bool Image::find_mode_clusters(size_t num_colors,
+                               ImageGetSampleColorsMode mode,
+                               const ColorHistogram &histogram,
+                               bool keep_centroids,
+                               const ColorKMeans::Settings &settings,
+                               std::vector<Color> &centroids) {
+    ColorKMeans::SeedMode seed_mode = ColorKMeans::SeedMode::keep_existing;
+    if (!keep_centroids) {
+        switch (mode.get_value()) {
+            case ImageGetSampleColorsMode::Value::kmeans_random_spread:
+                seed_mode = ColorKMeans::SeedMode::random_spread;
+                break;
+            case ImageGetSampleColorsMode::Value::kmeans_static_spread:
+                seed_mode = ColorKMeans::SeedMode::static_spread;
+                break;
+            case ImageGetSampleColorsMode::Value::kmeans_hue_spread:
+            case ImageGetSampleColorsMode::Value::kmeans_bright_hue_spread:
+            case ImageGetSampleColorsMode::Value::kmeans_saturated_hue_spread:
+                centroids = get_hue_spread_colors(num_colors);
+                break;
+            default: return false;
+        }
+    }
+    ColorHistogram filtered;
+    return ColorKMeans::find_weighted_clusters(
+        num_colors, seed_mode, get_mode_histogram(histogram, mode, filtered),
+        settings, centroids);
+}
+
+bool Image::find_sample_colors(size_t num_colors,
+                               ImageGetSampleColorsMode mode,
+                               const ColorHistogram &histogram,
+                               const SampleWeights &weights,
+                               const ColorKMeans::Settings &settings,
+                               std::vector<Color> &sample_colors) {
+    if (clusters_by_weight(weights, mode, settings)) {
+        return find_mode_clusters(num_colors, mode, histogram,
+                                  /* keep centroids */ false, settings,
+                                  sample_colors);
+    }
+    ColorHistogram filtered;
+    return cluster_unique_colors(
+        num_colors, mode,
+        get_mode_histogram(histogram, mode, filtered).to_colors(),
+        sample_colors);
+}
+
+ColorHistogram Image::get_mode_sample_histogram(
+    ImageGetSampleColorsMode mode, const SampleWeights &weights,
+    const ColorKMeans::Settings &settings, bool &success) const {
+    ColorHistogram storage;
+    const ColorHistogram &histogram = get_mode_weighted_histogram(
+        mode, weights, settings, storage, success);
+    if (!success) {
+        return ColorHistogram();
+    }
+    ColorHistogram filtered;
+    return get_mode_histogram(histogram, mode, filtered);
+}
+
+bool Image::read_within(const ReadFunction &ping_function,
+                        const ReadFunction &read_function,
+                        const std::string &name,
+                        const Magick::Geometry &decode_size,
+                        Magick::Geometry &original_size,
+                        std::stringstream &error_stream) {
+    if (!ping_size(ping_function, name, original_size, error_stream)) {
+        return false;
+    }
+    double scale = 1.0;
+    if (decode_size.width() > 0) {
+        scale = std::min(scale, static_cast<double>(decode_size.width())
+                                / original_size.width());
+    }
+    if (decode_size.height() > 0) {
+        scale = std::min(scale, static_cast<double>(decode_size.height())
+                                / original_size.height());
+    }
+    return read_scaled(read_function, original_size, scale, error_stream);
+}
+
+bool Image::read_at_most(const ReadFunction &ping_function,
+                         const ReadFunction &read_function,
+                         const std::string &name, size_t max_pixels,
+                         Magick::Geometry &original_size,
+                         std::stringstream &error_stream) {
+    if (!ping_size(ping_function, name, original_size, error_stream)) {
+        return false;
+    }
+    const double num_pixels = static_cast<double>(original_size.width())
+        * static_cast<double>(original_size.height());
+    const double scale = std::min(
+        1.0, std::sqrt(static_cast<double>(max_pixels) / num_pixels));
+    return read_scaled(read_function, original_size, scale, error_stream);
+}
+
+bool Image::read_within_budget(const ReadFunction &ping_function,
+                               const ReadFunction &read_function,
+                               const std::string &name, MemoryBudget &budget,
+                               Magick::Geometry &original_size,
+                               std::stringstream &error_stream) {
+    if (!ping_size(ping_function, name, original_size, error_stream)) {
+        return false;
+    }
+    const uint64_t num_pixels =
+        static_cast<uint64_t>(original_size.width()) * original_size.height();
+    const uint64_t full_bytes = MemoryBudget::read_bytes(num_pixels);
+    if (budget.fits(full_bytes)) {
+        budget.record("read", MemoryBudget::Path::full, full_bytes,
+                      full_bytes);
+        return read_scaled(read_function, original_size, 1.0, error_stream);
+    }
+    const uint64_t max_pixels = budget.max_read_pixels();
+    budget.record("read", MemoryBudget::Path::sampled, full_bytes,
+                  MemoryBudget::read_bytes(max_pixels));
+    const uint64_t decode_bytes = num_pixels * MemoryBudget::pixel_cache_bytes;
+    if (!budget.fits(decode_bytes)) {
+        budget.record("decode", MemoryBudget::Path::tiled, decode_bytes,
+                      budget.max_bytes());
+    }
+    const double scale = std::sqrt(static_cast<double>(max_pixels)
+                                   / static_cast<double>(num_pixels));
+    return read_scaled(read_function, original_size, scale, error_stream);
+}
+
+bool Image::read_scaled(const ReadFunction &read_function,
+                        const Magick::Geometry &original_size, double scale,
+                        std::stringstream &error_stream) {
+    Magick::Image &image = get();
+    image = Magick::Image();
+    const Magick::Geometry target_size(
+        std::max<size_t>(static_cast<size_t>(original_size.width() * scale),
+                         1),
+        std::max<size_t>(static_cast<size_t>(original_size.height() * scale),
+                         1));
+    try {
+        if (scale < 1.0) {
+            // libjpeg decodes at the smallest DCT scale of at least this
+            // size; other decoders ignore the hint.
+            image.defineValue("jpeg", "size", std::string(target_size));
+        }
+        read_function(image);
+        if ((image.columns() > target_size.width())
+            || (image.rows() > target_size.height())) {
+            image.scale(target_size);
+        }
+    } catch (Magick::Exception &error) {
+        error_stream << "ImageMagick exception: " << error.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+const ColorHistogram &Image::get_cached_histogram(bool &success) const {
+    Cache &cache = *cache_;
+    std::call_once(cache.histogram_once_, [this, &cache]() {
+        cache.histogram_success_ = ColorCounter::count(
+            image_, SampleWeights(), cache.histogram_);
+    });
+    success = cache.histogram_success_;
+    return cache.histogram_;
+}
+
+const ColorHistogram &Image::get_histogram(const SampleWeights &weights,
+                                           ColorHistogram &storage,
+                                           bool &success) const {
+    if (weights.uniform()) {
+        return get_cached_histogram(success);
+    }
+    success = ColorCounter::count(image_, weights, storage);
+    return storage;
+}
+
+const ColorHistogram &Image::get_mode_weighted_histogram(
+    ImageGetSampleColorsMode mode, const SampleWeights &weights,
+    const ColorKMeans::Settings &settings, ColorHistogram &storage,
+    bool &success) const {
+    const ColorHistogram &histogram =
+        get_histogram(weights, storage, success);
+    if (!success || mode.needs_image()
+        || clusters_by_weight(weights, mode, settings)) {
+        return histogram;
+    }
+    // Unit weights are only taken with uniform weights, so histogram is
+    // the cached one rather than storage.
+    storage = with_unit_weights(histogram);
+    return storage;
+}
+
+std::vector<Color> Image::get_unique_colors_for_mode(
+    ImageGetSampleColorsMode mode) const {
+    bool success = false;
+    const ColorHistogram &histogram = get_cached_histogram(success);
+    Cache &cache = *cache_;
+    std::call_once(cache.hsl_once_, [&histogram, &cache]() {
+        std::vector<uint32_t> colors(histogram.size(), 0);
+        for (size_t i = 0; i < histogram.size(); ++i) {
+            colors[i] = histogram.rgb24(i);
+        }
+        cache.hsls_.assign(histogram.size(), FixedHsl{0, 0, 0});
+        FixedHsl::from_rgb24(colors.data(), colors.size(),
+                             cache.hsls_.data());
+        if (!histogram.empty()) {
+            uint32_t min_saturation = FixedHsl::one;
+            uint32_t max_saturation = 0;
+            uint32_t min_lightness = FixedHsl::one;
+            uint32_t max_lightness = 0;
+            for (const FixedHsl &hsl : cache.hsls_) {
+                min_saturation = std::min(min_saturation, hsl.saturation_);
+                max_saturation = std::max(max_saturation, hsl.saturation_);
+                min_lightness = std::min(min_lightness, hsl.lightness_);
+                max_lightness = std::max(max_lightness, hsl.lightness_);
+            }
+            const double one = FixedHsl::one;
+            cache.hsl_range_ = HslRangeProperties(
+                min_saturation / one, max_saturation / one,
+                min_lightness / one, max_lightness / one);
+        }
+    });
+
+    const HslRangeProperties range =
+        (mode.get_value()
+         == ImageGetSampleColorsMode::Value::kmeans_bright_hue_spread)
+        ? get_bright_range(cache.hsl_range_)
+        : get_saturated_range(cache.hsl_range_);
+    std::vector<Color> colors;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        if (range.contains(cache.hsls_[i])) {
+            colors.push_back(Color::from_rgb24(histogram.rgb24(i)));
+        }
+    }
+    return colors;
+}
+
 namespace {
 
 HslRangeProperties::HslRangeProperties(
@@ -144,62 +849,53 @@ HslRangeProperties::HslRangeProperties(
     min_lightness_(min_lightness),
     max_lightness_(max_lightness) { }
 
-HslRangeProperties::HslRangeProperties(const std::vector<Color> &colors) :
+HslRangeProperties::HslRangeProperties(const ColorHistogram &histogram) :
     min_saturation_(0.0),
     max_saturation_(0.0),
     min_lightness_(0.0),
     max_lightness_(0.0) {
-    if (!colors.empty()) {
+    if (!histogram.empty()) {
         min_saturation_ = 1.0;
         min_lightness_ = 1.0;
     }
-    for (const Color &color : colors) {
-        Magick::ColorHSL color_hsl(color.get());
-        min_saturation_ = std::min(min_saturation_, color_hsl.saturation());
-        max_saturation_ = std::max(max_saturation_, color_hsl.saturation());
-        min_lightness_ = std::min(min_lightness_, color_hsl.lightness());
-        max_lightness_ = std::max(max_lightness_, color_hsl.lightness());
+    for (const ColorHistogram::Entry entry : histogram) {
+        const FixedHsl hsl = FixedHsl::from_rgb24(entry.rgb24_);
+        min_saturation_ = std::min(min_saturation_, hsl.saturation());
+        max_saturation_ = std::max(max_saturation_, hsl.saturation());
+        min_lightness_ = std::min(min_lightness_, hsl.lightness());
+        max_lightness_ = std::max(max_lightness_, hsl.lightness());
     }
 }
 
-std::vector<Color> get_filtered_colors(const std::vector<Color> &colors,
-                                       const HslRangeProperties &properties) {
-    auto inside_range = [properties](const Color &c) {
-        Magick::ColorHSL c_hsl(c.get());
-        return ((c_hsl.saturation() >= properties.min_saturation_)
-                && (c_hsl.saturation() <= properties.max_saturation_)
-                && (c_hsl.lightness() >= properties.min_lightness_)
-                && (c_hsl.lightness() <= properties.max_lightness_));
-    };
-    std::vector<Color> filtered_colors;
-    std::copy_if(colors.begin(), colors.end(),
-                 std::back_inserter(filtered_colors), inside_range);
-    return filtered_colors;
+bool HslRangeProperties::contains(const FixedHsl &hsl) const {
+    const double saturation = hsl.saturation();
+    const double lightness = hsl.lightness();
+    return ((saturation >= min_saturation_)
+            && (saturation <= max_saturation_)
+            && (lightness >= min_lightness_)
+            && (lightness <= max_lightness_));
 }
 
-std::vector<Color> get_bright_colors(const std::vector<Color> &colors) {
-    HslRangeProperties total_range(colors);
+HslRangeProperties get_bright_range(const HslRangeProperties &total_range) {
     const double min_s = total_range.min_saturation_;
     const double max_s = total_range.max_saturation_;
     const double min_l = total_range.min_lightness_;
     const double max_l = total_range.max_lightness_;
-    HslRangeProperties bright_range(
+    return HslRangeProperties(
         std::min(0.2, min_s + ((max_s - min_s) * 0.2)), 1.0,
         std::min(0.3, min_l + ((max_l - min_l) * 0.3)), 1.0);
-    return get_filtered_colors(colors, bright_range);
 }
 
-std::vector<Color> get_saturated_colors(const std::vector<Color> &colors) {
-    HslRangeProperties total_range(colors);
+HslRangeProperties get_saturated_range(
+    const HslRangeProperties &total_range) {
     const double min_s = total_range.min_saturation_;
     const double max_s = total_range.max_saturation_;
     const double min_l = total_range.min_lightness_;
     const double max_l = total_range.max_lightness_;
-    HslRangeProperties saturated_range(
+    return HslRangeProperties(
         std::min(0.5, min_s + ((max_s - min_s) * 0.5)), 1.0,
         std::min(0.1, min_l + ((max_l - min_l) * 0.1)),
         std::max(0.9, min_l + ((max_l - min_l) * 0.9)));
-    return get_filtered_colors(colors, saturated_range);
 }
 
 std::vector<Color> get_hue_spread_colors(int num_colors) {
@@ -207,14 +903,115 @@ std::vector<Color> get_hue_spread_colors(int num_colors) {
     hue_spread_colors.reserve(num_colors);
     double hue_increment = (1.0 / num_colors);
     for (int i = 0; i < num_colors; ++i) {
-        double hue_value = hue_increment * i;
-        Magick::ColorHSL hue_spread_color(
-            static_cast<Magick::Quantum>(hue_value),
-            static_cast<Magick::Quantum>(1.0),
-            static_cast<Magick::Quantum>(0.5));
-        hue_spread_colors.emplace_back(Magick::Color(hue_spread_color));
+        const FixedHsl hsl = FixedHsl::from_unit(hue_increment * i, 1.0, 0.5);
+        hue_spread_colors.emplace_back(
+            hsl.to_rgb<uint16_t>().to_magick());
     }
     return hue_spread_colors;
 }
+
+const ColorHistogram &get_mode_histogram(const ColorHistogram &histogram,
+                                         ImageGetSampleColorsMode mode,
+                                         ColorHistogram &filtered) {
+    HslRangeProperties range(0.0, 0.0, 0.0, 0.0);
+    switch (mode.get_value()) {
+        case ImageGetSampleColorsMode::Value::kmeans_bright_hue_spread:
+            range = get_bright_range(HslRangeProperties(histogram));
+            break;
+        case ImageGetSampleColorsMode::Value::kmeans_saturated_hue_spread:
+            range = get_saturated_range(HslRangeProperties(histogram));
+            break;
+        default: return histogram;
+    }
+    histogram.filtered(
+        [&range](const ColorHistogram::Entry &entry) {
+            return range.contains(FixedHsl::from_rgb24(entry.rgb24_));
+        },
+        filtered);
+    return filtered;
+}
+
+bool ping_size(const std::function<void(Magick::Image &)> &ping_function,
+               const std::string &name, Magick::Geometry &size,
+               std::stringstream &error_stream) {
+    Magick::Image header;
+    try {
+        ping_function(header);
+    } catch (Magick::Exception &error) {
+        error_stream << "ImageMagick exception: " << error.what() << std::endl;
+        return false;
+    }
+    if ((header.columns() == 0) || (header.rows() == 0)) {
+        error_stream << "Empty image \"" << name << "\"" << std::endl;
+        return false;
+    }
+    size = Magick::Geometry(header.columns(), header.rows());
+    return true;
+}
+
+bool cluster_unique_colors(size_t num_colors, ImageGetSampleColorsMode mode,
+                           const std::vector<Color> &colors,
+                           std::vector<Color> &centroids) {
+    switch (mode.get_value()) {
+        case ImageGetSampleColorsMode::Value::kmeans_random_spread:
+            return ColorKMeans::find_clusters(
+                num_colors, ColorKMeans::SeedMode::random_spread, colors,
+                centroids);
+        case ImageGetSampleColorsMode::Value::kmeans_static_spread:
+            return ColorKMeans::find_clusters(
+                num_colors, ColorKMeans::SeedMode::static_spread, colors,
+                centroids);
+        case ImageGetSampleColorsMode::Value::kmeans_hue_spread:
+        case ImageGetSampleColorsMode::Value::kmeans_bright_hue_spread:
+        case ImageGetSampleColorsMode::Value::kmeans_saturated_hue_spread:
+            centroids = get_hue_spread_colors(num_colors);
+            return ColorKMeans::find_clusters(
+                num_colors, ColorKMeans::SeedMode::keep_existing, colors,
+                centroids);
+        default: return false;
+    }
+}
+
+bool clusters_by_weight(const SampleWeights &weights,
+                        ImageGetSampleColorsMode mode,
+                        const ColorKMeans::Settings &settings) {
+    // Only the weighted clustering supports restarts and seeds, which only
+    // random spread uses; the other modes keep clustering unique colors.
+    const bool random_spread = mode.get_value()
+        == ImageGetSampleColorsMode::Value::kmeans_random_spread;
+    return !weights.uniform()
+        || (random_spread && ((settings.num_restarts_ > 1)
+                              || settings.seed_.has_value()));
+}
+
+ColorHistogram with_unit_weights(const ColorHistogram &histogram) {
+    ColorHistogram unit_histogram;
+    unit_histogram.reserve(histogram.size());
+    for (const ColorHistogram::Entry entry : histogram) {
+        unit_histogram.add(entry.rgb24_, 1.0);
+    }
+    return unit_histogram;
+}
+
+Magick::Image scaled_to_at_most(const Magick::Image &image,
+                                uint64_t max_pixels) {
+    const double scale = std::min(
+        1.0, std::sqrt(static_cast<double>(max_pixels)
+                       / (static_cast<double>(image.columns())
+                          * static_cast<double>(image.rows()))));
+    Magick::Image scaled(image);
+    scaled.scale(Magick::Geometry(
+        std::max<size_t>(static_cast<size_t>(image.columns() * scale), 1),
+        std::max<size_t>(static_cast<size_t>(image.rows() * scale), 1)));
+    return scaled;
+}
+
+bool cluster_superpixels(size_t num_colors, const Superpixels &superpixels,
+                         const ColorKMeans::Settings &settings,
+                         std::vector<Color> &centroids) {
+    return ColorKMeans::find_weighted_clusters(
+        num_colors, ColorKMeans::SeedMode::static_spread,
+        superpixels.to_histogram(), settings, centroids);
+}
 }  // namespace
 }  // namespace palette
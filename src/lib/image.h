@@ -1,16 +1,33 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
 #include <vector>
 
 #include <Magick++.h>
 
+#include "lib/color_k_means.h"
+
 namespace palette {
 
 class Color;
+class ColorHistogram;
 class ImageGetSampleColorsMode;
+class MemoryBudget;
+class PixelView;
+class SampleWeights;
+class Superpixels;
 
 class Image {
  public:
+    // Levels of an image pyramid are halved until neither side exceeds this.
+    static const size_t pyramid_base_size = 128;
+    static const size_t pyramid_refine_iterations = 3;
+    static constexpr double pyramid_refine_tolerance = 1.0;
+
     Image();
     explicit Image(const Magick::Image &image);
     explicit Image(Magick::Image &&image);
@@ -19,15 +36,244 @@ class Image {
 
     Image &operator=(const Image &other);
 
+    // Give access to the underlying image. The non-const overload discards
+    // the colors and color properties cached from the current pixels.
     Magick::Image &get();
     const Magick::Image &get() const;
 
-    std::vector<Color> get_colors() const;
+    // Read the image file scaled down, keeping its aspect ratio, to fit
+    // within decode_size; a zero width or height leaves that side unbounded.
+    // The size is passed to the decoder so that JPEG files are scaled while
+    // decoding, and whatever size remains is box-filtered down. Set
+    // original_size to the size stored in the file. Return whether or not
+    // the file could be read.
+    bool read(const std::string &file, const Magick::Geometry &decode_size,
+              Magick::Geometry &original_size,
+              std::stringstream &error_stream);
+
+    // Like read, but scale the image down to at most max_pixels pixels.
+    bool read(const std::string &file, size_t max_pixels,
+              Magick::Geometry &original_size,
+              std::stringstream &error_stream);
+
+    // Like read, but decode an image file held in memory, such as one read
+    // from a pipe, at full size or scaled down.
+    bool read(const Magick::Blob &blob, std::stringstream &error_stream);
+    bool read(const Magick::Blob &blob, const Magick::Geometry &decode_size,
+              Magick::Geometry &original_size,
+              std::stringstream &error_stream);
+    bool read(const Magick::Blob &blob, size_t max_pixels,
+              Magick::Geometry &original_size,
+              std::stringstream &error_stream);
+
+    // Like read, but read the image at full size only if reading it and
+    // counting its colors fit within budget, and otherwise scale it down to
+    // the most pixels that fit. A decoder that cannot scale while decoding
+    // still decodes at full size, which ImageMagick does in a pixel cache
+    // on disk once MemoryBudget::apply_magick_limits has been called.
+    // Record the paths taken in budget.
+    bool read(const std::string &file, MemoryBudget &budget,
+              Magick::Geometry &original_size,
+              std::stringstream &error_stream);
+    bool read(const Magick::Blob &blob, MemoryBudget &budget,
+              Magick::Geometry &original_size,
+              std::stringstream &error_stream);
+
+    // Encode the image in the given format, such as "png", replacing the
+    // contents of blob. Return whether or not it could be encoded.
+    bool write(Magick::Blob &blob, const std::string &format,
+               std::stringstream &error_stream) const;
+
+    // Return the color of every pixel, ordered by color. This takes a Color
+    // per pixel, many times the memory of the image itself; the overload
+    // with a budget bounds it.
+    std::vector<Color> get_colors(bool &success) const;
     std::vector<Color> get_unique_colors() const;
+
+    // Like get_colors and get_unique_colors, but replace the contents of
+    // colors, reusing its storage. Return whether or not the colors could
+    // be read.
+    bool get_colors(std::vector<Color> &colors) const;
+    void get_unique_colors(std::vector<Color> &colors) const;
+
+    // Like get_colors, but list the colors of a copy of the image scaled
+    // down to fit if a Color per pixel does not fit within budget. Record
+    // the path taken in budget.
+    bool get_colors(MemoryBudget &budget, std::vector<Color> &colors) const;
+
+    // Return the histogram of every pixel, computed on first use and kept
+    // with the image, to iterate over its packed colors without copying
+    // them. The reference is valid until the image is destroyed or its
+    // non-const get() is called.
+    const ColorHistogram &get_cached_histogram(bool &success) const;
     std::vector<Color> get_sample_colors(
         size_t num_colors, ImageGetSampleColorsMode mode, bool &success) const;
 
+    // Return the distinct colors of the image, ordered by color, with the
+    // total weight of the pixels having each, read directly from the pixel
+    // cache.
+    ColorHistogram get_histogram(const SampleWeights &weights,
+                                 bool &success) const;
+
+    // Like get_sample_colors, but each pixel counts by its weight, pixels of
+    // zero weight are ignored, and clustering follows the given settings.
+    std::vector<Color> get_sample_colors(
+        size_t num_colors, ImageGetSampleColorsMode mode,
+        const SampleWeights &weights, const ColorKMeans::Settings &settings,
+        bool &success) const;
+
+    // Like get_sample_colors, but replace the contents of sample_colors,
+    // reusing its storage. Return whether or not sampling succeeded.
+    bool get_sample_colors(size_t num_colors, ImageGetSampleColorsMode mode,
+                           const SampleWeights &weights,
+                           const ColorKMeans::Settings &settings,
+                           std::vector<Color> &sample_colors) const;
+
+    // Like get_sample_colors, but keep the mode within budget alongside the
+    // image: quantize a copy scaled down to fit when a full copy does not,
+    // segment superpixels likewise through get_superpixel_colors, and
+    // cluster the histogram coarsened until its colors fit when its colors
+    // do not. A coarsened color weighs as many pixels as it merges, or as
+    // many colors for a mode that clusters unique colors, so that the
+    // approximate path keeps the mode's objective. Record the path taken
+    // in budget.
+    bool get_sample_colors(size_t num_colors, ImageGetSampleColorsMode mode,
+                           const SampleWeights &weights,
+                           const ColorKMeans::Settings &settings,
+                           MemoryBudget &budget,
+                           std::vector<Color> &sample_colors) const;
+
+    // Segment the image into superpixels, or a copy of it scaled down to fit
+    // if segmenting the image does not fit within budget, and cluster the
+    // mean colors of the superpixels, each weighted by its weighted area,
+    // into num_colors colors. Segmenting follows the settings superpixels
+    // was created with, and superpixels keeps the segmentation, such as for
+    // its label map. The superpixels mode does this with default settings.
+    // Return whether or not it succeeded.
+    bool get_superpixel_colors(size_t num_colors,
+                               const SampleWeights &weights,
+                               const ColorKMeans::Settings &settings,
+                               MemoryBudget &budget, Superpixels &superpixels,
+                               std::vector<Color> &sample_colors) const;
+
+    // Like get_histogram, but for pixels held in memory, read in place.
+    static ColorHistogram get_histogram(const PixelView &pixels,
+                                        const SampleWeights &weights,
+                                        bool &success);
+
+    // Like get_sample_colors, but for pixels held in memory. Every mode
+    // reads the pixels in place except quantize, which needs a copy of them
+    // as a Magick image.
+    static std::vector<Color> get_sample_colors(
+        const PixelView &pixels, size_t num_colors,
+        ImageGetSampleColorsMode mode, const SampleWeights &weights,
+        const ColorKMeans::Settings &settings, bool &success);
+
+    // Like get_sample_colors, but run the mode on a small copy of the image
+    // and then refine the colors with a few k-means iterations at each
+    // successively larger level of an image pyramid.
+    std::vector<Color> get_pyramid_sample_colors(
+        size_t num_colors, ImageGetSampleColorsMode mode,
+        const SampleWeights &weights, const ColorKMeans::Settings &settings,
+        bool &success) const;
+
+    // Move each of the given colors toward the mean of the image colors
+    // nearest to it, among the colors the mode samples from, weighted the
+    // way the mode weighs them.
+    std::vector<Color> refine_sample_colors(
+        const std::vector<Color> &colors, ImageGetSampleColorsMode mode,
+        const SampleWeights &weights, const ColorKMeans::Settings &settings,
+        bool &success) const;
+
+    // Return the histogram colors the mode samples from, weighted the way
+    // it weighs them: each color once when it clusters the unique colors,
+    // or else by the weighted pixels having it. Quantize and superpixels,
+    // which do not cluster the colors themselves, sample from every
+    // weighted pixel.
+    ColorHistogram get_mode_sample_histogram(
+        ImageGetSampleColorsMode mode, const SampleWeights &weights,
+        const ColorKMeans::Settings &settings, bool &success) const;
+
+    // Sample colors from a histogram, such as one merged from several
+    // images, the way get_sample_colors samples them from an image: the
+    // unique colors the mode samples from, each counting once, or the
+    // histogram by weight when the weights or settings call for it. Return
+    // whether or not sampling succeeded; the modes that need an image
+    // cannot sample a histogram.
+    static bool find_sample_colors(size_t num_colors,
+                                   ImageGetSampleColorsMode mode,
+                                   const ColorHistogram &histogram,
+                                   const SampleWeights &weights,
+                                   const ColorKMeans::Settings &settings,
+                                   std::vector<Color> &sample_colors);
+
+    // Cluster the histogram colors the mode samples from, seeded the way
+    // the mode seeds them unless keep_centroids is set. Return whether or
+    // not clustering succeeded; the modes that need an image can only
+    // refine existing centroids.
+    static bool find_mode_clusters(size_t num_colors,
+                                   ImageGetSampleColorsMode mode,
+                                   const ColorHistogram &histogram,
+                                   bool keep_centroids,
+                                   const ColorKMeans::Settings &settings,
+                                   std::vector<Color> &centroids);
+
  private:
+    // Results derived from the pixels of image_, computed on first use and
+    // kept until the image may be modified. Copies of an image share them.
+    struct Cache;
+
+    // Like get_histogram, but return the cached histogram when the weights
+    // are uniform, or else count the colors into storage, so that the
+    // cached histogram is never copied.
+    const ColorHistogram &get_histogram(const SampleWeights &weights,
+                                        ColorHistogram &storage,
+                                        bool &success) const;
+
+    // Like get_histogram, but weighted the way the mode weighs colors: each
+    // color once when it clusters the unique colors, or else by the
+    // weighted pixels having it. The mode's filter is left to
+    // find_mode_clusters, which computes its range from the colors given.
+    const ColorHistogram &get_mode_weighted_histogram(
+        ImageGetSampleColorsMode mode, const SampleWeights &weights,
+        const ColorKMeans::Settings &settings, ColorHistogram &storage,
+        bool &success) const;
+
+    // Reads a file or blob into the given image, or pings it for its size.
+    using ReadFunction = std::function<void(Magick::Image &image)>;
+
+    // Read the image through read_function scaled down to fit within
+    // decode_size or to at most max_pixels, after reading its original
+    // size through ping_function. Name the image in errors by name.
+    bool read_within(const ReadFunction &ping_function,
+                     const ReadFunction &read_function,
+                     const std::string &name,
+                     const Magick::Geometry &decode_size,
+                     Magick::Geometry &original_size,
+                     std::stringstream &error_stream);
+    bool read_at_most(const ReadFunction &ping_function,
+                      const ReadFunction &read_function,
+                      const std::string &name, size_t max_pixels,
+                      Magick::Geometry &original_size,
+                      std::stringstream &error_stream);
+    bool read_within_budget(const ReadFunction &ping_function,
+                            const ReadFunction &read_function,
+                            const std::string &name, MemoryBudget &budget,
+                            Magick::Geometry &original_size,
+                            std::stringstream &error_stream);
+
+    // Read the image through read_function scaled down by the given
+    // factor, whose original size has been read already.
+    bool read_scaled(const ReadFunction &read_function,
+                     const Magick::Geometry &original_size, double scale,
+                     std::stringstream &error_stream);
+
+    // Return the unique colors that the bright or saturated hue spread
+    // modes cluster, using cached HSL values of the unique colors.
+    std::vector<Color> get_unique_colors_for_mode(
+        ImageGetSampleColorsMode mode) const;
+
     Magick::Image image_;
+    std::shared_ptr<Cache> cache_;
 };
 }  // namespace palette
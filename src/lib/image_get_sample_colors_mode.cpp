@@ -29,6 +29,10 @@ bool ImageGetSampleColorsMode::valid() const {
     return value_ != Value::unknown;
 }
 
+bool ImageGetSampleColorsMode::needs_image() const {
+    return (value_ == Value::quantize) || (value_ == Value::superpixels);
+}
+
 std::string ImageGetSampleColorsMode::to_string() const {
     return value_to_string(value_);
 }
@@ -55,6 +59,9 @@ ImageGetSampleColorsMode::Value ImageGetSampleColorsMode::value_from_string(
                 Value::kmeans_saturated_hue_spread)) == 0) {
         return Value::kmeans_saturated_hue_spread;
     }
+    if (value_str.compare(value_to_string(Value::superpixels)) == 0) {
+        return Value::superpixels;
+    }
     return Value::unknown;
 }
 
@@ -72,6 +79,8 @@ std::string ImageGetSampleColorsMode::value_to_string(const Value value) {
             return "kmeans-bright-hue-spread";
         case Value::kmeans_saturated_hue_spread:
             return "kmeans-saturated-hue-spread";
+        case Value::superpixels:
+            return "superpixels";
         default: break;
     }
     return "unknown";
@@ -13,6 +13,7 @@ class ImageGetSampleColorsMode {
         kmeans_hue_spread,
         kmeans_bright_hue_spread,
         kmeans_saturated_hue_spread,
+        superpixels,
         unknown
     };
 
@@ -24,6 +25,11 @@ class ImageGetSampleColorsMode {
 
     Value get_value() const;
     bool valid() const;
+
+    // Return whether or not the mode works on the pixels of an image rather
+    // than on a histogram of its colors, so that it can only refine colors
+    // against a histogram.
+    bool needs_image() const;
     std::string to_string() const;
 
     static Value value_from_string(const std::string &value_str);
@@ -0,0 +1,60 @@
+#include "lib/image_rows.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Magick++.h>
+
+namespace palette {
+
+ImageRows::ImageRows(const Magick::Image &image) :
+    image_(image.constImage()),
+    exception_(MagickCore::AcquireExceptionInfo()),
+    view_(MagickCore::AcquireVirtualCacheView(image_, exception_)) { }
+
+ImageRows::~ImageRows() {
+    MagickCore::DestroyCacheView(view_);
+    MagickCore::DestroyExceptionInfo(exception_);
+}
+
+size_t ImageRows::width() const { return image_->columns; }
+
+size_t ImageRows::height() const { return image_->rows; }
+
+bool ImageRows::read_rgb24(ssize_t x, ssize_t y, size_t width,
+                           uint32_t *rgb) {
+    const Magick::Quantum *pixels = MagickCore::GetCacheViewVirtualPixels(
+        view_, x, y, width, 1, exception_);
+    if (pixels == nullptr) {
+        return false;
+    }
+    const size_t num_channels = MagickCore::GetPixelChannels(image_);
+    for (size_t i = 0; i < width; ++i) {
+        rgb[i] = (static_cast<uint32_t>(MagickCore::ScaleQuantumToChar(
+                      MagickCore::GetPixelRed(image_, pixels))) << 16)
+            | (static_cast<uint32_t>(MagickCore::ScaleQuantumToChar(
+                   MagickCore::GetPixelGreen(image_, pixels))) << 8)
+            | static_cast<uint32_t>(MagickCore::ScaleQuantumToChar(
+                  MagickCore::GetPixelBlue(image_, pixels)));
+        pixels += num_channels;
+    }
+    return true;
+}
+
+bool ImageRows::read_intensity(ssize_t x, ssize_t y, size_t width,
+                               float *intensity) {
+    const Magick::Quantum *pixels = MagickCore::GetCacheViewVirtualPixels(
+        view_, x, y, width, 1, exception_);
+    if (pixels == nullptr) {
+        return false;
+    }
+    const size_t num_channels = MagickCore::GetPixelChannels(image_);
+    for (size_t i = 0; i < width; ++i) {
+        intensity[i] = static_cast<float>(
+            MagickCore::GetPixelIntensity(image_, pixels)
+            / MagickCore::QuantumRange);
+        pixels += num_channels;
+    }
+    return true;
+}
+}  // namespace palette
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Magick++.h>
+
+namespace palette {
+
+// Reads spans of pixel rows from an image through a virtual view of its
+// pixel cache, without copying the image. Each thread must use its own
+// ImageRows; any number of them may read the same image concurrently.
+class ImageRows {
+ public:
+    explicit ImageRows(const Magick::Image &image);
+    ImageRows(const ImageRows &other) = delete;
+    ~ImageRows();
+
+    ImageRows &operator=(const ImageRows &other) = delete;
+
+    size_t width() const;
+    size_t height() const;
+
+    // Read width pixels starting at (x, y) as 0xRRGGBB. Return whether or
+    // not the pixels could be read.
+    bool read_rgb24(ssize_t x, ssize_t y, size_t width, uint32_t *rgb);
+
+    // Read width pixel intensities starting at (x, y), scaled to [0, 1].
+    bool read_intensity(ssize_t x, ssize_t y, size_t width, float *intensity);
+
+ private:
+    const MagickCore::Image *image_;
+    MagickCore::ExceptionInfo *exception_;
+    MagickCore::CacheView *view_;
+};
+}  // namespace palette
@@ -0,0 +1,193 @@
+#include "lib/image_sequence.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Magick++.h>
+
+#include "lib/color.h"
+#include "lib/color_counter.h"
+#include "lib/color_histogram.h"
+#include "lib/color_k_means.h"
+#include "lib/image.h"
+#include "lib/image_get_sample_colors_mode.h"
+#include "lib/parallel.h"
+#include "lib/sample_weights.h"
+
+namespace palette {
+namespace {
+
+// Return the first frame of the index-th of num_runs contiguous runs that
+// together cover num_frames frames.
+size_t get_run_begin(size_t index, size_t num_runs, size_t num_frames);
+}  // namespace
+
+ImageSequence::ImageSequence() : frames_() { }
+
+ImageSequence::ImageSequence(const ImageSequence &other) :
+    frames_(other.frames_) { }
+
+ImageSequence &ImageSequence::operator=(const ImageSequence &other) {
+    frames_ = other.frames_;
+    return *this;
+}
+
+bool ImageSequence::read(const std::string &file,
+                         std::stringstream &error_stream) {
+    return read_frames(
+        [&file](std::list<Magick::Image> &frames) {
+            Magick::readImages(&frames, file);
+        },
+        file, error_stream);
+}
+
+bool ImageSequence::read(const Magick::Blob &blob,
+                         std::stringstream &error_stream) {
+    return read_frames(
+        [&blob](std::list<Magick::Image> &frames) {
+            Magick::readImages(&frames, blob);
+        },
+        "<memory>", error_stream);
+}
+
+size_t ImageSequence::size() const { return frames_.size(); }
+
+Image &ImageSequence::frame(size_t index) { return frames_.at(index); }
+
+const Image &ImageSequence::frame(size_t index) const {
+    return frames_.at(index);
+}
+
+bool ImageSequence::get_frame_sample_colors(
+    size_t num_colors, ImageGetSampleColorsMode mode,
+    const SampleWeights &weights, const ColorKMeans::Settings &settings,
+    std::vector<std::vector<Color>> &frame_colors) const {
+    frame_colors.assign(frames_.size(), std::vector<Color>());
+    const size_t num_runs =
+        std::min(frames_.size(), Parallel::default_num_threads());
+    const ColorKMeans::Settings warm_start_settings(
+        warm_start_iterations, warm_start_tolerance);
+    std::vector<char> run_success(num_runs, false);
+    Parallel::run(num_runs, [&](size_t run) {
+        const size_t begin = get_run_begin(run, num_runs, frames_.size());
+        const size_t end = get_run_begin(run + 1, num_runs, frames_.size());
+        // An exception must not leave the thread, which would terminate
+        // the process.
+        bool success = false;
+        try {
+            frame_colors[begin] = frames_[begin].get_sample_colors(
+                num_colors, mode, weights, settings, success);
+            for (size_t f = begin + 1; success && (f < end); ++f) {
+                frame_colors[f] = frames_[f].refine_sample_colors(
+                    frame_colors[f - 1], mode, weights, warm_start_settings,
+                    success);
+            }
+        } catch (Magick::Exception &) {
+            success = false;
+        }
+        run_success[run] = success;
+    });
+    return std::all_of(run_success.begin(), run_success.end(),
+                       [](char success) { return success; });
+}
+
+std::vector<Color> ImageSequence::get_merged_sample_colors(
+    size_t num_colors, ImageGetSampleColorsMode mode,
+    const SampleWeights &weights, const ColorKMeans::Settings &settings,
+    bool &success) const {
+    success = false;
+    std::vector<Color> sample_colors;
+    if (frames_.empty()) {
+        return sample_colors;
+    }
+
+    // Each run merges the histograms of its frames; runs are then merged
+    // in order. Frames are counted into a local histogram rather than the
+    // one each image caches, which would keep a histogram per frame.
+    const size_t num_runs =
+        std::min(frames_.size(), Parallel::default_num_threads());
+    std::vector<ColorHistogram> run_histograms(num_runs);
+    std::vector<char> run_success(num_runs, false);
+    Parallel::run(num_runs, [&](size_t run) {
+        const size_t begin = get_run_begin(run, num_runs, frames_.size());
+        const size_t end = get_run_begin(run + 1, num_runs, frames_.size());
+        bool frame_success = true;
+        ColorHistogram frame_histogram;
+        try {
+            for (size_t f = begin; frame_success && (f < end); ++f) {
+                frame_success = ColorCounter::count(
+                    frames_[f].get(), weights, frame_histogram);
+                run_histograms[run].merge(frame_histogram);
+            }
+        } catch (Magick::Exception &) {
+            frame_success = false;
+        }
+        run_success[run] = frame_success;
+    });
+    if (!std::all_of(run_success.begin(), run_success.end(),
+                     [](char run_succeeded) { return run_succeeded; })) {
+        return sample_colors;
+    }
+    ColorHistogram histogram;
+    for (const auto &run_histogram : run_histograms) {
+        histogram.merge(run_histogram);
+    }
+
+    if (mode.needs_image()) {
+        // Run the mode on the first frame, which it needs the pixels of,
+        // and refine its colors against every frame.
+        sample_colors = frames_.front().get_sample_colors(
+            num_colors, mode, weights, settings, success);
+        if (success) {
+            success = Image::find_mode_clusters(
+                sample_colors.size(), mode, histogram,
+                /* keep centroids */ true, settings, sample_colors);
+        }
+    } else {
+        // Cluster the merged colors as a single image's would be, so that
+        // a sequence of one frame gives the colors of that frame.
+        success = Image::find_sample_colors(num_colors, mode, histogram,
+                                            weights, settings,
+                                            sample_colors);
+    }
+    return sample_colors;
+}
+
+bool ImageSequence::read_frames(
+    const std::function<void(std::list<Magick::Image> &frames)>
+        &read_function,
+    const std::string &name, std::stringstream &error_stream) {
+    frames_.clear();
+    std::list<Magick::Image> decoded_frames;
+    std::list<Magick::Image> coalesced_frames;
+    try {
+        read_function(decoded_frames);
+        Magick::coalesceImages(&coalesced_frames, decoded_frames.begin(),
+                               decoded_frames.end());
+    } catch (Magick::Exception &error) {
+        error_stream << "ImageMagick exception: " << error.what() << std::endl;
+        return false;
+    }
+    if (coalesced_frames.empty()) {
+        error_stream << "No frames in \"" << name << "\"" << std::endl;
+        return false;
+    }
+    frames_.reserve(coalesced_frames.size());
+    for (auto &frame : coalesced_frames) {
+        frames_.emplace_back(std::move(frame));
+    }
+    return true;
+}
+
+namespace {
+
+size_t get_run_begin(size_t index, size_t num_runs, size_t num_frames) {
+    return (index * num_frames) / num_runs;
+}
+}  // namespace
+}  // namespace palette
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Magick++.h>
+
+#include "lib/color_k_means.h"
+#include "lib/image.h"
+
+namespace palette {
+
+class Color;
+class ImageGetSampleColorsMode;
+class SampleWeights;
+
+// The frames of an animation or multi-image file, each coalesced into a
+// complete image so that frames can be sampled independently.
+class ImageSequence {
+ public:
+    // Limits on refining the colors of one frame from the frame before it.
+    static const size_t warm_start_iterations = 5;
+    static constexpr double warm_start_tolerance = 1.0;
+
+    ImageSequence();
+    ImageSequence(const ImageSequence &other);
+
+    ImageSequence &operator=(const ImageSequence &other);
+
+    // Read and coalesce every frame of a file. Return whether or not at
+    // least one frame could be read.
+    bool read(const std::string &file, std::stringstream &error_stream);
+
+    // Like read, but decode a file held in memory.
+    bool read(const Magick::Blob &blob, std::stringstream &error_stream);
+
+    size_t size() const;
+    Image &frame(size_t index);
+    const Image &frame(size_t index) const;
+
+    // Get sample colors of every frame. Frames are split into contiguous
+    // runs that are processed in parallel; the mode samples the first frame
+    // of each run, and each later frame refines the colors of the frame
+    // before it. Return whether or not every frame was sampled.
+    bool get_frame_sample_colors(
+        size_t num_colors, ImageGetSampleColorsMode mode,
+        const SampleWeights &weights, const ColorKMeans::Settings &settings,
+        std::vector<std::vector<Color>> &frame_colors) const;
+
+    // Get sample colors of all frames together, as if they were one image.
+    std::vector<Color> get_merged_sample_colors(
+        size_t num_colors, ImageGetSampleColorsMode mode,
+        const SampleWeights &weights, const ColorKMeans::Settings &settings,
+        bool &success) const;
+
+ private:
+    // Coalesce the frames read through read_function and keep them. Name
+    // the input in errors by name.
+    bool read_frames(
+        const std::function<void(std::list<Magick::Image> &frames)>
+            &read_function,
+        const std::string &name, std::stringstream &error_stream);
+
+    std::vector<Image> frames_;
+};
+}  // namespace palette
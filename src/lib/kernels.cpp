@@ -0,0 +1,20 @@
+#include "lib/kernels.h"
+
+#include "lib/cpu_features.h"
+
+namespace palette {
+
+const Kernels &Kernels::get() {
+    static const Kernels &kernels = get(CpuFeatures::active());
+    return kernels;
+}
+
+const Kernels &Kernels::get(CpuFeatures::Level level) {
+    switch (level) {
+        case CpuFeatures::Level::avx512: return avx512_kernels;
+        case CpuFeatures::Level::avx2: return avx2_kernels;
+        case CpuFeatures::Level::sse4_2: return sse4_kernels;
+        default: return baseline_kernels;
+    }
+}
+}  // namespace palette
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "lib/cpu_features.h"
+
+namespace palette {
+
+// The library's hot loops, compiled once for each level of CpuFeatures:
+// kernels_baseline.cpp with no extra flags, and kernels_sse4.cpp,
+// kernels_avx2.cpp and kernels_avx512.cpp with the flags of their
+// instruction sets, which the Makefile sets per file. Every variant
+// computes the same results.
+struct Kernels final {
+    // Scale of the fixed-point values of hsl_from_rgb24, FixedHsl::one.
+    static constexpr uint32_t hsl_one = uint32_t(1) << 24;
+
+    // Return the kernels of CpuFeatures::active(), chosen on first call.
+    static const Kernels &get();
+    static const Kernels &get(CpuFeatures::Level level);
+
+    // Set distances[i] to the squared distance from color i to its nearest
+    // palette color and, unless indices is null, indices[i] to the index of
+    // the first such palette color. Colors and the palette are given a
+    // channel at a time. The palette must not be empty.
+    void (*nearest_colors)(const float *channel0, const float *channel1,
+                           const float *channel2, size_t num_colors,
+                           const float *palette0, const float *palette1,
+                           const float *palette2, size_t palette_size,
+                           float *distances, uint32_t *indices);
+
+    // Return the dot product of two arrays of size bytes.
+    uint32_t (*dot_u8)(const uint8_t *a, const uint8_t *b, size_t size);
+
+    // Pack width pixels of num_channels bytes each, 3 or 4, in RGB or, if
+    // bgr, in BGR order, as 0xRRGGBB.
+    void (*pack_rgb24)(const uint8_t *pixels, size_t num_channels, bool bgr,
+                       size_t width, uint32_t *rgb);
+
+    // Return how many of the width colors of row, at least one, are equal
+    // to the first before any other color. Width must not be zero.
+    size_t (*run_length)(const uint32_t *row, size_t width);
+
+    // Return the offset of the first '#' or '(' byte of data, where colors
+    // written in text begin, or size if there is none.
+    size_t (*find_site)(const uint8_t *data, size_t size);
+
+    // Convert colors packed as 0xRRGGBB as FixedHsl::from_rgb24 does,
+    // storing the hue, saturation and lightness of each color in turn.
+    void (*hsl_from_rgb24)(const uint32_t *rgb, size_t num_colors,
+                           uint32_t *hsl);
+};
+
+// Defined by kernels_*.cpp.
+extern const Kernels baseline_kernels;
+extern const Kernels sse4_kernels;
+extern const Kernels avx2_kernels;
+extern const Kernels avx512_kernels;
+}  // namespace palette
@@ -0,0 +1,9 @@
+// Kernels for processors with AVX2 and FMA.
+
+#include "lib/kernels.h"
+#include "lib/kernels_impl.h"
+
+namespace palette {
+
+const Kernels avx2_kernels = local_kernels;
+}  // namespace palette
@@ -0,0 +1,9 @@
+// Kernels for processors with AVX-512 F, BW, VL and DQ.
+
+#include "lib/kernels.h"
+#include "lib/kernels_impl.h"
+
+namespace palette {
+
+const Kernels avx512_kernels = local_kernels;
+}  // namespace palette
@@ -0,0 +1,9 @@
+// Kernels for any processor, with no flags beyond the build's own.
+
+#include "lib/kernels.h"
+#include "lib/kernels_impl.h"
+
+namespace palette {
+
+const Kernels baseline_kernels = local_kernels;
+}  // namespace palette
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "lib/kernels.h"
+
+// Bodies of the kernels, included by each kernels_*.cpp and compiled for
+// the instruction set of that file. They are plain loops that the compiler
+// vectorizes for the instruction set at hand, except where a loop cannot
+// express the instructions and intrinsics are used under that file's
+// __AVX2__ or __SSE2__.
+//
+// Everything here has internal linkage and calls no inline function or
+// template from another header, intrinsics aside, which are always
+// inlined, so the linker never keeps a copy built for a newer instruction
+// set where code for any processor calls it.
+
+namespace palette {
+namespace {
+
+void nearest_colors(const float *channel0, const float *channel1,
+                    const float *channel2, size_t num_colors,
+                    const float *palette0, const float *palette1,
+                    const float *palette2, size_t palette_size,
+                    float *distances, uint32_t *indices) {
+    for (size_t i = 0; i < num_colors; ++i) {
+        distances[i] = FLT_MAX;
+    }
+    if (indices != nullptr) {
+        for (size_t i = 0; i < num_colors; ++i) {
+            indices[i] = 0;
+        }
+    }
+    // The palette is the outer loop so that the inner loop runs over
+    // consecutive colors.
+    for (size_t p = 0; p < palette_size; ++p) {
+        const float q0 = palette0[p];
+        const float q1 = palette1[p];
+        const float q2 = palette2[p];
+        if (indices == nullptr) {
+            for (size_t i = 0; i < num_colors; ++i) {
+                const float d0 = channel0[i] - q0;
+                const float d1 = channel1[i] - q1;
+                const float d2 = channel2[i] - q2;
+                const float d = (d0 * d0) + (d1 * d1) + (d2 * d2);
+                distances[i] = (d < distances[i]) ? d : distances[i];
+            }
+        } else {
+            const auto index = static_cast<uint32_t>(p);
+            for (size_t i = 0; i < num_colors; ++i) {
+                const float d0 = channel0[i] - q0;
+                const float d1 = channel1[i] - q1;
+                const float d2 = channel2[i] - q2;
+                const float d = (d0 * d0) + (d1 * d1) + (d2 * d2);
+                const bool nearer = d < distances[i];
+                distances[i] = nearer ? d : distances[i];
+                indices[i] = nearer ? index : indices[i];
+            }
+        }
+    }
+}
+
+uint32_t dot_u8(const uint8_t *a, const uint8_t *b, size_t size) {
+    uint32_t sum = 0;
+    for (size_t n = 0; n < size; ++n) {
+        sum += static_cast<uint32_t>(a[n]) * static_cast<uint32_t>(b[n]);
+    }
+    return sum;
+}
+
+// Pack pixels whose layout is known at compile time, so that the loop has
+// constant strides.
+template <size_t NumChannels, size_t Red, size_t Blue>
+void pack_pixels(const uint8_t *pixels, size_t width, uint32_t *rgb) {
+    for (size_t i = 0; i < width; ++i) {
+        const uint8_t *pixel = pixels + (i * NumChannels);
+        rgb[i] = (static_cast<uint32_t>(pixel[Red]) << 16)
+            | (static_cast<uint32_t>(pixel[1]) << 8)
+            | static_cast<uint32_t>(pixel[Blue]);
+    }
+}
+
+void pack_rgb24(const uint8_t *pixels, size_t num_channels, bool bgr,
+                size_t width, uint32_t *rgb) {
+    if (num_channels == 4) {
+        if (bgr) {
+            pack_pixels<4, 2, 0>(pixels, width, rgb);
+        } else {
+            pack_pixels<4, 0, 2>(pixels, width, rgb);
+        }
+    } else if (bgr) {
+        pack_pixels<3, 2, 0>(pixels, width, rgb);
+    } else {
+        pack_pixels<3, 0, 2>(pixels, width, rgb);
+    }
+}
+
+size_t run_length(const uint32_t *row, size_t width) {
+    const size_t block_size = 16;
+    const uint32_t first = row[0];
+    size_t i = 1;
+    // Compare a block at a time with no exit inside the block, which
+    // takes a vector compare or two, and finish in the first block that
+    // holds another color.
+    for (; (i + block_size) <= width; i += block_size) {
+        uint32_t differences = 0;
+        for (size_t k = 0; k < block_size; ++k) {
+            differences |= row[i + k] ^ first;
+        }
+        if (differences != 0) {
+            break;
+        }
+    }
+    while ((i < width) && (row[i] == first)) {
+        ++i;
+    }
+    return i;
+}
+
+size_t find_site(const uint8_t *data, size_t size) {
+    size_t i = 0;
+    // Compare a block at a time and take the first site from the mask of
+    // matching bytes, which no plain loop compiles to.
+#if defined(__AVX2__)
+    const __m256i hash_bytes = _mm256_set1_epi8('#');
+    const __m256i paren_bytes = _mm256_set1_epi8('(');
+    for (; (i + 32) <= size; i += 32) {
+        const __m256i block = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(data + i));
+        const auto sites = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, hash_bytes),
+                            _mm256_cmpeq_epi8(block, paren_bytes))));
+        if (sites != 0) {
+            return i + static_cast<size_t>(__builtin_ctz(sites));
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i hash_bytes = _mm_set1_epi8('#');
+    const __m128i paren_bytes = _mm_set1_epi8('(');
+    for (; (i + 16) <= size; i += 16) {
+        const __m128i block = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(data + i));
+        const auto sites = static_cast<uint32_t>(_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(block, hash_bytes),
+                         _mm_cmpeq_epi8(block, paren_bytes))));
+        if (sites != 0) {
+            return i + static_cast<size_t>(__builtin_ctz(sites));
+        }
+    }
+#endif
+    while ((i < size) && (data[i] != '#') && (data[i] != '(')) {
+        ++i;
+    }
+    return i;
+}
+
+void hsl_from_rgb24(const uint32_t *rgb, size_t num_colors, uint32_t *hsl) {
+    // Quotients of integers below 2^53 are correctly rounded in double,
+    // and these quotients are never within rounding error of a half, so
+    // adding a half and truncating rounds them to the nearest integer.
+    const double scale = static_cast<double>(Kernels::hsl_one);
+    for (size_t i = 0; i < num_colors; ++i) {
+        const int32_t red = static_cast<int32_t>((rgb[i] >> 16) & 0xFF);
+        const int32_t green = static_cast<int32_t>((rgb[i] >> 8) & 0xFF);
+        const int32_t blue = static_cast<int32_t>(rgb[i] & 0xFF);
+        const int32_t max_green_blue = (green > blue) ? green : blue;
+        const int32_t min_green_blue = (green < blue) ? green : blue;
+        const int32_t max = (red > max_green_blue) ? red : max_green_blue;
+        const int32_t min = (red < min_green_blue) ? red : min_green_blue;
+        const int32_t chroma = max - min;
+        const int32_t sum = max + min;
+        const int32_t hue_sixths = (max == red)
+            ? ((green - blue) + ((green < blue) ? (6 * chroma) : 0))
+            : ((max == green) ? ((2 * chroma) + blue - red)
+                              : ((4 * chroma) + red - green));
+        const int32_t saturation_denominator =
+            (sum <= 255) ? sum : (510 - sum);
+        // Gray has neither hue nor saturation; divide by one instead.
+        const int32_t safe_chroma = (chroma > 0) ? chroma : 1;
+        const int32_t safe_denominator =
+            (saturation_denominator > 0) ? saturation_denominator : 1;
+        hsl[(i * 3) + 0] = static_cast<uint32_t>(
+            ((hue_sixths * scale) / (6 * safe_chroma)) + 0.5);
+        hsl[(i * 3) + 1] = static_cast<uint32_t>(
+            ((chroma * scale) / safe_denominator) + 0.5);
+        hsl[(i * 3) + 2] = static_cast<uint32_t>(
+            ((sum * scale) / 510.0) + 0.5);
+    }
+}
+
+// The kernels of the including file's instruction set.
+constexpr Kernels local_kernels = {
+    &nearest_colors, &dot_u8, &pack_rgb24, &run_length, &find_site,
+    &hsl_from_rgb24};
+}  // namespace
+}  // namespace palette
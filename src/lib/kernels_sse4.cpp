@@ -0,0 +1,9 @@
+// Kernels for processors with SSE4.2 and POPCNT.
+
+#include "lib/kernels.h"
+#include "lib/kernels_impl.h"
+
+namespace palette {
+
+const Kernels sse4_kernels = local_kernels;
+}  // namespace palette
@@ -0,0 +1,93 @@
+#include "lib/mapped_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace palette {
+
+MappedFile::MappedFile() : data_(nullptr), size_(0) { }
+
+MappedFile::MappedFile(MappedFile &&other) :
+    data_(other.data_), size_(other.size_) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+}
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile &MappedFile::operator=(MappedFile &&other) {
+    if (this != &other) {
+        close();
+        data_ = other.data_;
+        size_ = other.size_;
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+// Map the whole file into memory. Return whether or not mapping was
+// successful. An empty file is mapped successfully with a null data pointer.
+bool MappedFile::open(const std::string &file_name,
+                      std::stringstream &error_stream) {
+    close();
+    const int fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error_stream << "Failed to open " << file_name << ": "
+            << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) != 0) {
+        error_stream << "Failed to stat " << file_name << ": "
+            << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return false;
+    }
+    const size_t file_size = static_cast<size_t>(file_stat.st_size);
+    if (file_size == 0) {
+        ::close(fd);
+        return true;
+    }
+    void *mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the descriptor is closed.
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        error_stream << "Failed to map " << file_name << ": "
+            << std::strerror(errno) << std::endl;
+        return false;
+    }
+    data_ = static_cast<const unsigned char *>(mapping);
+    size_ = file_size;
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_ != nullptr) {
+        ::munmap(const_cast<unsigned char *>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+// Hint that the mapping will be read once from front to back, so the kernel
+// reads ahead aggressively and drops pages behind the reader.
+void MappedFile::advise_sequential() const {
+    if (data_ != nullptr) {
+        ::madvise(const_cast<unsigned char *>(data_), size_, MADV_SEQUENTIAL);
+    }
+}
+
+bool MappedFile::is_open() const { return data_ != nullptr; }
+
+const unsigned char *MappedFile::data() const { return data_; }
+
+size_t MappedFile::size() const { return size_; }
+}  // namespace palette
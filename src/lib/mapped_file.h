@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <sstream>
+#include <string>
+
+namespace palette {
+
+// Read-only memory mapping of an entire file. The mapping is released when
+// the object is destroyed; copying is disallowed but moving is allowed.
+class MappedFile {
+ public:
+    MappedFile();
+    MappedFile(const MappedFile &other) = delete;
+    MappedFile(MappedFile &&other);
+    ~MappedFile();
+
+    MappedFile &operator=(const MappedFile &other) = delete;
+    MappedFile &operator=(MappedFile &&other);
+
+    bool open(const std::string &file_name, std::stringstream &error_stream);
+    void close();
+    void advise_sequential() const;
+
+    bool is_open() const;
+    const unsigned char *data() const;
+    size_t size() const;
+
+ private:
+    const unsigned char *data_;
+    size_t size_;
+};
+}  // namespace palette
@@ -0,0 +1,184 @@
+#include "lib/mapped_palette.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "lib/binary_palette_format.h"
+#include "lib/color.h"
+#include "lib/mapped_file.h"
+
+namespace palette {
+namespace {
+
+bool section_fits(uint64_t offset, uint64_t num_bytes, size_t file_size) {
+    return ((offset % 8) == 0) && (offset <= file_size)
+        && (num_bytes <= (file_size - offset));
+}
+}  // namespace
+
+MappedPalette::MappedPalette() :
+    file_(),
+    header_(nullptr),
+    colors_(nullptr),
+    columns_(),
+    strings_(nullptr) { }
+
+// Take over the mapping, and leave other empty rather than pointing into it.
+MappedPalette::MappedPalette(MappedPalette &&other) :
+    file_(std::move(other.file_)),
+    header_(other.header_),
+    colors_(other.colors_),
+    columns_(),
+    strings_(other.strings_) {
+    std::copy(std::begin(other.columns_), std::end(other.columns_),
+              std::begin(columns_));
+    other.header_ = nullptr;
+    other.colors_ = nullptr;
+    std::fill(std::begin(other.columns_), std::end(other.columns_), nullptr);
+    other.strings_ = nullptr;
+}
+
+// Map a binary palette file and validate its header and section bounds.
+// Return whether or not the file is a usable binary palette.
+bool MappedPalette::open(const std::string &file_name,
+                         std::stringstream &error_stream) {
+    header_ = nullptr;
+    if (!file_.open(file_name, error_stream)) {
+        return false;
+    }
+    if (!has_magic(file_.data(), file_.size())
+        || (file_.size() < sizeof(BinaryPaletteHeader))) {
+        error_stream << file_name << " is not a binary palette file"
+            << std::endl;
+        return false;
+    }
+
+    const auto *header =
+        reinterpret_cast<const BinaryPaletteHeader *>(file_.data());
+    if (header->byte_order_ != BinaryPaletteHeader::byte_order_mark) {
+        error_stream << file_name << " was written on a machine with "
+            << "a different byte order" << std::endl;
+        return false;
+    }
+    if (header->version_ != BinaryPaletteHeader::current_version) {
+        error_stream << file_name << " has binary palette format version "
+            << header->version_ << "; only version "
+            << BinaryPaletteHeader::current_version << " is supported"
+            << std::endl;
+        return false;
+    }
+
+    const uint64_t num_colors = header->num_colors_;
+    const size_t file_size = file_.size();
+    bool valid = (num_colors < (uint64_t(1) << 32))
+        && section_fits(header->colors_offset_,
+                        num_colors * sizeof(uint32_t), file_size)
+        && section_fits(header->strings_offset_,
+                        header->strings_size_, file_size)
+        && (header->strings_size_ > 0)
+        && (header->palette_name_offset_ < header->strings_size_)
+        && (header->palette_comment_offset_ < header->strings_size_);
+    const char *strings = reinterpret_cast<const char *>(
+        file_.data() + header->strings_offset_);
+    valid = valid && (strings[header->strings_size_ - 1] == '\0');
+    for (uint32_t c = 0; valid && (c < BinaryPaletteHeader::num_columns);
+         ++c) {
+        const uint64_t column_offset = header->column_offsets_[c];
+        columns_[c] = nullptr;
+        if (column_offset == 0) {
+            continue;
+        }
+        valid = section_fits(column_offset,
+                             (num_colors + 1) * sizeof(uint32_t), file_size);
+        if (valid) {
+            columns_[c] = reinterpret_cast<const uint32_t *>(
+                file_.data() + column_offset);
+            // Individual entries are bounds-checked on access.
+            valid = (columns_[c][0] > 0)
+                && (columns_[c][num_colors] <= header->strings_size_);
+        }
+    }
+    if (!valid) {
+        error_stream << file_name << " is a truncated or corrupt "
+            << "binary palette file" << std::endl;
+        return false;
+    }
+
+    header_ = header;
+    colors_ = reinterpret_cast<const uint32_t *>(
+        file_.data() + header->colors_offset_);
+    strings_ = strings;
+    return true;
+}
+
+bool MappedPalette::has_magic(const unsigned char *data, size_t size) {
+    return (data != nullptr)
+        && (size >= sizeof(BinaryPaletteHeader::magic_string))
+        && (std::memcmp(data, BinaryPaletteHeader::magic_string,
+                        sizeof(BinaryPaletteHeader::magic_string)) == 0);
+}
+
+size_t MappedPalette::size() const {
+    return (header_ == nullptr) ? 0 : header_->num_colors_;
+}
+
+const uint32_t *MappedPalette::rgb24_data() const { return colors_; }
+
+uint32_t MappedPalette::rgb24(size_t index) const { return colors_[index]; }
+
+Color MappedPalette::color(size_t index) const {
+    return Color::from_rgb24(colors_[index]);
+}
+
+bool MappedPalette::has_column(Column column) const {
+    return (header_ != nullptr) && (columns_[column] != nullptr);
+}
+
+std::string_view MappedPalette::column_string(Column column,
+                                              size_t index) const {
+    if (!has_column(column) || (index >= size())) {
+        return std::string_view();
+    }
+    const uint32_t begin = columns_[column][index];
+    const uint32_t end = columns_[column][index + 1];
+    if ((end <= begin) || (end > header_->strings_size_)) {
+        return std::string_view();
+    }
+    return std::string_view(strings_ + begin, end - begin - 1);
+}
+
+std::string_view MappedPalette::palette_name() const {
+    return (header_ == nullptr)
+        ? std::string_view() : table_string(header_->palette_name_offset_);
+}
+
+std::string_view MappedPalette::palette_comment() const {
+    return (header_ == nullptr)
+        ? std::string_view() : table_string(header_->palette_comment_offset_);
+}
+
+size_t MappedPalette::find(Column column, std::string_view value) const {
+    const size_t num_colors = size();
+    if (!has_column(column)) {
+        return num_colors;
+    }
+    for (size_t i = 0; i < num_colors; ++i) {
+        if (column_string(column, i) == value) {
+            return i;
+        }
+    }
+    return num_colors;
+}
+
+// Strings in the table are NUL-terminated and the table itself ends with a
+// NUL byte, which open() verified.
+std::string_view MappedPalette::table_string(uint32_t offset) const {
+    return std::string_view(strings_ + offset);
+}
+}  // namespace palette
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "lib/binary_palette_format.h"
+#include "lib/mapped_file.h"
+
+namespace palette {
+
+class Color;
+
+// Binary palette file mapped into memory. Colors and strings are read in
+// place from the mapping without any parsing.
+class MappedPalette {
+ public:
+    using Column = BinaryPaletteHeader::Column;
+
+    MappedPalette();
+    MappedPalette(const MappedPalette &other) = delete;
+    MappedPalette(MappedPalette &&other);
+
+    MappedPalette &operator=(const MappedPalette &other) = delete;
+
+    bool open(const std::string &file_name, std::stringstream &error_stream);
+
+    static bool has_magic(const unsigned char *data, size_t size);
+
+    size_t size() const;
+    const uint32_t *rgb24_data() const;
+    uint32_t rgb24(size_t index) const;
+    Color color(size_t index) const;
+
+    bool has_column(Column column) const;
+    std::string_view column_string(Column column, size_t index) const;
+    std::string_view palette_name() const;
+    std::string_view palette_comment() const;
+
+    // Return the index of the first entry whose string in the given column
+    // equals value, or size() if there is none.
+    size_t find(Column column, std::string_view value) const;
+
+ private:
+    std::string_view table_string(uint32_t offset) const;
+
+    MappedFile file_;
+    const BinaryPaletteHeader *header_;
+    const uint32_t *colors_;
+    const uint32_t *columns_[BinaryPaletteHeader::num_columns];
+    const char *strings_;
+};
+}  // namespace palette
@@ -0,0 +1,338 @@
+#include "lib/mapped_palette_index.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "lib/color.h"
+#include "lib/mapped_file.h"
+#include "lib/palette_index_format.h"
+#include "lib/palette_signature.h"
+#include "lib/parallel.h"
+
+namespace palette {
+namespace {
+
+// Entries are ranked in parallel in blocks of this many.
+const size_t block_size = 65536;
+
+// Bands of more bits would need impractically large bucket tables.
+const uint32_t max_band_bits = 24;
+
+// Similarity score of an entry, as the unscaled dot product of signatures.
+using Score = std::pair<uint32_t, uint32_t>;
+
+bool section_fits(uint64_t offset, uint64_t num_bytes, size_t file_size);
+bool better_score(const Score &left, const Score &right);
+void keep_best(size_t k, std::vector<Score> &scores);
+void for_each_key_within(uint32_t key, uint32_t num_bits, size_t radius,
+                         uint32_t first_bit,
+                         const std::function<void(uint32_t)> &visit);
+}  // namespace
+
+MappedPaletteIndex::MappedPaletteIndex() :
+    file_(),
+    header_(nullptr),
+    hyperplanes_(nullptr),
+    signatures_(nullptr),
+    buckets_(nullptr),
+    postings_(nullptr),
+    palette_offsets_(nullptr),
+    colors_(nullptr),
+    name_offsets_(nullptr),
+    strings_(nullptr) { }
+
+// Map a palette index file and validate its header and section bounds.
+// Return whether or not the file is a usable palette index.
+bool MappedPaletteIndex::open(const std::string &file_name,
+                              std::stringstream &error_stream) {
+    header_ = nullptr;
+    if (!file_.open(file_name, error_stream)) {
+        return false;
+    }
+    if (!has_magic(file_.data(), file_.size())
+        || (file_.size() < sizeof(PaletteIndexHeader))) {
+        error_stream << file_name << " is not a palette index file"
+            << std::endl;
+        return false;
+    }
+
+    const auto *header =
+        reinterpret_cast<const PaletteIndexHeader *>(file_.data());
+    if (header->byte_order_ != PaletteIndexHeader::byte_order_mark) {
+        error_stream << file_name << " was written on a machine with "
+            << "a different byte order" << std::endl;
+        return false;
+    }
+    if (header->version_ != PaletteIndexHeader::current_version) {
+        error_stream << file_name << " has palette index format version "
+            << header->version_ << "; only version "
+            << PaletteIndexHeader::current_version << " is supported"
+            << std::endl;
+        return false;
+    }
+    if ((header->signature_size_ != PaletteSignature::size)
+        || (header->hash_bits_ != PaletteSignature::hash_bits)) {
+        error_stream << file_name << " holds signatures of a different "
+            << "kind than this version computes" << std::endl;
+        return false;
+    }
+
+    const uint64_t num_entries = header->num_entries_;
+    const uint64_t num_colors = header->num_colors_;
+    const uint64_t num_bands = header->num_bands_;
+    const uint64_t band_bits = header->band_bits_;
+    const size_t file_size = file_.size();
+    bool valid = (num_entries < (uint64_t(1) << 32))
+        && (num_colors < (uint64_t(1) << 32))
+        && (band_bits > 0) && (band_bits <= max_band_bits)
+        && ((num_bands * band_bits) <= PaletteSignature::hash_bits);
+    const uint64_t num_buckets = uint64_t(1) << (valid ? band_bits : 0);
+    valid = valid
+        && section_fits(header->hyperplanes_offset_,
+                        (PaletteSignature::hash_bits + 1)
+                        * PaletteSignature::size * sizeof(float), file_size)
+        && section_fits(header->signatures_offset_,
+                        num_entries * PaletteSignature::size, file_size)
+        && section_fits(header->hashes_offset_,
+                        num_entries * sizeof(uint64_t), file_size)
+        && section_fits(header->buckets_offset_,
+                        num_bands * (num_buckets + 1) * sizeof(uint32_t),
+                        file_size)
+        && section_fits(header->postings_offset_,
+                        num_bands * num_entries * sizeof(uint32_t),
+                        file_size)
+        && section_fits(header->palette_offsets_offset_,
+                        (num_entries + 1) * sizeof(uint32_t), file_size)
+        && section_fits(header->colors_offset_,
+                        num_colors * sizeof(uint32_t), file_size)
+        && section_fits(header->name_offsets_offset_,
+                        (num_entries + 1) * sizeof(uint32_t), file_size)
+        && section_fits(header->strings_offset_, header->strings_size_,
+                        file_size);
+    if (valid) {
+        buckets_ = reinterpret_cast<const uint32_t *>(
+            file_.data() + header->buckets_offset_);
+        palette_offsets_ = reinterpret_cast<const uint32_t *>(
+            file_.data() + header->palette_offsets_offset_);
+        name_offsets_ = reinterpret_cast<const uint32_t *>(
+            file_.data() + header->name_offsets_offset_);
+        strings_ = reinterpret_cast<const char *>(
+            file_.data() + header->strings_offset_);
+        // Individual palettes and names are bounds-checked on access.
+        valid = (palette_offsets_[num_entries] <= num_colors)
+            && (name_offsets_[num_entries] <= header->strings_size_)
+            && ((header->strings_size_ == 0)
+                || (strings_[header->strings_size_ - 1] == '\0'));
+    }
+    for (uint64_t band = 0; valid && (band < num_bands); ++band) {
+        const uint32_t *band_buckets = buckets_ + (band * (num_buckets + 1));
+        valid = (band_buckets[0] == 0)
+            && (band_buckets[num_buckets] == num_entries);
+        for (uint64_t b = 0; valid && (b < num_buckets); ++b) {
+            valid = (band_buckets[b] <= band_buckets[b + 1]);
+        }
+    }
+    if (!valid) {
+        error_stream << file_name << " is a truncated or corrupt "
+            << "palette index file" << std::endl;
+        return false;
+    }
+
+    header_ = header;
+    hyperplanes_ = reinterpret_cast<const float *>(
+        file_.data() + header->hyperplanes_offset_);
+    signatures_ = file_.data() + header->signatures_offset_;
+    postings_ = reinterpret_cast<const uint32_t *>(
+        file_.data() + header->postings_offset_);
+    colors_ = reinterpret_cast<const uint32_t *>(
+        file_.data() + header->colors_offset_);
+    return true;
+}
+
+bool MappedPaletteIndex::has_magic(const unsigned char *data, size_t size) {
+    return (data != nullptr)
+        && (size >= sizeof(PaletteIndexHeader::magic_string))
+        && (std::memcmp(data, PaletteIndexHeader::magic_string,
+                        sizeof(PaletteIndexHeader::magic_string)) == 0);
+}
+
+size_t MappedPaletteIndex::size() const {
+    return (header_ == nullptr) ? 0 : header_->num_entries_;
+}
+
+std::string_view MappedPaletteIndex::name(size_t index) const {
+    if (index >= size()) {
+        return std::string_view();
+    }
+    const uint32_t begin = name_offsets_[index];
+    const uint32_t end = name_offsets_[index + 1];
+    if ((end <= begin) || (end > header_->strings_size_)) {
+        return std::string_view();
+    }
+    return std::string_view(strings_ + begin, end - begin - 1);
+}
+
+void MappedPaletteIndex::get_palette(size_t index,
+                                     std::vector<Color> &colors) const {
+    colors.clear();
+    if (index >= size()) {
+        return;
+    }
+    const uint32_t begin = palette_offsets_[index];
+    const uint32_t end = palette_offsets_[index + 1];
+    if ((end < begin) || (end > header_->num_colors_)) {
+        return;
+    }
+    colors.reserve(end - begin);
+    for (uint32_t c = begin; c < end; ++c) {
+        colors.push_back(Color::from_rgb24(colors_[c]));
+    }
+}
+
+const uint8_t *MappedPaletteIndex::signature(size_t index) const {
+    return signatures_ + (index * PaletteSignature::size);
+}
+
+size_t MappedPaletteIndex::query(const std::vector<Color> &colors, size_t k,
+                                 size_t probe_radius, bool exhaustive,
+                                 std::vector<Match> &matches) const {
+    matches.clear();
+    if ((size() == 0) || (k == 0)) {
+        return 0;
+    }
+    const PaletteSignature::Value query_signature =
+        PaletteSignature::compute(colors);
+    if (!exhaustive) {
+        const float *center = hyperplanes_
+            + (PaletteSignature::hash_bits * PaletteSignature::size);
+        const uint64_t hash = PaletteSignature::hash(
+            query_signature.data(), hyperplanes_, center);
+        std::vector<uint32_t> candidates;
+        gather_candidates(hash, probe_radius, candidates);
+        if (candidates.size() >= std::min(k, size())) {
+            rank(query_signature.data(), candidates.data(),
+                 candidates.size(), k, matches);
+            return candidates.size();
+        }
+    }
+    rank(query_signature.data(), nullptr, size(), k, matches);
+    return size();
+}
+
+// Collect the distinct entries in the buckets of every band whose bits are
+// within the probe radius of the hash.
+void MappedPaletteIndex::gather_candidates(
+    uint64_t hash, size_t probe_radius,
+    std::vector<uint32_t> &candidates) const {
+    const uint32_t band_bits = header_->band_bits_;
+    const uint64_t num_buckets = uint64_t(1) << band_bits;
+    const uint32_t num_entries = static_cast<uint32_t>(size());
+    candidates.clear();
+    for (uint32_t band = 0; band < header_->num_bands_; ++band) {
+        const uint32_t *band_buckets =
+            buckets_ + (band * (num_buckets + 1));
+        const uint32_t *band_postings = postings_ + (band * size());
+        const uint32_t key = static_cast<uint32_t>(
+            (hash >> (band * band_bits)) & (num_buckets - 1));
+        for_each_key_within(
+            key, band_bits, probe_radius, 0, [&](uint32_t bucket) {
+                for (uint32_t p = band_buckets[bucket];
+                     p < band_buckets[bucket + 1]; ++p) {
+                    if (band_postings[p] < num_entries) {
+                        candidates.push_back(band_postings[p]);
+                    }
+                }
+            });
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                     candidates.end());
+}
+
+// Rank the entries at the given indices, or all entries if indices is
+// null, by the similarity of their signatures to the query signature, and
+// keep the best k. Blocks of entries are ranked in parallel, each keeping
+// its own best k, and the survivors are ranked again.
+void MappedPaletteIndex::rank(const uint8_t *query_signature,
+                              const uint32_t *indices, size_t num_indices,
+                              size_t k, std::vector<Match> &matches) const {
+    const size_t num_blocks = (num_indices + block_size - 1) / block_size;
+    std::vector<std::vector<Score>> block_scores(num_blocks);
+    Parallel::run(num_blocks, [&](size_t block) {
+        const size_t begin = block * block_size;
+        const size_t end = std::min(num_indices, begin + block_size);
+        std::vector<Score> &scores = block_scores[block];
+        scores.reserve(end - begin);
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t index = (indices == nullptr)
+                ? static_cast<uint32_t>(i) : indices[i];
+            scores.emplace_back(
+                PaletteSignature::dot(query_signature, signature(index)),
+                index);
+        }
+        keep_best(k, scores);
+    });
+
+    std::vector<Score> scores;
+    for (const std::vector<Score> &block : block_scores) {
+        scores.insert(scores.end(), block.begin(), block.end());
+    }
+    keep_best(k, scores);
+    matches.clear();
+    matches.reserve(scores.size());
+    for (const Score &score : scores) {
+        matches.push_back(Match{
+            score.second,
+            PaletteSignature::similarity(query_signature,
+                                         signature(score.second))});
+    }
+}
+
+namespace {
+
+bool section_fits(uint64_t offset, uint64_t num_bytes, size_t file_size) {
+    return ((offset % 8) == 0) && (offset <= file_size)
+        && (num_bytes <= (file_size - offset));
+}
+
+// Order by higher score first and then by lower index.
+bool better_score(const Score &left, const Score &right) {
+    return (left.first != right.first)
+        ? (left.first > right.first) : (left.second < right.second);
+}
+
+// Keep the best k scores, best first.
+void keep_best(size_t k, std::vector<Score> &scores) {
+    const size_t num_kept = std::min(k, scores.size());
+    std::partial_sort(scores.begin(), scores.begin() + num_kept,
+                      scores.end(), better_score);
+    scores.resize(num_kept);
+}
+
+// Call visit with every key of num_bits bits that differs from key in at
+// most radius of the bits at or above first_bit.
+void for_each_key_within(uint32_t key, uint32_t num_bits, size_t radius,
+                         uint32_t first_bit,
+                         const std::function<void(uint32_t)> &visit) {
+    if (first_bit == 0) {
+        visit(key);
+    }
+    if (radius == 0) {
+        return;
+    }
+    for (uint32_t bit = first_bit; bit < num_bits; ++bit) {
+        const uint32_t flipped = key ^ (uint32_t(1) << bit);
+        visit(flipped);
+        for_each_key_within(flipped, num_bits, radius - 1, bit + 1, visit);
+    }
+}
+}  // namespace
+}  // namespace palette
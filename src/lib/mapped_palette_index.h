@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lib/mapped_file.h"
+#include "lib/palette_index_format.h"
+
+namespace palette {
+
+class Color;
+
+// Palette index file written by PaletteIndexBuilder, mapped into memory and
+// queried in place.
+//
+// A query gathers candidates from the buckets its hash falls into in each
+// band and from the buckets whose bits differ from it in at most the probe
+// radius places. The candidates are then ranked by the exact similarity of
+// their signatures. If that yields fewer candidates than requested, or an
+// exhaustive query is requested, every entry is ranked instead.
+class MappedPaletteIndex {
+ public:
+    struct Match final {
+        size_t index_;
+        double similarity_;
+    };
+
+    MappedPaletteIndex();
+    MappedPaletteIndex(const MappedPaletteIndex &other) = delete;
+    MappedPaletteIndex(MappedPaletteIndex &&other) = default;
+
+    MappedPaletteIndex &operator=(const MappedPaletteIndex &other) = delete;
+
+    bool open(const std::string &file_name, std::stringstream &error_stream);
+
+    static bool has_magic(const unsigned char *data, size_t size);
+
+    static constexpr size_t default_probe_radius = 1;
+
+    size_t size() const;
+    std::string_view name(size_t index) const;
+    void get_palette(size_t index, std::vector<Color> &colors) const;
+    const uint8_t *signature(size_t index) const;
+
+    // Find up to k entries most similar to the palette, most similar
+    // first, and return the number of entries whose signatures were
+    // compared.
+    size_t query(const std::vector<Color> &colors, size_t k,
+                 size_t probe_radius, bool exhaustive,
+                 std::vector<Match> &matches) const;
+
+ private:
+    void gather_candidates(uint64_t hash, size_t probe_radius,
+                           std::vector<uint32_t> &candidates) const;
+    void rank(const uint8_t *query_signature, const uint32_t *indices,
+              size_t num_indices, size_t k,
+              std::vector<Match> &matches) const;
+
+    MappedFile file_;
+    const PaletteIndexHeader *header_;
+    const float *hyperplanes_;
+    const uint8_t *signatures_;
+    const uint32_t *buckets_;
+    const uint32_t *postings_;
+    const uint32_t *palette_offsets_;
+    const uint32_t *colors_;
+    const uint32_t *name_offsets_;
+    const char *strings_;
+};
+}  // namespace palette
@@ -0,0 +1,204 @@
+#include "lib/memory_budget.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Magick++.h>
+
+namespace palette {
+namespace {
+
+// More colors than this cannot be distinct at 8 bits per channel.
+const uint64_t max_distinct_colors = uint64_t(1) << 24;
+
+// Units of bytes_to_string, each 1024 times the last.
+const char *const byte_units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+}  // namespace
+
+MemoryBudget::MemoryBudget() :
+    max_bytes_(0), decisions_mutex_(), decisions_(), notes_() { }
+
+MemoryBudget::MemoryBudget(uint64_t max_bytes) :
+    max_bytes_(max_bytes), decisions_mutex_(), decisions_(),
+    notes_() { }
+
+bool MemoryBudget::parse(const std::string &text, uint64_t &max_bytes) {
+    size_t end = 0;
+    while ((end < text.size())
+           && std::isdigit(static_cast<unsigned char>(text[end]))) {
+        ++end;
+    }
+    if ((end == 0) || (end > std::numeric_limits<uint64_t>::digits10)) {
+        return false;
+    }
+    uint64_t bytes = std::stoull(text.substr(0, end));
+    if (end < text.size()) {
+        if ((end + 1) != text.size()) {
+            return false;
+        }
+        const size_t exponent = std::string("KMGT").find(
+            static_cast<char>(std::toupper(
+                static_cast<unsigned char>(text[end])))) + 1;
+        if (exponent == 0) {
+            return false;
+        }
+        const uint64_t multiplier = uint64_t(1) << (10 * exponent);
+        if (bytes > (std::numeric_limits<uint64_t>::max() / multiplier)) {
+            return false;
+        }
+        bytes *= multiplier;
+    }
+    if (bytes == 0) {
+        return false;
+    }
+    max_bytes = bytes;
+    return true;
+}
+
+bool MemoryBudget::limited() const { return max_bytes_ > 0; }
+
+uint64_t MemoryBudget::max_bytes() const { return max_bytes_; }
+
+bool MemoryBudget::fits(uint64_t bytes) const {
+    return !limited() || (bytes <= max_bytes_);
+}
+
+uint64_t MemoryBudget::read_bytes(uint64_t num_pixels) {
+    return (num_pixels * pixel_cache_bytes)
+        + (std::min(num_pixels, max_distinct_colors) * count_bytes_per_color);
+}
+
+uint64_t MemoryBudget::quantize_bytes(uint64_t num_pixels) {
+    return (num_pixels * pixel_cache_bytes) + max_quantize_tree_bytes;
+}
+
+uint64_t MemoryBudget::superpixel_bytes(uint64_t num_pixels) {
+    return num_pixels * superpixel_bytes_per_pixel;
+}
+
+uint64_t MemoryBudget::colors_bytes(uint64_t num_pixels) {
+    return num_pixels * color_bytes;
+}
+
+uint64_t MemoryBudget::cluster_bytes(uint64_t num_colors, bool weighted) {
+    return num_colors * (weighted ? weighted_color_bytes : unique_color_bytes);
+}
+
+uint64_t MemoryBudget::max_read_pixels() const {
+    if (!limited()) {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    // Counting takes memory per pixel only up to the most distinct colors.
+    const uint64_t distinct_bytes = read_bytes(max_distinct_colors);
+    const uint64_t num_pixels = (max_bytes_ >= distinct_bytes)
+        ? (max_distinct_colors
+           + ((max_bytes_ - distinct_bytes) / pixel_cache_bytes))
+        : (max_bytes_ / (pixel_cache_bytes + count_bytes_per_color));
+    return std::max<uint64_t>(num_pixels, 1);
+}
+
+uint64_t MemoryBudget::max_sampled_pixels(uint64_t held_bytes,
+                                          uint64_t fixed_bytes,
+                                          uint64_t bytes_per_pixel,
+                                          uint64_t min_pixels) const {
+    if (!limited()) {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    const uint64_t taken_bytes = held_bytes + fixed_bytes;
+    if (max_bytes_ <= taken_bytes) {
+        return min_pixels;
+    }
+    return std::max((max_bytes_ - taken_bytes) / bytes_per_pixel,
+                    min_pixels);
+}
+
+void MemoryBudget::apply_magick_limits() const {
+    if (!limited()) {
+        return;
+    }
+    Magick::ResourceLimits::memory(max_bytes_);
+    Magick::ResourceLimits::map(max_bytes_);
+}
+
+void MemoryBudget::record(const std::string &stage, Path path,
+                          uint64_t full_bytes, uint64_t bytes) {
+    if (!limited()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(decisions_mutex_);
+    decisions_.push_back(Decision{stage, path, full_bytes, bytes});
+}
+
+std::vector<MemoryBudget::Decision> MemoryBudget::decisions() const {
+    std::lock_guard<std::mutex> lock(decisions_mutex_);
+    return decisions_;
+}
+
+void MemoryBudget::note(const std::string &note) {
+    if (!limited()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(decisions_mutex_);
+    notes_.push_back(note);
+}
+
+std::vector<std::string> MemoryBudget::notes() const {
+    std::lock_guard<std::mutex> lock(decisions_mutex_);
+    return notes_;
+}
+
+std::string MemoryBudget::to_string() const {
+    std::stringstream stream;
+    stream << "Memory budget "
+        << (limited() ? bytes_to_string(max_bytes_) : "unlimited")
+        << std::endl;
+    for (const std::string &note : notes()) {
+        stream << note << std::endl;
+    }
+    for (const Decision &decision : decisions()) {
+        stream << decision.stage_ << ": " << path_to_string(decision.path_)
+            << ", estimated " << bytes_to_string(decision.bytes_);
+        if (decision.path_ != Path::full) {
+            stream << " instead of " << bytes_to_string(decision.full_bytes_);
+        }
+        stream << std::endl;
+    }
+    return stream.str();
+}
+
+std::string MemoryBudget::path_to_string(Path path) {
+    switch (path) {
+        case Path::full: return "full";
+        case Path::sampled: return "sampled";
+        case Path::binned: return "binned";
+        case Path::tiled: return "tiled";
+    }
+    return "";
+}
+
+std::string MemoryBudget::bytes_to_string(uint64_t bytes) {
+    const size_t num_units = sizeof(byte_units) / sizeof(byte_units[0]);
+    size_t unit = 0;
+    double value = static_cast<double>(bytes);
+    while ((value >= 1024.0) && ((unit + 1) < num_units)) {
+        value /= 1024.0;
+        ++unit;
+    }
+    std::stringstream stream;
+    if (unit == 0) {
+        stream << bytes << " " << byte_units[unit];
+    } else {
+        stream << std::fixed << std::setprecision(1) << value << " "
+            << byte_units[unit];
+    }
+    return stream.str();
+}
+}  // namespace palette
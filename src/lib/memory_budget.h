@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <Magick++.h>
+
+namespace palette {
+
+// Cap on the memory that reading an image and getting its colors may take.
+// Each stage estimates its peak footprint before it starts and, when the
+// estimate exceeds the budget, takes an approximate path that fits instead
+// of the exact one, recording which path it took.
+//
+// The estimates are rough upper bounds from the sizes of the structures
+// involved, not measurements; they keep a huge image from taking memory in
+// proportion to its size rather than account for every byte.
+class MemoryBudget {
+ public:
+    enum class Path {
+        // The exact path, which fits within the budget.
+        full,
+        // Fewer pixels: the image scaled down to fit.
+        sampled,
+        // Fewer colors: a histogram coarsened to fewer bits per channel.
+        binned,
+        // The full image kept by ImageMagick in a pixel cache on disk and
+        // read through memory a tile at a time.
+        tiled
+    };
+
+    struct Decision final {
+        std::string stage_;
+        Path path_;
+        // Estimated peak bytes of the stage on its full path and on the
+        // path it took.
+        uint64_t full_bytes_;
+        uint64_t bytes_;
+    };
+
+    // Bytes of ImageMagick's pixel cache per pixel, for red, green, blue and
+    // alpha.
+    static constexpr uint64_t pixel_cache_bytes =
+        4 * sizeof(MagickCore::Quantum);
+    // Bytes per distinct color while counting colors: a slot in a per-thread
+    // table with room to spare, an entry while merging the tables, and an
+    // entry of the histogram.
+    static constexpr uint64_t count_bytes_per_color = 64;
+    // Bytes per Color, with the storage its Magick::Color allocates.
+    static constexpr uint64_t color_bytes = 168;
+    // Bytes per color clustered by unweighted k-means: a Color and its
+    // column of the data.
+    static constexpr uint64_t unique_color_bytes =
+        color_bytes + (3 * sizeof(double));
+    // Bytes per histogram entry clustered by weighted k-means.
+    static constexpr uint64_t weighted_color_bytes = 64;
+    // Bytes of the tree ImageMagick classifies colors into when quantizing,
+    // which it prunes to a bounded number of nodes.
+    static constexpr uint64_t max_quantize_tree_bytes = uint64_t(64) << 20;
+    // Bytes per pixel segmented into superpixels: its CIELAB color, its
+    // label before and after the regions are made connected, and its place
+    // in the queue of a region.
+    static constexpr uint64_t superpixel_bytes_per_pixel = 32;
+
+    // Create an unlimited budget, with which every stage takes its full
+    // path and nothing is recorded.
+    MemoryBudget();
+    // Create a budget of max_bytes, or an unlimited one if it is zero.
+    explicit MemoryBudget(uint64_t max_bytes);
+
+    // Set max_bytes to a size such as "65536", "800M" or "2G", whose suffix
+    // K, M, G or T multiplies by a power of 1024. Return whether or not text
+    // is a positive size.
+    static bool parse(const std::string &text, uint64_t &max_bytes);
+
+    bool limited() const;
+    uint64_t max_bytes() const;
+
+    // Return whether or not a stage of the given estimated peak fits.
+    bool fits(uint64_t bytes) const;
+
+    // Estimate the peak bytes of reading an image of num_pixels pixels and
+    // counting its colors.
+    static uint64_t read_bytes(uint64_t num_pixels);
+    // Estimate the peak bytes of quantizing a copy of an image.
+    static uint64_t quantize_bytes(uint64_t num_pixels);
+    // Estimate the peak bytes of segmenting an image into superpixels.
+    static uint64_t superpixel_bytes(uint64_t num_pixels);
+    // Estimate the peak bytes of listing the colors of num_pixels pixels,
+    // one Color per pixel.
+    static uint64_t colors_bytes(uint64_t num_pixels);
+    // Estimate the peak bytes of clustering num_colors colors, unweighted
+    // or weighted.
+    static uint64_t cluster_bytes(uint64_t num_colors, bool weighted);
+
+    // Return the most pixels that an image may have for read_bytes to fit,
+    // at least one.
+    uint64_t max_read_pixels() const;
+    // Return the most pixels that a scaled-down copy of an image may have
+    // for a stage that takes fixed_bytes and bytes_per_pixel for each pixel
+    // of the copy, its pixel cache included, to fit while held_bytes are
+    // taken already, at least min_pixels.
+    uint64_t max_sampled_pixels(uint64_t held_bytes, uint64_t fixed_bytes,
+                                uint64_t bytes_per_pixel,
+                                uint64_t min_pixels) const;
+
+    // Limit the memory and memory-mapped files that ImageMagick allocates
+    // pixel caches from to the budget, so that it keeps a larger cache on
+    // disk instead. The limits hold for the whole process. Do nothing if
+    // the budget is unlimited.
+    void apply_magick_limits() const;
+
+    // Record the path a stage took, unless the budget is unlimited. Stages
+    // may record concurrently.
+    void record(const std::string &stage, Path path, uint64_t full_bytes,
+                uint64_t bytes);
+    std::vector<Decision> decisions() const;
+
+    // Record how the caller kept stages within the budget other than by a
+    // path of their own, such as by running them one at a time, unless the
+    // budget is unlimited.
+    void note(const std::string &note);
+    std::vector<std::string> notes() const;
+
+    // Return the budget, each note and each decision, one per line.
+    std::string to_string() const;
+
+    static std::string path_to_string(Path path);
+    // Format a number of bytes with a binary unit, such as "1.5 GiB".
+    static std::string bytes_to_string(uint64_t bytes);
+
+ private:
+    MemoryBudget(const MemoryBudget &other) = delete;
+    MemoryBudget &operator=(const MemoryBudget &other) = delete;
+
+    // Zero for an unlimited budget.
+    uint64_t max_bytes_;
+    mutable std::mutex decisions_mutex_;
+    std::vector<Decision> decisions_;
+    std::vector<std::string> notes_;
+};
+}  // namespace palette
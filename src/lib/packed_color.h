@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include <Magick++.h>
+
+namespace palette {
+
+// An RGB color stored as three channels of type Channel, which is uint8_t,
+// uint16_t or float. Integer channels span their whole range and float
+// channels span [0, 1]. Unlike Color, it is trivially copyable and holds
+// no Magick::Color, so vectors of it are contiguous and small; convert to
+// and from Magick::Color only where ImageMagick is called.
+template <typename Channel>
+struct PackedColor {
+    static_assert(std::is_same<Channel, uint8_t>::value
+                  || std::is_same<Channel, uint16_t>::value
+                  || std::is_same<Channel, float>::value,
+                  "Channel must be uint8_t, uint16_t or float");
+
+    // Value of a channel at full intensity.
+    static constexpr double channel_max =
+        std::is_floating_point<Channel>::value
+        ? 1.0 : static_cast<double>(std::numeric_limits<Channel>::max());
+
+    // Convert one channel value in [0, 1] to this depth, rounding to the
+    // nearest value and clamping out of range values.
+    static constexpr Channel from_unit(double value) {
+        const double clamped =
+            (value < 0.0) ? 0.0 : ((value > 1.0) ? 1.0 : value);
+        return std::is_floating_point<Channel>::value
+            ? static_cast<Channel>(clamped)
+            : static_cast<Channel>((clamped * channel_max) + 0.5);
+    }
+
+    // Convert one channel value of this depth to [0, 1].
+    static constexpr double to_unit(Channel value) {
+        return static_cast<double>(value) / channel_max;
+    }
+
+    // Convert from 8 bits per channel packed as 0xRRGGBB.
+    static constexpr PackedColor from_rgb24(uint32_t rgb) {
+        return PackedColor{from_unit(((rgb >> 16) & 0xFF) / 255.0),
+                           from_unit(((rgb >> 8) & 0xFF) / 255.0),
+                           from_unit((rgb & 0xFF) / 255.0)};
+    }
+
+    // Convert to 8 bits per channel packed as 0xRRGGBB.
+    constexpr uint32_t to_rgb24() const {
+        const PackedColor<uint8_t> color = to<uint8_t>();
+        return (static_cast<uint32_t>(color.red_) << 16)
+            | (static_cast<uint32_t>(color.green_) << 8)
+            | static_cast<uint32_t>(color.blue_);
+    }
+
+    // Convert to another channel depth.
+    template <typename Other>
+    constexpr PackedColor<Other> to() const {
+        return PackedColor<Other>{
+            PackedColor<Other>::from_unit(to_unit(red_)),
+            PackedColor<Other>::from_unit(to_unit(green_)),
+            PackedColor<Other>::from_unit(to_unit(blue_))};
+    }
+
+    // Convert from the quanta of an ImageMagick color, which span
+    // [0, QuantumRange] whatever the quantum depth of the build.
+    static PackedColor from_magick(const Magick::Color &color) {
+        return PackedColor{
+            from_unit(color.quantumRed() / MagickCore::QuantumRange),
+            from_unit(color.quantumGreen() / MagickCore::QuantumRange),
+            from_unit(color.quantumBlue() / MagickCore::QuantumRange)};
+    }
+
+    Magick::Color to_magick() const {
+        return Magick::Color(
+            static_cast<Magick::Quantum>(
+                to_unit(red_) * MagickCore::QuantumRange),
+            static_cast<Magick::Quantum>(
+                to_unit(green_) * MagickCore::QuantumRange),
+            static_cast<Magick::Quantum>(
+                to_unit(blue_) * MagickCore::QuantumRange));
+    }
+
+    constexpr bool operator==(const PackedColor &other) const {
+        return (red_ == other.red_) && (green_ == other.green_)
+            && (blue_ == other.blue_);
+    }
+
+    constexpr bool operator!=(const PackedColor &other) const {
+        return !(*this == other);
+    }
+
+    // Order by red, then green, then blue.
+    constexpr bool operator<(const PackedColor &other) const {
+        return (red_ != other.red_) ? (red_ < other.red_)
+            : ((green_ != other.green_) ? (green_ < other.green_)
+                                        : (blue_ < other.blue_));
+    }
+
+    Channel red_;
+    Channel green_;
+    Channel blue_;
+};
+
+using PackedColor8 = PackedColor<uint8_t>;
+using PackedColor16 = PackedColor<uint16_t>;
+using PackedColorFloat = PackedColor<float>;
+
+// The packed color that holds a quantum of the ImageMagick build without
+// loss: float when it is built with HDRI, whose quanta are fractional, and
+// otherwise the smallest integer channel of at least the quantum depth.
+#if defined(MAGICKCORE_HDRI_ENABLE) && MAGICKCORE_HDRI_ENABLE
+using QuantumPackedColor = PackedColorFloat;
+#elif MAGICKCORE_QUANTUM_DEPTH <= 8
+using QuantumPackedColor = PackedColor8;
+#elif MAGICKCORE_QUANTUM_DEPTH <= 16
+using QuantumPackedColor = PackedColor16;
+#else
+using QuantumPackedColor = PackedColorFloat;
+#endif
+
+static_assert(std::is_trivially_copyable<PackedColor8>::value
+              && (sizeof(PackedColor8) == 3),
+              "PackedColor8 must be three bytes");
+static_assert(std::is_trivially_copyable<PackedColor16>::value
+              && (sizeof(PackedColor16) == 6),
+              "PackedColor16 must be six bytes");
+static_assert(PackedColor8::from_rgb24(0x12ABEF).to_rgb24() == 0x12ABEF,
+              "rgb24 round trip must be exact");
+static_assert(PackedColor8::from_rgb24(0x12ABEF).to<uint16_t>().red_
+              == 0x1212,
+              "8-bit channels must widen by replication");
+}  // namespace palette
@@ -0,0 +1,477 @@
+#include "lib/palette_dictionary.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <Magick++.h>
+
+#include "lib/binary_palette_format.h"
+#include "lib/color.h"
+#include "lib/color_vector.h"
+#include "lib/mapped_palette.h"
+#include "lib/palette_format.h"
+
+namespace palette {
+namespace {
+
+namespace bpt = boost::property_tree;
+
+uint64_t align_offset(uint64_t offset) { return (offset + 7) & ~uint64_t(7); }
+
+// Write zero bytes until the stream position reaches the given offset.
+void pad_to(std::ofstream &out, uint64_t &position, uint64_t offset) {
+    static const char zeros[8] = { };
+    out.write(zeros, static_cast<std::streamsize>(offset - position));
+    position = offset;
+}
+}  // namespace
+
+PaletteDictionary::PaletteDictionary() :
+    name_(),
+    comment_(),
+    colors_(),
+    color_names_(),
+    color_keywords_(),
+    color_comments_() { }
+
+PaletteDictionary::PaletteDictionary(const PaletteDictionary &other) :
+    name_(other.name_),
+    comment_(other.comment_),
+    colors_(other.colors_),
+    color_names_(other.color_names_),
+    color_keywords_(other.color_keywords_),
+    color_comments_(other.color_comments_) { }
+
+PaletteDictionary::PaletteDictionary(PaletteDictionary &&other) :
+    name_(std::move(other.name_)),
+    comment_(std::move(other.comment_)),
+    colors_(std::move(other.colors_)),
+    color_names_(std::move(other.color_names_)),
+    color_keywords_(std::move(other.color_keywords_)),
+    color_comments_(std::move(other.color_comments_)) { }
+
+PaletteDictionary &PaletteDictionary::operator=(
+    const PaletteDictionary &other) {
+    name_ = other.name_;
+    comment_ = other.comment_;
+    colors_ = other.colors_;
+    color_names_ = other.color_names_;
+    color_keywords_ = other.color_keywords_;
+    color_comments_ = other.color_comments_;
+    return *this;
+}
+
+PaletteDictionary &PaletteDictionary::operator=(PaletteDictionary &&other) {
+    name_ = std::move(other.name_);
+    comment_ = std::move(other.comment_);
+    colors_ = std::move(other.colors_);
+    color_names_ = std::move(other.color_names_);
+    color_keywords_ = std::move(other.color_keywords_);
+    color_comments_ = std::move(other.color_comments_);
+    return *this;
+}
+
+std::string &PaletteDictionary::get_name() { return name_; }
+
+const std::string &PaletteDictionary::get_name() const { return name_; }
+
+std::string &PaletteDictionary::get_comment() { return comment_; }
+
+const std::string &PaletteDictionary::get_comment() const { return comment_; }
+
+ColorVector &PaletteDictionary::get_colors() { return colors_; }
+
+const ColorVector &PaletteDictionary::get_colors() const { return colors_; }
+
+std::vector<std::string> &PaletteDictionary::get_color_names() {
+    return color_names_;
+}
+
+const std::vector<std::string> &PaletteDictionary::get_color_names() const {
+    return color_names_;
+}
+
+std::vector<std::string> &PaletteDictionary::get_color_keywords() {
+    return color_keywords_;
+}
+
+const std::vector<std::string> &PaletteDictionary::get_color_keywords() const {
+    return color_keywords_;
+}
+
+std::vector<std::string> &PaletteDictionary::get_color_comments() {
+    return color_comments_;
+}
+
+const std::vector<std::string> &PaletteDictionary::get_color_comments() const {
+    return color_comments_;
+}
+
+// Guess the format of a palette file from its first bytes: binary palettes
+// begin with a magic string, JSON palettes begin with an object, and
+// anything else is treated as a list of colors.
+PaletteFormat PaletteDictionary::detect_format(const std::string &file_name) {
+    std::ifstream in(file_name, std::ios::binary);
+    unsigned char magic[sizeof(BinaryPaletteHeader::magic_string)] = { };
+    in.read(reinterpret_cast<char *>(magic), sizeof(magic));
+    if (!in) {
+        return PaletteFormat(in.gcount() > 0
+                             ? PaletteFormat::Value::hex
+                             : PaletteFormat::Value::unknown);
+    }
+    if (MappedPalette::has_magic(magic, sizeof(magic))) {
+        return PaletteFormat(PaletteFormat::Value::binary);
+    }
+    in.seekg(0);
+    char first_char = '\0';
+    in >> first_char;
+    return PaletteFormat((first_char == '{')
+                         ? PaletteFormat::Value::json
+                         : PaletteFormat::Value::hex);
+}
+
+// Read a palette file of any supported format. Return whether or not
+// reading was successful.
+bool PaletteDictionary::read(const std::string &file_name,
+                             std::stringstream &error_stream) {
+    const PaletteFormat format = detect_format(file_name);
+    switch (format.get()) {
+        case PaletteFormat::Value::json:
+            return read_json(file_name, error_stream);
+        case PaletteFormat::Value::binary:
+            return read_binary(file_name, error_stream);
+        case PaletteFormat::Value::hex:
+            return read_hex(file_name, error_stream);
+        default: break;
+    }
+    error_stream << "Failed to read palette from " << file_name << std::endl;
+    return false;
+}
+
+// Write the palette in the given format. Return whether or not writing was
+// successful.
+bool PaletteDictionary::write(const std::string &file_name,
+                              const PaletteFormat &format,
+                              std::stringstream &error_stream) const {
+    switch (format.get()) {
+        case PaletteFormat::Value::json:
+            return write_json(file_name, error_stream);
+        case PaletteFormat::Value::binary:
+            return write_binary(file_name, error_stream);
+        case PaletteFormat::Value::hex:
+            return write_hex(file_name, error_stream);
+        default: break;
+    }
+    error_stream << "Unknown palette format" << std::endl;
+    return false;
+}
+
+// Read a palette in the JSON layout of resources/palettes. A multi-line
+// palette comment is stored as an array of lines. Return whether or not
+// reading was successful.
+bool PaletteDictionary::read_json(const std::string &file_name,
+                                  std::stringstream &error_stream) {
+    PaletteDictionary result;
+    try {
+        bpt::ptree root;
+        bpt::read_json(file_name, root);
+        const bpt::ptree &palette_tree = root.get_child("palette");
+        result.name_ = palette_tree.get<std::string>("name", "");
+        const auto comment_tree = palette_tree.get_child_optional("comment");
+        if (comment_tree && comment_tree->empty()) {
+            result.comment_ = comment_tree->data();
+        } else if (comment_tree) {
+            bool first_line = true;
+            for (const auto &line : *comment_tree) {
+                result.comment_ += (first_line ? "" : "\n");
+                result.comment_ += line.second.data();
+                first_line = false;
+            }
+        }
+
+        bool any_names = false;
+        bool any_keywords = false;
+        bool any_comments = false;
+        for (const auto &entry : palette_tree.get_child("colors")) {
+            const bpt::ptree &color_tree = entry.second;
+            const std::string value = color_tree.get<std::string>("value");
+            try {
+                result.colors_.get().emplace_back(Magick::Color(value));
+            } catch (Magick::Exception &error) {
+                error_stream << "Color value \"" << value << "\" in "
+                    << file_name << " could not be interpreted as a color"
+                    << std::endl;
+                return false;
+            }
+            const auto color_name = color_tree.get_optional<std::string>(
+                "name");
+            const auto color_keyword = color_tree.get_optional<std::string>(
+                "keyword");
+            const auto color_comment = color_tree.get_optional<std::string>(
+                "comment");
+            any_names |= color_name.has_value();
+            any_keywords |= color_keyword.has_value();
+            any_comments |= color_comment.has_value();
+            result.color_names_.push_back(color_name.value_or(""));
+            result.color_keywords_.push_back(color_keyword.value_or(""));
+            result.color_comments_.push_back(color_comment.value_or(""));
+        }
+        if (!any_names) {
+            result.color_names_.clear();
+        }
+        if (!any_keywords) {
+            result.color_keywords_.clear();
+        }
+        if (!any_comments) {
+            result.color_comments_.clear();
+        }
+    } catch (bpt::ptree_error &error) {
+        error_stream << "Failed to read palette from " << file_name << ": "
+            << error.what() << std::endl;
+        return false;
+    }
+    *this = std::move(result);
+    return true;
+}
+
+// Copy a memory-mapped binary palette into this dictionary. Return whether
+// or not reading was successful.
+bool PaletteDictionary::read_binary(const std::string &file_name,
+                                    std::stringstream &error_stream) {
+    MappedPalette mapped;
+    if (!mapped.open(file_name, error_stream)) {
+        return false;
+    }
+    const size_t num_colors = mapped.size();
+    PaletteDictionary result;
+    result.name_ = std::string(mapped.palette_name());
+    result.comment_ = std::string(mapped.palette_comment());
+    result.colors_.get().reserve(num_colors);
+    for (size_t i = 0; i < num_colors; ++i) {
+        result.colors_.get().push_back(mapped.color(i));
+    }
+    const std::pair<MappedPalette::Column, std::vector<std::string> *>
+        columns[] = {
+            { BinaryPaletteHeader::name_column, &result.color_names_ },
+            { BinaryPaletteHeader::keyword_column, &result.color_keywords_ },
+            { BinaryPaletteHeader::comment_column, &result.color_comments_ }};
+    for (const auto &column : columns) {
+        if (!mapped.has_column(column.first)) {
+            continue;
+        }
+        column.second->reserve(num_colors);
+        for (size_t i = 0; i < num_colors; ++i) {
+            column.second->emplace_back(
+                mapped.column_string(column.first, i));
+        }
+    }
+    *this = std::move(result);
+    return true;
+}
+
+// Read a palette written as one color per line, ignoring blank lines. Return
+// whether or not reading was successful.
+bool PaletteDictionary::read_hex(const std::string &file_name,
+                                 std::stringstream &error_stream) {
+    std::ifstream in(file_name);
+    if (!in) {
+        error_stream << "Failed to open " << file_name << std::endl;
+        return false;
+    }
+    PaletteDictionary result;
+    std::string line;
+    while (std::getline(in, line)) {
+        const size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos) {
+            continue;
+        }
+        const size_t end = line.find_last_not_of(" \t\r");
+        const std::string value = line.substr(begin, end - begin + 1);
+        try {
+            result.colors_.get().emplace_back(Magick::Color(value));
+        } catch (Magick::Exception &error) {
+            error_stream << "Line \"" << value << "\" in " << file_name
+                << " could not be interpreted as a color" << std::endl;
+            return false;
+        }
+    }
+    *this = std::move(result);
+    return true;
+}
+
+// Write the palette in the JSON layout of resources/palettes. Return whether
+// or not writing was successful.
+bool PaletteDictionary::write_json(const std::string &file_name,
+                                   std::stringstream &error_stream) const {
+    bpt::ptree palette_tree;
+    palette_tree.put("name", name_);
+    bpt::ptree comment_tree;
+    std::istringstream comment_stream(comment_);
+    std::string comment_line;
+    while (std::getline(comment_stream, comment_line)) {
+        bpt::ptree line_tree;
+        line_tree.put_value(comment_line);
+        comment_tree.push_back(std::make_pair("", line_tree));
+    }
+    palette_tree.add_child("comment", comment_tree);
+
+    bpt::ptree colors_tree;
+    const std::vector<Color> &colors = colors_.get();
+    for (size_t i = 0; i < colors.size(); ++i) {
+        bpt::ptree color_tree;
+        if (i < color_names_.size()) {
+            color_tree.put("name", color_names_[i]);
+        }
+        if (i < color_keywords_.size()) {
+            color_tree.put("keyword", color_keywords_[i]);
+        }
+        color_tree.put("value", colors[i].to_string());
+        if (i < color_comments_.size()) {
+            color_tree.put("comment", color_comments_[i]);
+        }
+        colors_tree.push_back(std::make_pair("", color_tree));
+    }
+    palette_tree.add_child("colors", colors_tree);
+
+    bpt::ptree root;
+    root.add_child("palette", palette_tree);
+    try {
+        bpt::write_json(file_name, root);
+    } catch (bpt::ptree_error &error) {
+        error_stream << "Failed to write palette to " << file_name << ": "
+            << error.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Write the palette in the binary layout. Return whether or not writing was
+// successful.
+bool PaletteDictionary::write_binary(const std::string &file_name,
+                                     std::stringstream &error_stream) const {
+    const std::vector<Color> &colors = colors_.get();
+    const uint64_t num_colors = colors.size();
+    const std::vector<std::string> *columns[] = {
+        &color_names_, &color_keywords_, &color_comments_ };
+    static_assert(sizeof(columns) / sizeof(columns[0])
+                  == BinaryPaletteHeader::num_columns,
+                  "Every binary palette column needs a source");
+
+    // Build the string table and the offsets of each column into it.
+    std::string strings(1, '\0');
+    auto add_string = [&strings](const std::string &value) {
+        const uint64_t offset = strings.size();
+        strings.append(value);
+        strings.push_back('\0');
+        return offset;
+    };
+    BinaryPaletteHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic_, BinaryPaletteHeader::magic_string,
+                sizeof(header.magic_));
+    header.byte_order_ = BinaryPaletteHeader::byte_order_mark;
+    header.version_ = BinaryPaletteHeader::current_version;
+    header.num_colors_ = num_colors;
+    header.palette_name_offset_ = static_cast<uint32_t>(add_string(name_));
+    header.palette_comment_offset_ =
+        static_cast<uint32_t>(add_string(comment_));
+
+    std::vector<std::vector<uint32_t>> column_offsets(
+        BinaryPaletteHeader::num_columns);
+    for (uint32_t c = 0; c < BinaryPaletteHeader::num_columns; ++c) {
+        const std::vector<std::string> &column = *columns[c];
+        if (column.empty()) {
+            continue;
+        }
+        if (column.size() != num_colors) {
+            error_stream << "Palette has " << num_colors << " colors but "
+                << column.size() << " entries in a string column"
+                << std::endl;
+            return false;
+        }
+        for (const std::string &value : column) {
+            column_offsets[c].push_back(
+                static_cast<uint32_t>(add_string(value)));
+        }
+        column_offsets[c].push_back(static_cast<uint32_t>(strings.size()));
+    }
+    if (strings.size() > UINT32_MAX) {
+        error_stream << "Palette strings exceed the 4 GiB limit of the "
+            << "binary palette format" << std::endl;
+        return false;
+    }
+
+    // Lay out the sections after the header.
+    uint64_t offset = align_offset(sizeof(BinaryPaletteHeader));
+    header.colors_offset_ = offset;
+    offset = align_offset(offset + (num_colors * sizeof(uint32_t)));
+    for (uint32_t c = 0; c < BinaryPaletteHeader::num_columns; ++c) {
+        if (!column_offsets[c].empty()) {
+            header.column_offsets_[c] = offset;
+            offset = align_offset(
+                offset + (column_offsets[c].size() * sizeof(uint32_t)));
+        }
+    }
+    header.strings_offset_ = offset;
+    header.strings_size_ = strings.size();
+
+    std::vector<uint32_t> packed_colors;
+    packed_colors.reserve(num_colors);
+    for (const Color &color : colors) {
+        packed_colors.push_back(color.to_rgb24());
+    }
+
+    std::ofstream out(file_name, std::ios::binary | std::ios::trunc);
+    uint64_t position = 0;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    position += sizeof(header);
+    pad_to(out, position, header.colors_offset_);
+    out.write(reinterpret_cast<const char *>(packed_colors.data()),
+              static_cast<std::streamsize>(num_colors * sizeof(uint32_t)));
+    position += num_colors * sizeof(uint32_t);
+    for (uint32_t c = 0; c < BinaryPaletteHeader::num_columns; ++c) {
+        if (column_offsets[c].empty()) {
+            continue;
+        }
+        pad_to(out, position, header.column_offsets_[c]);
+        const size_t num_bytes = column_offsets[c].size() * sizeof(uint32_t);
+        out.write(reinterpret_cast<const char *>(column_offsets[c].data()),
+                  static_cast<std::streamsize>(num_bytes));
+        position += num_bytes;
+    }
+    pad_to(out, position, header.strings_offset_);
+    out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+    out.close();
+    if (!out) {
+        error_stream << "Failed to write palette to " << file_name
+            << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Write the palette as one color per line, discarding names and comments.
+// Return whether or not writing was successful.
+bool PaletteDictionary::write_hex(const std::string &file_name,
+                                  std::stringstream &error_stream) const {
+    std::ofstream out(file_name, std::ios::trunc);
+    if (!colors_.get().empty()) {
+        out << colors_.to_string("\n") << std::endl;
+    }
+    out.close();
+    if (!out) {
+        error_stream << "Failed to write palette to " << file_name
+            << std::endl;
+        return false;
+    }
+    return true;
+}
+}  // namespace palette
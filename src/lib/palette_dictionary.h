@@ -0,0 +1,68 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "lib/color_vector.h"
+#include "lib/palette_format.h"
+
+namespace palette {
+
+// Named collection of colors with optional per-color names, keywords, and
+// comments. Each string list is either empty or has one entry per color.
+//
+// Readable and writable as the JSON layout of resources/palettes (see
+// resources/palettes/solarized/solarized.json) and as the memory-mappable
+// binary layout described in lib/binary_palette_format.h, or as plain text
+// with one color per line.
+class PaletteDictionary {
+ public:
+    PaletteDictionary();
+    PaletteDictionary(const PaletteDictionary &other);
+    PaletteDictionary(PaletteDictionary &&other);
+
+    PaletteDictionary &operator=(const PaletteDictionary &other);
+    PaletteDictionary &operator=(PaletteDictionary &&other);
+
+    std::string &get_name();
+    const std::string &get_name() const;
+    std::string &get_comment();
+    const std::string &get_comment() const;
+    ColorVector &get_colors();
+    const ColorVector &get_colors() const;
+    std::vector<std::string> &get_color_names();
+    const std::vector<std::string> &get_color_names() const;
+    std::vector<std::string> &get_color_keywords();
+    const std::vector<std::string> &get_color_keywords() const;
+    std::vector<std::string> &get_color_comments();
+    const std::vector<std::string> &get_color_comments() const;
+
+    static PaletteFormat detect_format(const std::string &file_name);
+
+    bool read(const std::string &file_name, std::stringstream &error_stream);
+    bool write(const std::string &file_name, const PaletteFormat &format,
+               std::stringstream &error_stream) const;
+
+    bool read_json(const std::string &file_name,
+                   std::stringstream &error_stream);
+    bool read_binary(const std::string &file_name,
+                     std::stringstream &error_stream);
+    bool read_hex(const std::string &file_name,
+                  std::stringstream &error_stream);
+    bool write_json(const std::string &file_name,
+                    std::stringstream &error_stream) const;
+    bool write_binary(const std::string &file_name,
+                      std::stringstream &error_stream) const;
+    bool write_hex(const std::string &file_name,
+                   std::stringstream &error_stream) const;
+
+ private:
+    std::string name_;
+    std::string comment_;
+    ColorVector colors_;
+    std::vector<std::string> color_names_;
+    std::vector<std::string> color_keywords_;
+    std::vector<std::string> color_comments_;
+};
+}  // namespace palette
@@ -0,0 +1,153 @@
+#include "lib/palette_evaluation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "lib/color.h"
+#include "lib/color_histogram.h"
+#include "lib/color_space.h"
+#include "lib/kernels.h"
+#include "lib/packed_color.h"
+#include "lib/parallel.h"
+
+namespace palette {
+namespace {
+
+// Histogram colors are converted and measured in blocks of this many.
+const size_t block_size = 4096;
+
+// Colors converted to one space, as arrays of channels.
+struct ChannelArrays final {
+    explicit ChannelArrays(size_t num_colors);
+
+    // Convert the sRGB colors in [begin, end) of the histogram to the
+    // space, into the start of the arrays.
+    void convert(const ColorHistogram &histogram, size_t begin, size_t end,
+                 const ColorSpace &space);
+
+    std::vector<float> channel0_;
+    std::vector<float> channel1_;
+    std::vector<float> channel2_;
+};
+}  // namespace
+
+PaletteEvaluation::PaletteEvaluation(double coverage_delta_e) :
+    coverage_delta_e_(coverage_delta_e),
+    mean_delta_e_(0.0),
+    p95_delta_e_(0.0),
+    coverage_(0.0) { }
+
+PaletteEvaluation::PaletteEvaluation(const PaletteEvaluation &other) :
+    coverage_delta_e_(other.coverage_delta_e_),
+    mean_delta_e_(other.mean_delta_e_),
+    p95_delta_e_(other.p95_delta_e_),
+    coverage_(other.coverage_) { }
+
+PaletteEvaluation &PaletteEvaluation::operator=(
+    const PaletteEvaluation &other) {
+    coverage_delta_e_ = other.coverage_delta_e_;
+    mean_delta_e_ = other.mean_delta_e_;
+    p95_delta_e_ = other.p95_delta_e_;
+    coverage_ = other.coverage_;
+    return *this;
+}
+
+bool PaletteEvaluation::run(const ColorHistogram &histogram,
+                            const std::vector<Color> &palette) {
+    mean_delta_e_ = 0.0;
+    p95_delta_e_ = 0.0;
+    coverage_ = 0.0;
+    const double total_weight = histogram.total_weight();
+    if (histogram.empty() || palette.empty() || (total_weight <= 0.0)) {
+        return false;
+    }
+
+    const ColorSpace lab(ColorSpace::Value::lab);
+    ColorHistogram palette_histogram;
+    for (const Color &color : palette) {
+        palette_histogram.add(color.to_rgb24(), 1.0);
+    }
+    ChannelArrays palette_lab(palette.size());
+    palette_lab.convert(palette_histogram, 0, palette.size(), lab);
+
+    // Find the distance from every histogram color to its nearest palette
+    // color, block by block.
+    std::vector<float> delta_e(histogram.size());
+    const size_t num_blocks = (histogram.size() + block_size - 1) / block_size;
+    Parallel::run(num_blocks, [&](size_t block) {
+        const size_t begin = block * block_size;
+        const size_t end = std::min(begin + block_size, histogram.size());
+        ChannelArrays colors_lab(end - begin);
+        colors_lab.convert(histogram, begin, end, lab);
+        Kernels::get().nearest_colors(
+            colors_lab.channel0_.data(), colors_lab.channel1_.data(),
+            colors_lab.channel2_.data(), end - begin,
+            palette_lab.channel0_.data(), palette_lab.channel1_.data(),
+            palette_lab.channel2_.data(), palette.size(),
+            delta_e.data() + begin, nullptr);
+        for (size_t i = begin; i < end; ++i) {
+            delta_e[i] = std::sqrt(delta_e[i]);
+        }
+    });
+
+    std::vector<std::pair<float, double>> weighted_delta_e;
+    weighted_delta_e.reserve(histogram.size());
+    double delta_e_sum = 0.0;
+    double covered_weight = 0.0;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        const double weight = histogram.weight(i);
+        delta_e_sum += delta_e[i] * weight;
+        if (delta_e[i] <= coverage_delta_e_) {
+            covered_weight += weight;
+        }
+        weighted_delta_e.emplace_back(delta_e[i], weight);
+    }
+    mean_delta_e_ = delta_e_sum / total_weight;
+    coverage_ = covered_weight / total_weight;
+
+    // The 95th percentile is the smallest distance that at least 95% of the
+    // pixel weight does not exceed.
+    std::sort(weighted_delta_e.begin(), weighted_delta_e.end());
+    double cumulative_weight = 0.0;
+    for (const auto &entry : weighted_delta_e) {
+        cumulative_weight += entry.second;
+        p95_delta_e_ = entry.first;
+        if (cumulative_weight >= 0.95 * total_weight) {
+            break;
+        }
+    }
+    return true;
+}
+
+double PaletteEvaluation::get_mean_delta_e() const { return mean_delta_e_; }
+
+double PaletteEvaluation::get_p95_delta_e() const { return p95_delta_e_; }
+
+double PaletteEvaluation::get_coverage() const { return coverage_; }
+
+namespace {
+
+ChannelArrays::ChannelArrays(size_t num_colors) :
+    channel0_(num_colors),
+    channel1_(num_colors),
+    channel2_(num_colors) { }
+
+void ChannelArrays::convert(const ColorHistogram &histogram, size_t begin,
+                            size_t end, const ColorSpace &space) {
+    for (size_t i = begin; i < end; ++i) {
+        const PackedColorFloat color =
+            PackedColor8::from_rgb24(histogram.rgb24(i)).to<float>();
+        channel0_[i - begin] = color.red_;
+        channel1_[i - begin] = color.green_;
+        channel2_[i - begin] = color.blue_;
+    }
+    const size_t num_colors = end - begin;
+    space.from_rgb(num_colors, channel0_.data(), channel1_.data(),
+                   channel2_.data(), channel0_.data(), channel1_.data(),
+                   channel2_.data());
+}
+}  // namespace
+}  // namespace palette
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace palette {
+
+class Color;
+class ColorHistogram;
+
+// Measures how faithfully a palette reproduces the pixels of an image: the
+// Delta E (1976) in CIELAB from each pixel to its nearest palette color,
+// as a mean and a 95th percentile over the pixels, and the share of the
+// pixels that lie close to some palette color.
+class PaletteEvaluation {
+ public:
+    // Pixels within this Delta E of a palette color count as covered.
+    static constexpr double default_coverage_delta_e = 10.0;
+
+    explicit PaletteEvaluation(double coverage_delta_e);
+    PaletteEvaluation(const PaletteEvaluation &other);
+
+    PaletteEvaluation &operator=(const PaletteEvaluation &other);
+
+    // Evaluate the palette against the weighted colors of the histogram.
+    // Parts of the histogram are measured in parallel. Return whether or
+    // not both the histogram and the palette have colors.
+    bool run(const ColorHistogram &histogram,
+             const std::vector<Color> &palette);
+
+    double get_mean_delta_e() const;
+    double get_p95_delta_e() const;
+
+    // Return the share of pixel weight within the coverage Delta E of its
+    // nearest palette color, in [0, 1].
+    double get_coverage() const;
+
+ private:
+    double coverage_delta_e_;
+    double mean_delta_e_;
+    double p95_delta_e_;
+    double coverage_;
+};
+}  // namespace palette
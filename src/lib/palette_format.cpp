@@ -0,0 +1,46 @@
+#include "lib/palette_format.h"
+
+#include <string>
+
+namespace palette {
+
+PaletteFormat::PaletteFormat(Value value) : value_(value) { }
+
+PaletteFormat::PaletteFormat(const std::string &value_str) :
+    value_(value_from_string(value_str)) { }
+
+PaletteFormat::PaletteFormat(const PaletteFormat &other) :
+    value_(other.value_) { }
+
+PaletteFormat::Value PaletteFormat::get() const { return value_; }
+
+bool PaletteFormat::valid() const { return value_ != Value::unknown; }
+
+std::string PaletteFormat::to_string() const {
+    return value_to_string(value_);
+}
+
+PaletteFormat::Value PaletteFormat::value_from_string(
+    const std::string &value_str) {
+    if (value_str.compare(value_to_string(Value::json)) == 0) {
+        return Value::json;
+    }
+    if (value_str.compare(value_to_string(Value::binary)) == 0) {
+        return Value::binary;
+    }
+    if (value_str.compare(value_to_string(Value::hex)) == 0) {
+        return Value::hex;
+    }
+    return Value::unknown;
+}
+
+std::string PaletteFormat::value_to_string(const Value value) {
+    switch (value) {
+        case PaletteFormat::Value::json: return "json";
+        case PaletteFormat::Value::binary: return "binary";
+        case PaletteFormat::Value::hex: return "hex";
+        default: break;
+    }
+    return "unknown";
+}
+}  // namespace palette
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+namespace palette {
+
+class PaletteFormat {
+ public:
+    enum class Value { json, binary, hex, unknown };
+
+    explicit PaletteFormat(Value value);
+    explicit PaletteFormat(const std::string &value_str);
+    PaletteFormat(const PaletteFormat &other);
+
+    Value get() const;
+    bool valid() const;
+    std::string to_string() const;
+
+    static Value value_from_string(const std::string &value_str);
+    static std::string value_to_string(const Value value);
+
+ private:
+    Value value_;
+};
+}  // namespace palette
@@ -0,0 +1,231 @@
+#include "lib/palette_index_builder.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "lib/color.h"
+#include "lib/palette_index_format.h"
+#include "lib/palette_signature.h"
+
+namespace palette {
+namespace {
+
+uint64_t align_offset(uint64_t offset);
+void pad_to(std::ofstream &out, uint64_t &position, uint64_t offset);
+
+template <typename T>
+void write_section(std::ofstream &out, uint64_t &position, uint64_t offset,
+                   const std::vector<T> &values);
+}  // namespace
+
+PaletteIndexBuilder::PaletteIndexBuilder() :
+    PaletteIndexBuilder(default_seed) { }
+
+PaletteIndexBuilder::PaletteIndexBuilder(uint64_t seed) :
+    seed_(seed),
+    names_(),
+    palette_offsets_(1, 0),
+    colors_(),
+    signatures_() { }
+
+PaletteIndexBuilder::PaletteIndexBuilder(const PaletteIndexBuilder &other) :
+    seed_(other.seed_),
+    names_(other.names_),
+    palette_offsets_(other.palette_offsets_),
+    colors_(other.colors_),
+    signatures_(other.signatures_) { }
+
+PaletteIndexBuilder &PaletteIndexBuilder::operator=(
+    const PaletteIndexBuilder &other) {
+    seed_ = other.seed_;
+    names_ = other.names_;
+    palette_offsets_ = other.palette_offsets_;
+    colors_ = other.colors_;
+    signatures_ = other.signatures_;
+    return *this;
+}
+
+void PaletteIndexBuilder::add(const std::string &name,
+                              const std::vector<Color> &colors) {
+    names_.push_back(name);
+    for (const Color &color : colors) {
+        colors_.push_back(color.to_rgb24());
+    }
+    palette_offsets_.push_back(static_cast<uint32_t>(colors_.size()));
+    signatures_.push_back(PaletteSignature::compute(colors));
+}
+
+size_t PaletteIndexBuilder::size() const { return names_.size(); }
+
+// Hash the signatures, bucket them by band, and write the index file.
+// Return whether or not the file was written.
+bool PaletteIndexBuilder::write(const std::string &file_name,
+                                std::stringstream &error_stream) const {
+    const size_t num_entries = names_.size();
+    if ((num_entries > UINT32_MAX) || (colors_.size() > UINT32_MAX)) {
+        error_stream << "Palettes exceed the 4 Gi entry limit of the "
+            << "palette index format" << std::endl;
+        return false;
+    }
+
+    std::string strings;
+    std::vector<uint32_t> name_offsets;
+    name_offsets.reserve(num_entries + 1);
+    for (const std::string &name : names_) {
+        name_offsets.push_back(static_cast<uint32_t>(strings.size()));
+        strings.append(name);
+        strings.push_back('\0');
+        if (strings.size() > UINT32_MAX) {
+            error_stream << "Palette names exceed the 4 GiB limit of the "
+                << "palette index format" << std::endl;
+            return false;
+        }
+    }
+    name_offsets.push_back(static_cast<uint32_t>(strings.size()));
+
+    // Hyperplanes through the mean signature, with normals drawn from a
+    // Gaussian so their directions are uniform. They are stored in the
+    // file, so queries hash the same way wherever the index was built.
+    const size_t signature_size = PaletteSignature::size;
+    std::vector<float> hyperplanes(
+        (PaletteSignature::hash_bits + 1) * signature_size, 0.0f);
+    std::mt19937_64 generator(seed_);
+    std::normal_distribution<float> normal;
+    for (size_t n = 0; n < (PaletteSignature::hash_bits * signature_size);
+         ++n) {
+        hyperplanes[n] = normal(generator);
+    }
+    float *center =
+        hyperplanes.data() + (PaletteSignature::hash_bits * signature_size);
+    std::vector<uint8_t> signatures;
+    signatures.reserve(num_entries * signature_size);
+    std::vector<double> sums(signature_size, 0.0);
+    for (const PaletteSignature::Value &signature : signatures_) {
+        float values[PaletteSignature::size];
+        PaletteSignature::to_floats(signature.data(), values);
+        for (size_t n = 0; n < signature_size; ++n) {
+            sums[n] += values[n];
+        }
+        signatures.insert(signatures.end(), signature.begin(),
+                          signature.end());
+    }
+    for (size_t n = 0; (num_entries > 0) && (n < signature_size); ++n) {
+        center[n] = static_cast<float>(sums[n] / num_entries);
+    }
+
+    std::vector<uint64_t> hashes(num_entries);
+    for (size_t i = 0; i < num_entries; ++i) {
+        hashes[i] = PaletteSignature::hash(signatures_[i].data(),
+                                           hyperplanes.data(), center);
+    }
+
+    // Counting sort of the entries by each band's bits.
+    const size_t num_buckets = size_t(1) << band_bits;
+    const uint64_t band_mask = num_buckets - 1;
+    std::vector<uint32_t> buckets(num_bands * (num_buckets + 1), 0);
+    std::vector<uint32_t> postings(num_bands * num_entries);
+    for (uint32_t band = 0; band < num_bands; ++band) {
+        uint32_t *band_buckets = buckets.data() + (band * (num_buckets + 1));
+        uint32_t *band_postings = postings.data() + (band * num_entries);
+        const uint32_t shift = band * band_bits;
+        for (uint64_t hash : hashes) {
+            ++band_buckets[((hash >> shift) & band_mask) + 1];
+        }
+        for (size_t b = 0; b < num_buckets; ++b) {
+            band_buckets[b + 1] += band_buckets[b];
+        }
+        std::vector<uint32_t> next(band_buckets, band_buckets + num_buckets);
+        for (size_t i = 0; i < num_entries; ++i) {
+            const size_t bucket = (hashes[i] >> shift) & band_mask;
+            band_postings[next[bucket]++] = static_cast<uint32_t>(i);
+        }
+    }
+
+    PaletteIndexHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic_, PaletteIndexHeader::magic_string,
+                sizeof(header.magic_));
+    header.byte_order_ = PaletteIndexHeader::byte_order_mark;
+    header.version_ = PaletteIndexHeader::current_version;
+    header.num_entries_ = num_entries;
+    header.num_colors_ = colors_.size();
+    header.signature_size_ = static_cast<uint32_t>(signature_size);
+    header.hash_bits_ = static_cast<uint32_t>(PaletteSignature::hash_bits);
+    header.num_bands_ = num_bands;
+    header.band_bits_ = band_bits;
+
+    // Lay out the sections after the header.
+    uint64_t offset = align_offset(sizeof(PaletteIndexHeader));
+    header.hyperplanes_offset_ = offset;
+    offset = align_offset(offset + (hyperplanes.size() * sizeof(float)));
+    header.signatures_offset_ = offset;
+    offset = align_offset(offset + signatures.size());
+    header.hashes_offset_ = offset;
+    offset = align_offset(offset + (hashes.size() * sizeof(uint64_t)));
+    header.buckets_offset_ = offset;
+    offset = align_offset(offset + (buckets.size() * sizeof(uint32_t)));
+    header.postings_offset_ = offset;
+    offset = align_offset(offset + (postings.size() * sizeof(uint32_t)));
+    header.palette_offsets_offset_ = offset;
+    offset = align_offset(
+        offset + (palette_offsets_.size() * sizeof(uint32_t)));
+    header.colors_offset_ = offset;
+    offset = align_offset(offset + (colors_.size() * sizeof(uint32_t)));
+    header.name_offsets_offset_ = offset;
+    offset = align_offset(offset + (name_offsets.size() * sizeof(uint32_t)));
+    header.strings_offset_ = offset;
+    header.strings_size_ = strings.size();
+
+    std::ofstream out(file_name, std::ios::binary | std::ios::trunc);
+    uint64_t position = 0;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    position += sizeof(header);
+    write_section(out, position, header.hyperplanes_offset_, hyperplanes);
+    write_section(out, position, header.signatures_offset_, signatures);
+    write_section(out, position, header.hashes_offset_, hashes);
+    write_section(out, position, header.buckets_offset_, buckets);
+    write_section(out, position, header.postings_offset_, postings);
+    write_section(out, position, header.palette_offsets_offset_,
+                  palette_offsets_);
+    write_section(out, position, header.colors_offset_, colors_);
+    write_section(out, position, header.name_offsets_offset_, name_offsets);
+    pad_to(out, position, header.strings_offset_);
+    out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+    out.close();
+    if (!out) {
+        error_stream << "Failed to write palette index to " << file_name
+            << std::endl;
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+uint64_t align_offset(uint64_t offset) { return (offset + 7) & ~uint64_t(7); }
+
+// Write zero bytes until the stream position reaches the given offset.
+void pad_to(std::ofstream &out, uint64_t &position, uint64_t offset) {
+    static const char zeros[8] = { };
+    out.write(zeros, static_cast<std::streamsize>(offset - position));
+    position = offset;
+}
+
+// Write the values as a section beginning at the given offset.
+template <typename T>
+void write_section(std::ofstream &out, uint64_t &position, uint64_t offset,
+                   const std::vector<T> &values) {
+    pad_to(out, position, offset);
+    const size_t num_bytes = values.size() * sizeof(T);
+    out.write(reinterpret_cast<const char *>(values.data()),
+              static_cast<std::streamsize>(num_bytes));
+    position += num_bytes;
+}
+}  // namespace
+}  // namespace palette
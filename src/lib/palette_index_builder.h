@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "lib/palette_signature.h"
+
+namespace palette {
+
+class Color;
+
+// Collects named palettes and writes them to a palette index file (see
+// palette_index_format.h) that MappedPaletteIndex queries in place.
+//
+// Each palette is reduced to a PaletteSignature when it is added. When the
+// file is written, every signature is hashed with random hyperplanes
+// (SimHash), so that the probability of two signatures agreeing in a bit
+// grows with their similarity, and the hashes are split into bands whose
+// buckets list the entries sharing those bits.
+class PaletteIndexBuilder {
+ public:
+    // How the bits of a signature's hash are split into bands.
+    static constexpr uint32_t num_bands = 4;
+    static constexpr uint32_t band_bits =
+        PaletteSignature::hash_bits / num_bands;
+
+    static constexpr uint64_t default_seed = 1;
+
+    PaletteIndexBuilder();
+    explicit PaletteIndexBuilder(uint64_t seed);
+    PaletteIndexBuilder(const PaletteIndexBuilder &other);
+
+    PaletteIndexBuilder &operator=(const PaletteIndexBuilder &other);
+
+    // Add a palette of colors of equal weight under the given name.
+    void add(const std::string &name, const std::vector<Color> &colors);
+
+    size_t size() const;
+
+    bool write(const std::string &file_name,
+               std::stringstream &error_stream) const;
+
+ private:
+    uint64_t seed_;
+    std::vector<std::string> names_;
+    std::vector<uint32_t> palette_offsets_;
+    std::vector<uint32_t> colors_;
+    std::vector<PaletteSignature::Value> signatures_;
+};
+}  // namespace palette
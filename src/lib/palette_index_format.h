@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+namespace palette {
+
+// On-disk layout of a palette index file, designed to be memory-mapped and
+// queried in place. All integers are stored in host byte order, which
+// readers verify through byte_order_. Every section begins on an 8-byte
+// boundary.
+//
+//   header            PaletteIndexHeader
+//   hyperplanes       float[hash_bits_][signature_size_], then the
+//                     float[signature_size_] center subtracted from
+//                     signatures before they are hashed
+//   signatures        uint8_t[num_entries_][signature_size_]
+//   hashes            uint64_t[num_entries_]
+//   buckets           for each band, uint32_t[2^band_bits_ + 1] offsets
+//                     into the band's postings; bucket b of a band spans
+//                     [offset[b], offset[b + 1])
+//   postings          for each band, uint32_t[num_entries_] entry indices
+//                     ordered by the band's bits of their hashes
+//   palette offsets   uint32_t[num_entries_ + 1] offsets into the colors;
+//                     palette i spans [offset[i], offset[i + 1])
+//   colors            uint32_t[num_colors_], each packed as 0x00RRGGBB
+//   name offsets      uint32_t[num_entries_ + 1] offsets into the string
+//                     table; name i spans [offset[i], offset[i + 1] - 1)
+//                     and is NUL-terminated
+//   strings           string table
+struct PaletteIndexHeader final {
+    static constexpr char magic_string[8] = {
+        'P', 'A', 'L', 'I', 'N', 'D', 'E', 'X' };
+    static constexpr uint32_t byte_order_mark = 0x01020304;
+    static constexpr uint32_t current_version = 1;
+
+    char magic_[8];
+    uint32_t byte_order_;
+    uint32_t version_;
+    uint64_t num_entries_;
+    uint64_t num_colors_;
+    uint32_t signature_size_;
+    uint32_t hash_bits_;
+    uint32_t num_bands_;
+    uint32_t band_bits_;
+    uint64_t hyperplanes_offset_;
+    uint64_t signatures_offset_;
+    uint64_t hashes_offset_;
+    uint64_t buckets_offset_;
+    uint64_t postings_offset_;
+    uint64_t palette_offsets_offset_;
+    uint64_t colors_offset_;
+    uint64_t name_offsets_offset_;
+    uint64_t strings_offset_;
+    uint64_t strings_size_;
+};
+
+static_assert(sizeof(PaletteIndexHeader) == 128,
+              "Palette index header layout changed");
+}  // namespace palette
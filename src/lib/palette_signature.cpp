@@ -0,0 +1,148 @@
+#include "lib/palette_signature.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "lib/color.h"
+#include "lib/color_space.h"
+#include "lib/kernels.h"
+#include "lib/packed_color.h"
+
+namespace palette {
+namespace {
+
+// CIELAB bounds spanned by the grid. Chroma channels beyond them, which
+// only the most saturated sRGB colors reach, are clamped to the outer
+// nodes.
+const float min_lightness = 0.0f;
+const float max_lightness = 100.0f;
+const float min_chroma = -80.0f;
+const float max_chroma = 80.0f;
+
+// Scale of a signature byte holding a unit value.
+const double byte_scale = 255.0;
+
+float grid_coordinate(float value, float min_value, float max_value);
+}  // namespace
+
+PaletteSignature::Value PaletteSignature::compute(
+    const std::vector<Color> &colors) {
+    return compute(colors, std::vector<double>(colors.size(), 1.0));
+}
+
+PaletteSignature::Value PaletteSignature::compute(
+    const std::vector<Color> &colors, const std::vector<double> &weights) {
+    Value signature = { };
+    const size_t num_colors = std::min(colors.size(), weights.size());
+    if (num_colors == 0) {
+        return signature;
+    }
+
+    std::vector<float> lightness(num_colors);
+    std::vector<float> green_red(num_colors);
+    std::vector<float> blue_yellow(num_colors);
+    for (size_t i = 0; i < num_colors; ++i) {
+        const PackedColorFloat color =
+            PackedColorFloat::from_magick(colors[i].get());
+        lightness[i] = color.red_;
+        green_red[i] = color.green_;
+        blue_yellow[i] = color.blue_;
+    }
+    ColorSpace(ColorSpace::Value::lab).from_rgb(
+        num_colors, lightness.data(), green_red.data(), blue_yellow.data(),
+        lightness.data(), green_red.data(), blue_yellow.data());
+
+    // Spread each color's weight over the eight nodes around it.
+    double histogram[size] = { };
+    double total_weight = 0.0;
+    for (size_t i = 0; i < num_colors; ++i) {
+        const double weight = weights[i];
+        if (!(weight > 0.0)) {
+            continue;
+        }
+        total_weight += weight;
+        const float coordinates[3] = {
+            grid_coordinate(lightness[i], min_lightness, max_lightness),
+            grid_coordinate(green_red[i], min_chroma, max_chroma),
+            grid_coordinate(blue_yellow[i], min_chroma, max_chroma) };
+        size_t low[3];
+        float fraction[3];
+        for (size_t c = 0; c < 3; ++c) {
+            low[c] = std::min(static_cast<size_t>(coordinates[c]),
+                              grid_size - 2);
+            fraction[c] = coordinates[c] - static_cast<float>(low[c]);
+        }
+        for (size_t corner = 0; corner < 8; ++corner) {
+            size_t node = 0;
+            double corner_weight = weight;
+            for (size_t c = 0; c < 3; ++c) {
+                const bool high = ((corner >> c) & 1) != 0;
+                node = (node * grid_size) + low[c] + (high ? 1 : 0);
+                corner_weight *= high ? fraction[c] : (1.0f - fraction[c]);
+            }
+            histogram[node] += corner_weight;
+        }
+    }
+    if (total_weight <= 0.0) {
+        return signature;
+    }
+    for (size_t n = 0; n < size; ++n) {
+        const double value = std::sqrt(histogram[n] / total_weight);
+        signature[n] = static_cast<uint8_t>(
+            std::min(byte_scale, (value * byte_scale) + 0.5));
+    }
+    return signature;
+}
+
+uint32_t PaletteSignature::dot(const uint8_t *a, const uint8_t *b) {
+    return Kernels::get().dot_u8(a, b, size);
+}
+
+double PaletteSignature::similarity(const uint8_t *a, const uint8_t *b) {
+    // Rounding each node can push the dot product of a signature with
+    // itself slightly past the square of the byte scale.
+    return std::min(1.0, dot(a, b) / (byte_scale * byte_scale));
+}
+
+void PaletteSignature::to_floats(const uint8_t *signature, float *values) {
+    for (size_t n = 0; n < size; ++n) {
+        values[n] = static_cast<float>(signature[n] / byte_scale);
+    }
+}
+
+uint64_t PaletteSignature::hash(const uint8_t *signature,
+                               const float *hyperplanes,
+                               const float *center) {
+    float values[size];
+    to_floats(signature, values);
+    for (size_t n = 0; n < size; ++n) {
+        values[n] -= center[n];
+    }
+    uint64_t bits = 0;
+    for (size_t p = 0; p < hash_bits; ++p) {
+        const float *normal = hyperplanes + (p * size);
+        float projection = 0.0f;
+        for (size_t n = 0; n < size; ++n) {
+            projection += normal[n] * values[n];
+        }
+        if (projection >= 0.0f) {
+            bits |= uint64_t(1) << p;
+        }
+    }
+    return bits;
+}
+
+namespace {
+
+// Map a channel value to a coordinate in [0, grid_size - 1] along an axis
+// of the grid.
+float grid_coordinate(float value, float min_value, float max_value) {
+    const float unit = (value - min_value) / (max_value - min_value);
+    const float clamped = std::min(1.0f, std::max(0.0f, unit));
+    return clamped * static_cast<float>(PaletteSignature::grid_size - 1);
+}
+}  // namespace
+}  // namespace palette
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace palette {
+
+class Color;
+
+// Fixed-length signature of a palette for similarity search. The colors
+// of the palette are converted to CIELAB and spread with trilinear weights
+// over the nodes of a coarse 4x4x4 grid, so that close colors in
+// neighboring cells still share nodes. The square root of each node's
+// share of the total weight is stored in a byte, which makes a signature a
+// unit vector whose dot product with another signature is the
+// Bhattacharyya coefficient of the two grid histograms: 1 for palettes
+// that spread the same way over the grid, and 0 for palettes with no
+// nearby colors.
+class PaletteSignature {
+ public:
+    static constexpr size_t grid_size = 4;
+    static constexpr size_t size = grid_size * grid_size * grid_size;
+    static constexpr size_t hash_bits = 64;
+
+    using Value = std::array<uint8_t, size>;
+
+    // Compute the signature of colors of equal weight.
+    static Value compute(const std::vector<Color> &colors);
+
+    // Compute the signature of colors weighed by the corresponding
+    // weights, which must be as many as the colors. Return an all-zero
+    // signature if there are no colors or no positive weights.
+    static Value compute(const std::vector<Color> &colors,
+                         const std::vector<double> &weights);
+
+    // Return the dot product of two signatures without scaling, through
+    // the dot_u8 kernel of the processor.
+    static uint32_t dot(const uint8_t *a, const uint8_t *b);
+
+    // Return the similarity of two signatures in [0, 1].
+    static double similarity(const uint8_t *a, const uint8_t *b);
+
+    // Convert a signature to unit-scale floats.
+    static void to_floats(const uint8_t *signature, float *values);
+
+    // Return the SimHash of a signature: bit p is set if the signature,
+    // less center, lies on the positive side of hyperplane p. Hyperplanes
+    // are hash_bits normals of size floats each, and center holds size
+    // floats.
+    static uint64_t hash(const uint8_t *signature, const float *hyperplanes,
+                         const float *center);
+};
+}  // namespace palette
@@ -0,0 +1,46 @@
+#include "lib/parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace palette {
+
+size_t Parallel::default_num_threads() {
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+void Parallel::run(size_t num_tasks,
+                   const std::function<void(size_t)> &task,
+                   size_t max_threads) {
+    if (max_threads == 0) {
+        max_threads = default_num_threads();
+    }
+    const size_t num_threads = std::min(num_tasks, max_threads);
+    if (num_threads <= 1) {
+        for (size_t i = 0; i < num_tasks; ++i) {
+            task(i);
+        }
+        return;
+    }
+    std::atomic<size_t> next_task(0);
+    auto work = [&next_task, num_tasks, &task]() {
+        for (size_t i = next_task++; i < num_tasks; i = next_task++) {
+            task(i);
+        }
+    };
+    // The calling thread takes a share of the work as well.
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+    for (size_t t = 1; t < num_threads; ++t) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+}  // namespace palette
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace palette {
+
+// Runs independent tasks on threads that live for the duration of one call.
+class Parallel {
+ public:
+    // Return the number of threads used when no maximum is given.
+    static size_t default_num_threads();
+
+    // Call task(i) once for every i in [0, num_tasks) using at most
+    // max_threads threads, or default_num_threads() if max_threads is 0.
+    // Tasks are handed out in order. Return once every task has finished.
+    static void run(size_t num_tasks,
+                    const std::function<void(size_t)> &task,
+                    size_t max_threads = 0);
+};
+}  // namespace palette
@@ -0,0 +1,108 @@
+#include "lib/pixel_view.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Magick++.h>
+
+#include "lib/kernels.h"
+
+namespace palette {
+
+PixelView::PixelView(const uint8_t *data, size_t width, size_t height,
+                     size_t stride, Format format) :
+    data_(data),
+    width_(width),
+    height_(height),
+    stride_(stride),
+    format_(format) { }
+
+PixelView::PixelView(const uint8_t *data, size_t width, size_t height,
+                     Format format) :
+    data_(data),
+    width_(width),
+    height_(height),
+    stride_(0),
+    format_(format) {
+    stride_ = width_ * get_num_channels();
+}
+
+PixelView::PixelView(const PixelView &other) :
+    data_(other.data_),
+    width_(other.width_),
+    height_(other.height_),
+    stride_(other.stride_),
+    format_(other.format_) { }
+
+PixelView &PixelView::operator=(const PixelView &other) {
+    data_ = other.data_;
+    width_ = other.width_;
+    height_ = other.height_;
+    stride_ = other.stride_;
+    format_ = other.format_;
+    return *this;
+}
+
+const uint8_t *PixelView::data() const { return data_; }
+
+size_t PixelView::width() const { return width_; }
+
+size_t PixelView::height() const { return height_; }
+
+size_t PixelView::stride() const { return stride_; }
+
+PixelView::Format PixelView::format() const { return format_; }
+
+size_t PixelView::get_num_channels() const {
+    switch (format_) {
+        case Format::rgb8:
+        case Format::bgr8:
+            return 3;
+        case Format::rgba8:
+        case Format::bgra8:
+            return 4;
+    }
+    return 0;
+}
+
+bool PixelView::valid() const {
+    return (data_ != nullptr) && (width_ > 0) && (height_ > 0)
+        && (stride_ >= width_ * get_num_channels());
+}
+
+bool PixelView::read_rgb24(ssize_t x, ssize_t y, size_t width,
+                           uint32_t *rgb) const {
+    if ((x < 0) || (y < 0) || (static_cast<size_t>(y) >= height_)
+        || (static_cast<size_t>(x) + width > width_)) {
+        return false;
+    }
+    const size_t num_channels = get_num_channels();
+    const bool bgr = (format_ == Format::bgr8) || (format_ == Format::bgra8);
+    const uint8_t *pixels =
+        data_ + (static_cast<size_t>(y) * stride_)
+        + (static_cast<size_t>(x) * num_channels);
+    Kernels::get().pack_rgb24(pixels, num_channels, bgr, width, rgb);
+    return true;
+}
+
+// Pack the pixels as RGB whatever their format, so that the image has no
+// alpha channel for ImageMagick to take into account.
+Magick::Image PixelView::to_magick_image() const {
+    const size_t num_channels = 3;
+    std::vector<uint8_t> packed(width_ * height_ * num_channels);
+    std::vector<uint32_t> row(width_);
+    uint8_t *pixel = packed.data();
+    for (size_t y = 0; y < height_; ++y) {
+        read_rgb24(0, static_cast<ssize_t>(y), width_, row.data());
+        for (const uint32_t rgb : row) {
+            pixel[0] = static_cast<uint8_t>(rgb >> 16);
+            pixel[1] = static_cast<uint8_t>(rgb >> 8);
+            pixel[2] = static_cast<uint8_t>(rgb);
+            pixel += num_channels;
+        }
+    }
+    return Magick::Image(width_, height_, "RGB", Magick::CharPixel,
+                         packed.data());
+}
+}  // namespace palette
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Magick++.h>
+
+namespace palette {
+
+// A view of 8-bit pixels that the caller already holds in memory, such as
+// decoded video frames, read in place without copying. The pixels must
+// stay alive and unchanged while the view is used. Any number of threads
+// may read the same view concurrently.
+class PixelView {
+ public:
+    // Channel order of each pixel. Alpha channels are ignored.
+    enum class Format { rgb8, rgba8, bgr8, bgra8 };
+
+    // View height rows of width pixels, each row starting stride bytes
+    // after the one before it.
+    PixelView(const uint8_t *data, size_t width, size_t height,
+              size_t stride, Format format);
+
+    // View tightly packed rows.
+    PixelView(const uint8_t *data, size_t width, size_t height,
+              Format format);
+
+    PixelView(const PixelView &other);
+
+    PixelView &operator=(const PixelView &other);
+
+    const uint8_t *data() const;
+    size_t width() const;
+    size_t height() const;
+    size_t stride() const;
+    Format format() const;
+
+    // Return the number of bytes of each pixel.
+    size_t get_num_channels() const;
+
+    // Return whether or not the view has at least one pixel and its rows do
+    // not overlap.
+    bool valid() const;
+
+    // Read width pixels starting at (x, y) as 0xRRGGBB. Return whether or
+    // not the pixels lie inside the view.
+    bool read_rgb24(ssize_t x, ssize_t y, size_t width, uint32_t *rgb) const;
+
+    // Return a copy of the pixels as an RGB image, for the operations that
+    // only ImageMagick provides.
+    Magick::Image to_magick_image() const;
+
+ private:
+    const uint8_t *data_;
+    size_t width_;
+    size_t height_;
+    size_t stride_;
+    Format format_;
+};
+}  // namespace palette
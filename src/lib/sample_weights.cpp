@@ -0,0 +1,197 @@
+#include "lib/sample_weights.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <Magick++.h>
+
+#include "lib/image_rows.h"
+
+namespace palette {
+
+SampleWeights::SampleWeights() :
+    kind_(Kind::uniform),
+    regions_(),
+    mask_(),
+    center_spread_(default_center_spread) { }
+
+SampleWeights::SampleWeights(const std::vector<Magick::Geometry> &regions) :
+    kind_(Kind::regions),
+    regions_(regions),
+    mask_(),
+    center_spread_(default_center_spread) { }
+
+SampleWeights::SampleWeights(const Magick::Image &mask) :
+    kind_(Kind::mask),
+    regions_(),
+    mask_(mask),
+    center_spread_(default_center_spread) { }
+
+SampleWeights::SampleWeights(const SampleWeights &other) :
+    kind_(other.kind_),
+    regions_(other.regions_),
+    mask_(other.mask_),
+    center_spread_(other.center_spread_) { }
+
+SampleWeights &SampleWeights::operator=(const SampleWeights &other) {
+    kind_ = other.kind_;
+    regions_ = other.regions_;
+    mask_ = other.mask_;
+    center_spread_ = other.center_spread_;
+    return *this;
+}
+
+SampleWeights SampleWeights::center_weighted(double spread) {
+    SampleWeights weights;
+    weights.kind_ = Kind::center;
+    weights.center_spread_ = spread;
+    return weights;
+}
+
+bool SampleWeights::uniform() const { return kind_ == Kind::uniform; }
+
+bool SampleWeights::unit_weights() const {
+    return (kind_ == Kind::uniform) || (kind_ == Kind::regions);
+}
+
+SampleWeights SampleWeights::scaled(double x_scale, double y_scale) const {
+    SampleWeights weights(*this);
+    for (auto &region : weights.regions_) {
+        // Round outward so that a region never vanishes.
+        const double x = static_cast<double>(region.xOff());
+        const double y = static_cast<double>(region.yOff());
+        const double left = std::floor(x * x_scale);
+        const double top = std::floor(y * y_scale);
+        const double right = std::ceil((x + region.width()) * x_scale);
+        const double bottom = std::ceil((y + region.height()) * y_scale);
+        region = Magick::Geometry(static_cast<size_t>(right - left),
+                                  static_cast<size_t>(bottom - top),
+                                  static_cast<ssize_t>(left),
+                                  static_cast<ssize_t>(top));
+    }
+    return weights;
+}
+
+bool SampleWeights::for_each_span(size_t width, size_t height,
+                                  size_t y_begin, size_t y_end,
+                                  const SpanVisitor &visitor) const {
+    y_end = std::min(y_end, height);
+    switch (kind_) {
+        case Kind::uniform:
+            for (size_t y = y_begin; y < y_end; ++y) {
+                if (!visitor(y, 0, width, nullptr)) {
+                    return false;
+                }
+            }
+            return true;
+        case Kind::regions: {
+            // Merge the intervals of all regions crossing each row so that
+            // overlapping regions do not count pixels twice.
+            std::vector<std::pair<size_t, size_t>> spans;
+            for (size_t y = y_begin; y < y_end; ++y) {
+                spans.clear();
+                for (const auto &region : regions_) {
+                    const ssize_t top = region.yOff();
+                    const ssize_t left = region.xOff();
+                    const ssize_t row = static_cast<ssize_t>(y);
+                    if ((row < top)
+                        || (row >= (top + static_cast<ssize_t>(
+                                        region.height())))) {
+                        continue;
+                    }
+                    const size_t x_begin = static_cast<size_t>(
+                        std::max<ssize_t>(left, 0));
+                    const size_t x_end = static_cast<size_t>(
+                        std::min<ssize_t>(
+                            left + static_cast<ssize_t>(region.width()),
+                            static_cast<ssize_t>(width)));
+                    if (x_begin < x_end) {
+                        spans.emplace_back(x_begin, x_end);
+                    }
+                }
+                std::sort(spans.begin(), spans.end());
+                size_t merged_begin = 0;
+                size_t merged_end = 0;
+                for (const auto &span : spans) {
+                    if (span.first > merged_end) {
+                        if ((merged_end > merged_begin)
+                            && !visitor(y, merged_begin, merged_end,
+                                        nullptr)) {
+                            return false;
+                        }
+                        merged_begin = span.first;
+                    }
+                    merged_end = std::max(merged_end, span.second);
+                }
+                if ((merged_end > merged_begin)
+                    && !visitor(y, merged_begin, merged_end, nullptr)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case Kind::mask: {
+            // A mask of a different size is sampled at the nearest pixel
+            // rather than resized.
+            ImageRows mask_rows(mask_);
+            const size_t mask_width = mask_rows.width();
+            const size_t mask_height = mask_rows.height();
+            if ((mask_width == 0) || (mask_height == 0)) {
+                return false;
+            }
+            std::vector<float> mask_row(mask_width);
+            std::vector<float> weights(width);
+            size_t loaded_mask_y = mask_height;
+            for (size_t y = y_begin; y < y_end; ++y) {
+                const size_t mask_y = (y * mask_height) / height;
+                if (mask_y != loaded_mask_y) {
+                    if (!mask_rows.read_intensity(0, mask_y, mask_width,
+                                                  mask_row.data())) {
+                        return false;
+                    }
+                    loaded_mask_y = mask_y;
+                }
+                if (mask_width == width) {
+                    std::copy(mask_row.begin(), mask_row.end(),
+                              weights.begin());
+                } else {
+                    for (size_t x = 0; x < width; ++x) {
+                        weights[x] = mask_row[(x * mask_width) / width];
+                    }
+                }
+                if (!visitor(y, 0, width, weights.data())) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case Kind::center: {
+            // Squared distances are normalized so that a corner is at 1.
+            std::vector<float> x_terms(width);
+            for (size_t x = 0; x < width; ++x) {
+                const double dx = ((x + 0.5) / width) - 0.5;
+                x_terms[x] = static_cast<float>(2.0 * dx * dx);
+            }
+            const double scale = -0.5 / (center_spread_ * center_spread_);
+            std::vector<float> weights(width);
+            for (size_t y = y_begin; y < y_end; ++y) {
+                const double dy = ((y + 0.5) / height) - 0.5;
+                const float y_term = static_cast<float>(2.0 * dy * dy);
+                for (size_t x = 0; x < width; ++x) {
+                    weights[x] = std::exp(
+                        static_cast<float>(scale) * (x_terms[x] + y_term));
+                }
+                if (!visitor(y, 0, width, weights.data())) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        default: break;
+    }
+    return false;
+}
+}  // namespace palette
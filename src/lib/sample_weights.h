@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include <Magick++.h>
+
+namespace palette {
+
+// How much each pixel of an image counts when sampling its colors: every
+// pixel equally, only pixels inside a list of rectangles, each pixel by the
+// intensity of the matching pixel of a mask image, or by closeness to the
+// center of the image. Weights are produced one row span at a time, so
+// applying them never copies or crops the image.
+class SampleWeights {
+ public:
+    static constexpr double default_center_spread = 0.5;
+
+    // Called for pixels [x_begin, x_end) of row y with one weight per pixel,
+    // or with null weights if every pixel has weight 1. Returning false
+    // stops the traversal.
+    using SpanVisitor = std::function<bool(size_t y,
+                                           size_t x_begin, size_t x_end,
+                                           const float *weights)>;
+
+    SampleWeights();
+    explicit SampleWeights(const std::vector<Magick::Geometry> &regions);
+    explicit SampleWeights(const Magick::Image &mask);
+    SampleWeights(const SampleWeights &other);
+
+    SampleWeights &operator=(const SampleWeights &other);
+
+    // Weigh pixels by a Gaussian of their distance from the center of the
+    // image, where spread is the standard deviation relative to the
+    // distance from the center to a corner.
+    static SampleWeights center_weighted(double spread);
+
+    bool uniform() const;
+
+    // Return whether or not every pixel has weight either 0 or 1, so that
+    // weighted totals are whole pixel counts.
+    bool unit_weights() const;
+
+    // Return the same weights for a copy of the image resized by the given
+    // factors. Only regions depend on the image size.
+    SampleWeights scaled(double x_scale, double y_scale) const;
+
+    // Visit the weighted spans of rows [y_begin, y_end) of an image of the
+    // given size. Overlapping regions are visited once. Return whether or
+    // not every span was visited.
+    bool for_each_span(size_t width, size_t height,
+                       size_t y_begin, size_t y_end,
+                       const SpanVisitor &visitor) const;
+
+ private:
+    enum class Kind { uniform, regions, mask, center };
+
+    Kind kind_;
+    std::vector<Magick::Geometry> regions_;
+    Magick::Image mask_;
+    double center_spread_;
+};
+}  // namespace palette
@@ -2,6 +2,7 @@
 
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <Magick++.h>
 
@@ -25,6 +26,57 @@ ColorVector &StripesImage::get_stripe_colors() { return stripe_colors_; }
 bool StripesImage::export_image(const std::string file_name,
                                 std::stringstream &export_stream,
                                 std::stringstream &error_stream) {
+    Magick::Image stripes;
+    if (!create_image(stripes, error_stream)) {
+        return false;
+    }
+    try {
+        stripes.write(file_name);
+    } catch (Magick::Exception &error) {
+        error_stream << "ImageMagick exception: " << error.what() << std::endl;
+        return false;
+    }
+    export_stream << "Wrote " << std::dec << stripes.columns() << "x"
+        << stripes.rows() << " image to " << file_name << " with colors: "
+        << stripe_colors_.to_string(", ") << std::endl;
+    return true;
+}
+
+bool StripesImage::export_image(Magick::Blob &blob, const std::string &format,
+                                std::stringstream &export_stream,
+                                std::stringstream &error_stream) {
+    Magick::Image stripes;
+    if (!create_image(stripes, error_stream)) {
+        return false;
+    }
+    try {
+        stripes.write(&blob, format);
+    } catch (Magick::Exception &error) {
+        error_stream << "ImageMagick exception: " << error.what() << std::endl;
+        return false;
+    }
+    export_stream << "Wrote " << std::dec << stripes.columns() << "x"
+        << stripes.rows() << " " << format << " image of " << blob.length()
+        << " bytes with colors: " << stripe_colors_.to_string(", ")
+        << std::endl;
+    return true;
+}
+
+bool StripesImage::export_image(std::vector<unsigned char> &buffer,
+                                const std::string &format,
+                                std::stringstream &export_stream,
+                                std::stringstream &error_stream) {
+    Magick::Blob blob;
+    if (!export_image(blob, format, export_stream, error_stream)) {
+        return false;
+    }
+    const auto *data = static_cast<const unsigned char *>(blob.data());
+    buffer.assign(data, data + blob.length());
+    return true;
+}
+
+bool StripesImage::create_image(Magick::Image &image,
+                                std::stringstream &error_stream) {
     if (stripe_colors_.get().empty()) {
         error_stream << "Empty list of colors" << std::endl;
         return false;
@@ -88,15 +140,7 @@ bool StripesImage::export_image(const std::string file_name,
         ++stripe_idx;
     }
 
-    try {
-        stripes.write(file_name);
-    } catch (Magick::Exception &error) {
-        error_stream << "ImageMagick exception: " << error.what() << std::endl;
-        return false;
-    }
-    export_stream << "Wrote " << std::dec << image_width << "x" << image_height
-        << " image to " << file_name << " with colors: "
-        << stripe_colors_.to_string(", ") << std::endl;
+    image = stripes;
     return true;
 }
 }  // namespace palette
@@ -2,6 +2,9 @@
 
 #include <sstream>
 #include <string>
+#include <vector>
+
+#include <Magick++.h>
 
 #include "lib/color_vector.h"
 #include "lib/orientation.h"
@@ -20,7 +23,21 @@ class StripesImage {
                       std::stringstream &export_stream,
                       std::stringstream &error_stream);
 
+    // Like export_image, but encode the image in the given format, such as
+    // "png", into blob or into buffer, replacing its contents.
+    bool export_image(Magick::Blob &blob, const std::string &format,
+                      std::stringstream &export_stream,
+                      std::stringstream &error_stream);
+    bool export_image(std::vector<unsigned char> &buffer,
+                      const std::string &format,
+                      std::stringstream &export_stream,
+                      std::stringstream &error_stream);
+
  private:
+    // Draw the stripes into image. Return whether or not the stripes are
+    // configured correctly.
+    bool create_image(Magick::Image &image, std::stringstream &error_stream);
+
     int stripe_length_;
     int stripe_width_;
     Orientation stripe_orientation_;
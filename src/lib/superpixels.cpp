@@ -0,0 +1,482 @@
+#include "lib/superpixels.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <Magick++.h>
+
+#include "lib/color.h"
+#include "lib/color_histogram.h"
+#include "lib/color_space.h"
+#include "lib/image_rows.h"
+#include "lib/packed_color.h"
+#include "lib/parallel.h"
+#include "lib/pixel_view.h"
+#include "lib/sample_weights.h"
+
+namespace palette {
+namespace {
+
+// A center of k-means over CIELAB color and position.
+struct Center final {
+    float lightness_;
+    float a_;
+    float b_;
+    float x_;
+    float y_;
+};
+
+// Sums over the pixels assigned to a center or to a region.
+struct Sums final {
+    void add(float lightness, float a, float b, size_t x, size_t y);
+    void add(const Sums &other);
+
+    double lightness_;
+    double a_;
+    double b_;
+    double x_;
+    double y_;
+    double count_;
+};
+
+// Label of a pixel not yet in a region.
+const uint32_t unlabeled = std::numeric_limits<uint32_t>::max();
+
+// Return where the given part of size begins when size is split into
+// num_parts nearly equal parts.
+size_t part_begin(size_t part, size_t num_parts, size_t size);
+
+// Return the squared distance between two colors packed as 0xRRGGBB, in
+// 8-bit channel units.
+uint32_t rgb24_distance(uint32_t left, uint32_t right);
+}  // namespace
+
+Superpixels::Settings::Settings() :
+    region_size_(default_region_size),
+    compactness_(default_compactness),
+    num_iterations_(default_num_iterations),
+    max_threads_(0) { }
+
+Superpixels::Superpixels() :
+    settings_(), width_(0), height_(0), labels_(), regions_() { }
+
+Superpixels::Superpixels(const Settings &settings) :
+    settings_(settings), width_(0), height_(0), labels_(), regions_() { }
+
+Superpixels::Superpixels(const Superpixels &other) :
+    settings_(other.settings_),
+    width_(other.width_),
+    height_(other.height_),
+    labels_(other.labels_),
+    regions_(other.regions_) { }
+
+Superpixels &Superpixels::operator=(const Superpixels &other) {
+    settings_ = other.settings_;
+    width_ = other.width_;
+    height_ = other.height_;
+    labels_ = other.labels_;
+    regions_ = other.regions_;
+    return *this;
+}
+
+bool Superpixels::segment(const Magick::Image &image,
+                          const SampleWeights &weights) {
+    return segment_rows(
+        image.columns(), image.rows(),
+        [&image]() { return ImageRows(image); }, weights);
+}
+
+bool Superpixels::segment(const PixelView &pixels,
+                          const SampleWeights &weights) {
+    if (!pixels.valid()) {
+        *this = Superpixels(settings_);
+        return false;
+    }
+    return segment_rows(
+        pixels.width(), pixels.height(),
+        [&pixels]() { return pixels; }, weights);
+}
+
+size_t Superpixels::width() const { return width_; }
+
+size_t Superpixels::height() const { return height_; }
+
+const std::vector<uint32_t> &Superpixels::labels() const { return labels_; }
+
+const std::vector<Superpixels::Region> &Superpixels::regions() const {
+    return regions_;
+}
+
+ColorHistogram Superpixels::to_histogram() const {
+    std::vector<std::pair<uint32_t, double>> entries;
+    entries.reserve(regions_.size());
+    for (const Region &region : regions_) {
+        if (region.weight_ > 0.0) {
+            entries.emplace_back(region.rgb24_, region.weight_);
+        }
+    }
+    std::sort(entries.begin(), entries.end());
+    ColorHistogram histogram;
+    histogram.reserve(entries.size());
+    for (size_t i = 0; i < entries.size();) {
+        const uint32_t rgb = entries[i].first;
+        double weight = 0.0;
+        for (; (i < entries.size()) && (entries[i].first == rgb); ++i) {
+            weight += entries[i].second;
+        }
+        histogram.add(rgb, weight);
+    }
+    return histogram;
+}
+
+Magick::Image Superpixels::to_magick_image(
+    const std::vector<Color> &colors) const {
+    if (labels_.empty()) {
+        return Magick::Image();
+    }
+    std::vector<uint32_t> palette_rgb;
+    palette_rgb.reserve(colors.size());
+    for (const Color &color : colors) {
+        palette_rgb.push_back(color.to_rgb24());
+    }
+    std::vector<uint32_t> region_rgb(regions_.size(), 0);
+    for (size_t r = 0; r < regions_.size(); ++r) {
+        region_rgb[r] = regions_[r].rgb24_;
+        uint32_t min_distance = std::numeric_limits<uint32_t>::max();
+        for (uint32_t rgb : palette_rgb) {
+            const uint32_t distance = rgb24_distance(regions_[r].rgb24_, rgb);
+            if (distance < min_distance) {
+                min_distance = distance;
+                region_rgb[r] = rgb;
+            }
+        }
+    }
+
+    std::vector<uint8_t> pixels(3 * labels_.size());
+    Parallel::run(height_, [&](size_t y) {
+        for (size_t p = y * width_; p < ((y + 1) * width_); ++p) {
+            const uint32_t rgb = region_rgb[labels_[p]];
+            pixels[(3 * p) + 0] = static_cast<uint8_t>((rgb >> 16) & 0xFF);
+            pixels[(3 * p) + 1] = static_cast<uint8_t>((rgb >> 8) & 0xFF);
+            pixels[(3 * p) + 2] = static_cast<uint8_t>(rgb & 0xFF);
+        }
+    }, settings_.max_threads_);
+    return Magick::Image(width_, height_, "RGB", Magick::CharPixel,
+                         pixels.data());
+}
+
+template <typename MakeRows>
+bool Superpixels::segment_rows(size_t width, size_t height,
+                               const MakeRows &make_rows,
+                               const SampleWeights &weights) {
+    width_ = width;
+    height_ = height;
+    labels_.clear();
+    regions_.clear();
+    if ((width == 0) || (height == 0)) {
+        return true;
+    }
+    const size_t num_pixels = width * height;
+    const size_t num_bands = std::min(
+        height, (settings_.max_threads_ > 0)
+        ? settings_.max_threads_ : Parallel::default_num_threads());
+    std::vector<char> band_success(num_bands, false);
+
+    // Convert every pixel to CIELAB once, into one plane per channel, each
+    // band of rows through its own reader.
+    const ColorSpace lab_space(ColorSpace::Value::lab);
+    std::vector<float> lab(3 * num_pixels, 0.0f);
+    float *const lightness = lab.data();
+    float *const a = lightness + num_pixels;
+    float *const b = a + num_pixels;
+    Parallel::run(num_bands, [&](size_t band) {
+        auto rows = make_rows();
+        std::vector<uint32_t> row(width);
+        std::vector<float> red(width);
+        std::vector<float> green(width);
+        std::vector<float> blue(width);
+        for (size_t y = part_begin(band, num_bands, height);
+             y < part_begin(band + 1, num_bands, height); ++y) {
+            if (!rows.read_rgb24(0, static_cast<ssize_t>(y), width,
+                                 row.data())) {
+                return;
+            }
+            for (size_t x = 0; x < width; ++x) {
+                red[x] = ((row[x] >> 16) & 0xFF) / 255.0f;
+                green[x] = ((row[x] >> 8) & 0xFF) / 255.0f;
+                blue[x] = (row[x] & 0xFF) / 255.0f;
+            }
+            const size_t offset = y * width;
+            lab_space.from_rgb(width, red.data(), green.data(), blue.data(),
+                               lightness + offset, a + offset, b + offset);
+        }
+        band_success[band] = true;
+    }, settings_.max_threads_);
+    if (!std::all_of(band_success.begin(), band_success.end(),
+                     [](char success) { return success; })) {
+        return false;
+    }
+
+    // Start a center in the middle of each grid cell.
+    const size_t region_size = std::max<size_t>(settings_.region_size_, 1);
+    const size_t grid_width =
+        std::max<size_t>((width + (region_size / 2)) / region_size, 1);
+    const size_t grid_height =
+        std::max<size_t>((height + (region_size / 2)) / region_size, 1);
+    std::vector<size_t> column_cells(width, 0);
+    for (size_t column = 0; column < grid_width; ++column) {
+        std::fill(column_cells.begin() + part_begin(column, grid_width, width),
+                  column_cells.begin()
+                  + part_begin(column + 1, grid_width, width),
+                  column);
+    }
+    std::vector<Center> centers(grid_width * grid_height);
+    for (size_t row = 0; row < grid_height; ++row) {
+        const size_t y = (part_begin(row, grid_height, height)
+                          + part_begin(row + 1, grid_height, height) - 1) / 2;
+        for (size_t column = 0; column < grid_width; ++column) {
+            const size_t x = (part_begin(column, grid_width, width)
+                              + part_begin(column + 1, grid_width, width)
+                              - 1) / 2;
+            const size_t p = (y * width) + x;
+            centers[(row * grid_width) + column] = Center{
+                lightness[p], a[p], b[p], static_cast<float>(x),
+                static_cast<float>(y)};
+        }
+    }
+
+    // Squared distances in the image count against squared CIELAB
+    // distances in proportion to the squared compactness per cell side.
+    const double cell_area = static_cast<double>(num_pixels)
+        / static_cast<double>(grid_width * grid_height);
+    const auto spatial_weight = static_cast<float>(
+        (settings_.compactness_ * settings_.compactness_) / cell_area);
+
+    // A tile is the pixels of one grid row. Its pixels are compared only
+    // with the centers of its own row and the rows above and below it, so
+    // it sums its pixels for those three rows of centers alone.
+    labels_.assign(num_pixels, 0);
+    const size_t sums_per_tile = 3 * grid_width;
+    std::vector<Sums> tile_sums(grid_height * sums_per_tile);
+    const size_t num_iterations =
+        std::max<size_t>(settings_.num_iterations_, 1);
+    for (size_t iteration = 0; iteration < num_iterations; ++iteration) {
+        Parallel::run(grid_height, [&](size_t tile) {
+            Sums *const sums = tile_sums.data() + (tile * sums_per_tile);
+            std::fill(sums, sums + sums_per_tile, Sums{});
+            const size_t first_row = (tile > 0) ? (tile - 1) : 0;
+            const size_t last_row = std::min(tile + 1, grid_height - 1);
+            for (size_t y = part_begin(tile, grid_height, height);
+                 y < part_begin(tile + 1, grid_height, height); ++y) {
+                for (size_t x = 0; x < width; ++x) {
+                    const size_t p = (y * width) + x;
+                    const size_t column = column_cells[x];
+                    const size_t first_column = (column > 0) ? (column - 1) : 0;
+                    const size_t last_column =
+                        std::min(column + 1, grid_width - 1);
+                    float min_distance = std::numeric_limits<float>::max();
+                    size_t nearest = (first_row * grid_width) + first_column;
+                    for (size_t row = first_row; row <= last_row; ++row) {
+                        for (size_t c = first_column; c <= last_column; ++c) {
+                            const Center &center =
+                                centers[(row * grid_width) + c];
+                            const float dl = lightness[p] - center.lightness_;
+                            const float da = a[p] - center.a_;
+                            const float db = b[p] - center.b_;
+                            const float dx = static_cast<float>(x) - center.x_;
+                            const float dy = static_cast<float>(y) - center.y_;
+                            const float distance = (dl * dl) + (da * da)
+                                + (db * db)
+                                + (spatial_weight * ((dx * dx) + (dy * dy)));
+                            if (distance < min_distance) {
+                                min_distance = distance;
+                                nearest = (row * grid_width) + c;
+                            }
+                        }
+                    }
+                    labels_[p] = static_cast<uint32_t>(nearest);
+                    sums[(((nearest / grid_width) + 1 - tile) * grid_width)
+                         + (nearest % grid_width)]
+                        .add(lightness[p], a[p], b[p], x, y);
+                }
+            }
+        }, settings_.max_threads_);
+
+        // Move each center to the mean of its pixels, summed by the tiles
+        // of its own row and the rows above and below it.
+        Parallel::run(grid_height, [&](size_t row) {
+            const size_t first_tile = (row > 0) ? (row - 1) : 0;
+            const size_t last_tile = std::min(row + 1, grid_height - 1);
+            for (size_t column = 0; column < grid_width; ++column) {
+                Sums total{};
+                for (size_t tile = first_tile; tile <= last_tile; ++tile) {
+                    total.add(tile_sums[(tile * sums_per_tile)
+                                        + ((row + 1 - tile) * grid_width)
+                                        + column]);
+                }
+                if (total.count_ > 0.0) {
+                    centers[(row * grid_width) + column] = Center{
+                        static_cast<float>(total.lightness_ / total.count_),
+                        static_cast<float>(total.a_ / total.count_),
+                        static_cast<float>(total.b_ / total.count_),
+                        static_cast<float>(total.x_ / total.count_),
+                        static_cast<float>(total.y_ / total.count_)};
+                }
+            }
+        }, settings_.max_threads_);
+    }
+
+    // Label the connected pixels of each center as a region, merging any
+    // fragment smaller than a quarter of a cell into the region to the left
+    // of or above where it starts, which is labeled already.
+    const size_t min_area =
+        std::max<size_t>(static_cast<size_t>(cell_area / 4.0), 1);
+    std::vector<uint32_t> components(num_pixels, unlabeled);
+    std::vector<Sums> region_sums;
+    std::vector<size_t> members;
+    for (size_t start = 0; start < num_pixels; ++start) {
+        if (components[start] != unlabeled) {
+            continue;
+        }
+        uint32_t adjacent = unlabeled;
+        if ((start % width) > 0) {
+            adjacent = components[start - 1];
+        } else if (start >= width) {
+            adjacent = components[start - width];
+        }
+        const uint32_t label = labels_[start];
+        const auto component = static_cast<uint32_t>(region_sums.size());
+        auto visit = [&](size_t p) {
+            if ((components[p] == unlabeled) && (labels_[p] == label)) {
+                components[p] = component;
+                members.push_back(p);
+            }
+        };
+        members.clear();
+        visit(start);
+        for (size_t i = 0; i < members.size(); ++i) {
+            const size_t p = members[i];
+            if ((p % width) > 0) {
+                visit(p - 1);
+            }
+            if (((p % width) + 1) < width) {
+                visit(p + 1);
+            }
+            if (p >= width) {
+                visit(p - width);
+            }
+            if ((p + width) < num_pixels) {
+                visit(p + width);
+            }
+        }
+        Sums sums{};
+        for (size_t p : members) {
+            sums.add(lightness[p], a[p], b[p], p % width, p / width);
+        }
+        if ((members.size() < min_area) && (adjacent != unlabeled)) {
+            for (size_t p : members) {
+                components[p] = adjacent;
+            }
+            region_sums[adjacent].add(sums);
+        } else {
+            region_sums.push_back(sums);
+        }
+    }
+    labels_ = std::move(components);
+
+    // Convert the mean color of each region back to sRGB.
+    const size_t num_regions = region_sums.size();
+    std::vector<float> means(3 * num_regions, 0.0f);
+    for (size_t r = 0; r < num_regions; ++r) {
+        const Sums &sums = region_sums[r];
+        means[r] = static_cast<float>(sums.lightness_ / sums.count_);
+        means[num_regions + r] = static_cast<float>(sums.a_ / sums.count_);
+        means[(2 * num_regions) + r] =
+            static_cast<float>(sums.b_ / sums.count_);
+    }
+    lab_space.to_rgb(num_regions, means.data(), means.data() + num_regions,
+                     means.data() + (2 * num_regions), means.data(),
+                     means.data() + num_regions,
+                     means.data() + (2 * num_regions));
+    regions_.reserve(num_regions);
+    for (size_t r = 0; r < num_regions; ++r) {
+        const Sums &sums = region_sums[r];
+        regions_.push_back(Region{
+            PackedColor<float>{means[r], means[num_regions + r],
+                               means[(2 * num_regions) + r]}.to_rgb24(),
+            static_cast<size_t>(sums.count_), sums.count_,
+            sums.x_ / sums.count_, sums.y_ / sums.count_});
+    }
+    if (weights.uniform()) {
+        return true;
+    }
+
+    // Total the weights of the pixels of each region, band by band.
+    std::vector<std::vector<double>> band_weights(num_bands);
+    Parallel::run(num_bands, [&](size_t band) {
+        std::vector<double> &totals = band_weights[band];
+        totals.assign(num_regions, 0.0);
+        band_success[band] = weights.for_each_span(
+            width, height, part_begin(band, num_bands, height),
+            part_begin(band + 1, num_bands, height),
+            [&](size_t y, size_t x_begin, size_t x_end, const float *span) {
+                const uint32_t *row_labels = labels_.data() + (y * width);
+                for (size_t x = x_begin; x < x_end; ++x) {
+                    totals[row_labels[x]] +=
+                        (span == nullptr) ? 1.0 : span[x - x_begin];
+                }
+                return true;
+            });
+    }, settings_.max_threads_);
+    for (Region &region : regions_) {
+        region.weight_ = 0.0;
+    }
+    for (const auto &totals : band_weights) {
+        for (size_t r = 0; r < num_regions; ++r) {
+            regions_[r].weight_ += totals[r];
+        }
+    }
+    return std::all_of(band_success.begin(), band_success.end(),
+                       [](char success) { return success; });
+}
+
+namespace {
+
+void Sums::add(float lightness, float a, float b, size_t x, size_t y) {
+    lightness_ += lightness;
+    a_ += a;
+    b_ += b;
+    x_ += static_cast<double>(x);
+    y_ += static_cast<double>(y);
+    count_ += 1.0;
+}
+
+void Sums::add(const Sums &other) {
+    lightness_ += other.lightness_;
+    a_ += other.a_;
+    b_ += other.b_;
+    x_ += other.x_;
+    y_ += other.y_;
+    count_ += other.count_;
+}
+
+size_t part_begin(size_t part, size_t num_parts, size_t size) {
+    return (part * size) / num_parts;
+}
+
+uint32_t rgb24_distance(uint32_t left, uint32_t right) {
+    uint32_t distance = 0;
+    for (uint32_t shift = 0; shift < 24; shift += 8) {
+        const int32_t difference =
+            static_cast<int32_t>((left >> shift) & 0xFF)
+            - static_cast<int32_t>((right >> shift) & 0xFF);
+        distance += static_cast<uint32_t>(difference * difference);
+    }
+    return distance;
+}
+}  // namespace
+}  // namespace palette
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Magick++.h>
+
+namespace palette {
+
+class Color;
+class ColorHistogram;
+class PixelView;
+class SampleWeights;
+
+// SLIC superpixels: connected regions of similar color that are compact in
+// the image, found by k-means over CIELAB color and pixel position.
+//
+// Centers start in the cells of a grid, and each pixel is compared only
+// with the centers of the cells around its own, so an iteration takes time
+// linear in the pixels. Each tile of one grid row assigns its pixels and
+// sums them per center in parallel with the others. A last pass, the only
+// serial one, merges fragments too small to be regions into a neighbor so
+// that every region is connected.
+class Superpixels {
+ public:
+    static const size_t default_region_size = 16;
+    static constexpr double default_compactness = 10.0;
+    static const size_t default_num_iterations = 10;
+
+    struct Settings final {
+        Settings();
+
+        // Side in pixels of the grid cells the centers start in.
+        size_t region_size_;
+        // CIELAB distance that counts as much as a distance of one region
+        // size in the image; higher values give more compact regions.
+        double compactness_;
+        size_t num_iterations_;
+        // Threads, or 0 for Parallel::default_num_threads().
+        size_t max_threads_;
+    };
+
+    // A connected region of pixels.
+    struct Region final {
+        // Mean color, packed as 0xRRGGBB.
+        uint32_t rgb24_;
+        // Number of pixels.
+        size_t area_;
+        // Total sample weight of the pixels.
+        double weight_;
+        // Centroid in pixels.
+        double x_;
+        double y_;
+    };
+
+    Superpixels();
+    explicit Superpixels(const Settings &settings);
+    Superpixels(const Superpixels &other);
+
+    Superpixels &operator=(const Superpixels &other);
+
+    // Divide the pixels into regions, and total the given weights of the
+    // pixels of each. Return whether or not the pixels could be read.
+    bool segment(const Magick::Image &image, const SampleWeights &weights);
+    bool segment(const PixelView &pixels, const SampleWeights &weights);
+
+    size_t width() const;
+    size_t height() const;
+
+    // Return the index of the region of each pixel, row by row.
+    const std::vector<uint32_t> &labels() const;
+    const std::vector<Region> &regions() const;
+
+    // Return the mean colors of the regions of nonzero weight, ordered by
+    // color, each with the total weight of the regions that have it, so
+    // that clustering by weight weighs each region by its weighted area.
+    ColorHistogram to_histogram() const;
+
+    // Return the label map as an image in which each region is filled with
+    // the color nearest its mean among colors, or with its mean if colors
+    // is empty.
+    Magick::Image to_magick_image(const std::vector<Color> &colors) const;
+
+ private:
+    template <typename MakeRows>
+    bool segment_rows(size_t width, size_t height, const MakeRows &make_rows,
+                      const SampleWeights &weights);
+
+    Settings settings_;
+    size_t width_;
+    size_t height_;
+    std::vector<uint32_t> labels_;
+    std::vector<Region> regions_;
+};
+}  // namespace palette
@@ -0,0 +1,198 @@
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+
+#include <Magick++.h>
+
+#include "lib/color.h"
+#include "lib/color_vector.h"
+#include "lib/palette_dictionary.h"
+#include "lib/palette_format.h"
+
+#include "tools/tools_common.h"
+
+namespace {
+
+class ConvPalette : public Tool {
+ public:
+    ConvPalette() :
+        help_(false),
+        verbose_(false),
+        format_(std::nullopt),
+        input_file_(std::nullopt),
+        output_file_(std::nullopt),
+        options_string_(std::string()) { }
+
+    // Parse command line input into private members of this ConvPalette
+    // object. Return 0 if successful, or return a nonzero int if a fatal
+    // error is encountered.
+    int parse_options(int argc, char **argv) {
+        try {
+            try_parse_options(argc, argv);
+        } catch (cli::TooManyPositionals &error) {
+            std::cerr << "Error: more than one input file and one output "
+                << "file specified" << std::endl;
+            return exit_more_information();
+        } catch (cli::MultipleOccurrences &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
+        } catch (cli::UnknownOption &error) {
+            std::cerr << "Error: unrecognized option \""
+                << error.option() << "\"" << std::endl;
+            return exit_more_information();
+        } catch (cli::MissingArgument &error) {
+            std::cerr << "Error: failed to interpret an argument after the "
+                << error.option() << " option" << std::endl;
+            return exit_more_information();
+        } catch (cli::Error &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
+        }
+        return 0;
+    }
+
+    // Evaluate the collected command line options, read a palette in any
+    // format, and write it in the requested format. Return 0 if successful,
+    // or return a nonzero int if a fatal error is encountered.
+    int run() {
+        if (help_) {
+            return exit_help();
+        }
+        if (!input_file_.has_value()) {
+            std::cerr << "Error: No input file specified" << std::endl;
+            return exit_more_information();
+        }
+        if (!output_file_.has_value()) {
+            std::cerr << "Error: No output file specified" << std::endl;
+            return exit_more_information();
+        }
+
+        const palette::PaletteFormat input_format =
+            palette::PaletteDictionary::detect_format(input_file_.value());
+        // Without an explicit format, convert JSON to binary and anything
+        // else to JSON.
+        const palette::PaletteFormat output_format(format_.value_or(
+            (input_format.get() == palette::PaletteFormat::Value::json)
+            ? "binary" : "json"));
+        if (!output_format.valid()) {
+            std::cerr << "Error: \"" << format_.value() << "\" is not a "
+                << "valid format; it must be \"json\", \"binary\", or "
+                << "\"hex\"" << std::endl;
+            return exit_more_information();
+        }
+
+        std::stringstream error_stream;
+        palette::PaletteDictionary dictionary;
+        if (!dictionary.read(input_file_.value(), error_stream)
+            || !dictionary.write(output_file_.value(), output_format,
+                                 error_stream)) {
+            std::cerr << "Error: " << error_stream.str();
+            return 1;
+        }
+        if (verbose_) {
+            std::cout << "Converted " << dictionary.get_colors().get().size()
+                << " colors from " << input_file_.value() << " ("
+                << input_format.to_string() << ") to "
+                << output_file_.value() << " ("
+                << output_format.to_string() << ")" << std::endl;
+        }
+        return 0;
+    }
+
+ private:
+    // Initialize ImageMagick for every run but one that prints help.
+    bool uses_magick() { return !help_; }
+
+    // Return the name of the executable file.
+    std::string exec_name() { return EXEC_NAME; }
+
+    // Return description of options constructed by a call to parse_options.
+    std::string options_string() { return options_string_; }
+
+    // Return summary of the functionality of this tool.
+    std::string usage_string() {
+        std::stringstream usage_stream;
+        usage_stream << "Usage: " << exec_name()
+            << " [arguments] [input] [output]" << std::endl
+            << "Convert a palette between JSON, binary, and hex list formats."
+            << std::endl << std::endl;
+        usage_stream << "The input format is detected automatically. "
+            << "Binary palettes can be" << std::endl
+            << "memory-mapped by other tools without any parsing."
+            << std::endl;
+        return usage_stream.str();
+    }
+
+    // Return description of specific examples of using this tool.
+    std::string examples_string() {
+        std::stringstream examples_stream;
+        examples_stream << "Examples: " << exec_name()
+            << " solarized.json solarized.palette" << std::endl;
+        examples_stream << "      or: " << exec_name()
+            << " -f hex -I solarized.palette -O solarized.txt" << std::endl;
+        return examples_stream.str();
+    }
+
+    // Create names and a description for each command line option.
+    void create_options(cli::OptionsDescription &opt,
+                        cli::PositionalOptionsDescription &pos_opt) {
+        const char *help_chars = "Print this help message and exit";
+        const char *verbose_chars = "Print extra information to stdout";
+
+        const char *format_chars = "Specify the output format (\"json\", "
+            "\"binary\", or \"hex\"; default \"binary\" for JSON input and "
+            "\"json\" otherwise)";
+        const auto *format_semantic(cli::value<std::string>());
+
+        const char *input_chars = "Specify the path of input palette file";
+        const auto *input_semantic(cli::value<std::string>());
+
+        const char *output_chars = "Specify the path of output palette file";
+        const auto *output_semantic(cli::value<std::string>());
+
+        opt.add_options()
+            ("help,h", help_chars)
+            ("verbose,v", verbose_chars)
+            ("format,f", format_semantic, format_chars)
+            ("input,I", input_semantic, input_chars)
+            ("output,O", output_semantic, output_chars);
+        pos_opt.add("input", 1).add("output", 1);
+
+        std::stringstream options_stream;
+        options_stream << opt;
+        options_string_ = options_stream.str();
+    }
+
+    // Set private fields of this ConvPalette object from the command line
+    // options.
+    void set_options(const cli::VariablesMap &var_map) {
+        help_ |= !var_map["help"].empty();
+        verbose_ |= !var_map["verbose"].empty();
+        if (!var_map["format"].empty()) {
+            format_ = std::optional<std::string>(
+                var_map["format"].as<std::string>());
+        }
+        if (!var_map["input"].empty()) {
+            input_file_ = std::optional<std::string>(
+                var_map["input"].as<std::string>());
+        }
+        if (!var_map["output"].empty()) {
+            output_file_ = std::optional<std::string>(
+                var_map["output"].as<std::string>());
+        }
+    }
+
+    bool help_;
+    bool verbose_;
+    std::optional<std::string> format_;
+    std::optional<std::string> input_file_;
+    std::optional<std::string> output_file_;
+    std::string options_string_;
+};
+}  // namespace
+
+int main(int argc, char **argv) {
+    ConvPalette convpalette_state;
+    return convpalette_state.main(argc, argv);
+}
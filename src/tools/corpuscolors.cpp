@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Magick++.h>
+
+#include "lib/color.h"
+#include "lib/color_k_means.h"
+#include "lib/color_vector.h"
+#include "lib/corpus_histogram.h"
+#include "lib/image.h"
+#include "lib/image_get_sample_colors_mode.h"
+
+#include "tools/tools_common.h"
+
+namespace {
+
+class CorpusColors : public Tool {
+ public:
+    CorpusColors() :
+        help_(false),
+        verbose_(false),
+        weigh_by_pixels_(false),
+        mode_(std::nullopt),
+        number_(std::nullopt),
+        seed_(std::nullopt),
+        partial_file_(std::nullopt),
+        shard_(std::nullopt),
+        max_colors_(std::nullopt),
+        max_pixels_(std::nullopt),
+        input_files_(std::vector<std::string>()),
+        options_string_(std::string()) { }
+
+    // Parse command line input into private members of this CorpusColors
+    // object. Return 0 if successful, or return a nonzero int if a fatal
+    // error is encountered.
+    int parse_options(int argc, char **argv) {
+        try {
+            try_parse_options(argc, argv);
+        } catch (cli::MultipleOccurrences &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
+        } catch (cli::UnknownOption &error) {
+            std::cerr << "Error: unrecognized option \""
+                << error.option() << "\"" << std::endl;
+            return exit_more_information();
+        } catch (cli::MissingArgument &error) {
+            std::cerr << "Error: failed to interpret an argument after the "
+                << error.option() << " option" << std::endl;
+            return exit_more_information();
+        } catch (cli::Error &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
+        }
+        return 0;
+    }
+
+    // Evaluate the collected command line options, merge the histograms
+    // of every input, and either write the merged histogram to a partial
+    // file or list the colors of one palette for the whole corpus. Return 0
+    // if successful, or return a nonzero int if a fatal error is
+    // encountered.
+    int run() {
+        if (help_) {
+            return exit_help();
+        }
+        if (input_files_.empty()) {
+            std::cerr << "Error: No input file specified" << std::endl;
+            return exit_more_information();
+        }
+        const bool cluster = !partial_file_.has_value();
+        if (cluster && !mode_.has_value()) {
+            std::cerr << "Error: No mode specified" << std::endl;
+            return exit_more_information();
+        }
+        if (cluster && (number_.value_or(0) <= 0)) {
+            std::cerr << "Error: Number of colors must be a positive integer"
+                << std::endl;
+            return exit_more_information();
+        }
+        const palette::ImageGetSampleColorsMode mode(mode_.value_or(
+            palette::ImageGetSampleColorsMode::value_to_string(
+                palette::ImageGetSampleColorsMode::Value::
+                    kmeans_static_spread)));
+        if (!mode.valid()) {
+            std::cerr << "Error: Unknown mode \"" << mode_.value() << "\""
+                << std::endl;
+            return exit_more_information();
+        }
+        if (mode.needs_image()) {
+            std::cerr << "Error: " << mode.to_string() << " needs a single "
+                << "image; choose a kmeans mode to cluster a corpus"
+                << std::endl;
+            return exit_more_information();
+        }
+        if ((max_colors_.value_or(1) == 0)
+            || (max_pixels_.value_or(1) == 0)) {
+            std::cerr << "Error: Maximum numbers of colors and pixels must be "
+                << "positive integers" << std::endl;
+            return exit_more_information();
+        }
+        size_t shard_index = 0;
+        size_t num_shards = 1;
+        if (shard_.has_value()
+            && !parse_shard(shard_.value(), shard_index, num_shards)) {
+            std::cerr << "Error: Shard must be given as K/N with K between 1 "
+                << "and N" << std::endl;
+            return exit_more_information();
+        }
+
+        // Partial histograms of other processes are added as they are, and
+        // images are counted together in parallel.
+        palette::CorpusHistogram::Settings settings;
+        settings.max_colors_ = static_cast<size_t>(max_colors_.value_or(
+            palette::CorpusHistogram::default_max_colors));
+        settings.max_pixels_ = static_cast<size_t>(max_pixels_.value_or(0));
+        settings.weigh_by_pixels_ = weigh_by_pixels_;
+        palette::CorpusHistogram corpus(settings);
+        std::vector<std::string> image_files;
+        std::stringstream error_stream;
+        for (size_t i = shard_index; i < input_files_.size();
+             i += num_shards) {
+            if (!is_partial_file(input_files_[i])) {
+                image_files.push_back(input_files_[i]);
+                continue;
+            }
+            palette::CorpusHistogram partial(settings);
+            if (!partial.read(input_files_[i], error_stream)) {
+                std::cerr << "Error: " << error_stream.str();
+                return 1;
+            }
+            corpus.add(partial);
+        }
+        if (!corpus.add_images(image_files, error_stream)) {
+            std::cerr << "Error: " << error_stream.str();
+            return 1;
+        }
+        if (verbose_) {
+            std::cout << "Merged " << corpus.num_images() << " images into "
+                << corpus.get().size() << " colors";
+            if (corpus.coarsened_bits() > 0) {
+                std::cout << ", coarsened by " << corpus.coarsened_bits()
+                    << " bits per channel";
+            }
+            std::cout << std::endl;
+        }
+
+        if (!cluster) {
+            if (!corpus.write(partial_file_.value(), error_stream)) {
+                std::cerr << "Error: " << error_stream.str();
+                return 1;
+            }
+            return 0;
+        }
+        palette::ColorKMeans::Settings kmeans_settings;
+        kmeans_settings.seed_ = seed_;
+        std::vector<palette::Color> sample_colors;
+        if (corpus.get().empty()
+            || !palette::Image::find_mode_clusters(
+                static_cast<size_t>(number_.value()), mode, corpus.get(),
+                /* keep centroids */ false, kmeans_settings,
+                sample_colors)) {
+            std::cerr << "Getting color subset failed" << std::endl;
+            return 1;
+        }
+        std::sort(sample_colors.begin(), sample_colors.end());
+        palette::ColorVector output_colors(std::move(sample_colors));
+        std::cout << output_colors.to_string("\n") << std::endl;
+        return 0;
+    }
+
+ private:
+    // Initialize ImageMagick for every run but one that prints help.
+    bool uses_magick() { return !help_; }
+
+    // Return the name of the executable file.
+    std::string exec_name() { return EXEC_NAME; }
+
+    // Return description of options constructed by a call to parse_options.
+    std::string options_string() { return options_string_; }
+
+    // Return summary of the functionality of this tool.
+    std::string usage_string() {
+        std::stringstream usage_stream;
+        usage_stream << "Usage: " << exec_name()
+            << " -m mode -n number [arguments] [input ...]" << std::endl
+            << "   or: " << exec_name()
+            << " -O partial [arguments] [input ...]" << std::endl
+            << "Print one list of hex colors for a whole set of images."
+            << std::endl << std::endl;
+        usage_stream << "The colors of every image are counted in parallel "
+            << "and merged into one" << std::endl
+            << "histogram, which is clustered once. Inputs may also be "
+            << "partial histograms" << std::endl
+            << "written by -O, so that several processes can each count a "
+            << "shard of the" << std::endl
+            << "images for one process to merge." << std::endl;
+        return usage_stream.str();
+    }
+
+    // Return description of specific examples of using this tool.
+    std::string examples_string() {
+        std::stringstream examples_stream;
+        examples_stream << "Examples: " << exec_name()
+            << " -m kmeans-static-spread -n 16 sprites/*.png" << std::endl;
+        examples_stream << "      or: " << exec_name()
+            << " -s 1/2 -O part1.hist photos/*.jpg" << std::endl;
+        examples_stream << "      or: " << exec_name()
+            << " -m kmeans-random-spread -n 8 part1.hist part2.hist"
+            << std::endl;
+        return examples_stream.str();
+    }
+
+    // Create names and a description for each command line option.
+    void create_options(cli::OptionsDescription &opt,
+                        cli::PositionalOptionsDescription &pos_opt) {
+        const char *help_chars = "Print this help message and exit";
+        const char *verbose_chars = "Print extra information to stdout";
+
+        std::stringstream mode_stream;
+        mode_stream << "Method for clustering the colors ("
+            << "kmeans-random-spread" << ", "
+            << "kmeans-static-spread" << ", "
+            << "kmeans-hue-spread" << ", "
+            << "kmeans-bright-hue-spread" << ", "
+            << "kmeans-saturated-hue-spread" << ")";
+        std::string mode_string = mode_stream.str();
+        const char *mode_chars = mode_string.c_str();
+        const auto *mode_semantic(cli::value<std::string>());
+
+        const char *number_chars = "Number of colors to list";
+        const auto *number_semantic(cli::value<int>());
+
+        const char *seed_chars = "Seed for kmeans-random-spread, making its "
+            "results reproducible";
+        const auto *seed_semantic(cli::value<uint64_t>());
+
+        const char *partial_chars = "Write the merged histogram to this "
+            "partial file instead of listing colors";
+        const auto *partial_semantic(cli::value<std::string>());
+
+        const char *shard_chars = "Read only shard K of N, every Nth input "
+            "starting with the Kth";
+        const auto *shard_semantic(cli::value<std::string>());
+
+        std::stringstream max_colors_stream;
+        max_colors_stream << "Coarsen merged histograms to at most this many "
+            << "colors (default "
+            << palette::CorpusHistogram::default_max_colors << ")";
+        std::string max_colors_string = max_colors_stream.str();
+        const char *max_colors_chars = max_colors_string.c_str();
+        const auto *max_colors_semantic(cli::value<uint64_t>());
+
+        const char *max_pixels_chars = "Scale each image down while reading "
+            "it to at most this many pixels";
+        const auto *max_pixels_semantic(cli::value<uint64_t>());
+
+        const char *weigh_by_pixels_chars = "Weigh images by their number of "
+            "pixels instead of equally";
+
+        const char *input_chars =
+            "Specify an additional input image or partial histogram file";
+        const auto *input_semantic(cli::value<std::vector<std::string>>());
+
+        opt.add_options()
+            ("help,h", help_chars)
+            ("verbose,v", verbose_chars)
+            ("mode,m", mode_semantic, mode_chars)
+            ("number,n", number_semantic, number_chars)
+            ("seed,S", seed_semantic, seed_chars)
+            ("partial,O", partial_semantic, partial_chars)
+            ("shard,s", shard_semantic, shard_chars)
+            ("max-colors,C", max_colors_semantic, max_colors_chars)
+            ("max-pixels,P", max_pixels_semantic, max_pixels_chars)
+            ("weigh-by-pixels,w", weigh_by_pixels_chars)
+            ("input,I", input_semantic, input_chars);
+        pos_opt.add("input", -1);
+
+        std::stringstream options_stream;
+        options_stream << opt;
+        options_string_ = options_stream.str();
+    }
+
+    // Set private fields of this CorpusColors object from the command line
+    // options.
+    void set_options(const cli::VariablesMap &var_map) {
+        help_ |= !var_map["help"].empty();
+        verbose_ |= !var_map["verbose"].empty();
+        weigh_by_pixels_ |= !var_map["weigh-by-pixels"].empty();
+        if (!var_map["mode"].empty()) {
+            mode_ = std::optional<std::string>(
+                var_map["mode"].as<std::string>());
+        }
+        if (!var_map["number"].empty()) {
+            number_ = std::optional<int>(var_map["number"].as<int>());
+        }
+        if (!var_map["seed"].empty()) {
+            seed_ = std::optional<uint64_t>(var_map["seed"].as<uint64_t>());
+        }
+        if (!var_map["partial"].empty()) {
+            partial_file_ = std::optional<std::string>(
+                var_map["partial"].as<std::string>());
+        }
+        if (!var_map["shard"].empty()) {
+            shard_ = std::optional<std::string>(
+                var_map["shard"].as<std::string>());
+        }
+        if (!var_map["max-colors"].empty()) {
+            max_colors_ = std::optional<uint64_t>(
+                var_map["max-colors"].as<uint64_t>());
+        }
+        if (!var_map["max-pixels"].empty()) {
+            max_pixels_ = std::optional<uint64_t>(
+                var_map["max-pixels"].as<uint64_t>());
+        }
+        if (!var_map["input"].empty()) {
+            auto input_opts =
+                var_map["input"].as<std::vector<std::string>>();
+            input_files_.insert(
+                input_files_.end(), input_opts.begin(), input_opts.end());
+        }
+    }
+
+    // Parse a shard given as K/N into a zero-based index and a count.
+    static bool parse_shard(const std::string &shard, size_t &shard_index,
+                            size_t &num_shards) {
+        std::stringstream shard_stream(shard);
+        size_t k = 0;
+        char separator = '\0';
+        size_t n = 0;
+        if (!(shard_stream >> k >> separator >> n) || (separator != '/')
+            || !shard_stream.eof() || (k == 0) || (k > n)) {
+            return false;
+        }
+        shard_index = k - 1;
+        num_shards = n;
+        return true;
+    }
+
+    // Return whether or not the file begins like a partial histogram.
+    static bool is_partial_file(const std::string &file_name) {
+        unsigned char magic[8] = { };
+        std::ifstream input_stream(file_name, std::ios::binary);
+        input_stream.read(reinterpret_cast<char *>(magic), sizeof(magic));
+        return palette::CorpusHistogram::has_magic(
+            magic, static_cast<size_t>(input_stream.gcount()));
+    }
+
+    bool help_;
+    bool verbose_;
+    bool weigh_by_pixels_;
+    std::optional<std::string> mode_;
+    std::optional<int> number_;
+    std::optional<uint64_t> seed_;
+    std::optional<std::string> partial_file_;
+    std::optional<std::string> shard_;
+    std::optional<uint64_t> max_colors_;
+    std::optional<uint64_t> max_pixels_;
+    std::vector<std::string> input_files_;
+    std::string options_string_;
+};
+}  // namespace
+
+int main(int argc, char **argv) {
+    CorpusColors corpuscolors_state;
+    return corpuscolors_state.main(argc, argv);
+}
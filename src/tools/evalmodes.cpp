@@ -0,0 +1,562 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Magick++.h>
+
+#include "lib/color.h"
+#include "lib/color_histogram.h"
+#include "lib/color_k_means.h"
+#include "lib/color_space.h"
+#include "lib/cpu_features.h"
+#include "lib/image.h"
+#include "lib/image_get_sample_colors_mode.h"
+#include "lib/palette_evaluation.h"
+#include "lib/sample_weights.h"
+
+#include "tools/tools_common.h"
+
+namespace {
+
+class EvalModes : public Tool {
+ public:
+    static const int default_num_colors = 8;
+    static const int default_num_repeats = 3;
+    // Generated test images are square with sides of this many pixels.
+    static const size_t generated_image_size = 256;
+    static const uint64_t default_generator_seed = 1;
+
+    EvalModes() :
+        help_(false),
+        verbose_(false),
+        pyramid_(false),
+        cpu_features_(false),
+        number_(std::nullopt),
+        modes_(std::nullopt),
+        num_generated_(std::nullopt),
+        num_repeats_(std::nullopt),
+        seed_(std::nullopt),
+        coverage_delta_e_(std::nullopt),
+        input_files_(std::vector<std::string>()),
+        options_string_(std::string()) { }
+
+    // Parse command line input into private members of this EvalModes
+    // object. Return 0 if successful, or return a nonzero int if a fatal
+    // error is encountered.
+    int parse_options(int argc, char **argv) {
+        try {
+            try_parse_options(argc, argv);
+        } catch (cli::MultipleOccurrences &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
+        } catch (cli::UnknownOption &error) {
+            std::cerr << "Error: unrecognized option \""
+                << error.option() << "\"" << std::endl;
+            return exit_more_information();
+        } catch (cli::MissingArgument &error) {
+            std::cerr << "Error: failed to interpret an argument after the "
+                << error.option() << " option" << std::endl;
+            return exit_more_information();
+        } catch (cli::Error &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
+        }
+        return 0;
+    }
+
+    // Evaluate the collected command line options, run every mode over the
+    // corpus, and print a table of their speed and fidelity. Return 0 if
+    // successful, or return a nonzero int if a fatal error is encountered.
+    int run() {
+        if (help_) {
+            return exit_help();
+        }
+        if (cpu_features_) {
+            std::cout << palette::CpuFeatures::report();
+            return 0;
+        }
+        const int num_colors = number_.value_or(default_num_colors);
+        const int num_generated = num_generated_.value_or(0);
+        const int num_repeats = num_repeats_.value_or(default_num_repeats);
+        const double coverage_delta_e = coverage_delta_e_.value_or(
+            palette::PaletteEvaluation::default_coverage_delta_e);
+        if (num_colors <= 0) {
+            std::cerr << "Error: Number of colors must be a positive integer"
+                << std::endl;
+            return exit_more_information();
+        }
+        if ((num_generated < 0) || (num_repeats <= 0)) {
+            std::cerr << "Error: Numbers of generated images and repeats "
+                << "must not be negative" << std::endl;
+            return exit_more_information();
+        }
+        if (input_files_.empty() && (num_generated == 0)) {
+            std::cerr << "Error: No input file or generated images specified"
+                << std::endl;
+            return exit_more_information();
+        }
+        std::vector<Variant> variants;
+        if (!get_variants(variants)) {
+            return exit_more_information();
+        }
+
+        std::vector<std::pair<std::string, Magick::Image>> corpus;
+        for (const std::string &input_file : input_files_) {
+            Magick::Image image;
+            try {
+                image.read(input_file);
+            } catch (Magick::Exception &error) {
+                std::cerr << error.what() << std::endl;
+                return 1;
+            }
+            corpus.emplace_back(input_file, std::move(image));
+        }
+        for (int g = 0; g < num_generated; ++g) {
+            corpus.push_back(generate_image(static_cast<size_t>(g)));
+        }
+
+        if (verbose_) {
+            std::cout << "Kernels in use: "
+                << palette::CpuFeatures::level_to_string(
+                    palette::CpuFeatures::active())
+                << std::endl;
+        }
+        palette::ColorKMeans::Settings settings;
+        settings.seed_ = seed_;
+        std::vector<Totals> totals(variants.size());
+        for (const auto &named_image : corpus) {
+            bool histogram_success = false;
+            const palette::ColorHistogram histogram =
+                palette::Image(named_image.second).get_cached_histogram(
+                    histogram_success);
+            if (!histogram_success) {
+                std::cerr << "Error: failed to read pixels of "
+                    << named_image.first << std::endl;
+                return 1;
+            }
+            for (size_t v = 0; v < variants.size(); ++v) {
+                std::vector<double> milliseconds;
+                std::vector<palette::Color> colors;
+                bool success = true;
+                for (int r = 0; success && (r < num_repeats); ++r) {
+                    // A new image for each run, so that no run reuses the
+                    // histogram that an earlier one cached.
+                    const palette::Image image(named_image.second);
+                    const auto start = std::chrono::steady_clock::now();
+                    colors = variants[v].pyramid_
+                        ? image.get_pyramid_sample_colors(
+                            num_colors, variants[v].mode_,
+                            palette::SampleWeights(), settings, success)
+                        : image.get_sample_colors(
+                            num_colors, variants[v].mode_,
+                            palette::SampleWeights(), settings, success);
+                    milliseconds.push_back(
+                        std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                        .count());
+                }
+                palette::PaletteEvaluation evaluation(coverage_delta_e);
+                if (!success || !evaluation.run(histogram, colors)) {
+                    std::cerr << "Warning: " << variants[v].name_
+                        << " failed on " << named_image.first << std::endl;
+                    ++totals[v].num_failures_;
+                    continue;
+                }
+                std::sort(milliseconds.begin(), milliseconds.end());
+                const double median_milliseconds =
+                    milliseconds[milliseconds.size() / 2];
+                totals[v].add(median_milliseconds, evaluation);
+                if (verbose_) {
+                    std::cout << named_image.first << " "
+                        << variants[v].name_ << ": " << std::fixed
+                        << std::setprecision(1) << median_milliseconds
+                        << " ms, mean " << std::setprecision(2)
+                        << evaluation.get_mean_delta_e() << ", p95 "
+                        << evaluation.get_p95_delta_e() << ", coverage "
+                        << std::setprecision(1)
+                        << (100.0 * evaluation.get_coverage()) << "%"
+                        << std::endl;
+                }
+            }
+        }
+        if (verbose_) {
+            std::cout << std::endl;
+        }
+        print_table(variants, totals);
+        return 0;
+    }
+
+ private:
+    // A mode, optionally run through the image pyramid.
+    struct Variant final {
+        std::string name_;
+        palette::ImageGetSampleColorsMode mode_;
+        bool pyramid_;
+    };
+
+    // Sums of the measurements of one variant over the corpus.
+    struct Totals final {
+        void add(double milliseconds,
+                 const palette::PaletteEvaluation &evaluation) {
+            milliseconds_ += milliseconds;
+            mean_delta_e_ += evaluation.get_mean_delta_e();
+            p95_delta_e_ += evaluation.get_p95_delta_e();
+            coverage_ += evaluation.get_coverage();
+            ++num_images_;
+        }
+
+        double milliseconds_ = 0.0;
+        double mean_delta_e_ = 0.0;
+        double p95_delta_e_ = 0.0;
+        double coverage_ = 0.0;
+        size_t num_images_ = 0;
+        size_t num_failures_ = 0;
+    };
+
+    // Set variants to the selected modes, each also through the pyramid if
+    // requested. Return whether or not every mode is known.
+    bool get_variants(std::vector<Variant> &variants) {
+        std::vector<palette::ImageGetSampleColorsMode> modes;
+        const std::string mode_list = modes_.value_or("all");
+        if (mode_list == "all") {
+            for (auto value : {
+                    palette::ImageGetSampleColorsMode::Value::quantize,
+                    palette::ImageGetSampleColorsMode::Value::
+                        kmeans_random_spread,
+                    palette::ImageGetSampleColorsMode::Value::
+                        kmeans_static_spread,
+                    palette::ImageGetSampleColorsMode::Value::
+                        kmeans_hue_spread,
+                    palette::ImageGetSampleColorsMode::Value::
+                        kmeans_bright_hue_spread,
+                    palette::ImageGetSampleColorsMode::Value::
+                        kmeans_saturated_hue_spread,
+                    palette::ImageGetSampleColorsMode::Value::superpixels}) {
+                modes.emplace_back(value);
+            }
+        } else {
+            std::stringstream mode_stream(mode_list);
+            std::string mode_string;
+            while (std::getline(mode_stream, mode_string, ',')) {
+                palette::ImageGetSampleColorsMode mode(mode_string);
+                if (!mode.valid()) {
+                    std::cerr << "Error: Unknown mode \"" << mode_string
+                        << "\"" << std::endl;
+                    return false;
+                }
+                modes.push_back(mode);
+            }
+        }
+        for (const auto &mode : modes) {
+            variants.push_back(Variant{mode.to_string(), mode, false});
+            if (pyramid_) {
+                variants.push_back(
+                    Variant{mode.to_string() + "+pyramid", mode, true});
+            }
+        }
+        return !variants.empty();
+    }
+
+    // Return the generated test image of the given index, named after its
+    // kind: bands of a few planted colors with noise, a smooth field of
+    // every hue and lightness, or uniform noise.
+    std::pair<std::string, Magick::Image> generate_image(size_t index) {
+        std::mt19937_64 generator(seed_.value_or(default_generator_seed)
+                                  + index);
+        const size_t size = generated_image_size;
+        std::vector<float> red(size * size);
+        std::vector<float> green(size * size);
+        std::vector<float> blue(size * size);
+        std::string kind;
+        switch (index % 3) {
+            case 0: {
+                kind = "bands";
+                const size_t num_bands = 6;
+                std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+                std::normal_distribution<float> noise(0.0f, 0.03f);
+                std::vector<float> band_colors(num_bands * 3);
+                for (float &channel : band_colors) {
+                    channel = unit(generator);
+                }
+                for (size_t i = 0; i < size * size; ++i) {
+                    const size_t band = ((i % size) * num_bands) / size;
+                    red[i] = band_colors[band * 3] + noise(generator);
+                    green[i] = band_colors[(band * 3) + 1] + noise(generator);
+                    blue[i] = band_colors[(band * 3) + 2] + noise(generator);
+                }
+                break;
+            }
+            case 1: {
+                kind = "field";
+                for (size_t i = 0; i < size * size; ++i) {
+                    red[i] = static_cast<float>(i % size) / size;
+                    green[i] = 1.0f;
+                    blue[i] = static_cast<float>(i / size) / size;
+                }
+                palette::ColorSpace(palette::ColorSpace::Value::hsl).to_rgb(
+                    size * size, red.data(), green.data(), blue.data(),
+                    red.data(), green.data(), blue.data());
+                break;
+            }
+            default: {
+                kind = "noise";
+                std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+                for (size_t i = 0; i < size * size; ++i) {
+                    red[i] = unit(generator);
+                    green[i] = unit(generator);
+                    blue[i] = unit(generator);
+                }
+                break;
+            }
+        }
+        std::vector<uint8_t> pixels(size * size * 3);
+        for (size_t i = 0; i < size * size; ++i) {
+            pixels[i * 3] = to_byte(red[i]);
+            pixels[(i * 3) + 1] = to_byte(green[i]);
+            pixels[(i * 3) + 2] = to_byte(blue[i]);
+        }
+        std::stringstream name_stream;
+        name_stream << "generated-" << kind << "-" << index;
+        return std::make_pair(
+            name_stream.str(),
+            Magick::Image(size, size, "RGB", Magick::CharPixel,
+                          pixels.data()));
+    }
+
+    // Return a channel value in [0, 1] as a byte, clamping it first.
+    static uint8_t to_byte(float channel) {
+        return static_cast<uint8_t>(
+            (std::min(1.0f, std::max(0.0f, channel)) * 255.0f) + 0.5f);
+    }
+
+    // Print the time and fidelity of every variant averaged over the images
+    // it succeeded on, marking the variants that no other is both at least
+    // as fast as and at least as faithful to (by mean Delta E) as.
+    void print_table(const std::vector<Variant> &variants,
+                     const std::vector<Totals> &totals) {
+        std::vector<double> milliseconds(variants.size(), 0.0);
+        std::vector<double> mean_delta_e(variants.size(), 0.0);
+        for (size_t v = 0; v < variants.size(); ++v) {
+            if (totals[v].num_images_ > 0) {
+                milliseconds[v] =
+                    totals[v].milliseconds_ / totals[v].num_images_;
+                mean_delta_e[v] =
+                    totals[v].mean_delta_e_ / totals[v].num_images_;
+            }
+        }
+        auto dominated = [&](size_t v) {
+            for (size_t w = 0; w < variants.size(); ++w) {
+                if ((w != v) && (totals[w].num_images_ > 0)
+                    && (milliseconds[w] <= milliseconds[v])
+                    && (mean_delta_e[w] <= mean_delta_e[v])
+                    && ((milliseconds[w] < milliseconds[v])
+                        || (mean_delta_e[w] < mean_delta_e[v]))) {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        std::cout << std::left << std::setw(36) << "variant" << std::right
+            << std::setw(8) << "images" << std::setw(10) << "time ms"
+            << std::setw(10) << "mean dE" << std::setw(10) << "p95 dE"
+            << std::setw(10) << "coverage" << "  pareto" << std::endl;
+        for (size_t v = 0; v < variants.size(); ++v) {
+            const Totals &total = totals[v];
+            std::cout << std::left << std::setw(36) << variants[v].name_
+                << std::right << std::setw(8) << total.num_images_;
+            if (total.num_images_ == 0) {
+                std::cout << "  failed" << std::endl;
+                continue;
+            }
+            const double n = static_cast<double>(total.num_images_);
+            std::cout << std::fixed << std::setprecision(1)
+                << std::setw(10) << milliseconds[v] << std::setprecision(2)
+                << std::setw(10) << mean_delta_e[v]
+                << std::setw(10) << (total.p95_delta_e_ / n)
+                << std::setprecision(1) << std::setw(9)
+                << (100.0 * total.coverage_ / n) << "%"
+                << (dominated(v) ? "" : "  *") << std::endl;
+        }
+    }
+
+    // Initialize ImageMagick for every run but one that prints help or
+    // the processor features.
+    bool uses_magick() { return !help_ && !cpu_features_; }
+
+    // Return the name of the executable file.
+    std::string exec_name() { return EXEC_NAME; }
+
+    // Return description of options constructed by a call to parse_options.
+    std::string options_string() { return options_string_; }
+
+    // Return summary of the functionality of this tool.
+    std::string usage_string() {
+        std::stringstream usage_stream;
+        usage_stream << "Usage: " << exec_name()
+            << " [arguments] [input ...]" << std::endl
+            << "Compare the speed and fidelity of the getcolors modes over "
+            << "a corpus of images." << std::endl << std::endl;
+        usage_stream << "Each mode picks a palette from each image. Its "
+            << "fidelity is the Delta E (1976)" << std::endl
+            << "in CIELAB from each pixel to its nearest palette color, as "
+            << "a mean and a 95th" << std::endl
+            << "percentile, and the share of pixels within the coverage "
+            << "Delta E of a palette" << std::endl
+            << "color. Times are the median of the repeated runs. Variants "
+            << "that no other" << std::endl
+            << "variant beats on both time and mean Delta E are marked as "
+            << "Pareto optimal." << std::endl;
+        return usage_stream.str();
+    }
+
+    // Return description of specific examples of using this tool.
+    std::string examples_string() {
+        std::stringstream examples_stream;
+        examples_stream << "Examples: " << exec_name()
+            << " -g 6 resources/photographs/*.png" << std::endl;
+        examples_stream << "      or: " << exec_name()
+            << " -p -n 12 -m kmeans-static-spread,quantize photo.jpg"
+            << std::endl;
+        examples_stream << "      or: " << palette::CpuFeatures::
+            override_variable << "=baseline " << exec_name() << " -g 6"
+            << std::endl;
+        return examples_stream.str();
+    }
+
+    // Create names and a description for each command line option.
+    void create_options(cli::OptionsDescription &opt,
+                        cli::PositionalOptionsDescription &pos_opt) {
+        const char *help_chars = "Print this help message and exit";
+        const char *verbose_chars =
+            "Print the measurements of every image as well";
+
+        std::stringstream number_stream;
+        number_stream << "Number of colors in each palette (default "
+            << default_num_colors << ")";
+        std::string number_string = number_stream.str();
+        const char *number_chars = number_string.c_str();
+        const auto *number_semantic(cli::value<int>());
+
+        const char *mode_chars = "Comma-separated list of modes to compare "
+            "(default all)";
+        const auto *mode_semantic(cli::value<std::string>());
+
+        const char *pyramid_chars =
+            "Also run each mode through the image pyramid";
+
+        const char *cpu_features_chars = "Print the detected processor "
+            "features and the kernels in use, and exit";
+
+        std::stringstream generated_stream;
+        generated_stream << "Add this many generated " << generated_image_size
+            << "x" << generated_image_size << " test images to the corpus";
+        std::string generated_string = generated_stream.str();
+        const char *generated_chars = generated_string.c_str();
+        const auto *generated_semantic(cli::value<int>());
+
+        std::stringstream repeats_stream;
+        repeats_stream << "Run each mode this many times on each image "
+            << "(default " << default_num_repeats << ")";
+        std::string repeats_string = repeats_stream.str();
+        const char *repeats_chars = repeats_string.c_str();
+        const auto *repeats_semantic(cli::value<int>());
+
+        const char *seed_chars = "Seed for kmeans-random-spread and the "
+            "generated images";
+        const auto *seed_semantic(cli::value<uint64_t>());
+
+        std::stringstream coverage_stream;
+        coverage_stream << "Delta E within which a pixel counts as covered "
+            << "(default "
+            << palette::PaletteEvaluation::default_coverage_delta_e << ")";
+        std::string coverage_string = coverage_stream.str();
+        const char *coverage_chars = coverage_string.c_str();
+        const auto *coverage_semantic(cli::value<double>());
+
+        const char *input_chars = "Specify an additional input image file";
+        const auto *input_semantic(cli::value<std::vector<std::string>>());
+
+        opt.add_options()
+            ("help,h", help_chars)
+            ("verbose,v", verbose_chars)
+            ("number,n", number_semantic, number_chars)
+            ("mode,m", mode_semantic, mode_chars)
+            ("pyramid,p", pyramid_chars)
+            ("cpu-features", cpu_features_chars)
+            ("generated,g", generated_semantic, generated_chars)
+            ("repeats,r", repeats_semantic, repeats_chars)
+            ("seed,S", seed_semantic, seed_chars)
+            ("coverage,c", coverage_semantic, coverage_chars)
+            ("input,I", input_semantic, input_chars);
+        pos_opt.add("input", -1);
+
+        std::stringstream options_stream;
+        options_stream << opt;
+        options_string_ = options_stream.str();
+    }
+
+    // Set private fields of this EvalModes object from the command line
+    // options.
+    void set_options(const cli::VariablesMap &var_map) {
+        help_ |= !var_map["help"].empty();
+        verbose_ |= !var_map["verbose"].empty();
+        pyramid_ |= !var_map["pyramid"].empty();
+        cpu_features_ |= !var_map["cpu-features"].empty();
+        if (!var_map["number"].empty()) {
+            number_ = std::optional<int>(var_map["number"].as<int>());
+        }
+        if (!var_map["mode"].empty()) {
+            modes_ = std::optional<std::string>(
+                var_map["mode"].as<std::string>());
+        }
+        if (!var_map["generated"].empty()) {
+            num_generated_ =
+                std::optional<int>(var_map["generated"].as<int>());
+        }
+        if (!var_map["repeats"].empty()) {
+            num_repeats_ = std::optional<int>(var_map["repeats"].as<int>());
+        }
+        if (!var_map["seed"].empty()) {
+            seed_ = std::optional<uint64_t>(var_map["seed"].as<uint64_t>());
+        }
+        if (!var_map["coverage"].empty()) {
+            coverage_delta_e_ =
+                std::optional<double>(var_map["coverage"].as<double>());
+        }
+        if (!var_map["input"].empty()) {
+            auto input_opts =
+                var_map["input"].as<std::vector<std::string>>();
+            input_files_.insert(
+                input_files_.end(), input_opts.begin(), input_opts.end());
+        }
+    }
+
+    bool help_;
+    bool verbose_;
+    bool pyramid_;
+    bool cpu_features_;
+    std::optional<int> number_;
+    std::optional<std::string> modes_;
+    std::optional<int> num_generated_;
+    std::optional<int> num_repeats_;
+    std::optional<uint64_t> seed_;
+    std::optional<double> coverage_delta_e_;
+    std::vector<std::string> input_files_;
+    std::string options_string_;
+};
+}  // namespace
+
+int main(int argc, char **argv) {
+    EvalModes evalmodes_state;
+    return evalmodes_state.main(argc, argv);
+}
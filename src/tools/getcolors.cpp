@@ -1,24 +1,36 @@
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iomanip>
 #include <iostream>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
-#include <boost/program_options.hpp>
-
 #include <Magick++.h>
 
+#include "lib/blob_stream.h"
+#include "lib/cluster_count_criterion.h"
+#include "lib/cluster_count_search.h"
 #include "lib/color.h"
+#include "lib/color_histogram.h"
+#include "lib/color_k_means.h"
 #include "lib/color_vector.h"
+#include "lib/cpu_features.h"
 #include "lib/image.h"
 #include "lib/image_get_sample_colors_mode.h"
+#include "lib/image_sequence.h"
+#include "lib/memory_budget.h"
+#include "lib/parallel.h"
+#include "lib/sample_weights.h"
+#include "lib/superpixels.h"
 
 #include "tools/tools_common.h"
 
 namespace {
 
-namespace bpo = boost::program_options;
-
 class GetColors : public Tool {
  public:
     static const size_t default_quantize_tree_depth = 8;
@@ -26,10 +38,27 @@ class GetColors : public Tool {
     GetColors() :
         help_(false),
         verbose_(false),
+        cpu_features_(false),
         mode_(std::nullopt),
+        number_(std::nullopt),
         max_num_colors_(std::nullopt),
+        auto_num_colors_range_(std::nullopt),
+        criterion_(std::nullopt),
         quantize_tree_depth_(std::nullopt),
+        regions_(),
+        mask_file_(std::nullopt),
+        center_weighted_(false),
+        pyramid_(false),
+        frames_(std::nullopt),
+        num_restarts_(std::nullopt),
+        seed_(std::nullopt),
+        max_pixels_(std::nullopt),
+        decode_size_(std::nullopt),
+        max_memory_(std::nullopt),
+        superpixel_size_(std::nullopt),
+        label_map_file_(std::nullopt),
         input_file_(std::nullopt),
+        input_blob_(),
         options_string_(std::string()) { }
 
     // Parse command line input into private members of this GetColors
@@ -38,16 +67,19 @@ class GetColors : public Tool {
     int parse_options(int argc, char **argv) {
         try {
             try_parse_options(argc, argv);
-        } catch (bpo::too_many_positional_options_error &error) {
+        } catch (cli::TooManyPositionals &error) {
             std::cerr << "Error: more than one input file specified"
                 << std::endl;
             return exit_more_information();
-        } catch (bpo::unknown_option &error) {
+        } catch (cli::UnknownOption &error) {
             std::cerr << "Error: " << error.what() << std::endl;
             return exit_more_information();
-        } catch (bpo::invalid_command_line_syntax &error) {
+        } catch (cli::MissingArgument &error) {
             std::cerr << "Error: failed to interpret an argument after the "
-                << error.tokens() << " option" << std::endl;
+                << error.option() << " option" << std::endl;
+            return exit_more_information();
+        } catch (cli::Error &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
             return exit_more_information();
         }
         return 0;
@@ -65,6 +97,10 @@ class GetColors : public Tool {
         if (help_) {
             return exit_help();
         }
+        if (cpu_features_) {
+            std::cout << palette::CpuFeatures::report();
+            return 0;
+        }
         if (!mode_.has_value()) {
             std::cerr << "Error: No mode specified" << std::endl;
             return exit_more_information();
@@ -73,13 +109,34 @@ class GetColors : public Tool {
             std::cerr << "Error: No input file specified" << std::endl;
             return exit_more_information();
         }
-        if (!max_num_colors_.has_value()) {
+        if (reading_stdin()) {
+            std::stringstream error_stream;
+            if (!palette::BlobStream::read(std::cin, input_blob_,
+                                           error_stream)) {
+                std::cerr << "Error: " << error_stream.str();
+                return 1;
+            }
+        }
+        if (!number_.has_value()) {
             std::cerr << "Error: No number of colors specified" << std::endl;
             return exit_more_information();
         }
-        if (*max_num_colors_ <= 0) {
-            std::cerr << "Error: Number of colors must be a positive integer"
-                << std::endl;
+        if (!parse_number(number_.value())) {
+            std::cerr << "Error: Number of colors must be a positive integer "
+                << "or auto[:MIN-MAX]" << std::endl;
+            return exit_more_information();
+        }
+        palette::ClusterCountCriterion criterion(criterion_.value_or(
+            palette::ClusterCountCriterion::value_to_string(
+                palette::ClusterCountCriterion::Value::silhouette)));
+        if (!criterion.valid()) {
+            std::cerr << "Error: Unknown criterion \"" << criterion_.value()
+                << "\"" << std::endl;
+            return exit_more_information();
+        }
+        if (num_restarts_.value_or(1) <= 0) {
+            std::cerr << "Error: Number of restarts must be a positive "
+                << "integer" << std::endl;
             return exit_more_information();
         }
         int quantize_tree_depth = quantize_tree_depth_.value_or(
@@ -90,26 +147,437 @@ class GetColors : public Tool {
             quantize_tree_depth = static_cast<int>(default_quantize_tree_depth);
         }
 
+        if (frames_.has_value()) {
+            if (auto_num_colors_range_.has_value()) {
+                std::cerr << "Error: automatic number of colors cannot be "
+                    << "combined with frames" << std::endl;
+                return exit_more_information();
+            }
+            return run_frames(quantize_tree_depth);
+        }
+
+        const int num_read_limits = (max_pixels_.has_value() ? 1 : 0)
+            + (decode_size_.has_value() ? 1 : 0)
+            + (max_memory_.has_value() ? 1 : 0);
+        if (num_read_limits > 1) {
+            std::cerr << "Error: only one of max-pixels, decode-size and "
+                << "max-memory may be specified" << std::endl;
+            return exit_more_information();
+        }
+        if (max_pixels_.value_or(1) == 0) {
+            std::cerr << "Error: Maximum number of pixels must be a positive "
+                << "integer" << std::endl;
+            return exit_more_information();
+        }
+        uint64_t max_memory = 0;
+        if (max_memory_.has_value()
+            && !palette::MemoryBudget::parse(max_memory_.value(),
+                                             max_memory)) {
+            std::cerr << "Error: Maximum memory must be a positive size, "
+                << "optionally followed by K, M, G or T" << std::endl;
+            return exit_more_information();
+        }
+        palette::MemoryBudget budget(max_memory);
+        budget.apply_magick_limits();
+
         // Load image from input file.
         palette::Image image;
+        Magick::Geometry original_size;
+        if (!read_image(image, budget, original_size)) {
+            return 1;
+        }
+        image.get().quantizeTreeDepth(quantize_tree_depth);
+
+        std::vector<palette::ImageGetSampleColorsMode> modes;
+        if (!parse_modes(modes)) {
+            return 1;
+        }
+        if (superpixel_size_.value_or(1) <= 0) {
+            std::cerr << "Error: Superpixel size must be a positive integer"
+                << std::endl;
+            return exit_more_information();
+        }
+        if (label_map_file_.has_value()
+            && ((modes.size() > 1) || pyramid_
+                || (modes.front().get_value()
+                    != palette::ImageGetSampleColorsMode::Value::
+                        superpixels))) {
+            std::cerr << "Error: a label map needs the superpixels mode "
+                << "alone, without pyramid" << std::endl;
+            return exit_more_information();
+        }
+
+        palette::SampleWeights weights;
+        if (!get_sample_weights(weights)) {
+            return 1;
+        }
+        // Regions are given in pixels of the file, not of the decoded image.
+        const size_t columns = image.get().columns();
+        const size_t rows = image.get().rows();
+        if ((columns != original_size.width())
+            || (rows != original_size.height())) {
+            weights = weights.scaled(
+                static_cast<double>(columns) / original_size.width(),
+                static_cast<double>(rows) / original_size.height());
+        }
+
+        const palette::ColorKMeans::Settings settings = get_kmeans_settings();
+        std::vector<size_t> mode_num_colors(modes.size(), 0);
+        for (size_t m = 0; m < modes.size(); ++m) {
+            if (!auto_num_colors_range_.has_value()) {
+                mode_num_colors[m] = static_cast<size_t>(*max_num_colors_);
+            } else if (!choose_num_colors(image, modes[m], weights, settings,
+                                          criterion, mode_num_colors[m])) {
+                return 1;
+            }
+        }
+        if (modes.size() > 1) {
+            const int result = run_modes(image, modes, mode_num_colors,
+                                         weights, settings, budget);
+            report_memory(budget);
+            return result;
+        }
+        bool get_sample_colors_success = false;
+        std::vector<palette::Color> sample_colors = get_sample_colors(
+            image, modes.front(), mode_num_colors.front(), weights, settings,
+            budget, get_sample_colors_success);
+        report_memory(budget);
+        if (!get_sample_colors_success) {
+            std::cerr << "Getting color subset failed" << std::endl;
+            return 1;
+        }
+        std::sort(sample_colors.begin(), sample_colors.end());
+        palette::ColorVector output_colors(std::move(sample_colors));
+        std::cout << output_colors.to_string("\n") << std::endl;
+        return 0;
+    }
+
+ private:
+    // Get colors with every mode concurrently, and list the colors of each
+    // under a heading with the mode and the time it took. The modes share
+    // the histogram and HSL values cached by the image. Under a memory
+    // budget, which each mode checks its own peak against, the modes run
+    // one at a time instead so that together they stay within it. Return
+    // 0 if successful, or return a nonzero int if any mode fails.
+    int run_modes(const palette::Image &image,
+                  const std::vector<palette::ImageGetSampleColorsMode> &modes,
+                  const std::vector<size_t> &mode_num_colors,
+                  const palette::SampleWeights &weights,
+                  const palette::ColorKMeans::Settings &settings,
+                  palette::MemoryBudget &budget) {
+        std::vector<std::vector<palette::Color>> mode_colors(modes.size());
+        std::vector<char> mode_success(modes.size(), false);
+        std::vector<double> mode_milliseconds(modes.size(), 0.0);
+        const size_t max_threads = budget.limited() ? 1 : 0;
+        if (modes.size() > 1) {
+            budget.note("modes: ran one at a time, each within the budget");
+        }
+        palette::Parallel::run(modes.size(), [&](size_t m) {
+            const auto start = std::chrono::steady_clock::now();
+            // An exception must not leave the thread, which would terminate
+            // the process; the mode is reported as failed instead.
+            bool success = false;
+            try {
+                mode_colors[m] = get_sample_colors(
+                    image, modes[m], mode_num_colors[m], weights, settings,
+                    budget, success);
+            } catch (Magick::Exception &error) {
+                std::cerr << error.what() << std::endl;
+                success = false;
+            }
+            mode_success[m] = success;
+            mode_milliseconds[m] = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+        }, max_threads);
+
+        int result = 0;
+        for (size_t m = 0; m < modes.size(); ++m) {
+            if (m > 0) {
+                std::cout << std::endl;
+            }
+            std::cout << modes[m].to_string() << " (" << std::fixed
+                << std::setprecision(1) << mode_milliseconds[m] << " ms)"
+                << std::endl;
+            if (!mode_success[m]) {
+                std::cerr << "Getting color subset failed for mode "
+                    << modes[m].to_string() << std::endl;
+                result = 1;
+                continue;
+            }
+            std::sort(mode_colors[m].begin(), mode_colors[m].end());
+            palette::ColorVector output_colors(std::move(mode_colors[m]));
+            std::cout << output_colors.to_string("\n") << std::endl;
+        }
+        return result;
+    }
+
+    // Choose the number of colors for a mode by clustering the colors it
+    // samples, weighted the way it weighs them, with every number in the
+    // automatic range. Return whether or not a number could be chosen.
+    bool choose_num_colors(const palette::Image &image,
+                           palette::ImageGetSampleColorsMode mode,
+                           const palette::SampleWeights &weights,
+                           const palette::ColorKMeans::Settings &settings,
+                           const palette::ClusterCountCriterion &criterion,
+                           size_t &num_colors) const {
+        bool histogram_success = false;
+        const palette::ColorHistogram histogram =
+            image.get_mode_sample_histogram(mode, weights, settings,
+                                            histogram_success);
+        palette::ClusterCountSearch search(
+            auto_num_colors_range_->first, auto_num_colors_range_->second,
+            criterion);
+        std::stringstream error_stream;
+        if (!histogram_success
+            || !search.run(histogram, settings, error_stream)) {
+            std::cerr << error_stream.str();
+            std::cerr << "Choosing number of colors failed for mode "
+                << mode.to_string() << std::endl;
+            return false;
+        }
+        if (verbose_) {
+            std::cout << "Number of colors for mode " << mode.to_string()
+                << std::endl << search.to_string();
+        }
+        num_colors = search.get_best_num_clusters();
+        return true;
+    }
+
+    // Get colors from the image with one mode, through the image pyramid
+    // if requested, which samples small copies of the image anyway, or else
+    // within the memory budget. The superpixels mode follows the superpixel
+    // options and writes the label map if requested.
+    std::vector<palette::Color> get_sample_colors(
+        const palette::Image &image, palette::ImageGetSampleColorsMode mode,
+        size_t num_colors, const palette::SampleWeights &weights,
+        const palette::ColorKMeans::Settings &settings,
+        palette::MemoryBudget &budget, bool &success) const {
+        if (pyramid_) {
+            return image.get_pyramid_sample_colors(
+                num_colors, mode, weights, settings, success);
+        }
+        std::vector<palette::Color> sample_colors;
+        if (mode.get_value()
+            == palette::ImageGetSampleColorsMode::Value::superpixels) {
+            palette::Superpixels::Settings superpixel_settings;
+            superpixel_settings.region_size_ = static_cast<size_t>(
+                superpixel_size_.value_or(static_cast<int>(
+                    palette::Superpixels::default_region_size)));
+            palette::Superpixels superpixels(superpixel_settings);
+            success = image.get_superpixel_colors(
+                num_colors, weights, settings, budget, superpixels,
+                sample_colors);
+            if (success && label_map_file_.has_value()) {
+                success = write_label_map(superpixels, sample_colors);
+            }
+            return sample_colors;
+        }
+        success = image.get_sample_colors(num_colors, mode, weights,
+                                          settings, budget, sample_colors);
+        return sample_colors;
+    }
+
+    // Write an image of the superpixels, each filled with its nearest
+    // color. Return whether or not it could be written.
+    bool write_label_map(const palette::Superpixels &superpixels,
+                         const std::vector<palette::Color> &colors) const {
         try {
-            image.get().read(input_file_.value());
+            Magick::Image label_map = superpixels.to_magick_image(colors);
+            label_map.write(label_map_file_.value());
         } catch (Magick::Exception &error) {
             std::cerr << error.what() << std::endl;
-            return 1;
+            return false;
         }
-        image.get().quantizeTreeDepth(quantize_tree_depth);
+        if (verbose_) {
+            std::cout << "Wrote label map of " << superpixels.regions().size()
+                << " superpixels to " << label_map_file_.value()
+                << std::endl;
+        }
+        return true;
+    }
 
-        palette::ImageGetSampleColorsMode mode(mode_.value());
-        if (!mode.valid()) {
+    // Print the path each stage took within a limited memory budget: all
+    // of them to stdout when verbose, or else those that fell back to an
+    // approximate path to stderr.
+    void report_memory(const palette::MemoryBudget &budget) const {
+        if (!budget.limited()) {
+            return;
+        }
+        if (verbose_) {
+            std::cout << budget.to_string();
+            return;
+        }
+        const auto decisions = budget.decisions();
+        if (std::any_of(decisions.begin(), decisions.end(),
+                        [](const palette::MemoryBudget::Decision &decision) {
+                            return decision.path_
+                                != palette::MemoryBudget::Path::full;
+                        })) {
+            std::cerr << budget.to_string();
+        }
+    }
+
+    // Parse the mode option as one mode, a comma-separated list of modes, or
+    // "all". Return whether or not every mode is known.
+    bool parse_modes(std::vector<palette::ImageGetSampleColorsMode> &modes) {
+        modes.clear();
+        if (mode_.value() == "all") {
+            for (auto value : {
+                    palette::ImageGetSampleColorsMode::Value::quantize,
+                    palette::ImageGetSampleColorsMode::Value::
+                        kmeans_random_spread,
+                    palette::ImageGetSampleColorsMode::Value::
+                        kmeans_static_spread,
+                    palette::ImageGetSampleColorsMode::Value::
+                        kmeans_hue_spread,
+                    palette::ImageGetSampleColorsMode::Value::
+                        kmeans_bright_hue_spread,
+                    palette::ImageGetSampleColorsMode::Value::
+                        kmeans_saturated_hue_spread,
+                    palette::ImageGetSampleColorsMode::Value::superpixels}) {
+                modes.emplace_back(value);
+            }
+            return true;
+        }
+        std::stringstream mode_list(mode_.value());
+        std::string mode_string;
+        while (std::getline(mode_list, mode_string, ',')) {
+            palette::ImageGetSampleColorsMode mode(mode_string);
+            if (!mode.valid()) {
+                std::cerr << "Unknown mode \"" << mode_string << "\""
+                    << std::endl;
+                return false;
+            }
+            modes.push_back(mode);
+        }
+        if (modes.empty()) {
             std::cerr << "Unknown mode \"" << mode_.value() << "\""
                 << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Parse the number option as either a positive number of colors or
+    // "auto" with an optional range "auto:MIN-MAX". Return whether or not
+    // the option is valid.
+    bool parse_number(const std::string &number) {
+        const std::string auto_prefix = "auto";
+        if (number.compare(0, auto_prefix.size(), auto_prefix) == 0) {
+            std::pair<int, int> range(
+                palette::ClusterCountSearch::default_min_clusters,
+                palette::ClusterCountSearch::default_max_clusters);
+            const std::string rest = number.substr(auto_prefix.size());
+            if (!rest.empty()) {
+                const size_t dash = rest.find('-');
+                if ((rest[0] != ':') || (dash == std::string::npos)
+                    || !parse_positive(rest.substr(1, dash - 1), range.first)
+                    || !parse_positive(rest.substr(dash + 1), range.second)
+                    || (range.first > range.second)) {
+                    return false;
+                }
+            }
+            auto_num_colors_range_ = range;
+            return true;
+        }
+        int num_colors = 0;
+        if (!parse_positive(number, num_colors)) {
+            return false;
+        }
+        max_num_colors_ = num_colors;
+        return true;
+    }
+
+    // Parse a whole string as a positive integer. Return whether or not it
+    // is one.
+    static bool parse_positive(const std::string &text, int &value) {
+        size_t end = 0;
+        try {
+            value = std::stoi(text, &end);
+        } catch (std::exception &error) {
+            return false;
+        }
+        return (end == text.size()) && (value > 0);
+    }
+
+    // Read every frame of the input file and list colors of each frame, one
+    // line per frame, or of all frames together. Return 0 if successful, or
+    // return a nonzero int if a fatal error is encountered.
+    int run_frames(int quantize_tree_depth) {
+        const bool per_frame = (frames_.value() == "per-frame");
+        if (!per_frame && (frames_.value() != "merged")) {
+            std::cerr << "Error: unknown frames option \"" << frames_.value()
+                << "\"" << std::endl;
+            return exit_more_information();
+        }
+        if (pyramid_) {
+            std::cerr << "Error: pyramid cannot be combined with frames"
+                << std::endl;
+            return exit_more_information();
+        }
+        if (max_pixels_.has_value() || decode_size_.has_value()
+            || max_memory_.has_value()) {
+            std::cerr << "Error: decoding at a smaller size cannot be "
+                << "combined with frames" << std::endl;
+            return exit_more_information();
+        }
+        if (superpixel_size_.has_value() || label_map_file_.has_value()) {
+            std::cerr << "Error: superpixel options cannot be combined with "
+                << "frames" << std::endl;
+            return exit_more_information();
+        }
+
+        palette::ImageSequence sequence;
+        std::stringstream error_stream;
+        const bool read_success = reading_stdin()
+            ? sequence.read(input_blob_, error_stream)
+            : sequence.read(input_file_.value(), error_stream);
+        if (!read_success) {
+            std::cerr << error_stream.str();
+            return 1;
+        }
+        for (size_t f = 0; f < sequence.size(); ++f) {
+            sequence.frame(f).get().quantizeTreeDepth(quantize_tree_depth);
+        }
+
+        std::vector<palette::ImageGetSampleColorsMode> modes;
+        if (!parse_modes(modes)) {
             return 1;
         }
+        if (modes.size() > 1) {
+            std::cerr << "Error: only one mode can be combined with frames"
+                << std::endl;
+            return exit_more_information();
+        }
+        const palette::ImageGetSampleColorsMode &mode = modes.front();
+
+        palette::SampleWeights weights;
+        if (!get_sample_weights(weights)) {
+            return 1;
+        }
+
+        const palette::ColorKMeans::Settings settings = get_kmeans_settings();
+        if (per_frame) {
+            std::vector<std::vector<palette::Color>> frame_colors;
+            if (!sequence.get_frame_sample_colors(*max_num_colors_, mode,
+                                                  weights, settings,
+                                                  frame_colors)) {
+                std::cerr << "Getting color subset failed" << std::endl;
+                return 1;
+            }
+            for (auto &colors : frame_colors) {
+                std::sort(colors.begin(), colors.end());
+                palette::ColorVector output_colors(std::move(colors));
+                std::cout << output_colors.to_string(" ") << std::endl;
+            }
+            return 0;
+        }
 
         bool get_sample_colors_success = false;
-        std::vector<palette::Color> sample_colors = image.get_sample_colors(
-            *max_num_colors_, mode, get_sample_colors_success);
+        std::vector<palette::Color> sample_colors =
+            sequence.get_merged_sample_colors(
+                *max_num_colors_, mode, weights, settings,
+                get_sample_colors_success);
         if (!get_sample_colors_success) {
             std::cerr << "Getting color subset failed" << std::endl;
             return 1;
@@ -120,7 +588,130 @@ class GetColors : public Tool {
         return 0;
     }
 
- private:
+    // Return whether or not the input image is read from standard input.
+    bool reading_stdin() const { return input_file_.value_or("") == "-"; }
+
+    // Read the input file, scaled down while decoding if the max-pixels or
+    // decode-size option is set or it does not fit within a limited memory
+    // budget, and set original_size to its size in the file. Return whether
+    // or not the image could be read.
+    bool read_image(palette::Image &image, palette::MemoryBudget &budget,
+                    Magick::Geometry &original_size) {
+        std::stringstream error_stream;
+        bool success = true;
+        if (budget.limited()) {
+            success = reading_stdin()
+                ? image.read(input_blob_, budget, original_size, error_stream)
+                : image.read(input_file_.value(), budget, original_size,
+                             error_stream);
+        } else if (max_pixels_.has_value()) {
+            const auto max_pixels = static_cast<size_t>(max_pixels_.value());
+            success = reading_stdin()
+                ? image.read(input_blob_, max_pixels, original_size,
+                             error_stream)
+                : image.read(input_file_.value(), max_pixels, original_size,
+                             error_stream);
+        } else if (decode_size_.has_value()) {
+            Magick::Geometry decode_size;
+            try {
+                decode_size = Magick::Geometry(decode_size_.value());
+            } catch (Magick::Exception &error) {
+                decode_size.isValid(false);
+            }
+            if (!decode_size.isValid()) {
+                std::cerr << "Error: invalid decode size \""
+                    << decode_size_.value() << "\"" << std::endl;
+                return false;
+            }
+            success = reading_stdin()
+                ? image.read(input_blob_, decode_size, original_size,
+                             error_stream)
+                : image.read(input_file_.value(), decode_size,
+                             original_size, error_stream);
+        } else if (reading_stdin()) {
+            success = image.read(input_blob_, error_stream);
+            original_size = Magick::Geometry(image.get().columns(),
+                                             image.get().rows());
+        } else {
+            try {
+                image.get().read(input_file_.value());
+            } catch (Magick::Exception &error) {
+                std::cerr << error.what() << std::endl;
+                return false;
+            }
+            original_size = Magick::Geometry(image.get().columns(),
+                                             image.get().rows());
+        }
+        if (!success) {
+            std::cerr << error_stream.str();
+            return false;
+        }
+        if (verbose_) {
+            std::cout << "Read " << image.get().columns() << "x"
+                << image.get().rows() << " pixels of "
+                << original_size.width() << "x" << original_size.height()
+                << " image" << std::endl;
+        }
+        return true;
+    }
+
+    // Return k-means settings from the restarts and seed options.
+    palette::ColorKMeans::Settings get_kmeans_settings() const {
+        palette::ColorKMeans::Settings settings;
+        settings.num_restarts_ =
+            static_cast<size_t>(num_restarts_.value_or(1));
+        settings.seed_ = seed_;
+        return settings;
+    }
+
+    // Build the pixel weights selected by the region, mask and
+    // center-weighted options. Return whether or not the options are
+    // consistent and any mask image could be read.
+    bool get_sample_weights(palette::SampleWeights &weights) {
+        const int num_weightings = (regions_.empty() ? 0 : 1)
+            + (mask_file_.has_value() ? 1 : 0) + (center_weighted_ ? 1 : 0);
+        if (num_weightings > 1) {
+            std::cerr << "Error: only one of region, mask and "
+                << "center-weighted may be specified" << std::endl;
+            return false;
+        }
+        if (!regions_.empty()) {
+            std::vector<Magick::Geometry> regions;
+            for (const std::string &region : regions_) {
+                Magick::Geometry geometry;
+                try {
+                    geometry = Magick::Geometry(region);
+                } catch (Magick::Exception &error) {
+                    geometry.isValid(false);
+                }
+                if (!geometry.isValid()) {
+                    std::cerr << "Error: invalid region \"" << region
+                        << "\"" << std::endl;
+                    return false;
+                }
+                regions.push_back(geometry);
+            }
+            weights = palette::SampleWeights(regions);
+        } else if (mask_file_.has_value()) {
+            Magick::Image mask;
+            try {
+                mask.read(mask_file_.value());
+            } catch (Magick::Exception &error) {
+                std::cerr << error.what() << std::endl;
+                return false;
+            }
+            weights = palette::SampleWeights(mask);
+        } else if (center_weighted_) {
+            weights = palette::SampleWeights::center_weighted(
+                palette::SampleWeights::default_center_spread);
+        }
+        return true;
+    }
+
+    // Initialize ImageMagick for every run but one that prints help or
+    // the processor features.
+    bool uses_magick() { return !help_ && !cpu_features_; }
+
     // Return the name of the executable file.
     std::string exec_name() { return EXEC_NAME; }
 
@@ -143,12 +734,22 @@ class GetColors : public Tool {
             << " -n 4 -I input.png" << std::endl;
         examples_stream << "      or: " << exec_name()
             << " --number 24 input.gif" << std::endl;
+        examples_stream << "      or: " << exec_name()
+            << " -m kmeans-static-spread -n 6 -r 200x100+40+40 input.png"
+            << std::endl;
+        examples_stream << "      or: " << exec_name()
+            << " -m kmeans-static-spread -n auto:3-10 -v input.jpg"
+            << std::endl;
+        examples_stream << "      or: " << exec_name()
+            << " -m superpixels -n 8 -L regions.png input.jpg" << std::endl;
+        examples_stream << "      or: curl -s URL | " << exec_name()
+            << " -m kmeans-static-spread -n 6 -P 1000000 -" << std::endl;
         return examples_stream.str();
     }
 
     // Create names and a description for each command line option.
-    void create_options(bpo::options_description &opt,
-                        bpo::positional_options_description &pos_opt) {
+    void create_options(cli::OptionsDescription &opt,
+                        cli::PositionalOptionsDescription &pos_opt) {
         const char *help_chars = "Print this help message and exit";
         const char *verbose_chars = "Print extra information to stdout";
 
@@ -159,17 +760,35 @@ class GetColors : public Tool {
             << "kmeans-static-spread" << ", "
             << "kmeans-hue-spread" << ", "
             << "kmeans-bright-hue-spread" << ", "
-            << "kmeans-saturated-hue-spread" << ")";
+            << "kmeans-saturated-hue-spread" << ", "
+            << "superpixels" << "), a comma-separated "
+            << "list of methods, or \"all\" to compare every method";
         std::string mode_string = mode_stream.str();
         const char *mode_chars = mode_string.c_str();
-        const auto *mode_semantic(bpo::value<std::string>());
+        const auto *mode_semantic(cli::value<std::string>());
 
         std::stringstream number_stream;
         number_stream << "Specify maximum number of colors to list "
-            "from the image";
+            "from the image, or \"auto\" to choose one between "
+            << palette::ClusterCountSearch::default_min_clusters << " and "
+            << palette::ClusterCountSearch::default_max_clusters
+            << " or within a range given as \"auto:MIN-MAX\"";
         std::string number_string = number_stream.str();
         const char *number_chars = number_string.c_str();
-        const auto *number_semantic(bpo::value<int>());
+        const auto *number_semantic(cli::value<std::string>());
+
+        std::stringstream criterion_stream;
+        criterion_stream << "Criterion for an automatic number of colors ("
+            << palette::ClusterCountCriterion::value_to_string(
+                palette::ClusterCountCriterion::Value::elbow) << ", "
+            << palette::ClusterCountCriterion::value_to_string(
+                palette::ClusterCountCriterion::Value::silhouette)
+            << "; default "
+            << palette::ClusterCountCriterion::value_to_string(
+                palette::ClusterCountCriterion::Value::silhouette) << ")";
+        std::string criterion_string = criterion_stream.str();
+        const char *criterion_chars = criterion_string.c_str();
+        const auto *criterion_semantic(cli::value<std::string>());
 
         std::stringstream depth_stream;
         depth_stream << "Specify depth of tree used "
@@ -177,13 +796,100 @@ class GetColors : public Tool {
             << default_quantize_tree_depth << ")";
         std::string depth_string = depth_stream.str();
         const char *depth_chars = depth_string.c_str();
-        const auto *depth_semantic(bpo::value<int>());
+        const auto *depth_semantic(cli::value<int>());
+
+        std::stringstream region_stream;
+        region_stream << "Only sample pixels inside a region given as "
+            << "WIDTHxHEIGHT+X+Y; may be repeated";
+        std::string region_string = region_stream.str();
+        const char *region_chars = region_string.c_str();
+        const auto *region_semantic(cli::value<std::vector<std::string>>());
+
+        std::stringstream mask_stream;
+        mask_stream << "Weigh each pixel by the intensity of a mask image, "
+            << "which is stretched to the size of the input image";
+        std::string mask_string = mask_stream.str();
+        const char *mask_chars = mask_string.c_str();
+        const auto *mask_semantic(cli::value<std::string>());
+
+        const char *center_chars =
+            "Weigh pixels near the center of the image more heavily";
+
+        std::stringstream pyramid_stream;
+        pyramid_stream << "Run the mode on a copy of the image scaled down to "
+            << palette::Image::pyramid_base_size << " pixels, then refine "
+            << "the colors at each larger size";
+        std::string pyramid_string = pyramid_stream.str();
+        const char *pyramid_chars = pyramid_string.c_str();
+
+        std::stringstream frames_stream;
+        frames_stream << "Read every frame of an animation or image "
+            << "sequence and list colors of each frame on its own line "
+            << "(per-frame) or of all frames together (merged)";
+        std::string frames_string = frames_stream.str();
+        const char *frames_chars = frames_string.c_str();
+        const auto *frames_semantic(cli::value<std::string>());
+
+        std::stringstream restarts_stream;
+        restarts_stream << "Run kmeans-random-spread this many times in "
+            << "parallel and keep the tightest clusters (default 1)";
+        std::string restarts_string = restarts_stream.str();
+        const char *restarts_chars = restarts_string.c_str();
+        const auto *restarts_semantic(cli::value<int>());
+
+        std::stringstream seed_stream;
+        seed_stream << "Seed for kmeans-random-spread, making its results "
+            << "reproducible";
+        std::string seed_string = seed_stream.str();
+        const char *seed_chars = seed_string.c_str();
+        const auto *seed_semantic(cli::value<uint64_t>());
+
+        std::stringstream max_pixels_stream;
+        max_pixels_stream << "Scale the image down while reading it to at "
+            << "most this many pixels";
+        std::string max_pixels_string = max_pixels_stream.str();
+        const char *max_pixels_chars = max_pixels_string.c_str();
+        const auto *max_pixels_semantic(cli::value<uint64_t>());
+
+        std::stringstream decode_size_stream;
+        decode_size_stream << "Scale the image down while reading it to fit "
+            << "within WIDTHxHEIGHT";
+        std::string decode_size_string = decode_size_stream.str();
+        const char *decode_size_chars = decode_size_string.c_str();
+        const auto *decode_size_semantic(cli::value<std::string>());
+
+        std::stringstream max_memory_stream;
+        max_memory_stream << "Keep reading the image and getting its colors "
+            << "within about this many bytes, such as 512M, by scaling the "
+            << "image down or coarsening its colors where they would not fit";
+        std::string max_memory_string = max_memory_stream.str();
+        const char *max_memory_chars = max_memory_string.c_str();
+        const auto *max_memory_semantic(cli::value<std::string>());
+
+        std::stringstream superpixel_size_stream;
+        superpixel_size_stream << "Side in pixels of the grid cells that "
+            << "superpixels start in (default "
+            << palette::Superpixels::default_region_size << ")";
+        std::string superpixel_size_string = superpixel_size_stream.str();
+        const char *superpixel_size_chars = superpixel_size_string.c_str();
+        const auto *superpixel_size_semantic(cli::value<int>());
+
+        std::stringstream label_map_stream;
+        label_map_stream << "Write an image of the superpixels, each filled "
+            << "with its nearest listed color, to this file";
+        std::string label_map_string = label_map_stream.str();
+        const char *label_map_chars = label_map_string.c_str();
+        const auto *label_map_semantic(cli::value<std::string>());
+
+        const char *cpu_features_chars = "Print the detected processor "
+            "features and the kernels in use, and exit";
 
         std::stringstream input_stream;
-        input_stream << "Input image file";
+        input_stream << "Input image file, or - to read it from standard "
+            << "input";
         std::string input_string = input_stream.str();
         const char *input_chars = input_string.c_str();
-        const auto *input_semantic(bpo::value<std::string>());
+        const auto *input_semantic(cli::value<std::string>());
 
         // TODO: Create an option to specify output format of colors.
         opt.add_options()
@@ -191,7 +897,22 @@ class GetColors : public Tool {
             ("verbose,v", verbose_chars)
             ("mode,m", mode_semantic, mode_chars)
             ("number,n", number_semantic, number_chars)
+            ("criterion,k", criterion_semantic, criterion_chars)
             ("depth,d", depth_semantic, depth_chars)
+            ("region,r", region_semantic, region_chars)
+            ("mask,M", mask_semantic, mask_chars)
+            ("center-weighted,c", center_chars)
+            ("pyramid,p", pyramid_chars)
+            ("frames,f", frames_semantic, frames_chars)
+            ("restarts,R", restarts_semantic, restarts_chars)
+            ("seed,S", seed_semantic, seed_chars)
+            ("max-pixels,P", max_pixels_semantic, max_pixels_chars)
+            ("decode-size,D", decode_size_semantic, decode_size_chars)
+            ("max-memory,B", max_memory_semantic, max_memory_chars)
+            ("superpixel-size,s", superpixel_size_semantic,
+             superpixel_size_chars)
+            ("label-map,L", label_map_semantic, label_map_chars)
+            ("cpu-features", cpu_features_chars)
             ("input,I", input_semantic, input_chars);
 
         pos_opt.add("input", 1);
@@ -203,20 +924,68 @@ class GetColors : public Tool {
 
     // Set private fields of this GetColor object from the command line
     // options.
-    void set_options(bpo::variables_map var_map) {
+    void set_options(const cli::VariablesMap &var_map) {
         help_ |= !var_map["help"].empty();
         verbose_ |= !var_map["verbose"].empty();
+        cpu_features_ |= !var_map["cpu-features"].empty();
         if (!var_map["mode"].empty()) {
             mode_ = std::optional<std::string>(
                 var_map["mode"].as<std::string>());
         }
         if (!var_map["number"].empty()) {
-            max_num_colors_ = std::optional<int>(var_map["number"].as<int>());
+            number_ = std::optional<std::string>(
+                var_map["number"].as<std::string>());
+        }
+        if (!var_map["criterion"].empty()) {
+            criterion_ = std::optional<std::string>(
+                var_map["criterion"].as<std::string>());
         }
         if (!var_map["depth"].empty()) {
             quantize_tree_depth_ =
                 std::optional<int>(var_map["depth"].as<int>());
         }
+        if (!var_map["region"].empty()) {
+            const auto &regions =
+                var_map["region"].as<std::vector<std::string>>();
+            regions_.insert(regions_.end(), regions.begin(), regions.end());
+        }
+        if (!var_map["mask"].empty()) {
+            mask_file_ = std::optional<std::string>(
+                var_map["mask"].as<std::string>());
+        }
+        center_weighted_ |= !var_map["center-weighted"].empty();
+        pyramid_ |= !var_map["pyramid"].empty();
+        if (!var_map["frames"].empty()) {
+            frames_ = std::optional<std::string>(
+                var_map["frames"].as<std::string>());
+        }
+        if (!var_map["restarts"].empty()) {
+            num_restarts_ =
+                std::optional<int>(var_map["restarts"].as<int>());
+        }
+        if (!var_map["seed"].empty()) {
+            seed_ = std::optional<uint64_t>(var_map["seed"].as<uint64_t>());
+        }
+        if (!var_map["max-pixels"].empty()) {
+            max_pixels_ = std::optional<uint64_t>(
+                var_map["max-pixels"].as<uint64_t>());
+        }
+        if (!var_map["decode-size"].empty()) {
+            decode_size_ = std::optional<std::string>(
+                var_map["decode-size"].as<std::string>());
+        }
+        if (!var_map["max-memory"].empty()) {
+            max_memory_ = std::optional<std::string>(
+                var_map["max-memory"].as<std::string>());
+        }
+        if (!var_map["superpixel-size"].empty()) {
+            superpixel_size_ =
+                std::optional<int>(var_map["superpixel-size"].as<int>());
+        }
+        if (!var_map["label-map"].empty()) {
+            label_map_file_ = std::optional<std::string>(
+                var_map["label-map"].as<std::string>());
+        }
         if (!var_map["input"].empty()) {
             input_file_ = std::optional<std::string>(
                 var_map["input"].as<std::string>());
@@ -225,17 +994,33 @@ class GetColors : public Tool {
 
     bool help_;
     bool verbose_;
+    bool cpu_features_;
     std::optional<std::string> mode_;
+    std::optional<std::string> number_;
     std::optional<int> max_num_colors_;
+    std::optional<std::pair<int, int>> auto_num_colors_range_;
+    std::optional<std::string> criterion_;
     std::optional<int> quantize_tree_depth_;
+    std::vector<std::string> regions_;
+    std::optional<std::string> mask_file_;
+    bool center_weighted_;
+    bool pyramid_;
+    std::optional<std::string> frames_;
+    std::optional<int> num_restarts_;
+    std::optional<uint64_t> seed_;
+    std::optional<uint64_t> max_pixels_;
+    std::optional<std::string> decode_size_;
+    std::optional<std::string> max_memory_;
+    std::optional<int> superpixel_size_;
+    std::optional<std::string> label_map_file_;
     std::optional<std::string> input_file_;
+    // The input image when it is read from standard input.
+    Magick::Blob input_blob_;
     std::string options_string_;
 };
 }  // namespace
 
 int main(int argc, char **argv) {
-    Magick::InitializeMagick(*argv);
     GetColors getcolors_state;
-    int parse_result = getcolors_state.parse_options(argc, argv);
-    return (parse_result == 0) ? getcolors_state.run() : parse_result;
+    return getcolors_state.main(argc, argv);
 }
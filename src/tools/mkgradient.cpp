@@ -0,0 +1,260 @@
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Magick++.h>
+
+#include "lib/color.h"
+#include "lib/color_space.h"
+#include "lib/gradient.h"
+#include "lib/hex_color_writer.h"
+
+#include "tools/tools_common.h"
+
+namespace {
+
+class MkGradient : public Tool {
+ public:
+    static constexpr const char *default_space = "rgb";
+
+    MkGradient() :
+        help_(false),
+        verbose_(false),
+        number_(std::nullopt),
+        space_(std::nullopt),
+        output_file_(std::nullopt),
+        colors_(std::vector<std::string>()),
+        options_string_(std::string()) { }
+
+    // Parse command line input into private members of this MkGradient
+    // object. Return 0 if successful, or return a nonzero int if a fatal
+    // error is encountered.
+    int parse_options(int argc, char **argv) {
+        try {
+            try_parse_options(argc, argv);
+        } catch (cli::TooManyPositionals &error) {
+            std::cerr << "Error: more than one output file specified"
+                << std::endl;
+            return exit_more_information();
+        } catch (cli::MultipleOccurrences &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
+        } catch (cli::UnknownOption &error) {
+            std::cerr << "Error: unrecognized option \""
+                << error.option() << "\"" << std::endl;
+            return exit_more_information();
+        } catch (cli::MissingArgument &error) {
+            std::cerr << "Error: failed to interpret an argument after the "
+                << error.option() << " option; "
+                << "if the color value has a '#' character then you must "
+                << "either place the color value in quotes or prefix the '#' "
+                << "character with a '\\' character" << std::endl;
+            return exit_more_information();
+        } catch (cli::Error &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
+        }
+        return 0;
+    }
+
+    // Evaluate the collected command line options and list the colors of a
+    // gradient. Return 0 if successful, or return a nonzero int if a fatal
+    // error is encountered.
+    int run() {
+        if (help_) {
+            return exit_help();
+        }
+        if (!number_.has_value()) {
+            std::cerr << "Error: No number of colors specified" << std::endl;
+            return exit_more_information();
+        }
+        if (*number_ <= 0) {
+            std::cerr << "Error: Number of colors must be a positive integer"
+                << std::endl;
+            return exit_more_information();
+        }
+        if (colors_.empty()) {
+            std::cerr << "Error: No colors specified" << std::endl;
+            return exit_more_information();
+        }
+        const palette::ColorSpace space(space_.value_or(default_space));
+        if (!space.valid()) {
+            std::cerr << "Error: \"" << space_.value() << "\" is not a "
+                << "valid color space" << std::endl;
+            return exit_more_information();
+        }
+
+        // Each stop is a color optionally followed by "@" and a position.
+        palette::Gradient gradient(space);
+        for (const auto &stop_str : colors_) {
+            const size_t at = stop_str.rfind('@');
+            const std::string color_str = stop_str.substr(0, at);
+            std::optional<double> position = std::nullopt;
+            if (at != std::string::npos) {
+                try {
+                    position = std::stod(stop_str.substr(at + 1));
+                } catch (std::exception &error) {
+                    std::cerr << "Error: position of stop \"" << stop_str
+                        << "\" is not a number" << std::endl;
+                    return exit_more_information();
+                }
+            }
+            palette::Color color;
+            try {
+                color = palette::Color(Magick::Color(color_str));
+            } catch (Magick::Exception &error) {
+                std::cerr << "Error: color option \"" << color_str
+                    << "\" could not be interpreted as a color" << std::endl;
+                return exit_more_information();
+            }
+            if (position.has_value()) {
+                gradient.add_stop(color, *position);
+            } else {
+                gradient.add_stop(color);
+            }
+        }
+
+        std::ofstream output_file_stream;
+        if (output_file_.has_value()) {
+            output_file_stream.open(output_file_.value(), std::ios::trunc);
+            if (!output_file_stream) {
+                std::cerr << "Error: failed to open "
+                    << output_file_.value() << std::endl;
+                return 1;
+            }
+        }
+        std::ostream &out = output_file_.has_value()
+            ? output_file_stream : std::cout;
+        std::stringstream error_stream;
+        palette::HexColorWriter writer(out);
+        if (!gradient.write_colors(static_cast<size_t>(*number_), writer,
+                                   error_stream)) {
+            std::cerr << "Error: " << error_stream.str();
+            return exit_more_information();
+        }
+        if (verbose_ && output_file_.has_value()) {
+            std::cout << "Wrote " << *number_ << " colors interpolated in "
+                << space.to_string() << " to " << output_file_.value()
+                << std::endl;
+        }
+        return 0;
+    }
+
+ private:
+    // Initialize ImageMagick for every run but one that prints help.
+    bool uses_magick() { return !help_; }
+
+    // Return the name of the executable file.
+    std::string exec_name() { return EXEC_NAME; }
+
+    // Return description of options constructed by a call to parse_options.
+    std::string options_string() { return options_string_; }
+
+    // Return summary of the functionality of this tool.
+    std::string usage_string() {
+        std::stringstream usage_stream;
+        usage_stream << "Usage: " << exec_name()
+            << " [arguments] [output]" << std::endl
+            << "List colors in hex format of a gradient through specified "
+            << "colors." << std::endl << std::endl;
+        usage_stream << "The first and last colors listed are the first and "
+            << "last colors specified." << std::endl
+            << "A color may be followed by \"@\" and a position between 0 "
+            << "and 1; colors" << std::endl
+            << "without positions are spaced evenly. Colors are listed to "
+            << "stdout unless" << std::endl
+            << "an output file is specified." << std::endl;
+        return usage_stream.str();
+    }
+
+    // Return description of specific examples of using this tool.
+    std::string examples_string() {
+        std::stringstream examples_stream;
+        examples_stream << "Examples: " << exec_name()
+            << " -n 8 -c red -c blue" << std::endl;
+        examples_stream << "      or: " << exec_name()
+            << " -n 1000000 -s oklab -c black -c \"#FF0000@0.25\" "
+            << "-c white ramp.txt" << std::endl;
+        return examples_stream.str();
+    }
+
+    // Create names and a description for each command line option.
+    void create_options(cli::OptionsDescription &opt,
+                        cli::PositionalOptionsDescription &pos_opt) {
+        const char *help_chars = "Print this help message and exit";
+        const char *verbose_chars = "Print extra information to stdout";
+
+        const char *number_chars = "Specify number of colors to list";
+        const auto *number_semantic(cli::value<int>());
+
+        std::stringstream space_stream;
+        space_stream << "Specify color space of interpolation "
+            << "(\"rgb\", \"linear-rgb\", \"hsl\", \"hsv\", \"oklab\", or "
+            << "\"lab\"; "
+            << "default " << default_space << ")";
+        std::string space_string = space_stream.str();
+        const char *space_chars = space_string.c_str();
+        const auto *space_semantic(cli::value<std::string>());
+
+        const char *color_chars =
+            "Specify an additional gradient stop by its color";
+        const auto *color_semantic(cli::value<std::vector<std::string>>());
+
+        const char *output_chars = "Specify the path of output text file";
+        const auto *output_semantic(cli::value<std::string>());
+
+        opt.add_options()
+            ("help,h", help_chars)
+            ("verbose,v", verbose_chars)
+            ("number,n", number_semantic, number_chars)
+            ("space,s", space_semantic, space_chars)
+            ("color,c", color_semantic, color_chars)
+            ("output,O", output_semantic, output_chars);
+        pos_opt.add("output", 1);
+
+        std::stringstream options_stream;
+        options_stream << opt;
+        options_string_ = options_stream.str();
+    }
+
+    // Set private fields of this MkGradient object from the command line
+    // options.
+    void set_options(const cli::VariablesMap &var_map) {
+        help_ |= !var_map["help"].empty();
+        verbose_ |= !var_map["verbose"].empty();
+        if (!var_map["number"].empty()) {
+            number_ = std::optional<int>(var_map["number"].as<int>());
+        }
+        if (!var_map["space"].empty()) {
+            space_ = std::optional<std::string>(
+                var_map["space"].as<std::string>());
+        }
+        if (!var_map["output"].empty()) {
+            output_file_ = std::optional<std::string>(
+                var_map["output"].as<std::string>());
+        }
+        if (!var_map["color"].empty()) {
+            auto color_opts =
+                var_map["color"].as< std::vector<std::string> >();
+            colors_.insert(
+                colors_.end(), color_opts.begin(), color_opts.end());
+        }
+    }
+
+    bool help_;
+    bool verbose_;
+    std::optional<int> number_;
+    std::optional<std::string> space_;
+    std::optional<std::string> output_file_;
+    std::vector<std::string> colors_;
+    std::string options_string_;
+};
+}  // namespace
+
+int main(int argc, char **argv) {
+    MkGradient mkgradient_state;
+    return mkgradient_state.main(argc, argv);
+}
@@ -0,0 +1,299 @@
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Magick++.h>
+
+#include "lib/color.h"
+#include "lib/color_space.h"
+#include "lib/grid_image.h"
+
+#include "tools/tools_common.h"
+
+namespace {
+
+class MkGrid : public Tool {
+ public:
+    static const size_t default_num_cells = 4;
+    static const size_t default_cell_size = 32;
+    static const size_t default_horizontal_channel = 1;
+    static const size_t default_vertical_channel = 2;
+    static constexpr const char *default_space = "rgb";
+
+    MkGrid() :
+        help_(false),
+        verbose_(false),
+        columns_(std::nullopt),
+        rows_(std::nullopt),
+        cell_size_(std::nullopt),
+        horizontal_channel_(std::nullopt),
+        vertical_channel_(std::nullopt),
+        space_(std::nullopt),
+        output_file_(std::nullopt),
+        colors_(std::vector<std::string>()),
+        options_string_(std::string()) { }
+
+    // Parse command line input into private members of this MkGrid
+    // object. Return 0 if successful, or return a nonzero int if a fatal
+    // error is encountered.
+    int parse_options(int argc, char **argv) {
+        try {
+            try_parse_options(argc, argv);
+        } catch (cli::TooManyPositionals &error) {
+            std::cerr << "Error: more than one output file specified"
+                << std::endl;
+            return exit_more_information();
+        } catch (cli::MultipleOccurrences &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
+        } catch (cli::UnknownOption &error) {
+            std::cerr << "Error: unrecognized option \""
+                << error.option() << "\"" << std::endl;
+            return exit_more_information();
+        } catch (cli::MissingArgument &error) {
+            std::cerr << "Error: failed to interpret an argument after the "
+                << error.option() << " option; "
+                << "if the color value has a '#' character then you must "
+                << "either place the color value in quotes or prefix the '#' "
+                << "character with a '\\' character" << std::endl;
+            return exit_more_information();
+        } catch (cli::Error &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
+        }
+        return 0;
+    }
+
+    // Evaluate the collected command line options and export an image.
+    // Return 0 if successful, or return a nonzero int if a fatal error is
+    // encountered.
+    int run() {
+        if (help_) {
+            return exit_help();
+        }
+        if (!output_file_.has_value()) {
+            std::cerr << "Error: No output file specified" << std::endl;
+            return exit_more_information();
+        }
+        if (colors_.size() != 2) {
+            std::cerr << "Error: Exactly two colors must be specified"
+                << std::endl;
+            return exit_more_information();
+        }
+        const palette::ColorSpace space(space_.value_or(default_space));
+        if (!space.valid()) {
+            std::cerr << "Error: \"" << space_.value() << "\" is not a "
+                << "valid color space" << std::endl;
+            return exit_more_information();
+        }
+
+        std::vector<palette::Color> colors;
+        for (const auto &color_str : colors_) {
+            try {
+                colors.emplace_back(Magick::Color(color_str));
+            } catch (Magick::Exception &error) {
+                std::cerr << "Error: color option \"" << color_str
+                    << "\" could not be interpreted as a color" << std::endl;
+                return exit_more_information();
+            }
+        }
+
+        const int num_cells = static_cast<int>(default_num_cells);
+        palette::GridImage image(
+            columns_.value_or(num_cells), rows_.value_or(num_cells),
+            cell_size_.value_or(static_cast<int>(default_cell_size)), space);
+        image.set_colors(colors.front(), colors.back());
+        image.set_channels(
+            horizontal_channel_.value_or(
+                static_cast<int>(default_horizontal_channel)) - 1,
+            vertical_channel_.value_or(
+                static_cast<int>(default_vertical_channel)) - 1);
+
+        // Export the image.
+        std::stringstream verbose_stream;
+        std::stringstream error_stream;
+        const bool export_success =
+            image.export_image(output_file_.value(),
+                               verbose_stream, error_stream);
+        if (!export_success) {
+            std::cerr << "Error: " << error_stream.str();
+            return exit_more_information();
+        }
+        if (verbose_) {
+            std::cout << verbose_stream.str();
+        }
+        return 0;
+    }
+
+ private:
+    // Initialize ImageMagick for every run but one that prints help.
+    bool uses_magick() { return !help_; }
+
+    // Return the name of the executable file.
+    std::string exec_name() { return EXEC_NAME; }
+
+    // Return description of options constructed by a call to parse_options.
+    std::string options_string() { return options_string_; }
+
+    // Return summary of the functionality of this tool.
+    std::string usage_string() {
+        std::stringstream usage_stream;
+        usage_stream << "Usage: " << exec_name()
+            << " [arguments] [output]" << std::endl
+            << "Create image file with a grid of cells representing a subset "
+            << "of a color space." << std::endl << std::endl;
+        usage_stream << "The top left and bottom right cells are the two "
+            << "specified colors. One" << std::endl
+            << "channel of the color space varies across columns, another "
+            << "varies down" << std::endl
+            << "rows, and the third varies along the diagonal." << std::endl;
+        return usage_stream.str();
+    }
+
+    // Return description of specific examples of using this tool.
+    std::string examples_string() {
+        std::stringstream examples_stream;
+        examples_stream << "Examples: " << exec_name()
+            << " -c \"#0000FF\" -c \"#FFFFFF\" -X 1 -Y 2 output.png"
+            << std::endl;
+        examples_stream << "      or: " << exec_name()
+            << " -s hsl -C 8 -R 4 -S 64 -c red -c \"#00FF80\" output.png"
+            << std::endl;
+        return examples_stream.str();
+    }
+
+    // Create names and a description for each command line option.
+    void create_options(cli::OptionsDescription &opt,
+                        cli::PositionalOptionsDescription &pos_opt) {
+        const char *help_chars = "Print this help message and exit";
+        const char *verbose_chars = "Print extra information to stdout";
+
+        std::stringstream columns_stream;
+        columns_stream << "Specify number of columns of cells (default "
+            << default_num_cells << ")";
+        std::string columns_string = columns_stream.str();
+        const char *columns_chars = columns_string.c_str();
+        const auto *columns_semantic(cli::value<int>());
+
+        std::stringstream rows_stream;
+        rows_stream << "Specify number of rows of cells (default "
+            << default_num_cells << ")";
+        std::string rows_string = rows_stream.str();
+        const char *rows_chars = rows_string.c_str();
+        const auto *rows_semantic(cli::value<int>());
+
+        std::stringstream cell_size_stream;
+        cell_size_stream << "Specify width and height in pixels of each cell "
+            << "(default " << default_cell_size << ")";
+        std::string cell_size_string = cell_size_stream.str();
+        const char *cell_size_chars = cell_size_string.c_str();
+        const auto *cell_size_semantic(cli::value<int>());
+
+        std::stringstream horizontal_stream;
+        horizontal_stream << "Specify channel (1, 2, or 3) of the color "
+            << "space that varies across columns (default "
+            << default_horizontal_channel << ")";
+        std::string horizontal_string = horizontal_stream.str();
+        const char *horizontal_chars = horizontal_string.c_str();
+        const auto *horizontal_semantic(cli::value<int>());
+
+        std::stringstream vertical_stream;
+        vertical_stream << "Specify channel (1, 2, or 3) of the color "
+            << "space that varies down rows (default "
+            << default_vertical_channel << ")";
+        std::string vertical_string = vertical_stream.str();
+        const char *vertical_chars = vertical_string.c_str();
+        const auto *vertical_semantic(cli::value<int>());
+
+        std::stringstream space_stream;
+        space_stream << "Specify color space of the grid "
+            << "(\"rgb\", \"linear-rgb\", \"hsl\", \"hsv\", \"oklab\", or "
+            << "\"lab\"; "
+            << "default " << default_space << ")";
+        std::string space_string = space_stream.str();
+        const char *space_chars = space_string.c_str();
+        const auto *space_semantic(cli::value<std::string>());
+
+        const char *color_chars =
+            "Specify the first and then the last color of the grid";
+        const auto *color_semantic(cli::value<std::vector<std::string>>());
+
+        const char *output_chars = "Specify the path of output image file";
+        const auto *output_semantic(cli::value<std::string>());
+
+        opt.add_options()
+            ("help,h", help_chars)
+            ("verbose,v", verbose_chars)
+            ("columns,C", columns_semantic, columns_chars)
+            ("rows,R", rows_semantic, rows_chars)
+            ("cell-size,S", cell_size_semantic, cell_size_chars)
+            ("horizontal,X", horizontal_semantic, horizontal_chars)
+            ("vertical,Y", vertical_semantic, vertical_chars)
+            ("space,s", space_semantic, space_chars)
+            ("color,c", color_semantic, color_chars)
+            ("output,O", output_semantic, output_chars);
+        pos_opt.add("output", 1);
+
+        std::stringstream options_stream;
+        options_stream << opt;
+        options_string_ = options_stream.str();
+    }
+
+    // Set private fields of this MkGrid object from the command line
+    // options.
+    void set_options(const cli::VariablesMap &var_map) {
+        help_ |= !var_map["help"].empty();
+        verbose_ |= !var_map["verbose"].empty();
+        if (!var_map["columns"].empty()) {
+            columns_ = std::optional<int>(var_map["columns"].as<int>());
+        }
+        if (!var_map["rows"].empty()) {
+            rows_ = std::optional<int>(var_map["rows"].as<int>());
+        }
+        if (!var_map["cell-size"].empty()) {
+            cell_size_ = std::optional<int>(var_map["cell-size"].as<int>());
+        }
+        if (!var_map["horizontal"].empty()) {
+            horizontal_channel_ =
+                std::optional<int>(var_map["horizontal"].as<int>());
+        }
+        if (!var_map["vertical"].empty()) {
+            vertical_channel_ =
+                std::optional<int>(var_map["vertical"].as<int>());
+        }
+        if (!var_map["space"].empty()) {
+            space_ = std::optional<std::string>(
+                var_map["space"].as<std::string>());
+        }
+        if (!var_map["output"].empty()) {
+            output_file_ = std::optional<std::string>(
+                var_map["output"].as<std::string>());
+        }
+        if (!var_map["color"].empty()) {
+            auto color_opts =
+                var_map["color"].as< std::vector<std::string> >();
+            colors_.insert(
+                colors_.end(), color_opts.begin(), color_opts.end());
+        }
+    }
+
+    bool help_;
+    bool verbose_;
+    std::optional<int> columns_;
+    std::optional<int> rows_;
+    std::optional<int> cell_size_;
+    std::optional<int> horizontal_channel_;
+    std::optional<int> vertical_channel_;
+    std::optional<std::string> space_;
+    std::optional<std::string> output_file_;
+    std::vector<std::string> colors_;
+    std::string options_string_;
+};
+}  // namespace
+
+int main(int argc, char **argv) {
+    MkGrid mkgrid_state;
+    return mkgrid_state.main(argc, argv);
+}
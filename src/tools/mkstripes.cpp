@@ -2,13 +2,14 @@
 #include <optional>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
-#include <boost/program_options.hpp>
-
 #include <Magick++.h>
 
+#include "lib/blob_stream.h"
 #include "lib/color.h"
+#include "lib/color_set.h"
 #include "lib/orientation.h"
 #include "lib/stripes_image.h"
 
@@ -16,21 +17,22 @@
 
 namespace {
 
-namespace bpo = boost::program_options;
-
 class MkStripes : public Tool {
  public:
     static const size_t default_width = 100;
     static const size_t default_length_multiplier = 100;
     static constexpr const char *default_orientation = "vertical";
+    static constexpr const char *default_format = "png";
 
     MkStripes() :
         help_(false),
         verbose_(false),
+        unique_(false),
         width_(std::nullopt),
         length_(std::nullopt),
         orientation_(std::nullopt),
         output_file_(std::nullopt),
+        format_(std::nullopt),
         colors_(std::vector<std::string>()),
         options_string_(std::string()) { }
 
@@ -40,26 +42,29 @@ class MkStripes : public Tool {
     int parse_options(int argc, char **argv) {
         try {
             try_parse_options(argc, argv);
-        } catch (bpo::too_many_positional_options_error &error) {
+        } catch (cli::TooManyPositionals &error) {
             std::cerr << "Error: more than one output file specified"
                 << std::endl;
             return exit_more_information();
-        } catch (bpo::multiple_occurrences &error) {
+        } catch (cli::MultipleOccurrences &error) {
             // Option X cannot be specified more than once.
             std::cerr << "Error: " << error.what() << std::endl;
             return exit_more_information();
-        } catch (bpo::unknown_option &error) {
+        } catch (cli::UnknownOption &error) {
             // Unrecognized option X.
             std::cerr << "Error: unrecognized option \""
-                << error.get_option_name() << "\"" << std::endl;
+                << error.option() << "\"" << std::endl;
             return exit_more_information();
-        } catch (bpo::invalid_command_line_syntax &error) {
+        } catch (cli::MissingArgument &error) {
             std::cerr << "Error: failed to interpret an argument after the "
-                << error.tokens() << " option; "
+                << error.option() << " option; "
                 << "if the color value has a '#' character then you must "
                 << "either place the color value in quotes or prefix the '#' "
                 << "character with a '\\' character" << std::endl;
             return exit_more_information();
+        } catch (cli::Error &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
         }
         return 0;
     }
@@ -118,33 +123,61 @@ class MkStripes : public Tool {
             return exit_more_information();
         }
 
+        // Stripes keep the order of the colors, dropping later repeats of
+        // a color if asked to.
+        palette::OrderedColorSet unique_colors;
+        std::vector<palette::Color> stripe_colors;
+        for (const auto &magick_color : magick_colors) {
+            palette::Color color(magick_color);
+            if (!unique_ || unique_colors.insert(color)) {
+                stripe_colors.push_back(std::move(color));
+            }
+        }
+
         const int stripe_length = length_.value_or(
-            magick_colors.size() * default_length_multiplier);
+            stripe_colors.size() * default_length_multiplier);
         const int stripe_width = width_.value_or(
             static_cast<int>(default_width));
         palette::StripesImage image(stripe_length, stripe_width,
                                     stripe_orientation);
-        for (const auto &magick_color : magick_colors) {
-            image.get_stripe_colors().get().emplace_back(magick_color);
-        }
+        image.get_stripe_colors().get() = std::move(stripe_colors);
 
-        // Export the image.
+        // Export the image, to stdout if the output file is "-".
         std::stringstream verbose_stream;
         std::stringstream error_stream;
-        const bool export_success =
-            image.export_image(output_file_.value(),
-                               verbose_stream, error_stream);
-        if (!export_success) {
+        const bool writing_stdout = (output_file_.value() == "-");
+        if (format_.has_value() && !writing_stdout) {
+            std::cerr << "Warning: format option only applies to output "
+                << "\"-\"; the format follows the output file name"
+                << std::endl;
+        }
+        if (writing_stdout) {
+            Magick::Blob blob;
+            if (!image.export_image(blob, format_.value_or(default_format),
+                                    verbose_stream, error_stream)) {
+                std::cerr << "Error: " << error_stream.str();
+                return exit_more_information();
+            }
+            if (!palette::BlobStream::write(blob, std::cout, error_stream)) {
+                std::cerr << "Error: " << error_stream.str();
+                return 1;
+            }
+        } else if (!image.export_image(output_file_.value(),
+                                       verbose_stream, error_stream)) {
             std::cerr << "Error: " << error_stream.str();
             return exit_more_information();
         }
+        // Keep the image alone on stdout when writing it there.
         if (verbose_) {
-            std::cout << verbose_stream.str();
+            (writing_stdout ? std::cerr : std::cout) << verbose_stream.str();
         }
         return 0;
     }
 
  private:
+    // Initialize ImageMagick for every run but one that prints help.
+    bool uses_magick() { return !help_; }
+
     // Return the name of the executable file.
     std::string exec_name() { return EXEC_NAME; }
 
@@ -175,21 +208,25 @@ class MkStripes : public Tool {
         examples_stream << "      or: " << exec_name()
             << " -c cyan -c \"#ffffff\" -c \"#FF0000\" "
             << "-l 500 -w 500 output.gif" << std::endl;
+        examples_stream << "      or: " << exec_name()
+            << " -c navy -c gold -f gif - | display" << std::endl;
         return examples_stream.str();
     }
 
     // Create names and a description for each command line option.
-    void create_options(bpo::options_description &opt,
-                        bpo::positional_options_description &pos_opt) {
+    void create_options(cli::OptionsDescription &opt,
+                        cli::PositionalOptionsDescription &pos_opt) {
         const char *help_chars = "Print this help message and exit";
         const char *verbose_chars = "Print extra information to stdout";
+        const char *unique_chars = "Drop every repeat of a color, keeping "
+            "the stripe of its first occurrence";
 
         std::stringstream width_stream;
         width_stream << "Specify width in pixels of each stripe "
             << "in generated image (default " << default_width << ")";
         std::string width_string = width_stream.str();
         const char *width_chars = width_string.c_str();
-        const auto *width_semantic(bpo::value<int>());
+        const auto *width_semantic(cli::value<int>());
 
         std::stringstream length_stream;
         length_stream << "Specify length in pixels of stripes "
@@ -197,7 +234,7 @@ class MkStripes : public Tool {
             << " multiplied by number of colors)";
         std::string length_string = length_stream.str();
         const char *length_chars = length_string.c_str();
-        const auto *length_semantic(bpo::value<int>());
+        const auto *length_semantic(cli::value<int>());
 
         std::stringstream orientation_stream;
         orientation_stream << "Specify orientation of stripes "
@@ -205,14 +242,23 @@ class MkStripes : public Tool {
             << default_orientation << ")";
         std::string orientation_string = orientation_stream.str();
         const char *orientation_chars = orientation_string.c_str();
-        const auto *orientation_semantic(bpo::value<std::string>());
+        const auto *orientation_semantic(cli::value<std::string>());
 
         const char *color_chars =
             "Specify an additional stripe by its color";
-        const auto *color_semantic(bpo::value<std::vector<std::string>>());
+        const auto *color_semantic(cli::value<std::vector<std::string>>());
 
-        const char *output_chars = "Specify the path of output image file";
-        const auto *output_semantic(bpo::value<std::string>());
+        const char *output_chars = "Specify the path of output image file, "
+            "or - to write the image to stdout";
+        const auto *output_semantic(cli::value<std::string>());
+
+        std::stringstream format_stream;
+        format_stream << "Specify the image format, such as \"png\" or "
+            << "\"gif\", when writing to stdout (default " << default_format
+            << ")";
+        std::string format_string = format_stream.str();
+        const char *format_chars = format_string.c_str();
+        const auto *format_semantic(cli::value<std::string>());
 
         // TODO: Either implement an --input/-I option or create
         //       another tool to read color values from a text file.
@@ -220,15 +266,15 @@ class MkStripes : public Tool {
         //                -O solarized.png
         // TODO: Create an --annotate/-a option to annotate stripes
         //       with their hex values.
-        // TODO: Consider creating an --unique/-U option that lets the
-        //       user opt in/out of removal of duplicate colors.
         opt.add_options()
             ("help,h", help_chars)
             ("verbose,v", verbose_chars)
+            ("unique,u", unique_chars)
             ("width,w", width_semantic, width_chars)
             ("length,l", length_semantic, length_chars)
             ("orientation,o", orientation_semantic, orientation_chars)
             ("color,c", color_semantic, color_chars)
+            ("format,f", format_semantic, format_chars)
             ("output,O", output_semantic, output_chars);
         pos_opt.add("output", 1);
 
@@ -239,9 +285,10 @@ class MkStripes : public Tool {
 
     // Set private fields of this MkStripes object from the command line
     // options.
-    void set_options(bpo::variables_map var_map) {
+    void set_options(const cli::VariablesMap &var_map) {
         help_ |= !var_map["help"].empty();
         verbose_ |= !var_map["verbose"].empty();
+        unique_ |= !var_map["unique"].empty();
         if (!var_map["width"].empty()) {
             width_ = std::optional<int>(var_map["width"].as<int>());
         }
@@ -256,6 +303,10 @@ class MkStripes : public Tool {
             output_file_ = std::optional<std::string>(
                 var_map["output"].as<std::string>());
         }
+        if (!var_map["format"].empty()) {
+            format_ = std::optional<std::string>(
+                var_map["format"].as<std::string>());
+        }
         if (!var_map["color"].empty()) {
             auto color_opts =
                 var_map["color"].as< std::vector<std::string> >();
@@ -266,20 +317,19 @@ class MkStripes : public Tool {
 
     bool help_;
     bool verbose_;
+    bool unique_;
     std::optional<int> width_;
     std::optional<int> length_;
     std::optional<std::string> orientation_;
     std::optional<std::string> output_file_;
+    std::optional<std::string> format_;
     std::vector<std::string> colors_;
     std::string options_string_;
 };
 }  // namespace
 
 int main(int argc, char **argv) {
-    Magick::InitializeMagick(*argv);
     MkStripes mkstripes_state;
     mkstripes_state.parse_stdin();
-    int parse_options_result = mkstripes_state.parse_options(argc, argv);
-    return ((parse_options_result == 0)
-            ? mkstripes_state.run() : parse_options_result);
+    return mkstripes_state.main(argc, argv);
 }
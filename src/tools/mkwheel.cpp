@@ -1,19 +1,21 @@
 #include <iostream>
 #include <chrono>
+#include <cstdint>
 #include <optional>
 #include <sstream>
 #include <string>
 #include <vector>
 
-#include <boost/program_options.hpp>
-
 #include <Magick++.h>
 
+#include "lib/fixed_hsl.h"
+#include "lib/packed_color.h"
+#include "lib/parallel.h"
+
 #include "tools/tools_common.h"
 
 namespace {
 
-namespace bpo = boost::program_options;
 namespace sch = std::chrono;
 
 class MkWheel : public Tool {
@@ -35,29 +37,32 @@ class MkWheel : public Tool {
     int parse_options(int argc, char **argv) {
         try {
             try_parse_options(argc, argv);
-        } catch (bpo::too_many_positional_options_error &error) {
+        } catch (cli::TooManyPositionals &error) {
             std::cerr << "Error: More than one output file specified"
                 << std::endl;
             return exit_more_information();
-        } catch (bpo::multiple_occurrences &error) {
+        } catch (cli::MultipleOccurrences &error) {
             // Option X cannot be specified more than once.
             std::cerr << "Error: " << error.what() << std::endl;
             return exit_more_information();
-        } catch (bpo::unknown_option &error) {
+        } catch (cli::UnknownOption &error) {
             // Unrecognized option X.
             std::cerr << "Error: Unrecognized option \""
-                << error.get_option_name() << "\"" << std::endl;
+                << error.option() << "\"" << std::endl;
             return exit_more_information();
-        } catch (bpo::invalid_command_line_syntax &error) {
+        } catch (cli::MissingArgument &error) {
             std::cerr << "Error: Failed to interpret an argument after the "
-                << error.tokens() << " option";
-            if (error.tokens().compare("--color") == 0) {
+                << error.option() << " option";
+            if (error.option().compare("--color") == 0) {
                 std::cerr << "; if the color value has a '#' character then "
                     << "you must either place the color value in quotes or "
                     << "prefix the '#' character with a '\\' character";
             }
             std::cerr << std::endl;
             return exit_more_information();
+        } catch (cli::Error &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
         }
         return 0;
     }
@@ -120,6 +125,9 @@ class MkWheel : public Tool {
     }
 
  private:
+    // Initialize ImageMagick for every run but one that prints help.
+    bool uses_magick() { return !help_; }
+
     // Return the name of the executable file.
     std::string exec_name() { return EXEC_NAME; }
 
@@ -151,8 +159,8 @@ class MkWheel : public Tool {
     }
 
     // Create names and a description for each command line option.
-    void create_options(bpo::options_description &opt,
-                        bpo::positional_options_description &pos_opt) {
+    void create_options(cli::OptionsDescription &opt,
+                        cli::PositionalOptionsDescription &pos_opt) {
         const char *help_chars = "Print this help message and exit";
         const char *verbose_chars = "Print extra information to stdout";
 
@@ -161,18 +169,18 @@ class MkWheel : public Tool {
             << "(default " << default_height << ")";
         std::string height_string = height_stream.str();
         const char *height_chars = height_string.c_str();
-        const auto *height_semantic(bpo::value<int>());
+        const auto *height_semantic(cli::value<int>());
 
         const char *type_chars = "Specify a type of color wheel to create "
             "(\"hsl-hue\" or \"hsl-hue-mirror\")";
-        const auto *type_semantic(bpo::value<std::string>());
+        const auto *type_semantic(cli::value<std::string>());
 
         const char *color_chars =
             "Specify a color on which to base the color wheel";
-        const auto *color_semantic(bpo::value<std::string>());
+        const auto *color_semantic(cli::value<std::string>());
 
         const char *output_chars = "Specify the path of output image file";
-        const auto *output_semantic(bpo::value<std::string>());
+        const auto *output_semantic(cli::value<std::string>());
 
         opt.add_options()
             ("help,h", help_chars)
@@ -190,7 +198,7 @@ class MkWheel : public Tool {
 
     // Set private fields of this MkWheel object from the command line
     // options.
-    void set_options(bpo::variables_map var_map) {
+    void set_options(const cli::VariablesMap &var_map) {
         help_ |= !var_map["help"].empty();
         verbose_ |= !var_map["verbose"].empty();
         if (!var_map["height"].empty()) {
@@ -221,7 +229,8 @@ class MkWheel : public Tool {
         double input_lightness = 0;
 
         try {
-            Magick::ColorHSL color_hsl(color_.value());
+            const palette::FixedHsl color_hsl = palette::FixedHsl::from_magick(
+                Magick::Color(color_.value()));
             input_hue = color_hsl.hue();
             input_saturation = color_hsl.saturation();
             input_lightness = color_hsl.lightness();
@@ -249,28 +258,37 @@ class MkWheel : public Tool {
                 << std::fixed << (360.0 * input_hue) << std::endl;
         }
 
-        // Evaluate hue, saturation, and lightness of each pixel using
-        // ImageMagick's fx expressions on the pixel's channels. Channel
-        // types are not straightforwardly named, as RedChannel signifies
-        // "channel 1," GreenChannel signifies "channel 2," etc. When the
-        // image's color space is set (from the RGB default) to HSL, then
-        // "channel 1" is the pixel's hue, "channel 2 is the pixel's
-        // saturation, etc.
-        Magick::Image wheel;
-        wheel.size(Magick::Geometry(image_width, image_height));
-        wheel.colorSpace(Magick::HSLColorspace);
-        const Magick::ChannelType hue_channel = Magick::RedChannel;
-        const Magick::ChannelType saturation_channel = Magick::GreenChannel;
-        const Magick::ChannelType lightness_channel = Magick::BlueChannel;
-
-        std::stringstream hue_fx_expr;
-        hue_fx_expr.precision(20);
-        hue_fx_expr << std::fixed << input_hue;
-        wheel.fx(hue_fx_expr.str(), hue_channel);
-        wheel.fx(mirror ? "(i-h)/h" : "i/w", saturation_channel);
-        wheel.fx("(h-j)/h", lightness_channel);
+        // Saturation grows from left to right and lightness from bottom to
+        // top. The mirror's left half spans saturations from -1 to 0,
+        // which in HSL are those of the complementary hue from 1 to 0.
+        // Pixels are converted in fixed point, a row per task, instead of
+        // through ImageMagick's fx expressions in the HSL color space.
+        const double complement_hue = (input_hue < 0.5)
+            ? (input_hue + 0.5) : (input_hue - 0.5);
+        std::vector<uint16_t> pixels(
+            static_cast<size_t>(image_width) * image_height * 3, 0);
+        palette::Parallel::run(image_height, [&](size_t j) {
+            const double lightness =
+                static_cast<double>(image_height - j) / image_height;
+            uint16_t *row = pixels.data() + (j * image_width * 3);
+            for (int i = 0; i < image_width; ++i) {
+                const double saturation = mirror
+                    ? static_cast<double>(i - image_height) / image_height
+                    : static_cast<double>(i) / image_width;
+                const palette::PackedColor16 color =
+                    palette::FixedHsl::from_unit(
+                        (saturation < 0.0) ? complement_hue : input_hue,
+                        (saturation < 0.0) ? -saturation : saturation,
+                        lightness).to_rgb<uint16_t>();
+                row[(i * 3) + 0] = color.red_;
+                row[(i * 3) + 1] = color.green_;
+                row[(i * 3) + 2] = color.blue_;
+            }
+        });
 
         try {
+            Magick::Image wheel(image_width, image_height, "RGB",
+                                Magick::ShortPixel, pixels.data());
             wheel.write(output_file_.value());
         } catch (Magick::Exception &error) {
             std::cerr << "ImageMagick exception: " << error.what() << std::endl;
@@ -291,10 +309,7 @@ class MkWheel : public Tool {
 }  // namespace
 
 int main(int argc, char **argv) {
-    Magick::InitializeMagick(*argv);
     MkWheel mkwheel_state;
     mkwheel_state.parse_stdin();
-    int parse_options_result = mkwheel_state.parse_options(argc, argv);
-    return ((parse_options_result == 0)
-            ? mkwheel_state.run() : parse_options_result);
+    return mkwheel_state.main(argc, argv);
 }
@@ -0,0 +1,396 @@
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Magick++.h>
+
+#include "lib/color.h"
+#include "lib/color_scanner.h"
+#include "lib/color_vector.h"
+#include "lib/mapped_palette_index.h"
+#include "lib/palette_dictionary.h"
+#include "lib/palette_index_builder.h"
+
+#include "tools/tools_common.h"
+
+namespace {
+
+class PalIndex : public Tool {
+ public:
+    static const int default_num_matches = 10;
+
+    PalIndex() :
+        help_(false),
+        verbose_(false),
+        build_(false),
+        lines_(false),
+        exhaustive_(false),
+        index_file_(std::nullopt),
+        query_colors_(std::nullopt),
+        query_file_(std::nullopt),
+        number_(std::nullopt),
+        probe_radius_(std::nullopt),
+        seed_(std::nullopt),
+        input_files_(std::vector<std::string>()),
+        options_string_(std::string()) { }
+
+    // Parse command line input into private members of this PalIndex
+    // object. Return 0 if successful, or return a nonzero int if a fatal
+    // error is encountered.
+    int parse_options(int argc, char **argv) {
+        try {
+            try_parse_options(argc, argv);
+        } catch (cli::MultipleOccurrences &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
+        } catch (cli::UnknownOption &error) {
+            std::cerr << "Error: unrecognized option \""
+                << error.option() << "\"" << std::endl;
+            return exit_more_information();
+        } catch (cli::MissingArgument &error) {
+            std::cerr << "Error: failed to interpret an argument after the "
+                << error.option() << " option" << std::endl;
+            return exit_more_information();
+        } catch (cli::Error &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
+        }
+        return 0;
+    }
+
+    // Evaluate the collected command line options and either build an
+    // index from the input palettes or query an existing index. Return 0
+    // if successful, or return a nonzero int if a fatal error is
+    // encountered.
+    int run() {
+        if (help_) {
+            return exit_help();
+        }
+        if (!index_file_.has_value()) {
+            std::cerr << "Error: No index file specified" << std::endl;
+            return exit_more_information();
+        }
+        const bool query =
+            query_colors_.has_value() || query_file_.has_value();
+        if (build_ == query) {
+            std::cerr << "Error: Specify either --build or a query palette"
+                << std::endl;
+            return exit_more_information();
+        }
+        return build_ ? run_build() : run_query();
+    }
+
+ private:
+    // Initialize ImageMagick for every run but one that prints help.
+    bool uses_magick() { return !help_; }
+
+    // Return the name of the executable file.
+    std::string exec_name() { return EXEC_NAME; }
+
+    // Return description of options constructed by a call to parse_options.
+    std::string options_string() { return options_string_; }
+
+    // Return summary of the functionality of this tool.
+    std::string usage_string() {
+        std::stringstream usage_stream;
+        usage_stream << "Usage: " << exec_name()
+            << " -x index --build [arguments] [input ...]" << std::endl
+            << "   or: " << exec_name()
+            << " -x index (-q colors | -Q palette) [arguments]" << std::endl
+            << "Build an index of palettes, or find the palettes in an index "
+            << "most similar" << std::endl
+            << "to a query palette." << std::endl << std::endl;
+        usage_stream << "Each input file is read as one palette in any "
+            << "format convpalette reads," << std::endl
+            << "or with --lines each line of text, such as the per-frame "
+            << "output of getcolors," << std::endl
+            << "is read as one palette named file:line. Matches are printed "
+            << "with their" << std::endl
+            << "similarity in [0, 1], their name, and their colors."
+            << std::endl;
+        return usage_stream.str();
+    }
+
+    // Return description of specific examples of using this tool.
+    std::string examples_string() {
+        std::stringstream examples_stream;
+        examples_stream << "Examples: " << exec_name()
+            << " -x palettes.idx --build resources/palettes/*.json"
+            << std::endl;
+        examples_stream << "      or: " << exec_name()
+            << " -x photos.idx --build --lines photo_palettes.txt"
+            << std::endl;
+        examples_stream << "      or: " << exec_name()
+            << " -x photos.idx -k 5 -q \"#1D2B53 #7E2553 #FF004D\""
+            << std::endl;
+        return examples_stream.str();
+    }
+
+    // Create names and a description for each command line option.
+    void create_options(cli::OptionsDescription &opt,
+                        cli::PositionalOptionsDescription &pos_opt) {
+        const char *help_chars = "Print this help message and exit";
+        const char *verbose_chars = "Print extra information to stdout";
+        const char *build_chars =
+            "Build the index from the input palettes";
+        const char *lines_chars =
+            "Read each line of the input files as a separate palette";
+
+        const char *index_chars = "Specify the path of the index file";
+        const auto *index_semantic(cli::value<std::string>());
+
+        const char *query_chars =
+            "Find palettes similar to these colors, written as hex colors "
+            "or rgb()";
+        const auto *query_semantic(cli::value<std::string>());
+
+        const char *query_file_chars =
+            "Find palettes similar to the palette in this file";
+        const auto *query_file_semantic(cli::value<std::string>());
+
+        std::stringstream number_stream;
+        number_stream << "Number of matches to print (default "
+            << default_num_matches << ")";
+        std::string number_string = number_stream.str();
+        const char *number_chars = number_string.c_str();
+        const auto *number_semantic(cli::value<int>());
+
+        std::stringstream probe_stream;
+        probe_stream << "Also search buckets whose hash bits differ from the "
+            "query in up to this many places (default "
+            << palette::MappedPaletteIndex::default_probe_radius << ")";
+        std::string probe_string = probe_stream.str();
+        const char *probe_chars = probe_string.c_str();
+        const auto *probe_semantic(cli::value<int>());
+
+        const char *exhaustive_chars =
+            "Compare the query with every palette instead of only hash "
+            "candidates";
+
+        const char *seed_chars =
+            "Seed for the random hyperplanes hashing the palettes";
+        const auto *seed_semantic(cli::value<uint64_t>());
+
+        const char *input_chars = "Specify an additional input palette file";
+        const auto *input_semantic(cli::value<std::vector<std::string>>());
+
+        opt.add_options()
+            ("help,h", help_chars)
+            ("verbose,v", verbose_chars)
+            ("index,x", index_semantic, index_chars)
+            ("build,B", build_chars)
+            ("lines,l", lines_chars)
+            ("query,q", query_semantic, query_chars)
+            ("query-file,Q", query_file_semantic, query_file_chars)
+            ("number,k", number_semantic, number_chars)
+            ("probe-radius,r", probe_semantic, probe_chars)
+            ("exhaustive,e", exhaustive_chars)
+            ("seed,S", seed_semantic, seed_chars)
+            ("input,I", input_semantic, input_chars);
+        pos_opt.add("input", -1);
+
+        std::stringstream options_stream;
+        options_stream << opt;
+        options_string_ = options_stream.str();
+    }
+
+    // Set private fields of this PalIndex object from the command line
+    // options.
+    void set_options(const cli::VariablesMap &var_map) {
+        help_ |= !var_map["help"].empty();
+        verbose_ |= !var_map["verbose"].empty();
+        build_ |= !var_map["build"].empty();
+        lines_ |= !var_map["lines"].empty();
+        exhaustive_ |= !var_map["exhaustive"].empty();
+        if (!var_map["index"].empty()) {
+            index_file_ = std::optional<std::string>(
+                var_map["index"].as<std::string>());
+        }
+        if (!var_map["query"].empty()) {
+            query_colors_ = std::optional<std::string>(
+                var_map["query"].as<std::string>());
+        }
+        if (!var_map["query-file"].empty()) {
+            query_file_ = std::optional<std::string>(
+                var_map["query-file"].as<std::string>());
+        }
+        if (!var_map["number"].empty()) {
+            number_ = std::optional<int>(var_map["number"].as<int>());
+        }
+        if (!var_map["probe-radius"].empty()) {
+            probe_radius_ =
+                std::optional<int>(var_map["probe-radius"].as<int>());
+        }
+        if (!var_map["seed"].empty()) {
+            seed_ = std::optional<uint64_t>(var_map["seed"].as<uint64_t>());
+        }
+        if (!var_map["input"].empty()) {
+            auto input_opts =
+                var_map["input"].as<std::vector<std::string>>();
+            input_files_.insert(
+                input_files_.end(), input_opts.begin(), input_opts.end());
+        }
+    }
+
+    // Read the input palettes into a new index and write it.
+    int run_build() {
+        if (input_files_.empty()) {
+            std::cerr << "Error: No input file specified" << std::endl;
+            return exit_more_information();
+        }
+        palette::PaletteIndexBuilder builder(
+            seed_.value_or(palette::PaletteIndexBuilder::default_seed));
+        std::stringstream error_stream;
+        for (const std::string &input_file : input_files_) {
+            const bool success = lines_
+                ? add_lines(input_file, builder, error_stream)
+                : add_palette_file(input_file, builder, error_stream);
+            if (!success) {
+                std::cerr << "Error: " << error_stream.str();
+                return 1;
+            }
+        }
+        if (!builder.write(index_file_.value(), error_stream)) {
+            std::cerr << "Error: " << error_stream.str();
+            return 1;
+        }
+        if (verbose_) {
+            std::cout << "Indexed " << builder.size() << " palettes in "
+                << index_file_.value() << std::endl;
+        }
+        return 0;
+    }
+
+    // Print the palettes in the index most similar to the query palette.
+    int run_query() {
+        const int num_matches = number_.value_or(default_num_matches);
+        const int probe_radius = probe_radius_.value_or(
+            palette::MappedPaletteIndex::default_probe_radius);
+        if (num_matches <= 0) {
+            std::cerr << "Error: Number of matches must be a positive "
+                << "integer" << std::endl;
+            return exit_more_information();
+        }
+        if (probe_radius < 0) {
+            std::cerr << "Error: Probe radius must not be negative"
+                << std::endl;
+            return exit_more_information();
+        }
+
+        std::stringstream error_stream;
+        std::vector<palette::Color> query_colors;
+        if (query_colors_.has_value()) {
+            scan_colors(query_colors_.value(), query_colors);
+        } else {
+            palette::PaletteDictionary dictionary;
+            if (!dictionary.read(query_file_.value(), error_stream)) {
+                std::cerr << "Error: " << error_stream.str();
+                return 1;
+            }
+            query_colors = dictionary.get_colors().get();
+        }
+        if (query_colors.empty()) {
+            std::cerr << "Error: Query palette has no colors" << std::endl;
+            return exit_more_information();
+        }
+
+        palette::MappedPaletteIndex index;
+        if (!index.open(index_file_.value(), error_stream)) {
+            std::cerr << "Error: " << error_stream.str();
+            return 1;
+        }
+        std::vector<palette::MappedPaletteIndex::Match> matches;
+        const size_t num_compared = index.query(
+            query_colors, static_cast<size_t>(num_matches),
+            static_cast<size_t>(probe_radius), exhaustive_, matches);
+        if (verbose_) {
+            std::cout << "Compared " << num_compared << " of "
+                << index.size() << " palettes" << std::endl;
+        }
+        std::vector<palette::Color> colors;
+        for (const auto &match : matches) {
+            index.get_palette(match.index_, colors);
+            std::cout << std::fixed << std::setprecision(4)
+                << match.similarity_ << "\t" << index.name(match.index_)
+                << "\t" << palette::ColorVector(colors).to_string(" ")
+                << std::endl;
+        }
+        return 0;
+    }
+
+    // Add the palette in a palette file, named by the file.
+    static bool add_palette_file(const std::string &input_file,
+                                 palette::PaletteIndexBuilder &builder,
+                                 std::stringstream &error_stream) {
+        palette::PaletteDictionary dictionary;
+        if (!dictionary.read(input_file, error_stream)) {
+            return false;
+        }
+        builder.add(input_file, dictionary.get_colors().get());
+        return true;
+    }
+
+    // Add the colors on each line of a text file that has any as a palette
+    // named by the file and line number.
+    static bool add_lines(const std::string &input_file,
+                          palette::PaletteIndexBuilder &builder,
+                          std::stringstream &error_stream) {
+        std::ifstream input_stream(input_file);
+        if (!input_stream) {
+            error_stream << "Failed to open " << input_file << std::endl;
+            return false;
+        }
+        std::string line;
+        std::vector<palette::Color> colors;
+        for (size_t line_number = 1; std::getline(input_stream, line);
+             ++line_number) {
+            scan_colors(line, colors);
+            if (!colors.empty()) {
+                builder.add(input_file + ":" + std::to_string(line_number),
+                            colors);
+            }
+        }
+        if (input_stream.bad()) {
+            error_stream << "Failed to read " << input_file << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Replace colors with the colors written in text.
+    static void scan_colors(const std::string &text,
+                            std::vector<palette::Color> &colors) {
+        colors.clear();
+        palette::ColorScanner::scan(
+            reinterpret_cast<const unsigned char *>(text.data()), text.size(),
+            [&](const palette::ScannedColor &match) {
+                colors.push_back(palette::Color::from_rgb24(match.rgb_));
+            });
+    }
+
+    bool help_;
+    bool verbose_;
+    bool build_;
+    bool lines_;
+    bool exhaustive_;
+    std::optional<std::string> index_file_;
+    std::optional<std::string> query_colors_;
+    std::optional<std::string> query_file_;
+    std::optional<int> number_;
+    std::optional<int> probe_radius_;
+    std::optional<uint64_t> seed_;
+    std::vector<std::string> input_files_;
+    std::string options_string_;
+};
+}  // namespace
+
+int main(int argc, char **argv) {
+    PalIndex palindex_state;
+    return palindex_state.main(argc, argv);
+}
@@ -0,0 +1,221 @@
+#include <charconv>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "lib/color_scanner.h"
+#include "lib/hex_color_writer.h"
+
+#include "tools/tools_common.h"
+
+namespace {
+
+class ParseColors : public Tool {
+ public:
+    ParseColors() :
+        help_(false),
+        verbose_(false),
+        offsets_(false),
+        unique_(false),
+        output_file_(std::nullopt),
+        input_files_(std::vector<std::string>()),
+        options_string_(std::string()) { }
+
+    // Parse command line input into private members of this ParseColors
+    // object. Return 0 if successful, or return a nonzero int if a fatal
+    // error is encountered.
+    int parse_options(int argc, char **argv) {
+        try {
+            try_parse_options(argc, argv);
+        } catch (cli::MultipleOccurrences &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
+        } catch (cli::UnknownOption &error) {
+            std::cerr << "Error: unrecognized option \""
+                << error.option() << "\"" << std::endl;
+            return exit_more_information();
+        } catch (cli::MissingArgument &error) {
+            std::cerr << "Error: failed to interpret an argument after the "
+                << error.option() << " option" << std::endl;
+            return exit_more_information();
+        } catch (cli::Error &error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return exit_more_information();
+        }
+        return 0;
+    }
+
+    // Evaluate the collected command line options and list the colors found
+    // in each input file. Return 0 if successful, or return a nonzero int if
+    // a fatal error is encountered.
+    int run() {
+        if (help_) {
+            return exit_help();
+        }
+        if (input_files_.empty()) {
+            std::cerr << "Error: No input file specified" << std::endl;
+            return exit_more_information();
+        }
+
+        std::ofstream output_file_stream;
+        if (output_file_.has_value()) {
+            output_file_stream.open(output_file_.value(), std::ios::trunc);
+            if (!output_file_stream) {
+                std::cerr << "Error: failed to open "
+                    << output_file_.value() << std::endl;
+                return 1;
+            }
+        }
+        std::ostream &out = output_file_.has_value()
+            ? output_file_stream : std::cout;
+        palette::HexColorWriter writer(out);
+        std::unordered_set<uint32_t> seen_colors;
+        const bool label_files = (input_files_.size() > 1);
+        size_t num_matches = 0;
+        size_t num_listed = 0;
+
+        for (const auto &input_file : input_files_) {
+            auto list_match = [&](const palette::ScannedColor &match) {
+                ++num_matches;
+                if (unique_ && !seen_colors.insert(match.rgb_).second) {
+                    return;
+                }
+                ++num_listed;
+                if (offsets_) {
+                    if (label_files) {
+                        writer.write_text(input_file.data(),
+                                          input_file.size());
+                        writer.write_text(":", 1);
+                    }
+                    char offset_chars[24];
+                    const auto result = std::to_chars(
+                        offset_chars, offset_chars + sizeof(offset_chars),
+                        match.offset_);
+                    *result.ptr = '\t';
+                    writer.write_text(offset_chars,
+                                      result.ptr + 1 - offset_chars);
+                }
+                writer.write_rgb24(match.rgb_);
+            };
+            std::stringstream error_stream;
+            if (!palette::ColorScanner::scan_file(input_file, list_match,
+                                                  error_stream)) {
+                std::cerr << "Error: " << error_stream.str();
+                return 1;
+            }
+        }
+        if (!writer.flush()) {
+            std::cerr << "Error: failed to write colors" << std::endl;
+            return 1;
+        }
+        if (verbose_ && output_file_.has_value()) {
+            std::cout << "Found " << num_matches << " colors in "
+                << input_files_.size() << " files and listed " << num_listed
+                << " to " << output_file_.value() << std::endl;
+        }
+        return 0;
+    }
+
+ private:
+    // Colors are parsed from text alone, so ImageMagick is never needed.
+    bool uses_magick() { return false; }
+
+    // Return the name of the executable file.
+    std::string exec_name() { return EXEC_NAME; }
+
+    // Return description of options constructed by a call to parse_options.
+    std::string options_string() { return options_string_; }
+
+    // Return summary of the functionality of this tool.
+    std::string usage_string() {
+        std::stringstream usage_stream;
+        usage_stream << "Usage: " << exec_name()
+            << " [arguments] [input ...]" << std::endl
+            << "List colors in hex format found in text files."
+            << std::endl << std::endl;
+        usage_stream << "Recognized forms are #RGB, #RGBA, #RRGGBB, "
+            << "#RRGGBBAA, rgb(), and rgba()." << std::endl
+            << "Colors are listed to stdout in order of appearance unless "
+            << "an output file" << std::endl
+            << "is specified." << std::endl;
+        return usage_stream.str();
+    }
+
+    // Return description of specific examples of using this tool.
+    std::string examples_string() {
+        std::stringstream examples_stream;
+        examples_stream << "Examples: " << exec_name()
+            << " -u ~/.vim/colors/solarized.vim" << std::endl;
+        examples_stream << "      or: " << exec_name()
+            << " --offsets style.css theme.conf -O colors.txt" << std::endl;
+        return examples_stream.str();
+    }
+
+    // Create names and a description for each command line option.
+    void create_options(cli::OptionsDescription &opt,
+                        cli::PositionalOptionsDescription &pos_opt) {
+        const char *help_chars = "Print this help message and exit";
+        const char *verbose_chars = "Print extra information to stdout";
+        const char *offsets_chars = "Prefix each color with its byte offset "
+            "(and file name if there are several input files)";
+        const char *unique_chars =
+            "List each color only the first time it is found";
+
+        const char *input_chars = "Specify an additional input text file";
+        const auto *input_semantic(cli::value<std::vector<std::string>>());
+
+        const char *output_chars = "Specify the path of output text file";
+        const auto *output_semantic(cli::value<std::string>());
+
+        opt.add_options()
+            ("help,h", help_chars)
+            ("verbose,v", verbose_chars)
+            ("offsets,p", offsets_chars)
+            ("unique,u", unique_chars)
+            ("input,I", input_semantic, input_chars)
+            ("output,O", output_semantic, output_chars);
+        pos_opt.add("input", -1);
+
+        std::stringstream options_stream;
+        options_stream << opt;
+        options_string_ = options_stream.str();
+    }
+
+    // Set private fields of this ParseColors object from the command line
+    // options.
+    void set_options(const cli::VariablesMap &var_map) {
+        help_ |= !var_map["help"].empty();
+        verbose_ |= !var_map["verbose"].empty();
+        offsets_ |= !var_map["offsets"].empty();
+        unique_ |= !var_map["unique"].empty();
+        if (!var_map["output"].empty()) {
+            output_file_ = std::optional<std::string>(
+                var_map["output"].as<std::string>());
+        }
+        if (!var_map["input"].empty()) {
+            auto input_opts =
+                var_map["input"].as< std::vector<std::string> >();
+            input_files_.insert(
+                input_files_.end(), input_opts.begin(), input_opts.end());
+        }
+    }
+
+    bool help_;
+    bool verbose_;
+    bool offsets_;
+    bool unique_;
+    std::optional<std::string> output_file_;
+    std::vector<std::string> input_files_;
+    std::string options_string_;
+};
+}  // namespace
+
+int main(int argc, char **argv) {
+    ParseColors parsecolors_state;
+    return parsecolors_state.main(argc, argv);
+}
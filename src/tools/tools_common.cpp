@@ -1,16 +1,430 @@
 #include "tools/tools_common.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <sstream>
 #include <string>
+#include <vector>
 
-#include <boost/program_options.hpp>
+#include <Magick++.h>
+
+namespace cli {
+namespace {
+
+// Help text is wrapped to this many columns, and option names take at most
+// the columns that leave room for min_description_length.
+const size_t line_length = 80;
+const size_t min_description_length = 40;
+
+// Return whether or not token would be taken as a known option rather than
+// as the value of the option before it.
+bool names_option(const std::string &token,
+                  const OptionsDescription &description);
+
+// Return the long form of an option, such as "--color".
+std::string long_form(const OptionsDescription::Option &option);
+
+// Append text to out, wrapped into lines of at most width columns, each
+// after the first indented by indent spaces.
+void write_wrapped(std::ostream &out, const std::string &text,
+                   size_t indent, size_t width);
+}  // namespace
+
+Error::Error(const std::string &message) : std::runtime_error(message) { }
+
+UnknownOption::UnknownOption(const std::string &option) :
+    Error("unrecognised option '" + option + "'"),
+    option_(option) { }
+
+const std::string &UnknownOption::option() const { return option_; }
+
+MultipleOccurrences::MultipleOccurrences(const std::string &option) :
+    Error("option '" + option + "' cannot be specified more than once") { }
+
+MissingArgument::MissingArgument(const std::string &option) :
+    Error("the required argument for option '" + option + "' is missing"),
+    option_(option) { }
+
+const std::string &MissingArgument::option() const { return option_; }
+
+InvalidValue::InvalidValue(const std::string &option,
+                           const std::string &text) :
+    Error("the argument ('" + text + "') for option '" + option
+          + "' is invalid") { }
+
+TooManyPositionals::TooManyPositionals() :
+    Error("too many positional options have been specified on the command "
+          "line") { }
+
+bool parse_value(const std::string &text, std::string &value) {
+    value = text;
+    return true;
+}
+
+bool parse_value(const std::string &text, int &value) {
+    if (text.empty() || std::isspace(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    const int64_t parsed = std::strtoll(text.c_str(), &end, 10);
+    if ((*end != '\0') || (errno != 0)
+        || (parsed < std::numeric_limits<int>::min())
+        || (parsed > std::numeric_limits<int>::max())) {
+        return false;
+    }
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+bool parse_value(const std::string &text, uint64_t &value) {
+    // strtoull would negate a leading '-' rather than reject it.
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    const uint64_t parsed = std::strtoull(text.c_str(), &end, 10);
+    if ((*end != '\0') || (errno != 0)) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+bool parse_value(const std::string &text, double &value) {
+    if (text.empty() || std::isspace(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    const double parsed = std::strtod(text.c_str(), &end);
+    if ((*end != '\0') || (errno != 0) || !std::isfinite(parsed)) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+VariablesMap::VariablesMap() : values_() { }
+
+VariablesMap::VariablesMap(const VariablesMap &other) :
+    values_(other.values_) { }
+
+VariablesMap &VariablesMap::operator=(const VariablesMap &other) {
+    values_ = other.values_;
+    return *this;
+}
+
+const Value &VariablesMap::operator[](const std::string &name) const {
+    static const Value empty_value;
+    const auto found = values_.find(name);
+    return (found == values_.end()) ? empty_value : found->second;
+}
+
+std::any &VariablesMap::at(const std::string &name) {
+    return values_[name].value_;
+}
+
+OptionsDescription::Adder::Adder(OptionsDescription &description) :
+    description_(description) { }
+
+OptionsDescription::Adder::Adder(const Adder &other) :
+    description_(other.description_) { }
+
+OptionsDescription::Adder &OptionsDescription::Adder::operator()(
+    const char *names, const char *description) {
+    return (*this)(names, nullptr, description);
+}
+
+OptionsDescription::Adder &OptionsDescription::Adder::operator()(
+    const char *names, const ValueSemantic *semantic,
+    const char *description) {
+    const std::string names_string(names);
+    const size_t comma = names_string.find(',');
+    const std::string long_name = names_string.substr(0, comma);
+    const char short_name = ((comma != std::string::npos)
+                             && ((comma + 1) < names_string.size()))
+        ? names_string[comma + 1] : '\0';
+    description_.options_.push_back(
+        Option{long_name, short_name, semantic, description});
+    return *this;
+}
+
+OptionsDescription::OptionsDescription(const std::string &caption) :
+    caption_(caption),
+    options_() { }
+
+OptionsDescription::OptionsDescription(const OptionsDescription &other) :
+    caption_(other.caption_),
+    options_(other.options_) { }
+
+OptionsDescription &OptionsDescription::operator=(
+    const OptionsDescription &other) {
+    caption_ = other.caption_;
+    options_ = other.options_;
+    return *this;
+}
+
+OptionsDescription::Adder OptionsDescription::add_options() {
+    return Adder(*this);
+}
+
+const OptionsDescription::Option *OptionsDescription::find_long(
+    const std::string &name) const {
+    const Option *prefixed = nullptr;
+    size_t num_prefixed = 0;
+    for (const Option &option : options_) {
+        if (option.long_name_ == name) {
+            return &option;
+        }
+        if (option.long_name_.compare(0, name.size(), name) == 0) {
+            prefixed = &option;
+            ++num_prefixed;
+        }
+    }
+    return (num_prefixed == 1) ? prefixed : nullptr;
+}
+
+const OptionsDescription::Option *OptionsDescription::find_short(
+    char name) const {
+    for (const Option &option : options_) {
+        if ((option.short_name_ != '\0') && (option.short_name_ == name)) {
+            return &option;
+        }
+    }
+    return nullptr;
+}
+
+std::ostream &operator<<(std::ostream &out,
+                         const OptionsDescription &description) {
+    std::vector<std::string> names;
+    size_t column = 0;
+    for (const auto &option : description.options_) {
+        std::string name = "  ";
+        if (option.short_name_ != '\0') {
+            name += std::string("-") + option.short_name_ + " [ "
+                + long_form(option) + " ]";
+        } else {
+            name += long_form(option);
+        }
+        if (option.semantic_ != nullptr) {
+            name += " arg";
+        }
+        column = std::max(column, name.size() + 1);
+        names.push_back(name);
+    }
+    column = std::min(column, line_length - min_description_length);
+
+    out << description.caption_ << ":" << std::endl;
+    for (size_t o = 0; o < names.size(); ++o) {
+        out << names[o];
+        if (names[o].size() < column) {
+            out << std::string(column - names[o].size(), ' ');
+        } else {
+            out << std::endl << std::string(column, ' ');
+        }
+        write_wrapped(out, description.options_[o].description_, column,
+                      line_length - column);
+        out << std::endl;
+    }
+    return out;
+}
+
+PositionalOptionsDescription::PositionalOptionsDescription() : names_() { }
+
+PositionalOptionsDescription::PositionalOptionsDescription(
+    const PositionalOptionsDescription &other) :
+    names_(other.names_) { }
+
+PositionalOptionsDescription &PositionalOptionsDescription::operator=(
+    const PositionalOptionsDescription &other) {
+    names_ = other.names_;
+    return *this;
+}
+
+PositionalOptionsDescription &PositionalOptionsDescription::add(
+    const std::string &name, int max_count) {
+    names_.emplace_back(name, max_count);
+    return *this;
+}
+
+std::string PositionalOptionsDescription::name_for_position(
+    size_t position) const {
+    for (const auto &name : names_) {
+        if ((name.second < 0)
+            || (position < static_cast<size_t>(name.second))) {
+            return name.first;
+        }
+        position -= static_cast<size_t>(name.second);
+    }
+    return std::string();
+}
+
+void parse(int argc, char **argv, const OptionsDescription &description,
+           const PositionalOptionsDescription &positional,
+           VariablesMap &variables) {
+    size_t num_positionals = 0;
+    bool options_ended = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string token(argv[i]);
+        if (options_ended || (token.size() < 2) || (token[0] != '-')) {
+            const std::string name =
+                positional.name_for_position(num_positionals++);
+            const OptionsDescription::Option *option =
+                description.find_long(name);
+            if (name.empty() || (option == nullptr)
+                || (option->semantic_ == nullptr)) {
+                throw TooManyPositionals();
+            }
+            option->semantic_->store(long_form(*option), token,
+                                     variables.at(option->long_name_));
+            continue;
+        }
+        if (token == "--") {
+            options_ended = true;
+            continue;
+        }
+
+        // Collect the options of the token, and the text after the one
+        // that takes a value, if any, up to the end of the token.
+        std::vector<const OptionsDescription::Option *> options;
+        std::string attached;
+        bool has_attached = false;
+        if (token[1] == '-') {
+            const size_t equals = token.find('=');
+            const std::string name = token.substr(2, equals - 2);
+            const OptionsDescription::Option *option =
+                description.find_long(name);
+            if (option == nullptr) {
+                throw UnknownOption(token.substr(0, equals));
+            }
+            options.push_back(option);
+            if (equals != std::string::npos) {
+                attached = token.substr(equals + 1);
+                has_attached = true;
+                if (option->semantic_ == nullptr) {
+                    throw Error("option '" + long_form(*option)
+                                + "' does not take any arguments");
+                }
+            }
+        } else {
+            for (size_t c = 1; c < token.size(); ++c) {
+                const OptionsDescription::Option *option =
+                    description.find_short(token[c]);
+                if (option == nullptr) {
+                    throw UnknownOption(std::string("-") + token[c]);
+                }
+                options.push_back(option);
+                if ((option->semantic_ != nullptr)
+                    && ((c + 1) < token.size())) {
+                    attached = token.substr(c + 1);
+                    has_attached = true;
+                    break;
+                }
+            }
+        }
+
+        for (const OptionsDescription::Option *option : options) {
+            if (option->semantic_ == nullptr) {
+                variables.at(option->long_name_) = true;
+                continue;
+            }
+            if (!has_attached) {
+                if (((i + 1) >= argc)
+                    || names_option(argv[i + 1], description)) {
+                    throw MissingArgument(long_form(*option));
+                }
+                attached = argv[++i];
+            }
+            option->semantic_->store(long_form(*option), attached,
+                                     variables.at(option->long_name_));
+        }
+    }
+}
+
+namespace {
+
+bool names_option(const std::string &token,
+                  const OptionsDescription &description) {
+    if ((token.size() < 2) || (token[0] != '-')) {
+        return false;
+    }
+    if (token[1] != '-') {
+        return description.find_short(token[1]) != nullptr;
+    }
+    return (token == "--")
+        || (description.find_long(token.substr(2, token.find('=') - 2))
+            != nullptr);
+}
+
+std::string long_form(const OptionsDescription::Option &option) {
+    return "--" + option.long_name_;
+}
+
+void write_wrapped(std::ostream &out, const std::string &text,
+                   size_t indent, size_t width) {
+    std::stringstream words(text);
+    std::string word;
+    size_t line_size = 0;
+    while (words >> word) {
+        if ((line_size > 0) && ((line_size + 1 + word.size()) > width)) {
+            out << std::endl << std::string(indent, ' ');
+            line_size = 0;
+        } else if (line_size > 0) {
+            out << " ";
+            ++line_size;
+        }
+        out << word;
+        line_size += word.size();
+    }
+}
+}  // namespace
+}  // namespace cli
+
+int Tool::main(int argc, char **argv) {
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start = Clock::now();
+    int result = parse_options(argc, argv);
+    const Clock::time_point parsed = Clock::now();
+    Clock::time_point initialized = parsed;
+    if (result == 0) {
+        if (uses_magick()) {
+            Magick::InitializeMagick(*argv);
+        }
+        initialized = Clock::now();
+        result = run();
+    }
+    const Clock::time_point finished = Clock::now();
+
+    const char *startup_times = std::getenv(startup_times_variable);
+    if ((startup_times != nullptr) && (*startup_times != '\0')) {
+        using Milliseconds = std::chrono::duration<double, std::milli>;
+        std::cerr << exec_name() << ": " << std::fixed
+            << std::setprecision(3) << "options "
+            << Milliseconds(parsed - start).count() << " ms, ImageMagick "
+            << Milliseconds(initialized - parsed).count() << " ms, run "
+            << Milliseconds(finished - initialized).count() << " ms"
+            << std::endl;
+    }
+    return result;
+}
 
 // Bare minimum functionality. Ideally the derived class redefines this
 // function to do more specific things with specific errors.
 int Tool::parse_options(int argc, char **argv) {
     try {
         try_parse_options(argc, argv);
-    } catch (boost::program_options::error &error) {
+    } catch (cli::Error &error) {
         std::cerr << "Error: " << error.what() << std::endl;
         return exit_more_information();
     }
@@ -29,16 +443,12 @@ int Tool::exit_more_information() {
     return 1;
 }
 
-// Common boost::program_options boilerplate.
 void Tool::try_parse_options(int argc, char **argv) {
-    boost::program_options::options_description opt_descr("Arguments");
-    boost::program_options::positional_options_description pos_opt_descr;
+    cli::OptionsDescription opt_descr("Arguments");
+    cli::PositionalOptionsDescription pos_opt_descr;
     create_options(opt_descr, pos_opt_descr);
-    boost::program_options::variables_map var_map;
-    boost::program_options::command_line_parser parser(argc, argv);
-    auto &parser_opt = parser.options(opt_descr).positional(pos_opt_descr);
-    boost::program_options::store(parser_opt.run(), var_map);
-    boost::program_options::notify(var_map);
+    cli::VariablesMap var_map;
+    cli::parse(argc, argv, opt_descr, pos_opt_descr, var_map);
     set_options(var_map);
 }
 
@@ -1,12 +1,247 @@
 #pragma once
 
+#include <any>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-#include <boost/program_options.hpp>
+// A small command line parser for the tools, which starts in microseconds
+// and needs no library. It accepts "--name value", "--name=value", unique
+// prefixes of long names, "-n value", "-nvalue", grouped short flags such as
+// "-hv", and "--" before arguments that begin with '-'. A lone "-" is a
+// positional argument.
+namespace cli {
+
+// Base of every error parse throws.
+class Error : public std::runtime_error {
+ public:
+    explicit Error(const std::string &message);
+};
+
+class UnknownOption : public Error {
+ public:
+    explicit UnknownOption(const std::string &option);
+
+    // Return the option as it was given, such as "--colour" or "-x".
+    const std::string &option() const;
+
+ private:
+    std::string option_;
+};
+
+class MultipleOccurrences : public Error {
+ public:
+    explicit MultipleOccurrences(const std::string &option);
+};
+
+class MissingArgument : public Error {
+ public:
+    explicit MissingArgument(const std::string &option);
+
+    // Return the long form of the option, such as "--color".
+    const std::string &option() const;
+
+ private:
+    std::string option_;
+};
+
+class InvalidValue : public Error {
+ public:
+    InvalidValue(const std::string &option, const std::string &text);
+};
+
+class TooManyPositionals : public Error {
+ public:
+    TooManyPositionals();
+};
+
+class OptionsDescription;
+class PositionalOptionsDescription;
+class VariablesMap;
+
+// Parse the arguments after argv[0] into variables. Throw an Error if the
+// arguments do not fit the descriptions.
+void parse(int argc, char **argv, const OptionsDescription &description,
+           const PositionalOptionsDescription &positional,
+           VariablesMap &variables);
+
+// Set value to the number or text in text. Return whether or not all of
+// text is a valid value of that type.
+bool parse_value(const std::string &text, std::string &value);
+bool parse_value(const std::string &text, int &value);
+bool parse_value(const std::string &text, uint64_t &value);
+bool parse_value(const std::string &text, double &value);
+
+// How to convert the text after an option into its value.
+class ValueSemantic {
+ public:
+    virtual ~ValueSemantic() { }
+
+    // Convert text and store it into value for the option of the given
+    // long form, appending to value if the option may repeat.
+    virtual void store(const std::string &option, const std::string &text,
+                       std::any &value) const = 0;
+};
+
+template <typename T>
+class TypedValue final : public ValueSemantic {
+ public:
+    void store(const std::string &option, const std::string &text,
+               std::any &value) const override;
+};
+
+// Return the semantic of an option that takes one value of type T, or one
+// value per occurrence if T is a vector.
+template <typename T>
+const ValueSemantic *value() {
+    static const TypedValue<T> semantic;
+    return &semantic;
+}
+
+// The value of one option, or an empty value if it was not given.
+class Value {
+ public:
+    Value() : value_() { }
+
+    bool empty() const { return !value_.has_value(); }
+
+    template <typename T>
+    const T &as() const { return *std::any_cast<T>(&value_); }
+
+ private:
+    friend class VariablesMap;
+
+    std::any value_;
+};
+
+class VariablesMap {
+ public:
+    VariablesMap();
+    VariablesMap(const VariablesMap &other);
+    VariablesMap &operator=(const VariablesMap &other);
+
+    // Return the value of the option of the given long name.
+    const Value &operator[](const std::string &name) const;
+
+ private:
+    friend void parse(int argc, char **argv,
+                      const OptionsDescription &description,
+                      const PositionalOptionsDescription &positional,
+                      VariablesMap &variables);
+
+    // Return the value of the option of the given long name to store into.
+    std::any &at(const std::string &name);
+
+    std::map<std::string, Value> values_;
+};
+
+class OptionsDescription {
+ public:
+    struct Option final {
+        std::string long_name_;
+        char short_name_;
+        // Null for a flag that takes no value.
+        const ValueSemantic *semantic_;
+        std::string description_;
+    };
+
+    // Adds options through calls such as
+    // add_options()("help,h", "Print help")("number,n", value<int>(), "...").
+    class Adder final {
+     public:
+        explicit Adder(OptionsDescription &description);
+        Adder(const Adder &other);
+
+        Adder &operator()(const char *names, const char *description);
+        Adder &operator()(const char *names, const ValueSemantic *semantic,
+                          const char *description);
+
+     private:
+        Adder &operator=(const Adder &other) = delete;
+
+        OptionsDescription &description_;
+    };
+
+    explicit OptionsDescription(const std::string &caption);
+    OptionsDescription(const OptionsDescription &other);
+    OptionsDescription &operator=(const OptionsDescription &other);
+
+    Adder add_options();
+
+    // Return the option whose long name is name or, failing that, the only
+    // option whose long name starts with name, or null if there is none.
+    const Option *find_long(const std::string &name) const;
+    const Option *find_short(char name) const;
+
+    // Print the options as help text, with descriptions wrapped in a column.
+    friend std::ostream &operator<<(std::ostream &out,
+                                    const OptionsDescription &description);
+
+ private:
+    std::string caption_;
+    std::vector<Option> options_;
+};
+
+class PositionalOptionsDescription {
+ public:
+    PositionalOptionsDescription();
+    PositionalOptionsDescription(const PositionalOptionsDescription &other);
+    PositionalOptionsDescription &operator=(
+        const PositionalOptionsDescription &other);
+
+    // Give the next max_count positional arguments, or all the remaining
+    // ones if max_count is -1, to the option of the given long name.
+    PositionalOptionsDescription &add(const std::string &name,
+                                      int max_count);
+
+    // Return the long name of the option that takes the positional argument
+    // at the given index, or an empty string if none does.
+    std::string name_for_position(size_t position) const;
+
+ private:
+    std::vector<std::pair<std::string, int>> names_;
+};
+
+template <typename T>
+void TypedValue<T>::store(const std::string &option,
+                          const std::string &text, std::any &value) const {
+    if constexpr (std::is_same<T, std::vector<std::string>>::value) {
+        if (!value.has_value()) {
+            value = T();
+        }
+        std::any_cast<T>(&value)->push_back(text);
+    } else {
+        if (value.has_value()) {
+            throw MultipleOccurrences(option);
+        }
+        T parsed{};
+        if (!parse_value(text, parsed)) {
+            throw InvalidValue(option, text);
+        }
+        value = parsed;
+    }
+}
+}  // namespace cli
 
 class Tool {
  public:
+    // Environment variable that, when set, makes main print to stderr how
+    // long parsing the options, initializing ImageMagick, and the run took.
+    static constexpr const char *startup_times_variable =
+        "PALETTE_STARTUP_TIMES";
+
     virtual ~Tool() { }
+
+    // Parse the options, initialize ImageMagick if the run uses it, and
+    // run. Return the exit status of the tool.
+    int main(int argc, char **argv);
+
     virtual int parse_options(int argc, char **argv);
     virtual int run() = 0;
 
@@ -15,9 +250,14 @@ class Tool {
     int exit_more_information();
     void try_parse_options(int argc, char **argv);
     virtual void create_options(
-        boost::program_options::options_description &opt,
-        boost::program_options::positional_options_description &pos_opt) = 0;
-    virtual void set_options(boost::program_options::variables_map var_map) = 0;
+        cli::OptionsDescription &opt,
+        cli::PositionalOptionsDescription &pos_opt) = 0;
+    virtual void set_options(const cli::VariablesMap &var_map) = 0;
+
+    // Return whether or not the run that the parsed options ask for uses
+    // ImageMagick. Runs that only print help or text skip initializing it,
+    // which takes most of the time of a short run.
+    virtual bool uses_magick() = 0;
 
     virtual std::string help_option_name();
     virtual std::string exec_name() = 0;
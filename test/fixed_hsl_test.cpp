@@ -0,0 +1,140 @@
+// Check the fixed-point HSL conversions of every 8-bit color: the batch
+// conversion agrees exactly with the scalar one, ImageMagick agrees within
+// one quantum, and every color converts back to itself. Then time the batch
+// conversion against Magick::ColorHSL. Exit with 1 on any disagreement.
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include <Magick++.h>
+
+#include "lib/color.h"
+#include "lib/cpu_features.h"
+#include "lib/fixed_hsl.h"
+#include "lib/packed_color.h"
+#include "lib/parallel.h"
+
+namespace {
+
+const size_t num_colors = size_t(1) << 24;
+// Colors converted at a time.
+const size_t block_size = size_t(1) << 16;
+// Disagreements reported before the check stops listing them.
+const size_t max_reported_errors = 10;
+
+// Return whether or not a fixed-point value is within one quantum of a
+// value in [0, 1].
+bool within_one_quantum(uint32_t fixed, double value);
+
+// Check every color, report the first few disagreements to std::cerr, and
+// return the number of colors that disagree.
+size_t check_all_rgb24();
+
+// Time converting every color in fixed point and through Magick::ColorHSL,
+// and print both times.
+void time_all_rgb24();
+}  // namespace
+
+int main(int, char **argv) {
+    Magick::InitializeMagick(*argv);
+    const size_t num_errors = check_all_rgb24();
+    if (num_errors > 0) {
+        std::cerr << "Error: " << num_errors << " of " << num_colors
+            << " colors failed the HSL check" << std::endl;
+        return 1;
+    }
+    std::cout << "Fixed-point HSL agrees with ImageMagick within one "
+        << "quantum for all " << num_colors << " colors" << std::endl;
+    time_all_rgb24();
+    return 0;
+}
+
+namespace {
+
+bool within_one_quantum(uint32_t fixed, double value) {
+    return std::fabs((fixed / static_cast<double>(palette::FixedHsl::one))
+                     - value) <= (1.0 / MagickCore::QuantumRange);
+}
+
+size_t check_all_rgb24() {
+    std::mutex error_mutex;
+    size_t num_errors = 0;
+    palette::Parallel::run(num_colors / block_size, [&](size_t block) {
+        std::vector<uint32_t> rgb(block_size, 0);
+        for (size_t i = 0; i < block_size; ++i) {
+            rgb[i] = static_cast<uint32_t>((block * block_size) + i);
+        }
+        std::vector<palette::FixedHsl> batch(block_size,
+                                             palette::FixedHsl{0, 0, 0});
+        palette::FixedHsl::from_rgb24(rgb.data(), rgb.size(), batch.data());
+
+        for (size_t i = 0; i < block_size; ++i) {
+            const palette::FixedHsl hsl = palette::FixedHsl::from_rgb24(rgb[i]);
+            const Magick::ColorHSL magick_hsl(
+                palette::PackedColor8::from_rgb24(rgb[i]).to_magick());
+            const char *error = nullptr;
+            if (batch[i] != hsl) {
+                error = "batch conversion differs";
+            } else if (!within_one_quantum(hsl.hue_, magick_hsl.hue())
+                       || !within_one_quantum(hsl.saturation_,
+                                              magick_hsl.saturation())
+                       || !within_one_quantum(hsl.lightness_,
+                                              magick_hsl.lightness())) {
+                error = "differs from ImageMagick by more than one quantum";
+            } else if (hsl.to_rgb<uint8_t>().to_rgb24() != rgb[i]) {
+                error = "does not convert back to itself";
+            }
+            if (error == nullptr) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (num_errors < max_reported_errors) {
+                std::cerr << "HSL of #" << std::hex << std::uppercase
+                    << std::setfill('0') << std::setw(6) << rgb[i]
+                    << std::dec << " " << error << std::endl;
+            }
+            ++num_errors;
+        }
+    });
+    return num_errors;
+}
+
+void time_all_rgb24() {
+    std::vector<uint32_t> colors(num_colors, 0);
+    for (size_t i = 0; i < num_colors; ++i) {
+        colors[i] = static_cast<uint32_t>(i);
+    }
+    std::vector<palette::FixedHsl> hsls(num_colors,
+                                        palette::FixedHsl{0, 0, 0});
+    auto start = std::chrono::steady_clock::now();
+    palette::FixedHsl::from_rgb24(colors.data(), num_colors, hsls.data());
+    const double fixed_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+
+    // Keep a sum so that the conversions are not optimized away.
+    double lightness_sum = 0.0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_colors; ++i) {
+        const Magick::ColorHSL hsl(
+            palette::Color::from_rgb24(colors[i]).get());
+        lightness_sum += hsl.lightness();
+    }
+    const double magick_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::fixed << std::setprecision(1)
+        << "Converted " << num_colors << " colors in " << fixed_ms
+        << " ms in fixed point with the "
+        << palette::CpuFeatures::level_to_string(
+            palette::CpuFeatures::active())
+        << " kernels and " << magick_ms << " ms through Magick::ColorHSL"
+        << " (mean lightness " << std::setprecision(6)
+        << (lightness_sum / num_colors) << ")" << std::endl;
+}
+}  // namespace